@@ -57,9 +57,71 @@
  *  - Changed on how to obtaining product-type
  *  - Depreciated GetArticleCode(). Still supporting backward compatibility
  *  - Update to documentation
+ *
+ *  October 2026
+ *  - Added storing samples in a store directory (-o, -i). Use spsquery
+ *    to read them back.
+ *  - Added tiered retention with background rollups (-K)
+ *  - Added group commit of the sample store with optional tmpfs staging (-c).
+ *    SIGINT / SIGTERM now stop the main loop, so pending samples are written.
+ *    A second one stops at once.
+ *  - Added circular sample file of fixed size (-R)
+ *  - Added replay of stored samples in place of the SPS30 (-r). No
+ *    hardware or super user is needed for a replay.
+ *  - Added background zstd compression of sealed segments (-z), needs a
+ *    build with make ZSTD=yes
+ *  - Added MQTT publisher with a spool for when the broker is away (-Q)
+ *  - Added InfluxDB line protocol exporter over UDP or TCP (-X)
+ *  - Added streaming of samples to the aggregator spsagg (-G)
+ *  - Added sample log with sequence numbers for subscribers that
+ *    resume after a reconnect (-L)
+ *  - Added web dashboard with server-sent events (-W)
+ *  - Added /api/history to the web server: a range of the store
+ *    downsampled with LTTB or min/max
+ *  - Added hour and day statistics with percentiles, updated with each
+ *    sample (-U)
+ *  - Added alert rules evaluated on each sample (-e)
+ *  - Added pre / post trigger capture of the raw samples around an
+ *    alert with the action capture (-k)
+ *  - Added report by exception with a swinging door deadband before the
+ *    display and the exporters (-y)
+ *  - Added duty cycling within a power budget with a learned settle time
+ *    after wake-up (-p)
+ *  - Added adaptive sampling rate from 1 Hz to a minimum rate, driven
+ *    by the change and variation of PM2.5 and PM10 (-s)
+ *  - Added quality flags to each sample: warm-up, cleaning and settling
+ *    detected from the values, status fault and retried read. A failed
+ *    read is retried once, else the sample is skipped. Samples can be
+ *    left out of the output (-q)
+ *  - Added fan cleaning after a dose of particles instead of a fixed
+ *    time, staggered over the sensors of a site (-j)
+ *  - Added housekeeping at its own rates (-g): status register, clean
+ *    interval, serial number / firmware and the system clock. Off
+ *    without -g, except the status register when the sample flags are
+ *    used (-E, -k, store, rules, exporters), which is polled instead of
+ *    read with each sample.
  **********************************************************************/
 
 # include "sps30lib.h"
+# include "spsstore.h"
+# include "spsrollup.h"
+# include "spsring.h"
+# include "spsreplay.h"
+# include "spszip.h"
+# include "spsmqtt.h"
+# include "spsinflux.h"
+# include "spsstream.h"
+# include "spslog.h"
+# include "spshttp.h"
+# include "spscube.h"
+# include "spsrule.h"
+# include "spscapture.h"
+# include "spsdeadband.h"
+# include "spspower.h"
+# include "spssampler.h"
+# include "spsquality.h"
+# include "spsclean.h"
+# include "spshouse.h"
 # include <getopt.h>
 # include <signal.h>
 # include <stdint.h>
@@ -120,6 +182,81 @@ typedef struct sps_par
     bool   DevStatus;            // display device status 
     bool   OptMode ;            //  perform sleep /wake up during wait-time
 
+    /* option sample store */
+    char   store[MAXBUF];       // store directory (empty = no store)
+    uint16_t sensor_id;         // sensor id in store
+    uint32_t commit_int;        // seconds between commits (data at risk)
+    uint32_t commit_size;       // samples per commit (0 = full block)
+    char   stage[MAXBUF];       // tmpfs staging directory (empty = none)
+    char   ring[MAXBUF];        // circular sample file (empty = none)
+    uint16_t ring_days;         // days to keep in circular file
+    bool   retention;           // perform rollups and retention
+    int    zip_level;           // zstd level of sealed segments (-1 = none)
+    bool   cube;                // hour and day statistics
+
+    /* option MQTT */
+    char   mqtt[MAXBUF];        // broker host[:port] (empty = none)
+    char   mqtt_topic[MAXBUF];  // topic template (empty = MQTT_TOPIC)
+    char   mqtt_id[MAXBUF];     // client id (empty = sps30-<sensor id>)
+    char   mqtt_spool[MAXBUF];  // spool file (empty = none)
+    int    mqtt_qos;            // 0 or 1
+    uint32_t mqtt_agg;          // seconds between aggregates (0 = none)
+
+    /* option InfluxDB */
+    char   influx[MAXBUF];      // udp://host:port or tcp://host:port (empty = none)
+    char   influx_site[MAXBUF]; // site tag (empty = none)
+    uint32_t influx_flush;      // ms before a batch is sent (0 = default)
+
+    /* option stream */
+    char   stream[MAXBUF];      // aggregator host:port or unix socket (empty = none)
+
+    /* option sample log */
+    char   log[MAXBUF];         // listen address for subscribers (empty = none)
+
+    /* option web server */
+    char   web[MAXBUF];         // listen address of the dashboard (empty = none)
+
+    /* option alert rules */
+    char   rules[MAXBUF];       // rule file (empty = none)
+
+    /* option capture */
+    char   capture[MAXBUF];     // directory for captures (empty = none)
+    uint32_t capture_pre;       // minutes before a trigger
+    uint32_t capture_post;      // minutes after a trigger
+
+    /* option deadband */
+    char   deadband[MAXBUF];    // deadbands (empty = report every sample)
+
+    /* option power budget */
+    double power_budget;        // mW (0 = no duty cycling)
+    uint32_t power_max;         // seconds of sleep at most
+
+    /* option adaptive sampler */
+    uint32_t sampler_max;       // seconds between samples at most (0 = fixed -w)
+    double sampler_rate;        // percent per minute
+    double sampler_var;         // percent
+
+    /* option quality */
+    uint16_t quality;           // SPS_FLAG_xxx left out of the output
+
+    /* option dose based cleaning */
+    double clean_mass;          // ug/m3 * h (0 = automatic clean of the SPS30)
+    double clean_num;           // #/cm3 * h
+    uint32_t clean_max;         // days between cleanings at most
+    uint16_t clean_slot;        // slot of this sensor
+    uint16_t clean_slots;       // sensors of the site
+
+    /* option housekeeping */
+    bool     house_on;            // -g given
+    uint32_t house[HOUSE_TASKS];  // seconds between the tasks (0 = off)
+
+    /* option replay */
+    char   replay[MAXBUF];      // store directory or circular file (empty = live)
+    int    replay_sensor;       // sensor id in source (-1 = as -i)
+    double replay_speed;        // 1 = recorded pace, 0 = as fast as possible
+    bool   replay_rebase;       // move timestamps to now
+    uint16_t keep[3];           // days to keep raw, minute, hour
+
     /* to store the SPS30 values */
     struct sps_values v;
         
@@ -137,8 +274,36 @@ typedef struct sps_par
 /* used as part of p_printf() */
 bool NoColor=false;
 
+/* set by signal handler to stop the main loop */
+volatile sig_atomic_t StopLoop = 0;
+
 /* global constructor */ 
 SPS30 MySensor;
+bool SensorOpen = false;        // not during a replay
+uint32_t BusErrors = 0;         // failed reads of the SPS30
+uint64_t Excluded = 0;          // samples left out of the output (-q)
+uint64_t Skipped = 0;           // samples not read after a retry
+
+/* sample store */
+SPSstore Store;
+SPSrollup Rollup;
+SPSring Ring;
+SPSreplay Replay;
+SPSzip Zip;
+SPSmqtt Mqtt;
+SPSinflux Influx;
+SPSstream Stream;
+SPSlog Log;
+SPShttp Web;
+SPScube Cube;
+SPSrule Rules;
+SPScapture Capture;
+SPSdeadband Deadband;
+SPSpower Power;
+SPSsampler Sampler;
+SPSquality Quality;
+SPSclean Clean;
+SPShouse House;
 
 char progname[20];
 
@@ -188,13 +353,362 @@ void p_printf(int level, char *format, ...) {
     free(col);
 }
  
+/*********************************************************************
+*  @brief report the write amplification and compactor CPU time
+**********************************************************************/
+void store_report()
+{
+    struct store_stats st;
+    struct rollup_stats rs;
+    struct zip_stats zs;
+
+    if (! Store.is_open()) return;
+
+    Store.stats(&st);
+    Rollup.stats(&rs);
+    Zip.stats(&zs);
+
+    if (st.bytes_in == 0) return;
+
+    p_printf(BLUE, (char *) "Store: %llu samples, %llu bytes written, write amplification %.1f\n",
+        (unsigned long long) st.samples, (unsigned long long) (st.bytes_written + rs.bytes_written),
+        (double) (st.bytes_written + rs.bytes_written) / st.bytes_in);
+
+    if (st.elapsed > 0)
+        p_printf(BLUE, (char *) "Store: %llu commits, %.1f writes/hour, data at risk max %u s (configured %u s)\n",
+            (unsigned long long) st.commits, st.writes * 3600.0 / st.elapsed, st.max_risk, st.interval);
+
+    if (rs.runs > 0)
+        p_printf(BLUE, (char *) "Rollup: %u passes, %llu rollups, %u raw / %u rollup files expired, CPU %.3f s\n",
+            rs.runs, (unsigned long long) rs.rollups, st.expired, rs.expired, rs.cpu);
+
+    if (zs.segments > 0)
+        p_printf(BLUE, (char *) "Zip: %u segments, ratio %.1f (%.1f on disk), CPU %.3f s\n",
+            zs.segments, (double) zs.raw_bytes / zs.zip_bytes, (double) zs.disk_bytes / zs.zip_bytes, zs.cpu);
+}
+
+/*********************************************************************
+*  @brief report the messages published and the time per sample (after
+*  Mqtt.close(), which moves the messages not sent to the spool)
+**********************************************************************/
+void mqtt_report()
+{
+    struct mqtt_stats st;
+
+    Mqtt.stats(&st);
+
+    if (st.samples == 0 && st.replayed == 0) return;
+
+    p_printf(BLUE, (char *) "MQTT: %llu published (%llu from spool) in %u batches, %llu spooled, %llu dropped, %u connects\n",
+        (unsigned long long) st.published, (unsigned long long) st.replayed, st.batches,
+        (unsigned long long) st.spooled, (unsigned long long) st.dropped, st.connects);
+
+    if (st.samples > 0)
+        p_printf(BLUE, (char *) "MQTT: %.2f us per sample\n", st.sample_time * 1e6 / st.samples);
+}
+
+/*********************************************************************
+*  @brief report the lines exported and the time per sample
+**********************************************************************/
+void influx_report()
+{
+    struct influx_stats st;
+
+    Influx.stats(&st);
+
+    if (st.lines == 0) return;
+
+    p_printf(BLUE, (char *) "Influx: %llu lines, %llu sent in %u batches / %u packets, %llu dropped, %u retries\n",
+        (unsigned long long) st.lines, (unsigned long long) st.sent, st.batches, st.packets,
+        (unsigned long long) st.dropped, st.retries);
+
+    p_printf(BLUE, (char *) "Influx: %.2f us per sample, %.1f bytes per line\n",
+        st.format_time * 1e6 / st.lines, st.sent ? (double) st.bytes / st.sent : 0);
+}
+
+/*********************************************************************
+*  @brief report the samples streamed to the aggregator
+**********************************************************************/
+void stream_report()
+{
+    struct stream_stats st;
+
+    Stream.stats(&st);
+
+    if (st.samples == 0) return;
+
+    p_printf(BLUE, (char *) "Stream: %llu samples, %llu sent, %llu dropped, %u connects\n",
+        (unsigned long long) st.samples, (unsigned long long) st.sent,
+        (unsigned long long) st.dropped, st.connects);
+}
+
+/*********************************************************************
+*  @brief report the samples sent to subscribers of the log
+**********************************************************************/
+void log_report()
+{
+    struct log_stats st;
+
+    Log.stats(&st);
+
+    if (st.connects == 0) return;
+
+    p_printf(BLUE, (char *) "Log: %u subscribers, %llu lines from the store, %llu live, %u gaps, %llu bytes\n",
+        st.connects, (unsigned long long) st.stored, (unsigned long long) st.live, st.gaps,
+        (unsigned long long) st.bytes);
+}
+
+/*********************************************************************
+*  @brief report the alerts of the rules
+**********************************************************************/
+void rule_report()
+{
+    struct rule_stats st;
+
+    if (! Rules.is_open()) return;
+
+    Rules.stats(&st);
+
+    p_printf(BLUE, (char *) "Rules: %u rules, %u windows, %llu fired, %llu cleared, %.2f us per sample\n",
+        st.rules, st.windows, (unsigned long long) st.fired, (unsigned long long) st.cleared,
+        st.samples ? st.eval_time * 1e6 / st.samples : 0);
+
+    if (st.exec_dropped)
+        p_printf(RED, (char *) "Rules: %u commands not run, too many running\n", st.exec_dropped);
+}
+
+/*********************************************************************
+*  @brief report the captures
+**********************************************************************/
+void capture_report()
+{
+    struct capture_stats st;
+
+    Capture.stats(&st);
+
+    if (st.sensors == 0) return;
+
+    p_printf(BLUE, (char *) "Capture: %u captures (%u extended), %llu samples written, %llu bytes of rings\n",
+        st.captures, st.extended, (unsigned long long) st.records, (unsigned long long) st.memory);
+
+    if (st.failed)
+        p_printf(RED, (char *) "Capture: %u files could not be written\n", st.failed);
+}
+
+/*********************************************************************
+*  @brief report the requests and events of the web server
+**********************************************************************/
+void web_report()
+{
+    struct http_stats st;
+
+    Web.stats(&st);
+
+    if (st.requests == 0) return;
+
+    p_printf(BLUE, (char *) "Web: %llu requests, %u viewers at most, %u too slow, %llu events, %llu bytes\n",
+        (unsigned long long) st.requests, st.viewers_max, st.slow, (unsigned long long) st.events,
+        (unsigned long long) st.bytes);
+
+    if (st.events > 0)
+        p_printf(BLUE, (char *) "Web: %.2f us per sample to encode\n", st.encode_time * 1e6 / st.events);
+
+    if (st.hist > 0 || st.hist_busy > 0)
+        p_printf(BLUE, (char *) "Web: %u history queries, %.1f ms on average, %u refused (busy)\n",
+            st.hist, st.hist > 0 ? st.hist_time * 1e3 / st.hist : 0, st.hist_busy);
+}
+
+/*****************************************************************
+ * @brief : publish / export a sample, never blocks on the network
+ * @param s : sample
+ ****************************************************************/
+void export_sample(struct sps_sample *s)
+{
+    Mqtt.sample(s);
+    Influx.sample(s);
+    Stream.sample(s);
+    Web.sample(s);
+}
+
+/*********************************************************************
+*  @brief report the estimated energy of the duty cycling
+**********************************************************************/
+void power_report()
+{
+    struct power_stats st;
+
+    if (! Power.is_open()) return;
+
+    Power.stats(&st);
+
+    if (st.samples == 0) return;
+
+    p_printf(BLUE, (char *) "Power: %llu samples, settled in %.1f s (%u timeouts), awake %.0f s, asleep %.0f s\n",
+        (unsigned long long) st.samples, st.settle, st.timeouts, st.awake, st.asleep);
+    p_printf(BLUE, (char *) "Power: %.1f mJ per sample, %.2f mW on average\n", st.energy / st.samples,
+        st.awake + st.asleep > 0 ? st.energy / (st.awake + st.asleep) : 0);
+}
+
+/*********************************************************************
+*  @brief report the samples taken by the adaptive sampler
+**********************************************************************/
+void sampler_report()
+{
+    struct sampler_stats st;
+
+    if (! Sampler.is_open()) return;
+
+    Sampler.stats(&st);
+
+    if (st.samples == 0) return;
+
+    p_printf(BLUE, (char *) "Sampler: %llu samples over %llu s (%.1f s on average), %.1f%% at 1 Hz, raised %u times\n",
+        (unsigned long long) st.samples, (unsigned long long) st.seconds, (double) st.seconds / st.samples,
+        st.fast * 100.0 / st.samples, st.raises);
+}
+
+/*********************************************************************
+*  @brief report the quality of the samples read
+**********************************************************************/
+void quality_report()
+{
+    struct quality_stats st;
+    char   buf[MAXBUF], *p = buf;
+    int    n;
+
+    Quality.stats(&st);
+
+    if (Skipped > 0)
+        p_printf(RED, (char *) "Quality: %llu samples skipped, the read failed twice\n", (unsigned long long) Skipped);
+
+    /* a replay has the quality as stored */
+    if (st.samples == 0) {
+        if (Excluded > 0)
+            p_printf(BLUE, (char *) "Quality: %llu samples left out\n", (unsigned long long) Excluded);
+        return;
+    }
+
+    buf[0] = 0x0;
+
+    for (int i = 0; i < 8; i++) {
+        if (st.flagged[i] == 0) continue;
+
+        for (unsigned j = 0; j < sizeof(sps_quality_name) / sizeof(sps_quality_name[0]); j++) {
+            if (sps_quality_name[j].flag != 0x100 << i) continue;
+
+            // stop when the buffer is full
+            n = snprintf(p, buf + sizeof(buf) - p, ", %s %llu", sps_quality_name[j].name,
+                (unsigned long long) st.flagged[i]);
+
+            if (n < 0 || n >= buf + sizeof(buf) - p) {
+                *p = 0x0;
+                i = 8;
+                break;
+            }
+
+            p += n;
+        }
+    }
+
+    p_printf(BLUE, (char *) "Quality: %llu samples%s, stable after %.1f s on average (%u of %u by time), %llu left out\n",
+        (unsigned long long) st.samples, buf, st.stable, st.timeouts, st.periods, (unsigned long long) Excluded);
+}
+
+/*********************************************************************
+*  @brief report the fan cleanings by dose
+**********************************************************************/
+void clean_report()
+{
+    struct clean_stats st;
+
+    if (! Clean.is_open()) return;
+
+    Clean.stats(&st);
+
+    p_printf(BLUE, (char *) "Clean: %u fan cleanings (%u by mass, %u by number, %u by time), %llu samples waited for the slot, dose at %.0f%% / %.0f%%\n",
+        st.cleanings, st.by_mass, st.by_num, st.by_time, (unsigned long long) st.deferred, st.mass, st.num);
+}
+
+/*********************************************************************
+*  @brief report the housekeeping
+**********************************************************************/
+void house_report()
+{
+    struct house_stats st;
+
+    if (! House.is_open()) return;
+
+    House.stats(&st);
+
+    p_printf(BLUE, (char *) "House: status %u polls (%u faults), clean interval %u checks (%u restored), device %u checks (%u changed), clock %u checks (%u steps)\n",
+        st.runs[HOUSE_T_STATUS], st.changes[HOUSE_T_STATUS], st.runs[HOUSE_T_CLEAN], st.changes[HOUSE_T_CLEAN],
+        st.runs[HOUSE_T_DEVICE], st.changes[HOUSE_T_DEVICE], st.runs[HOUSE_T_CLOCK], st.changes[HOUSE_T_CLOCK]);
+    p_printf(BLUE, (char *) "House: %u bus errors, %u tasks waited for a read\n",
+        st.errors[HOUSE_T_STATUS] + st.errors[HOUSE_T_CLEAN] + st.errors[HOUSE_T_DEVICE], st.yielded);
+}
+
+/*********************************************************************
+*  @brief report the samples left out by the deadband
+**********************************************************************/
+void deadband_report()
+{
+    struct deadband_stats st;
+
+    if (! Deadband.is_open()) return;
+
+    Deadband.stats(&st);
+
+    if (st.samples == 0) return;
+
+    p_printf(BLUE, (char *) "Deadband: %llu of %llu samples reported (%.1f : 1), %llu heartbeats, %llu status changes\n",
+        (unsigned long long) st.reported, (unsigned long long) st.samples,
+        st.reported ? (double) st.samples / st.reported : 0, (unsigned long long) st.heartbeats,
+        (unsigned long long) st.status);
+}
+
 /*********************************************************************
 *  @brief close hardware and program correctly
 **********************************************************************/
 void closeout()
 {
+   struct sps_sample s;
+
    /* reset pins in Raspberry Pi */
-   MySensor.close();
+   if (SensorOpen) MySensor.close();
+
+   /* stop compactor and write pending samples */
+   Rollup.stop();
+   Zip.stop();
+   store_report();
+   Store.close();
+   Cube.close();
+   Ring.close();
+   Replay.close();
+
+   /* the last sample held back by the deadband */
+   if (Deadband.is_open() && Deadband.flush(&s)) export_sample(&s);
+   deadband_report();
+   power_report();
+   sampler_report();
+   quality_report();
+   clean_report();
+   Clean.close();
+   house_report();
+
+   Mqtt.close();
+   mqtt_report();
+   Influx.close();
+   influx_report();
+   Stream.close();
+   stream_report();
+   Log.close();
+   log_report();
+   Web.close();
+   web_report();
+   rule_report();
+   Rules.close();
+   Capture.close();
+   capture_report();
    
 #ifdef DYLOS        // DYLOS monitor option
    /* close dylos */
@@ -212,22 +726,31 @@ void closeout()
 * @brief catch signals to close out correctly 
 * @param  sig_num : signal that was raised
 * 
+* Only async-signal-safe calls here: the main loop runs closeout()
 **********************************************************************/
 void signal_handler(int sig_num)
 {
+    static const char stop[] = "\nStopping SPS30 monitor without closing out\n";
+
     switch(sig_num)
     {
+        /* let the main loop end, so pending samples are written */
         case SIGINT:
-        case SIGKILL:
-        case SIGABRT:
         case SIGTERM:
+            if (! StopLoop) {
+                StopLoop = 1;
+                break;
+            }
+
+            /* a second one: stop now, the store recovers from a crash */
+            if (write(STDOUT_FILENO, stop, sizeof(stop) - 1) < 0) {}
+            _exit(EXIT_FAILURE);
+
+        /* fatal: nothing can be trusted, end as without handler */
+        case SIGABRT:
         default:
-#ifdef DYLOS                        // DYLOS monitor option
-            printf("\nStopping SPS30 & Dylos monitor\n");
-#else
-            printf("\nStopping SPS30 monitor\n");
-#endif
-            closeout();
+            signal(sig_num, SIG_DFL);
+            raise(sig_num);
             break;
     }
 }
@@ -254,13 +777,12 @@ void set_signals()
  * @brief generate timestamp
  * 
  * @param buf : returned the timestamp
+ * @param ltime : time to display
  *********************************************/  
-void get_time_stamp(char * buf)
+void get_time_stamp(char * buf, time_t ltime)
 {
-    time_t ltime;
     struct tm *tm ;
     
-    ltime = time(NULL);
     tm = localtime(&ltime);
     
     static const char wday_name[][4] = {
@@ -282,11 +804,6 @@ void get_time_stamp(char * buf)
  ************************************************/
 void init_variables(struct sps_par *sps)
 {
-    if (MySensor.begin() != ERR_OK) {
-        p_printf(RED,(char *)"Error during setting I2C\n");
-        exit(EXIT_FAILURE);
-    }
-    
     /* option SPS30 parameters */
     sps->interval = 604800;         // default value for autoclean
     sps->fanclean = false;
@@ -303,6 +820,56 @@ void init_variables(struct sps_par *sps)
     sps->relation = false;          // display correlation Dylos/SDS
     sps->DevStatus = false;         // display device status 
     sps->OptMode = false;           //  perform sleep /wake up during wait-time
+    sps->store[0] = 0x0;            // no sample store
+    sps->sensor_id = 0;             // sensor id in store
+    sps->commit_int = STORE_COMMIT_INT; // max seconds samples uncommitted
+    sps->commit_size = 0;           // commit when block is full
+    sps->stage[0] = 0x0;            // no staging on tmpfs
+    sps->ring[0] = 0x0;             // no circular file
+    sps->ring_days = 7;             // days in circular file
+    sps->retention = false;         // no rollups / retention
+    sps->zip_level = -1;            // no compression
+    sps->cube = false;              // no hour / day statistics
+    sps->keep[0] = ROLLUP_RAW_DAYS;
+    sps->keep[1] = ROLLUP_MINUTE_DAYS;
+    sps->keep[2] = ROLLUP_HOUR_DAYS;
+    sps->mqtt[0] = 0x0;             // no MQTT
+    sps->mqtt_topic[0] = 0x0;       // MQTT_TOPIC
+    sps->mqtt_id[0] = 0x0;          // sps30-<sensor id>
+    sps->mqtt_spool[0] = 0x0;       // no spool
+    sps->mqtt_qos = 0;
+    sps->mqtt_agg = 0;              // no aggregates
+    sps->influx[0] = 0x0;           // no InfluxDB
+    sps->influx_site[0] = 0x0;      // no site tag
+    sps->influx_flush = 0;          // INFLUX_FLUSH
+    sps->stream[0] = 0x0;           // no aggregator
+    sps->log[0] = 0x0;              // no sample log
+    sps->web[0] = 0x0;              // no web server
+    sps->rules[0] = 0x0;            // no alert rules
+    sps->capture[0] = 0x0;          // no capture
+    sps->capture_pre = 10;
+    sps->capture_post = 10;
+    sps->deadband[0] = 0x0;         // report every sample
+    sps->power_budget = 0;          // no duty cycling
+    sps->power_max = POWER_SLEEP_MAX;
+    sps->sampler_max = 0;           // fixed wait time
+    sps->sampler_rate = SAMPLER_RATE;
+    sps->sampler_var = SAMPLER_VAR;
+    sps->quality = 0;               // output every sample
+    sps->clean_mass = 0;            // automatic clean interval (-a)
+    sps->clean_num = CLEAN_NUM;
+    sps->clean_max = CLEAN_MAX_DAYS;
+    sps->clean_slot = 0;
+    sps->clean_slots = 1;
+    sps->house_on = false;          // no housekeeping
+    sps->house[HOUSE_T_STATUS] = HOUSE_STATUS;
+    sps->house[HOUSE_T_CLEAN] = HOUSE_CLEAN;
+    sps->house[HOUSE_T_DEVICE] = HOUSE_DEVICE;
+    sps->house[HOUSE_T_CLOCK] = HOUSE_CLOCK;
+    sps->replay[0] = 0x0;           // live measurements
+    sps->replay_sensor = -1;        // same sensor id as stored
+    sps->replay_speed = 1;          // recorded pace
+    sps->replay_rebase = false;     // keep recorded timestamps
 
 #ifdef DYLOS                        // DYLOS monitor option
     /* Dylos values */
@@ -319,6 +886,151 @@ void init_variables(struct sps_par *sps)
 #endif
 }
 
+/**********************************************************
+ * @brief action capture of the rules: start a capture on an alert
+ *********************************************************/
+void capture_action(const struct rule_event *ev, void *ctx)
+{
+    if (ev->state != RULE_CLEAR) Capture.trigger(ev->sensor, ev->ts, ev->rule);
+}
+
+/**********************************************************
+ * @brief open the sample store, rollups, circular file, MQTT, InfluxDB
+ * the stream to the aggregator, the sample log and the web server
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************/
+void init_store(struct sps_par *sps)
+{
+    /* the shortest time between samples, to size the circular file and
+     * the capture rings */
+    uint32_t step = sps->sampler_max > 0 ? SAMPLER_MIN : sps->loop_delay;
+
+    if (step < 1) step = 1;
+
+    /* open sample store */
+    if (sps->store[0] != 0x0) {
+        Store.policy(sps->commit_int, sps->commit_size, sps->stage[0] ? sps->stage : NULL);
+
+        if (Store.open(sps->store, sps->sensor_id, sps->verbose) != STORE_OK) {
+            p_printf(RED,(char *)"Could not open sample store %s\n", sps->store);
+            closeout();
+        }
+
+        if (sps->retention) {
+            Rollup.retention(sps->keep[0], sps->keep[1], sps->keep[2]);
+
+            if (Rollup.start(&Store, sps->store, sps->sensor_id, sps->verbose) != STORE_OK)
+                closeout();
+        }
+
+        if (sps->zip_level >= 0) {
+            if (Zip.start(sps->store, sps->sensor_id, sps->zip_level, sps->verbose) != STORE_OK)
+                closeout();
+        }
+
+        if (sps->log[0] != 0x0) {
+            if (Log.open(sps->log, sps->store, sps->sensor_id, sps->verbose) != STORE_OK)
+                closeout();
+        }
+
+        if (sps->cube) {
+            if (Cube.open(sps->store, sps->sensor_id, true, sps->quality, sps->verbose) != STORE_OK)
+                closeout();
+        }
+    }
+    else if (sps->retention || sps->zip_level >= 0 || sps->log[0] != 0x0 || sps->cube)
+        p_printf(RED,(char *)"Retention (-K), compression (-z), the sample log (-L) and the cube (-U) require a sample store (-o)\n");
+
+    /* open circular sample file */
+    if (sps->ring[0] != 0x0) {
+        if (Ring.open(sps->ring, sps->sensor_id, sps->ring_days, step, sps->verbose) != STORE_OK) {
+            p_printf(RED,(char *)"Could not open circular file %s\n", sps->ring);
+            closeout();
+        }
+    }
+
+    /* start MQTT publisher */
+    if (sps->mqtt[0] != 0x0) {
+        Mqtt.policy(sps->mqtt_topic[0] ? sps->mqtt_topic : NULL, sps->mqtt_qos,
+            sps->mqtt_id[0] ? sps->mqtt_id : NULL, sps->mqtt_spool[0] ? sps->mqtt_spool : NULL,
+            sps->mqtt_agg);
+
+        if (Mqtt.open(sps->mqtt, sps->sensor_id, sps->verbose) != STORE_OK) {
+            p_printf(RED,(char *)"Could not start MQTT publisher to %s\n", sps->mqtt);
+            closeout();
+        }
+    }
+
+    /* start InfluxDB exporter, the serial number and firmware are tags */
+    if (sps->influx[0] != 0x0) {
+        char serial[35] = "", firmware[16] = "";
+        SPS30_version gv;
+
+        if (SensorOpen) {
+            if (MySensor.GetSerialNumber(serial, sizeof(serial)) != ERR_OK) serial[0] = 0x0;
+            if (MySensor.GetVersion(&gv) == ERR_OK) snprintf(firmware, sizeof(firmware), "%d.%d", gv.major, gv.minor);
+        }
+
+        Influx.policy(sps->influx_site[0] ? sps->influx_site : NULL, serial, firmware, sps->influx_flush);
+
+        if (Influx.open(sps->influx, sps->sensor_id, sps->verbose) != STORE_OK) {
+            p_printf(RED,(char *)"Could not start InfluxDB exporter to %s\n", sps->influx);
+            closeout();
+        }
+    }
+
+    /* start the dashboard, with history when storing */
+    if (sps->web[0] != 0x0 && Store.is_open()) Web.history(sps->store);
+
+    if (sps->web[0] != 0x0 && Web.open(sps->web, sps->sensor_id, sps->verbose) != STORE_OK) {
+        p_printf(RED,(char *)"Could not start web server on %s\n", sps->web);
+        closeout();
+    }
+
+    /* start streaming to the aggregator */
+    if (sps->stream[0] != 0x0 && Stream.open(sps->stream, sps->verbose) != STORE_OK) {
+        p_printf(RED,(char *)"Could not start stream to %s\n", sps->stream);
+        closeout();
+    }
+
+    /* report by exception */
+    if (sps->deadband[0] != 0x0 && Deadband.open(sps->deadband, sps->verbose) != STORE_OK) {
+        p_printf(RED,(char *)"Incorrect deadband option\n");
+        closeout();
+    }
+
+    /* adaptive sampling rate */
+    if (sps->sampler_max > 0 && Sampler.open(sps->sampler_max, sps->sampler_rate, sps->sampler_var,
+        sps->verbose) != STORE_OK)
+        closeout();
+
+    /* fan cleaning after a dose, kept with the store */
+    if (sps->clean_mass > 0 && Clean.open(Store.is_open() ? sps->store : NULL, sps->sensor_id,
+        sps->clean_mass, sps->clean_num, sps->clean_max, sps->clean_slot, sps->clean_slots,
+        sps->verbose) != STORE_OK)
+        closeout();
+
+    /* keep the samples for a capture, triggered by the rules */
+    if (sps->capture[0] != 0x0) {
+        if (Capture.open(sps->capture, sps->capture_pre, sps->capture_post, step,
+            sps->verbose) != STORE_OK) {
+            p_printf(RED,(char *)"Could not start capture to %s\n", sps->capture);
+            closeout();
+        }
+
+        Rules.action("capture", capture_action, NULL);
+
+        if (sps->rules[0] == 0x0)
+            p_printf(RED,(char *)"Capture (-k) is triggered by a rule with 'do capture' (-e)\n");
+    }
+
+    /* compile the alert rules */
+    if (sps->rules[0] != 0x0 && Rules.load(sps->rules, sps->verbose) != STORE_OK) {
+        p_printf(RED,(char *)"Could not load the rules in %s\n", sps->rules);
+        closeout();
+    }
+}
+
 /**********************************************************
  * @brief initialise the Raspberry PI and SPS30 / Dylos hardware 
  * @param sps : pointer to SPS30 parameters
@@ -330,6 +1042,9 @@ void init_hw(struct sps_par *sps)
     /* progress & debug messages tell driver */
     MySensor.EnableDebugging(sps->verbose);
   
+    /* the dose based cleaning replaces the automatic clean */
+    if (sps->clean_mass > 0) sps->interval = 0;
+
     /* check for auto clean interval update */
     if (MySensor.GetAutoCleanInt(&val) != ERR_OK) {
         p_printf(RED,(char *)"Could not obtain the Auto Clean interval\n");
@@ -347,6 +1062,19 @@ void init_hw(struct sps_par *sps)
         }
     }  
 
+    /* duty cycling, in idle mode when the firmware has no sleep */
+    if (sps->power_budget > 0) {
+        if (Power.open(sps->power_budget, sps->power_max, MySensor.FWCheck(2,0), sps->verbose) != STORE_OK)
+            closeout();
+
+        if (sps->OptMode) {
+            p_printf(YELLOW,(char *)"The power budget (-p) replaces sleep during wait-time (-F)\n");
+            sps->OptMode = false;
+        }
+    }
+
+    /* open sample store and circular file */
+    init_store(sps);
   
 #ifdef DYLOS    // DYLOS monitor option
 
@@ -533,62 +1261,69 @@ bool sds_output(struct sps_par *sps)
 #endif
 
 /*****************************************************************
- * @brief : output the results
+ * @brief : display a sample
  * 
  * @param sps : pointer to SPS30 parameters
+ * @param s : sample
  ****************************************************************/
-void do_output(struct sps_par *sps)
+void disp_sample(struct sps_par *sps, struct sps_sample *s)
 {
     char buf[30];
     bool output = false;
-    uint8_t status;
-    
-    /* obtain the data */
-    if (MySensor.GetValues(&sps->v) != ERR_OK)  {
-        p_printf(RED,(char*) "Error during reading data\n");
-        closeout();
-    }
 
     if (sps->timestamp)  {
-        get_time_stamp(buf);
+        get_time_stamp(buf, (time_t) s->ts);
         p_printf(YELLOW, (char *) "%s\n",buf);
     }
        
     // format output of the data
     if (sps->mass) {
         p_printf(GREEN,(char *) "MASS\t\t\t      PM1: %8.4f PM2.5: %8.4f PM4: %8.4f PM10: %8.4f\n"
-        ,sps->v.MassPM1, sps->v.MassPM2, sps->v.MassPM4, sps->v.MassPM10);
+        ,s->v.MassPM1, s->v.MassPM2, s->v.MassPM4, s->v.MassPM10);
         
         output = true;
     }
     
     if (sps->num) {
         p_printf(GREEN,(char *) "NUM\t\tPM0: %8.4F PM1: %8.4f PM2.5: %8.4f PM4: %8.4f PM10: %8.4f\n"
-        ,sps->v.NumPM0, sps->v.NumPM1, sps->v.NumPM2, sps->v.NumPM4, sps->v.NumPM10);
+        ,s->v.NumPM0, s->v.NumPM1, s->v.NumPM2, s->v.NumPM4, s->v.NumPM10);
         
         output = true;
     }
     
     if (sps->partsize) {
-        p_printf(GREEN,(char *) "Partsize\t     %8.4f\n",sps->v.PartSize); 
+        p_printf(GREEN,(char *) "Partsize\t     %8.4f\n",s->v.PartSize); 
         
         output = true;
     }
     
     if (sps->DevStatus) {
         
-        if (MySensor.GetStatusReg(&status) == ERR_OK) {
+        if ((s->flags & SPS_FLAG_STATUS) == 0) {
                p_printf(GREEN,(char *) "Device Status\t     No Errors.\n");
         }    
         else {
             
-            if (status & STATUS_SPEED_ERROR)
+            if (s->flags & STATUS_SPEED_ERROR)
                 p_printf(RED,(char *) "Device Status\t      WARNING: Fan is turning too fast or too slow\n");
-            if (status & STATUS_LASER_ERROR)
+            if (s->flags & STATUS_LASER_ERROR)
                 p_printf(RED,(char *) "Device Status\t      ERROR  : Laser failure\n");
-            if (status & STATUS_FAN_ERROR)
+            if (s->flags & STATUS_FAN_ERROR)
                 p_printf(RED,(char *) "Device Status\t      ERROR  : Fan failure : fan is mechanically blocked or broken\n");
         }
+
+        /* the single flags, not bad or all */
+        if (s->flags & (SPS_FLAG_QUALITY & ~SPS_FLAG_FAULT)) {
+            p_printf(YELLOW,(char *) "Quality\t\t     ");
+
+            for (unsigned i = 0; i < sizeof(sps_quality_name) / sizeof(sps_quality_name[0]); i++) {
+                if ((s->flags & sps_quality_name[i].flag) && sps_quality_name[i].flag != SPS_FLAG_FAULT &&
+                    (sps_quality_name[i].flag & (sps_quality_name[i].flag - 1)) == 0)
+                    p_printf(YELLOW,(char *) "%s ", sps_quality_name[i].name);
+            }
+
+            p_printf(YELLOW,(char *) "\n");
+        }
        
         output = true;
     }
@@ -602,25 +1337,247 @@ void do_output(struct sps_par *sps)
 #endif
 
     if (output)    p_printf(WHITE, (char *) "\n");
-    else p_printf(RED, (char *) "Nothing selected to display \n");
+    else if (! Replay.is_open()) p_printf(RED, (char *) "Nothing selected to display \n");
 }
 
 /*****************************************************************
- * @brief : Display the device information
+ * @brief : after a wake-up or a cleaning read every second until the
+ * values are stable (see spsquality.h), at most QUALITY_MAX seconds
  * @param sps : pointer to SPS30 parameters
+ * @param flag : SPS_FLAG_SETTLE or SPS_FLAG_CLEAN
  ****************************************************************/
-uint8_t disp_dev(struct sps_par *sps)
+void settle(struct sps_par *sps, uint16_t flag)
 {
-    char    buf[35];
-    SPS30_version gv;
-        
-    /* get the serial number (check that communication works) */
-    if(MySensor.GetSerialNumber(buf, 35) != ERR_OK) {
-       p_printf (RED, (char *) "Error during getting serial number\n");
-       return(ERR_PROTOCOL);
+    Quality.event(flag);
+
+    for (int i = 0; i < QUALITY_MAX && Quality.unstable() && ! StopLoop; i++) {
+        delay(1000);
+
+        if (! MySensor.Check_data_ready()) continue;
+
+        if (MySensor.GetValues(&sps->v) != ERR_OK) BusErrors++;
+        else Quality.check(&sps->v);
     }
-    
-    if (strlen(buf) == 0) 
+}
+
+/*****************************************************************
+ * @brief : start a fan cleaning due by the dose (see spsclean.h)
+ * @param sps : pointer to SPS30 parameters
+ * @param ts : timestamp of the sample
+ ****************************************************************/
+void clean_fan(struct sps_par *sps, uint32_t ts)
+{
+    /* a replay only counts the cleanings */
+    if (Replay.is_open()) {
+        Clean.done(ts);
+        return;
+    }
+
+    /* else tried again with the next sample */
+    if (! MySensor.clean()) {
+        p_printf(RED,(char *)"Could not start a fan cleaning\n");
+        return;
+    }
+
+    Clean.done(ts);
+
+    /* not asleep during the cleaning, else the samples are flagged */
+    if (Power.is_open() || sps->OptMode) settle(sps, SPS_FLAG_CLEAN);
+    else Quality.event(SPS_FLAG_CLEAN);
+}
+
+/*****************************************************************
+ * @brief : add a sample to the store / circular file, then display
+ * and export it or, with a deadband, the samples to report
+ * 
+ * @param sps : pointer to SPS30 parameters
+ * @param s : sample (live or replayed)
+ ****************************************************************/
+void out_sample(struct sps_par *sps, struct sps_sample *s)
+{
+    struct sps_sample rep[2];
+    int n;
+
+    /* the sensor id as stored, also for a replay of another sensor */
+    s->sensor = sps->sensor_id;
+
+    /* add to sample store and / or circular file */
+    if (Store.is_open()) {
+        if (Store.append(s) != STORE_OK)
+            p_printf(RED,(char *) "Error during storing sample\n");
+        else {
+            Log.sample(s, Store.seq());
+            Cube.add(s);
+        }
+    }
+
+    if (Ring.is_open() && Ring.append(s) != STORE_OK)
+        p_printf(RED,(char *) "Error during writing circular file\n");
+
+    /* keep for a capture, before a rule can trigger it */
+    Capture.add(s, BusErrors);
+
+    /* alerts */
+    Rules.sample(s);
+
+    /* the interval until the next sample */
+    if (Sampler.is_open()) Sampler.sample(s);
+
+    /* fan cleaning when the dose is reached */
+    if (Clean.is_open() && Clean.sample(s)) clean_fan(sps, s->ts);
+
+    /* left out of the output by its quality */
+    if (s->flags & sps->quality) {
+        Excluded++;
+        return;
+    }
+
+    /* report by exception */
+    if (Deadband.is_open()) {
+        n = Deadband.sample(s, rep);
+
+        for (int i = 0; i < n; i++) {
+            disp_sample(sps, &rep[i]);
+            export_sample(&rep[i]);
+        }
+        return;
+    }
+
+    disp_sample(sps, s);
+    export_sample(s);
+}
+
+/*****************************************************************
+ * @brief : output the values read as a sample
+ * 
+ * @param sps : pointer to SPS30 parameters
+ * @param quality : SPS_FLAG_xxx of the read (see spsquality.h)
+ ****************************************************************/
+void put_values(struct sps_par *sps, uint16_t quality)
+{
+    struct sps_sample s;
+
+    /* the status register and clock of the last housekeeping */
+    s.ts = (uint32_t) time(NULL);
+    s.flags = (House.status() & SPS_FLAG_STATUS) | quality | House.flags();
+    s.v = sps->v;
+
+    Quality.count(s.flags);
+    out_sample(sps, &s);
+}
+
+/*****************************************************************
+ * @brief : read the SPS30 and output the results
+ * 
+ * @param sps : pointer to SPS30 parameters
+ ****************************************************************/
+void do_output(struct sps_par *sps)
+{
+    uint16_t quality = 0;
+
+    /* obtain the data, once more after a failed read (e.g. CRC error),
+     * when that fails too the sample is skipped */
+    if (MySensor.GetValues(&sps->v) != ERR_OK)  {
+        BusErrors++;
+        quality = SPS_FLAG_RETRY;
+
+        if (MySensor.GetValues(&sps->v) != ERR_OK)  {
+            BusErrors++;
+            Skipped++;
+            p_printf(RED,(char*) "Error during reading data, sample skipped\n");
+            return;
+        }
+    }
+
+    put_values(sps, quality | Quality.check(&sps->v));
+}
+
+/*****************************************************************
+ * @brief : duty cycle within a power budget: wake up, read until the
+ * values are stable, output one sample and sleep (see spspower.h)
+ * @param sps : pointer to SPS30 parameters
+ ****************************************************************/
+void power_loop(struct sps_par *sps)
+{
+    int      loop_set;
+    uint32_t wait;
+    uint16_t quality = 0;
+    bool     stable;
+
+    /*  check for endless loop */
+    if (sps->loop_count > 0 ) loop_set = sps->loop_count;
+    else loop_set = 1;
+
+    while (loop_set > 0 && ! StopLoop) {
+
+        /* no bus traffic while the fan and laser settle */
+        if ((wait = Power.wake()) > 0) sleep(wait);
+
+        for (stable = false; ! stable && ! StopLoop; ) {
+            delay(1000);
+
+            if (! MySensor.Check_data_ready()) continue;
+
+            if (MySensor.GetValues(&sps->v) != ERR_OK) BusErrors++;
+            else {
+                stable = Power.settled(&sps->v);
+                quality = Quality.check(&sps->v);
+            }
+        }
+
+        if (StopLoop) break;
+
+        put_values(sps, quality);
+
+        /* commit stored samples if due */
+        if (Store.is_open()) Store.sync();
+        if (Ring.is_open()) Ring.sync(sps->commit_int);
+
+        wait = Power.asleep(&sps->v, Sampler.is_open() ? Sampler.interval() : 0);
+
+        /* housekeeping while awake, before the next read */
+        BusErrors += House.run(wait > 0 ? wait : 1);
+
+        /* sleep mode, or idle mode on firmware below 2.0 */
+        if (wait > 0) {
+            if (Power.sleep_mode()) MySensor.sleep();
+            else MySensor.stop();
+
+            sleep(wait);
+            Clean.asleep(wait);
+
+            if (Power.sleep_mode()) {
+                MySensor.wakeup();
+                Quality.event(SPS_FLAG_SETTLE);
+            }
+            else if (! MySensor.start()) p_printf(RED,(char *) "Can not restart measurement\n");
+            else Quality.event(SPS_FLAG_WARMUP);
+        }
+
+        /* check for endless loop */
+        if (sps->loop_count > 0) loop_set--;
+    }
+
+    if (StopLoop) printf("\nStopping SPS30 monitor\n");
+    else printf("Reached the loopcount of %d.\nclosing down\n", sps->loop_count);
+}
+
+/*****************************************************************
+ * @brief : Display the device information
+ * @param sps : pointer to SPS30 parameters
+ ****************************************************************/
+uint8_t disp_dev(struct sps_par *sps)
+{
+    char    buf[35];
+    SPS30_version gv;
+        
+    /* get the serial number (check that communication works) */
+    if(MySensor.GetSerialNumber(buf, 35) != ERR_OK) {
+       p_printf (RED, (char *) "Error during getting serial number\n");
+       return(ERR_PROTOCOL);
+    }
+    
+    if (strlen(buf) == 0) 
         p_printf(YELLOW, (char *) "NO serialnumber available\n");
     else
         p_printf(YELLOW, (char *) "Serialnumber   %s\n", buf);
@@ -653,7 +1610,8 @@ uint8_t disp_dev(struct sps_par *sps)
 void main_loop(struct sps_par *sps)
 {
     int     loop_set, reset_retry = RESET_RETRY;
-    bool    first=true;
+    bool    first=true, nap;
+    uint32_t wait;
    
     if (disp_dev(sps) != ERR_OK) return;
     
@@ -667,28 +1625,55 @@ void main_loop(struct sps_par *sps)
     }
     
     p_printf(GREEN,(char *)  "Starting SPS30 measurement:\n");
+    Quality.event(SPS_FLAG_WARMUP);
 
     /* check for manual fan clean (can only be done after start) */
     if(sps->fanclean) {
         
-        if (MySensor.clean()) 
+        if (MySensor.clean()) {
             p_printf(BLUE,(char *)"A manual fan clean instruction has been sent\n");
+            Quality.event(SPS_FLAG_CLEAN);
+            Clean.done((uint32_t) time(NULL));
+        }
         else
             p_printf(RED,(char *)"Could not force a manual fan clean\n");
     }
+
+    /* status register, clean interval, device and clock checks with -g.
+     * Else only the status register, when anything uses the status flags
+     * of a sample: display (-E), capture (-k), store, rules or an exporter */
+    if (! sps->house_on) {
+        sps->house[HOUSE_T_CLEAN] = sps->house[HOUSE_T_DEVICE] = sps->house[HOUSE_T_CLOCK] = 0;
+        if (! sps->DevStatus && ! Capture.is_open() && ! Store.is_open() && ! Ring.is_open() &&
+            ! Rules.is_open() && sps->mqtt[0] == 0x0 && sps->influx[0] == 0x0 &&
+            sps->stream[0] == 0x0 && sps->web[0] == 0x0)
+            sps->house[HOUSE_T_STATUS] = 0;
+    }
+
+    if (sps->house[HOUSE_T_STATUS] || sps->house[HOUSE_T_CLEAN] || sps->house[HOUSE_T_DEVICE] ||
+        sps->house[HOUSE_T_CLOCK])
+        BusErrors += House.open(&MySensor, sps->house, sps->interval, sps->verbose);
+
+    /* duty cycle within a power budget */
+    if (Power.is_open()) {
+        power_loop(sps);
+        return;
+    }
                     
     /*  check for endless loop */
     if (sps->loop_count > 0 ) loop_set = sps->loop_count;
     else loop_set = 1;
     
     /* loop requested */
-    while (loop_set > 0)  {
+    while (loop_set > 0 && ! StopLoop)  {
         
         if(MySensor.Check_data_ready()) {
             reset_retry = RESET_RETRY;
             do_output(sps);
         }
         else  {
+            BusErrors++;
+
             if (reset_retry-- == 0) {
                 
                 p_printf (RED, (char *) "Retry count exceeded. perform softreset\n");
@@ -706,27 +1691,106 @@ void main_loop(struct sps_par *sps)
             }
         }
         
+        /* commit stored samples if due */
+        if (Store.is_open()) Store.sync();
+        if (Ring.is_open()) Ring.sync(sps->commit_int);
+
+        /* the adaptive sampler only sleeps during the longer intervals,
+         * the time to wake up is part of the interval */
+        if (Sampler.is_open()) {
+            wait = Sampler.interval();
+            nap = sps->OptMode && wait >= SAMPLER_NAP;
+            if (nap) wait -= 4;
+        }
+        else {
+            wait = sps->loop_delay;
+            nap = sps->OptMode;
+        }
+
+        /* housekeeping in the time until the next read, a new
+         * value is ready every second */
+        BusErrors += House.run(wait > 0 ? wait : 1);
+
         // if sleep was requisted during wait
-        if (sps->OptMode) MySensor.sleep();
+        if (nap) MySensor.sleep();
         
         /* delay for seconds */
-        sleep(sps->loop_delay);
+        sleep(wait);
+        if (nap) Clean.asleep(wait);
 
         // if sleep was requisted during wait
-        if (sps->OptMode) {
+        if (nap) {
             MySensor.wakeup();   
         
-            // give time to measure new results
-            delay(4000);     
+            // read until the new results are stable
+            settle(sps, SPS_FLAG_SETTLE);
         }
         
         /* check for endless loop */
         if (sps->loop_count > 0) loop_set--;
     }
     
+    if (StopLoop) {
+        printf("\nStopping SPS30 monitor\n");
+        return;
+    }
+
     printf("Reached the loopcount of %d.\nclosing down\n", sps->loop_count);
 }       
 
+/*****************************************************************
+ * @brief replay stored samples through the same output, store and
+ * circular file path as live measurements. Runs until the end of the
+ * data (-l is not used) and reports the throughput.
+ * @param sps : pointer to SPS30 parameters
+ ****************************************************************/
+void replay_loop(struct sps_par *sps)
+{
+    struct sps_sample s;
+    struct replay_stats st;
+    uint16_t sensor;
+    uint32_t next = 0;
+
+    sensor = sps->replay_sensor < 0 ? sps->sensor_id : (uint16_t) sps->replay_sensor;
+
+    /* the store would read back what it writes */
+    if (sps->store[0] != 0x0 && strcmp(sps->store, sps->replay) == 0 && sensor == sps->sensor_id) {
+        p_printf(RED,(char *) "Can not replay sensor %d into itself, use another -i or -o\n", sensor);
+        return;
+    }
+
+    if (Replay.open(sps->replay, sensor, sps->replay_speed, sps->replay_rebase, 0, UINT32_MAX) != STORE_OK) {
+        p_printf(RED,(char *) "Can not replay %s\n", sps->replay);
+        return;
+    }
+
+    p_printf(GREEN,(char *) "Starting replay of %s:\n", sps->replay);
+
+    while (! StopLoop && Replay.next(&s) == STORE_OK) {
+
+        /* the samples the adaptive sampler would have taken */
+        if (Sampler.is_open() && s.ts < next) continue;
+
+        sps->v = s.v;
+        out_sample(sps, &s);
+        next = s.ts + Sampler.interval();
+
+        /* commit stored samples if due */
+        if (Store.is_open()) Store.sync();
+        if (Ring.is_open()) Ring.sync(sps->commit_int);
+    }
+
+    Replay.stats(&st);
+
+    p_printf(BLUE,(char *) "Replay: %llu samples in %.3f s, %.0f samples/s\n",
+        (unsigned long long) st.samples, st.elapsed, st.elapsed > 0 ? st.samples / st.elapsed : 0);
+
+    if (st.behind >= 0.001)
+        p_printf(BLUE,(char *) "Replay: up to %.3f s behind the requested pace\n", st.behind);
+
+    if (StopLoop) printf("\nStopping replay\n");
+}
+
 /*********************************************************************
 * @brief usage information  
 * @param sps : pointer to SPS30 parameters
@@ -752,6 +1816,64 @@ void usage(struct sps_par *sps)
     "-M     add / remove MASS info to output          (default %s)\n"
     "-N     add / remove NUMBERS info to output       (default %s)\n"
     "-P     add / remove Partsize info to output      (default %s)\n"
+    "-o dir store samples in directory (read with spsquery)\n"
+    "-i #   sensor id in the sample store             (default %d)\n"
+    "-c interval=#,rate=#,size=#,stage=dir  store commit policy\n"
+    "       interval: max seconds data at risk        (default %d)\n"
+    "       rate: commits per hour, size: samples per commit,\n"
+    "       stage: directory on tmpfs (e.g. /dev/shm) to stage samples\n"
+    "-K raw=#,minute=#,hour=#  enable rollups, keep days (0 = forever)\n"
+    "                                     (default raw=%d,minute=%d,hour=%d)\n"
+    "-z #   compress sealed segments with zstd level #  (default %d)\n"
+    "-U     keep hour and day statistics with percentiles (spsquery -u)\n"
+    "-R file[,days=#]  keep last days in a circular file of fixed size\n"
+    "                                                 (default days=%d)\n"
+    "-Q host[:port][,topic=t,qos=#,id=name,spool=file,agg=#]  publish with MQTT\n"
+    "       topic: {sensor} and {type} are replaced   (default %s)\n"
+    "       qos: 0 or 1, spool: file to keep messages while the broker\n"
+    "       is away, agg: publish min/mean/max every # seconds\n"
+    "-X url[,site=name,flush=#]  send line protocol to InfluxDB or Telegraf\n"
+    "       url: udp://host[:port] or tcp://host[:port], flush: ms before\n"
+    "       a batch is sent                           (default %d)\n"
+    "-G addr    stream samples to the aggregator spsagg\n"
+    "       addr: host[:port] or unix:/path           (default port %s)\n"
+    "-L addr    serve the store as a log to subscribers (spstail) that\n"
+    "       resume after a sequence number, addr: [host]:port or unix:/path\n"
+    "-W addr    web dashboard with live values for many viewers\n"
+    "       addr: [host]:port                         (e.g. :%s)\n"
+    "       with -o also /api/history?from=-86400&points=1000 (see spshist.h)\n"
+    "-e file    alert rules, e.g. pm25: MassPM2 > 35 for 5m do log\n"
+    "       (see spsrule.h)\n"
+    "-k dir[,pre=#,post=#]  on a rule with 'do capture' write the samples of\n"
+    "       pre minutes before and post minutes after to a file in dir\n"
+    "       (read with spsquery -c)                   (default pre=%d,post=%d)\n"
+    "-y abs=#,rel=#,max=#,field=#/#  only display and export the samples\n"
+    "       needed to draw each field within the larger of abs and rel %%\n"
+    "       of the value, at least every max seconds  (default max=%d)\n"
+    "       e.g. -y abs=0.1,rel=2,NumPM0=5/3 (see spsdeadband.h)\n"
+    "-p mW[,max=#]  sleep between samples within an average power budget,\n"
+    "       longer when the air is stable, max: seconds (default max=%d)\n"
+    "       (replaces -F and -w, see spspower.h)\n"
+    "-s max=#,rate=#,var=#  adaptive sampling rate instead of -w: every\n"
+    "       second while PM2.5 or PM10 change more than rate %% per minute\n"
+    "       or vary more than var %%, else doubling up to max seconds\n"
+    "                                   (default max=%d,rate=%d,var=%d)\n"
+    "-q list  leave samples with this quality out of the display, the\n"
+    "       exporters and the cube: warmup,clean,settle,fault,retry,\n"
+    "       interp, bad (= warmup,clean,settle,fault) or all (see spsquality.h)\n"
+    "-j mass=#,num=#,max=#,slot=#/#  fan cleaning after a dose of MassPM10\n"
+    "       (ug/m3*h) or NumPM10 (#/cm3*h), at least every max days, only\n"
+    "       in slot k of n of the site (replaces -a, see spsclean.h)\n"
+    "                            (default mass=%d,num=%d,max=%d,slot=0/1)\n"
+    "-g status=#,clean=#,device=#,clock=#  seconds between housekeeping of\n"
+    "       the status register, clean interval, serial number / firmware\n"
+    "       and system clock, 0 = off (see spshouse.h). Without -g only\n"
+    "       the status register with -E, -k, a store, rules or exporters\n"
+    "                    (default status=%d,clean=%d,device=%d,clock=%d)\n"
+    "-r source[,sensor=#,speed=#|max,rebase]  replay a store directory or\n"
+    "       circular file instead of reading the SPS30 (no hardware needed)\n"
+    "       sensor: in source (default as -i), speed: times the recorded\n"
+    "       pace (default 1), rebase: first sample gets the current time\n"
     "\n\t*1 : requires SPS30 firmware level 2.2 or higher\n"
     "\t*2 : requires SPS30 firmware level 2.0 or higher\n"
     
@@ -773,7 +1895,12 @@ void usage(struct sps_par *sps)
    sps->OptMode?"added":"removed", 
    sps->mass?"added":"removed", 
    sps->num?"added":"removed",
-   sps->partsize?"added":"removed"
+   sps->partsize?"added":"removed",
+   sps->sensor_id, sps->commit_int, sps->keep[0], sps->keep[1], sps->keep[2],
+   ZIP_LEVEL, sps->ring_days, MQTT_TOPIC, INFLUX_FLUSH, STREAM_PORT, HTTP_PORT,
+   sps->capture_pre, sps->capture_post, DEADBAND_MAX, POWER_SLEEP_MAX,
+   SAMPLER_MAX, SAMPLER_RATE, SAMPLER_VAR, CLEAN_MASS, CLEAN_NUM, CLEAN_MAX_DAYS,
+   HOUSE_STATUS, HOUSE_CLEAN, HOUSE_DEVICE, HOUSE_CLOCK
 #ifdef DYLOS 
    ,
    sps->relation?"added":"removed"
@@ -787,6 +1914,398 @@ void usage(struct sps_par *sps)
 #endif
 }
 
+/*********************************************************************
+ * @brief parse the commit policy interval=#,rate=#,size=#,stage=dir
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_commit(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "interval", (char *) "rate", (char *) "size", (char *) "stage", NULL};
+    char *value;
+    uint32_t val;
+
+    while (*option != 0x0) {
+
+        switch (getsubopt(&option, keys, &value)) {
+        case 0:     // interval
+            if (value && (val = (uint32_t) strtod(value, NULL)) > 0) {
+                sps->commit_int = val;
+                continue;
+            }
+            break;
+
+        case 1:     // commits per hour
+            if (value && (val = (uint32_t) strtod(value, NULL)) > 0) {
+                sps->commit_int = 3600 / val;
+                if (sps->commit_int == 0) sps->commit_int = 1;
+                continue;
+            }
+            break;
+
+        case 2:     // size
+            if (value) {
+                sps->commit_size = (uint32_t) strtod(value, NULL);
+                continue;
+            }
+            break;
+
+        case 3:     // stage
+            if (value) {
+                strncpy(sps->stage, value, MAXBUF - 1);
+                continue;
+            }
+            break;
+        }
+
+        p_printf (RED, (char *) "Incorrect commit policy. Use interval=#,rate=#,size=#,stage=dir\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the circular file option file[,days=#]
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_ring(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "days", NULL};
+    char *value, *p;
+    int  val;
+
+    if ((p = strchr(option, ',')) != NULL) *p++ = 0x0;
+
+    strncpy(sps->ring, option, MAXBUF - 1);
+
+    while (p && *p != 0x0) {
+
+        if (getsubopt(&p, keys, &value) == 0 && value && (val = (int) strtod(value, NULL)) > 0) {
+            sps->ring_days = (uint16_t) val;
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect circular file option. Use file,days=#\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the capture option dir[,pre=#,post=#]
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_capture(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "pre", (char *) "post", NULL};
+    char *value, *p;
+
+    if ((p = strchr(option, ',')) != NULL) *p++ = 0x0;
+
+    strncpy(sps->capture, option, MAXBUF - 1);
+
+    while (p && *p != 0x0) {
+
+        switch (getsubopt(&p, keys, &value)) {
+        case 0:
+            if (value == NULL) break;
+            sps->capture_pre = (uint32_t) strtod(value, NULL);
+            continue;
+        case 1:
+            if (value == NULL) break;
+            sps->capture_post = (uint32_t) strtod(value, NULL);
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect capture option. Use dir,pre=#,post=#\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the adaptive sampler option max=#,rate=#,var=#
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_sampler(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "max", (char *) "rate", (char *) "var", NULL};
+    char *value;
+
+    sps->sampler_max = SAMPLER_MAX;
+
+    while (*option != 0x0) {
+
+        switch (getsubopt(&option, keys, &value)) {
+        case 0:
+            if (value == NULL) break;
+            sps->sampler_max = (uint32_t) strtod(value, NULL);
+            continue;
+        case 1:
+            if (value == NULL) break;
+            sps->sampler_rate = strtod(value, NULL);
+            continue;
+        case 2:
+            if (value == NULL) break;
+            sps->sampler_var = strtod(value, NULL);
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect sampler option. Use max=#,rate=#,var=#\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the housekeeping option status=#,clean=#,device=#,clock=#
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_house(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "status", (char *) "clean", (char *) "device", (char *) "clock", NULL};
+    char *value;
+    int  t;
+
+    sps->house_on = true;
+
+    while (*option != 0x0) {
+
+        /* the keys are in the order of the tasks */
+        if ((t = getsubopt(&option, keys, &value)) >= 0 && value != NULL) {
+            sps->house[t] = (uint32_t) strtoul(value, NULL, 10);
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect housekeeping option. Use status=#,clean=#,device=#,clock=#\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the dose based cleaning option mass=#,num=#,max=#,slot=#/#
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_clean(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "mass", (char *) "num", (char *) "max", (char *) "slot", NULL};
+    char *value, *end;
+
+    sps->clean_mass = CLEAN_MASS;
+
+    while (*option != 0x0) {
+
+        switch (getsubopt(&option, keys, &value)) {
+        case 0:
+            if (value == NULL) break;
+            sps->clean_mass = strtod(value, NULL);
+            continue;
+        case 1:
+            if (value == NULL) break;
+            sps->clean_num = strtod(value, NULL);
+            continue;
+        case 2:
+            if (value == NULL) break;
+            sps->clean_max = (uint32_t) strtoul(value, NULL, 10);
+            continue;
+        case 3:
+            if (value == NULL) break;
+            sps->clean_slot = (uint16_t) strtoul(value, &end, 10);
+            if (*end != '/') break;
+            sps->clean_slots = (uint16_t) strtoul(end + 1, NULL, 10);
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect clean option. Use mass=#,num=#,max=#,slot=#/#\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (sps->clean_mass <= 0) {
+        p_printf (RED, (char *) "Incorrect clean option. The mass dose must be above 0\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the power budget option mW[,max=#]
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_power(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "max", NULL};
+    char *value, *p;
+
+    if ((p = strchr(option, ',')) != NULL) *p++ = 0x0;
+
+    sps->power_budget = strtod(option, NULL);
+
+    while (p && *p != 0x0) {
+
+        if (getsubopt(&p, keys, &value) == 0 && value) {
+            sps->power_max = (uint32_t) strtod(value, NULL);
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect power option. Use mW,max=#\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (sps->power_budget <= 0) {
+        p_printf (RED, (char *) "Incorrect power budget %s mW\n", option);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the MQTT option host[:port][,topic=t,qos=#,id=name,spool=file,agg=#]
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_mqtt(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "topic", (char *) "qos", (char *) "id", (char *) "spool",
+        (char *) "agg", NULL};
+    char *value, *p;
+
+    if ((p = strchr(option, ',')) != NULL) *p++ = 0x0;
+
+    strncpy(sps->mqtt, option, MAXBUF - 1);
+
+    while (p && *p != 0x0) {
+
+        switch (getsubopt(&p, keys, &value)) {
+        case 0:
+            if (value == NULL) break;
+            strncpy(sps->mqtt_topic, value, MAXBUF - 1);
+            continue;
+        case 1:
+            if (value == NULL || (*value != '0' && *value != '1')) break;
+            sps->mqtt_qos = *value - '0';
+            continue;
+        case 2:
+            if (value == NULL) break;
+            strncpy(sps->mqtt_id, value, MAXBUF - 1);
+            continue;
+        case 3:
+            if (value == NULL) break;
+            strncpy(sps->mqtt_spool, value, MAXBUF - 1);
+            continue;
+        case 4:
+            if (value == NULL) break;
+            sps->mqtt_agg = (uint32_t) strtod(value, NULL);
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect MQTT option. Use host[:port],topic=t,qos=#,id=name,spool=file,agg=#\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the InfluxDB option url[,site=name,flush=#]
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_influx(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "site", (char *) "flush", NULL};
+    char *value, *p;
+
+    if ((p = strchr(option, ',')) != NULL) *p++ = 0x0;
+
+    strncpy(sps->influx, option, MAXBUF - 1);
+
+    while (p && *p != 0x0) {
+
+        switch (getsubopt(&p, keys, &value)) {
+        case 0:
+            if (value == NULL) break;
+            strncpy(sps->influx_site, value, MAXBUF - 1);
+            continue;
+        case 1:
+            if (value == NULL) break;
+            sps->influx_flush = (uint32_t) strtod(value, NULL);
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect InfluxDB option. Use url,site=name,flush=#\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the replay option source[,sensor=#,speed=#|max,rebase]
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_replay(char *option, struct sps_par *sps)
+{
+    char *const keys[] = {(char *) "sensor", (char *) "speed", (char *) "rebase", NULL};
+    char *value, *p;
+
+    if ((p = strchr(option, ',')) != NULL) *p++ = 0x0;
+
+    strncpy(sps->replay, option, MAXBUF - 1);
+
+    while (p && *p != 0x0) {
+
+        switch (getsubopt(&p, keys, &value)) {
+        case 0:     // sensor
+            if (value) {
+                sps->replay_sensor = (int) strtod(value, NULL);
+                continue;
+            }
+            break;
+
+        case 1:     // speed
+            if (value && strcmp(value, "max") == 0) {
+                sps->replay_speed = 0;
+                continue;
+            }
+            if (value && strtod(value, NULL) > 0) {
+                sps->replay_speed = strtod(value, NULL);
+                continue;
+            }
+            break;
+
+        case 2:     // rebase
+            sps->replay_rebase = true;
+            continue;
+        }
+
+        p_printf (RED, (char *) "Incorrect replay option. Use source,sensor=#,speed=#|max,rebase\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*********************************************************************
+ * @brief parse the retention days raw=#,minute=#,hour=#
+ * @param option : option argument
+ * @param sps : pointer to SPS30 parameters
+ *********************************************************************/
+void parse_keep(char *option, struct sps_par *sps)
+{
+    char *const tiers[] = {(char *) "raw", (char *) "minute", (char *) "hour", NULL};
+    char *value;
+    int  t;
+
+    while (*option != 0x0) {
+
+        t = getsubopt(&option, tiers, &value);
+
+        if (t < 0 || value == NULL) {
+            p_printf (RED, (char *) "Incorrect retention. Use raw=#,minute=#,hour=# (days)\n");
+            exit(EXIT_FAILURE);
+        }
+
+        sps->keep[t] = (uint16_t) strtod(value, NULL);
+    }
+
+    sps->retention = true;
+}
+
 /*********************************************************************
  * Parse parameter input 
  * @param sps : pointer to SPS30 parameters
@@ -856,7 +2375,7 @@ void parse_cmdline(int opt, char *option, struct sps_par *sps)
         break;
 
     case 'E':  // toggle display device errors
-        if (MySensor.FWCheck(2,2))  
+        if (! SensorOpen || MySensor.FWCheck(2,2))  
             sps->DevStatus =! sps->DevStatus;
         else {
             p_printf (RED, (char *) "Can enable display device error status\n");
@@ -865,7 +2384,7 @@ void parse_cmdline(int opt, char *option, struct sps_par *sps)
         break;
         
     case 'F':  // toggle force sleep during wait-time
-        if (MySensor.FWCheck(2,0))  
+        if (! SensorOpen || MySensor.FWCheck(2,0))  
             sps->OptMode =! sps->OptMode;
         else {
             p_printf (RED, (char *) "Can set sleep during wait-time\n");
@@ -883,6 +2402,98 @@ void parse_cmdline(int opt, char *option, struct sps_par *sps)
             exit(EXIT_FAILURE);
         }
         break;
+    case 'o':   // store samples in directory
+        strncpy(sps->store, option, MAXBUF - 1);
+        break;
+
+    case 'i':   // sensor id in store
+        sps->sensor_id = (uint16_t) strtod(option, NULL);
+        break;
+
+    case 'c':   // store commit policy
+        parse_commit(option, sps);
+        break;
+
+    case 'K':   // rollups and retention
+        parse_keep(option, sps);
+        break;
+
+    case 'U':   // hour and day statistics
+        sps->cube = true;
+        break;
+
+    case 'z':   // compress sealed segments
+        sps->zip_level = (int) strtod(option, NULL);
+
+        if (sps->zip_level < 1 || sps->zip_level > 19) {
+            p_printf (RED, (char *) "Incorrect zstd level. Must be 1 - 19\n");
+            exit(EXIT_FAILURE);
+        }
+        break;
+
+    case 'R':   // circular file
+        parse_ring(option, sps);
+        break;
+
+    case 'Q':   // MQTT publisher
+        parse_mqtt(option, sps);
+        break;
+
+    case 'X':   // InfluxDB exporter
+        parse_influx(option, sps);
+        break;
+
+    case 'e':   // alert rules
+        strncpy(sps->rules, option, MAXBUF - 1);
+        break;
+
+    case 'k':   // capture around an alert
+        parse_capture(option, sps);
+        break;
+
+    case 's':   // adaptive sampler
+        parse_sampler(option, sps);
+        break;
+
+    case 'g':   // housekeeping
+        parse_house(option, sps);
+        break;
+
+    case 'j':   // dose based cleaning
+        parse_clean(option, sps);
+        break;
+
+    case 'q':   // quality left out of the output
+        if (! sps_quality_mask(option, &sps->quality)) {
+            p_printf(RED, (char *) "Incorrect quality %s. Use warmup,clean,settle,fault,retry,interp,bad or all\n", option);
+            exit(EXIT_FAILURE);
+        }
+        break;
+
+    case 'p':   // power budget
+        parse_power(option, sps);
+        break;
+
+    case 'y':   // report by exception
+        strncpy(sps->deadband, option, MAXBUF - 1);
+        break;
+
+    case 'W':   // web dashboard
+        strncpy(sps->web, option, MAXBUF - 1);
+        break;
+
+    case 'L':   // sample log for subscribers
+        strncpy(sps->log, option, MAXBUF - 1);
+        break;
+
+    case 'G':   // stream to aggregator
+        strncpy(sps->stream, option, MAXBUF - 1);
+        break;
+
+    case 'r':   // replay instead of SPS30
+        parse_replay(option, sps);
+        break;
+
     case 'C':   // toggle correlation calculation
         sps->relation = ! sps->relation;
         break;
@@ -916,10 +2527,21 @@ void parse_cmdline(int opt, char *option, struct sps_par *sps)
  **********************/
 int main(int argc, char *argv[])
 {
+    const char *opts = "CAa:mdBl:v:w:EFTHhMNPD:S:o:i:K:c:R:r:z:UQ:X:G:L:W:e:k:y:p:s:q:j:g:";
     int opt;
+    bool replay = false;
     struct sps_par sps; // parameters
 
-    if (geteuid() != 0)  {
+    /* a replay does not use the SPS30, check before the options that
+     * ask it for the firmware level (-E, -F) */
+    opterr = 0;
+    while ((opt = getopt(argc, argv, opts)) != -1) {
+        if (opt == 'r') replay = true;
+    }
+    optind = 1;
+    opterr = 1;
+
+    if (! replay && geteuid() != 0)  {
         p_printf(RED,(char *) "You must be super user\n");
         exit(EXIT_FAILURE);
     }
@@ -933,11 +2555,35 @@ int main(int argc, char *argv[])
     /* set the initial values */
     init_variables(&sps);
 
+    if (! replay) {
+        if (MySensor.begin() != ERR_OK) {
+            p_printf(RED,(char *)"Error during setting I2C\n");
+            exit(EXIT_FAILURE);
+        }
+
+        SensorOpen = true;
+    }
+
     /* parse commandline */
-    while ((opt = getopt(argc, argv, "CAa:mdBl:v:w:EFTHhMNPD:S:")) != -1) {
+    while ((opt = getopt(argc, argv, opts)) != -1) {
         parse_cmdline(opt, optarg, &sps);
     }
 
+    if (replay) {
+#ifdef DYLOS
+        sps.dylos.include = false;
+#endif
+#ifdef SDS011
+        sps.sds.include = false;
+#endif
+        init_store(&sps);
+
+        /* replay stored samples */
+        replay_loop(&sps);
+
+        closeout();
+    }
+
     /* initialise hardware */
     init_hw(&sps);
 
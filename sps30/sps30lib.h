@@ -38,6 +38,7 @@
 # include <string.h>
 # include <unistd.h>
 # include <bcm2835.h>
+# include "spssample.h"
 
 /**
  * library version levels
@@ -66,33 +67,6 @@
  */
 #define INCLUDE_FWCHECK 1
 
-/* structure to return all values */
-struct sps_values
-{
-    float   MassPM1;        // Mass Concentration PM1.0 [μg/m3]
-    float   MassPM2;        // Mass Concentration PM2.5 [μg/m3]
-    float   MassPM4;        // Mass Concentration PM4.0 [μg/m3]
-    float   MassPM10;       // Mass Concentration PM10 [μg/m3]
-    float   NumPM0;         // Number Concentration PM0.5 [#/cm3]
-    float   NumPM1;         // Number Concentration PM1.0 [#/cm3]
-    float   NumPM2;         // Number Concentration PM2.5 [#/cm3]
-    float   NumPM4;         // Number Concentration PM4.0 [#/cm3]
-    float   NumPM10;        // Number Concentration PM4.0 [#/cm3]
-    float   PartSize;       // Typical Particle Size [μm]
-};
-
-/* used to get single value */
-#define v_MassPM1 1
-#define v_MassPM2 2
-#define v_MassPM4 3
-#define v_MassPM10 4
-#define v_NumPM0 5
-#define v_NumPM1 6
-#define v_NumPM2 7
-#define v_NumPM4 8
-#define v_NumPM10 9
-#define v_PartSize 10
-
 /* needed for conversion float IEE754 */
 typedef union {
     uint8_t array[4];
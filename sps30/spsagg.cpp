@@ -0,0 +1,834 @@
+/**
+ * spsagg.cpp
+ *
+ * Aggregator for the sample streams of many SPS30 monitors (option -G)
+ *
+ * Merges the streams into one stream ordered by timestamp and computes
+ * site rollups: per bucket the median over the sensors of the mean of
+ * each sensor. Does not need the BCM2835 library. Build with:
+ *      make spsagg
+ *
+ * Examples:
+ *  listen on TCP port 7030 and a Unix socket, rollups per minute
+ *      ./spsagg -l :7030 -l /tmp/spsagg.sock
+ *
+ *  also write the merged samples to a file, allow 10 s late samples
+ *      ./spsagg -l :7030 -o /data/site.bin -L 10
+ *
+ *  alert rules (see spsrule.h) on the merged stream of all sensors
+ *      ./spsagg -l :7030 -e /etc/sps/alerts.rules
+ *
+ *  keep 5 minutes of each sensor, write them with the next 10 minutes
+ *  when a rule with 'do capture' fires
+ *      ./spsagg -l :7030 -e /etc/sps/alerts.rules -k /data/capture,pre=5,post=10
+ *
+ *  leave samples in warm-up, cleaning or with a fault out of the rollups
+ *      ./spsagg -l :7030 -q bad
+ *
+ *  1000 simulated sensors, 60 times faster than real time
+ *      ./spsagg -l :7030 -v &
+ *      ./spsload -a localhost:7030 -n 1000 -s 60
+ *
+ * The merge is a k-way merge: a heap of the producers, ordered by the
+ * timestamp of their oldest sample. The watermark is the newest
+ * timestamp seen minus the lateness (-L). Samples up to the watermark
+ * are taken from the heap in order. A sample older than what was
+ * already merged is late: it is counted and left out.
+ *
+ * *****************************************************************
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * version 1.0 / October 2026
+ *  - initial version
+ *  - alert rules (-e)
+ *  - capture around an alert (-k)
+ *  - leave samples out of the rollup by their quality (-q)
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include <unistd.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <time.h>
+# include <signal.h>
+# include <sys/epoll.h>
+# include <sys/socket.h>
+# include "spsstream.h"
+# include "spsrule.h"
+# include "spscapture.h"
+
+#define AGG_MAJOR 1
+#define AGG_MINOR 0
+
+#define AGG_LATENESS    5               // seconds a sample may be late
+#define AGG_BUCKET      60              // seconds in a site rollup
+#define AGG_REPORT      10              // seconds between reports (-v)
+#define AGG_LISTEN      4               // listen addresses
+#define AGG_READ        65536           // bytes read at once
+#define AGG_EVENTS      1024            // events handled at once
+#define AGG_QUEUE       64              // first size of a producer queue
+#define AGG_SENSORS     65536           // sensor ids
+#define AGG_CAPTURE     10              // minutes before / after a capture
+
+/* a producer, or a listening socket */
+typedef struct producer
+{
+    int      fd;                        // -1 when closed
+    bool     listener;
+    char     name[24];                  // from the hello
+    uint8_t  part[sizeof(struct sps_sample)];   // incomplete record
+    uint32_t partlen;
+    bool     hello;                     // hello received
+
+    struct sps_sample *q;               // samples not yet merged
+    uint32_t qhead, qlen, qcap;
+    int      heap;                      // position in heap or -1
+    uint32_t last_ts;                   // newest timestamp received
+
+    uint64_t samples;
+    uint64_t late;
+} producer;
+
+/* a sensor in the current bucket */
+typedef struct sensor_acc
+{
+    double   sum[SPS_FIELDS];
+    uint32_t count;
+} sensor_acc;
+
+typedef struct agg_par
+{
+    char     listen[AGG_LISTEN][256];   // addresses
+    int      nlisten;
+    uint32_t lateness;                  // seconds
+    uint32_t bucket;                    // seconds
+    char     out[256];                  // merged samples file, "-" = CSV
+    char     rules[256];                // alert rules (empty = none)
+    char     capture[256];              // capture directory (empty = none)
+    uint32_t capture_pre;               // minutes before a trigger
+    uint32_t capture_post;              // minutes after a trigger
+    uint16_t quality;                   // SPS_FLAG_xxx left out of the rollup
+    int      verbose;
+} agg_par;
+
+char progname[20];
+
+static volatile sig_atomic_t Stop = 0;
+
+/* the merge */
+static producer **Heap;
+static int       HeapLen;
+static uint32_t  MaxTs;                 // newest timestamp seen
+static uint32_t  Merged;                // merged up to (inclusive)
+
+/* the site rollup */
+static int32_t   *Slot;                 // sensor id -> Acc
+static sensor_acc *Acc;
+static uint16_t  *AccId;
+static int       NAcc, MaxAcc;
+static uint32_t  BucketStart;
+static uint64_t  BucketSamples;
+static float     *Values;
+
+/* the merged stream */
+static FILE      *Out;
+static bool      OutCsv;
+
+/* alert rules */
+static SPSrule   Rules;
+static SPScapture Capture;
+
+/* statistics */
+static uint64_t  StSamples, StMerged, StLate, StBuckets, StExcluded;
+static uint32_t  StProducers, StConnects;
+
+/*********************************************************************
+ * @brief format a timestamp as local time
+ *********************************************************************/
+static void time_str(uint32_t ts, char *buf, int len)
+{
+    time_t t = ts;
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    strftime(buf, len, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+/*********************************************************************
+ * @brief CPU seconds used by the process
+ *********************************************************************/
+static double cpu_sec()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/*********************************************************************
+ *  heap of producers, by the timestamp of their oldest sample
+ *********************************************************************/
+
+static inline uint32_t head_ts(producer *p)
+{
+    return(p->q[p->qhead].ts);
+}
+
+static void heap_set(int i, producer *p)
+{
+    Heap[i] = p;
+    p->heap = i;
+}
+
+static void heap_up(int i)
+{
+    producer *p = Heap[i];
+
+    while (i > 0 && head_ts(Heap[(i - 1) / 2]) > head_ts(p)) {
+        heap_set(i, Heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+
+    heap_set(i, p);
+}
+
+static void heap_down(int i)
+{
+    producer *p = Heap[i];
+    int c;
+
+    while ((c = 2 * i + 1) < HeapLen) {
+        if (c + 1 < HeapLen && head_ts(Heap[c + 1]) < head_ts(Heap[c])) c++;
+        if (head_ts(Heap[c]) >= head_ts(p)) break;
+
+        heap_set(i, Heap[c]);
+        i = c;
+    }
+
+    heap_set(i, p);
+}
+
+static void heap_pop()
+{
+    Heap[0]->heap = -1;
+
+    if (--HeapLen > 0) {
+        heap_set(0, Heap[HeapLen]);
+        heap_down(0);
+    }
+}
+
+/*********************************************************************
+ *  site rollup
+ *********************************************************************/
+
+/**
+ * @brief k-th smallest value (the order of a is changed)
+ */
+static float select_k(float *a, int n, int k)
+{
+    int lo = 0, hi = n - 1, i, j;
+    float pivot, t;
+
+    while (lo < hi) {
+        pivot = a[(lo + hi) / 2];
+        i = lo;
+        j = hi;
+
+        while (i <= j) {
+            while (a[i] < pivot) i++;
+            while (a[j] > pivot) j--;
+
+            if (i <= j) {
+                t = a[i]; a[i] = a[j]; a[j] = t;
+                i++;
+                j--;
+            }
+        }
+
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else break;
+    }
+
+    return(a[k]);
+}
+
+/**
+ * @brief median of n values (the order of a is changed)
+ */
+static float median(float *a, int n)
+{
+    float hi = select_k(a, n, n / 2), lo;
+
+    if (n & 1) return(hi);
+
+    // the largest of the lower half
+    lo = a[0];
+    for (int i = 1; i < n / 2; i++) if (a[i] > lo) lo = a[i];
+
+    return((lo + hi) / 2);
+}
+
+/**
+ * @brief display the rollup of the bucket and start a new one
+ */
+static void bucket_close()
+{
+    char buf[30];
+    int  n = 0;
+
+    for (int i = 0; i < NAcc; i++) {
+        if (Acc[i].count > 0) n++;
+    }
+
+    if (n > 0) {
+        time_str(BucketStart, buf, sizeof(buf));
+        printf("%s,%d,%llu", buf, n, (unsigned long long) BucketSamples);
+
+        for (int f = 0; f < SPS_FIELDS; f++) {
+            n = 0;
+
+            for (int i = 0; i < NAcc; i++) {
+                if (Acc[i].count > 0) Values[n++] = Acc[i].sum[f] / Acc[i].count;
+            }
+
+            printf(",%.4f", median(Values, n));
+        }
+
+        printf("\n");
+        fflush(stdout);
+        StBuckets++;
+    }
+
+    for (int i = 0; i < NAcc; i++) {
+        Acc[i].count = 0;
+        memset(Acc[i].sum, 0x0, sizeof(Acc[i].sum));
+    }
+
+    BucketSamples = 0;
+}
+
+/**
+ * @brief add a merged sample to the bucket
+ */
+static void bucket_add(const struct sps_sample *s, uint32_t bucket)
+{
+    sensor_acc *a;
+    int32_t i;
+
+    if (s->ts >= BucketStart + bucket) {
+        bucket_close();
+        BucketStart = s->ts - s->ts % bucket;
+    }
+
+    if ((i = Slot[s->sensor]) < 0) {
+
+        if (NAcc == MaxAcc) {
+            MaxAcc = MaxAcc ? MaxAcc * 2 : 256;
+            Acc = (sensor_acc *) realloc(Acc, MaxAcc * sizeof(sensor_acc));
+            AccId = (uint16_t *) realloc(AccId, MaxAcc * sizeof(uint16_t));
+            Values = (float *) realloc(Values, MaxAcc * sizeof(float));
+
+            if (Acc == NULL || AccId == NULL || Values == NULL) {
+                printf("Out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        i = Slot[s->sensor] = NAcc++;
+        memset(&Acc[i], 0x0, sizeof(sensor_acc));
+        AccId[i] = s->sensor;
+    }
+
+    a = &Acc[i];
+
+    for (int f = 0; f < SPS_FIELDS; f++) a->sum[f] += sps_field(&s->v, f);
+
+    a->count++;
+    BucketSamples++;
+}
+
+/*********************************************************************
+ *  merge
+ *********************************************************************/
+
+/**
+ * @brief output a merged sample
+ */
+static void emit(const struct sps_sample *s, agg_par *a)
+{
+    char buf[30];
+
+    if (Out) {
+        if (OutCsv) {
+            time_str(s->ts, buf, sizeof(buf));
+            fprintf(Out, "%s,%u", buf, s->sensor);
+
+            for (int i = 0; i < SPS_FIELDS; i++) fprintf(Out, ",%.4f", sps_field(&s->v, i));
+            fprintf(Out, "\n");
+        }
+        else fwrite(s, sizeof(struct sps_sample), 1, Out);
+    }
+
+    if (s->flags & a->quality) StExcluded++;
+    else bucket_add(s, a->bucket);
+
+    Capture.add(s, 0);
+    Rules.sample(s);
+    StMerged++;
+}
+
+/**
+ * @brief merge the samples up to the watermark
+ * @param all : merge all (at the end)
+ */
+static void merge(agg_par *a, bool all)
+{
+    uint32_t wm = MaxTs > a->lateness ? MaxTs - a->lateness : 0;
+    producer *p;
+
+    while (HeapLen > 0) {
+        p = Heap[0];
+
+        if (! all && head_ts(p) > wm) break;
+
+        Merged = head_ts(p);
+        emit(&p->q[p->qhead], a);
+
+        p->qhead = (p->qhead + 1) % p->qcap;
+
+        if (--p->qlen > 0) heap_down(0);
+        else {
+            heap_pop();
+
+            // closed while its samples were waiting
+            if (p->fd < 0) {
+                free(p->q);
+                free(p);
+            }
+        }
+    }
+
+    if (wm > Merged) Merged = wm;
+}
+
+/**
+ * @brief a sample received from a producer
+ */
+static void receive(producer *p, const struct sps_sample *s)
+{
+    struct sps_sample *q;
+    uint32_t n;
+
+    StSamples++;
+    p->samples++;
+
+    // older than what was merged, or than the own previous sample
+    if ((StMerged > 0 && s->ts <= Merged) || s->ts < p->last_ts) {
+        p->late++;
+        StLate++;
+        return;
+    }
+
+    // grow the queue, the samples in order from 0
+    if (p->qlen == p->qcap) {
+        n = p->qcap ? p->qcap * 2 : AGG_QUEUE;
+
+        if ((q = (struct sps_sample *) malloc(n * sizeof(struct sps_sample))) == NULL) {
+            printf("Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (uint32_t i = 0; i < p->qlen; i++) q[i] = p->q[(p->qhead + i) % p->qcap];
+
+        free(p->q);
+        p->q = q;
+        p->qhead = 0;
+        p->qcap = n;
+    }
+
+    p->q[(p->qhead + p->qlen) % p->qcap] = *s;
+    p->last_ts = s->ts;
+
+    if (p->qlen++ == 0) {
+        heap_set(HeapLen++, p);
+        heap_up(HeapLen - 1);
+    }
+
+    if (s->ts > MaxTs) MaxTs = s->ts;
+}
+
+/*********************************************************************
+ *  connections
+ *********************************************************************/
+
+/**
+ * @brief read from a producer
+ *
+ * @return false when the connection is closed
+ */
+static bool read_producer(producer *p, agg_par *a)
+{
+    static uint8_t buf[AGG_READ + sizeof(struct sps_sample)];
+    struct stream_hello h;
+    struct sps_sample s;
+    ssize_t r;
+    size_t  len, pos = 0;
+
+    memcpy(buf, p->part, p->partlen);
+
+    if ((r = read(p->fd, buf + p->partlen, AGG_READ)) <= 0) {
+        if (r < 0 && (errno == EAGAIN || errno == EINTR)) return(true);
+        return(false);
+    }
+
+    len = p->partlen + r;
+
+    if (! p->hello) {
+        if (len < sizeof(h)) {
+            memcpy(p->part, buf, len);
+            p->partlen = len;
+            return(true);
+        }
+
+        memcpy(&h, buf, sizeof(h));
+
+        if (h.magic != STREAM_MAGIC || h.version != STREAM_VERSION) {
+            if (a->verbose) printf("# producer is not an SPS30 stream, closed\n");
+            return(false);
+        }
+
+        memcpy(p->name, h.name, sizeof(p->name));
+        p->name[sizeof(p->name) - 1] = 0x0;
+        p->hello = true;
+        pos = sizeof(h);
+
+        if (a->verbose > 1) printf("# producer %s connected\n", p->name);
+    }
+
+    for (; pos + sizeof(s) <= len; pos += sizeof(s)) {
+        memcpy(&s, buf + pos, sizeof(s));
+        receive(p, &s);
+    }
+
+    p->partlen = len - pos;
+    memcpy(p->part, buf + pos, p->partlen);
+
+    return(true);
+}
+
+/**
+ * @brief accept a producer
+ */
+static void accept_producer(int epfd, producer *l, agg_par *a)
+{
+    struct epoll_event ev;
+    producer *p;
+    int fd;
+
+    if ((fd = accept4(l->fd, NULL, NULL, SOCK_NONBLOCK)) < 0) return;
+
+    if ((p = (producer *) calloc(1, sizeof(producer))) == NULL) {
+        close(fd);
+        return;
+    }
+
+    p->fd = fd;
+    p->heap = -1;
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = p;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        close(fd);
+        free(p);
+        return;
+    }
+
+    StProducers++;
+    StConnects++;
+}
+
+/**
+ * @brief a producer closed: free it when its samples are merged
+ */
+static void close_producer(int epfd, producer *p, agg_par *a)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, p->fd, NULL);
+    close(p->fd);
+    p->fd = -1;
+    StProducers--;
+
+    if (a->verbose > 1) printf("# producer %s closed, %llu samples, %llu late\n", p->name,
+        (unsigned long long) p->samples, (unsigned long long) p->late);
+}
+
+/*********************************************************************
+ * @brief display the statistics
+ *********************************************************************/
+static void report(double elapsed, double cpu, uint64_t samples)
+{
+    printf("# %u producers, %u sensors, %llu samples (%.0f/s), %llu merged, %llu late, %d waiting, CPU %.1f%% (%.2f us per sample)\n",
+        StProducers, (unsigned) NAcc, (unsigned long long) StSamples, elapsed > 0 ? samples / elapsed : 0,
+        (unsigned long long) StMerged, (unsigned long long) StLate, HeapLen, elapsed > 0 ? cpu * 100 / elapsed : 0,
+        samples ? cpu * 1e6 / samples : 0);
+}
+
+/*********************************************************************
+* @brief usage information
+**********************************************************************/
+void usage()
+{
+    printf("%s [options]  (program version %d.%d)\n\n"
+    "-l addr    listen on host:port, :port, unix:/path or /path (up to %d)\n"
+    "                                                 (default :%s)\n"
+    "-L #       seconds a sample may be late          (default %d)\n"
+    "-b #       seconds in a site rollup              (default %d)\n"
+    "-o file    write the merged samples (48 bytes each), - = CSV on stdout\n"
+    "-e file    alert rules on the merged samples (see spsrule.h)\n"
+    "-k dir[,pre=#,post=#]  on a rule with 'do capture' write the samples of\n"
+    "           the sensor pre minutes before and post minutes after to dir\n"
+"                                                 (default pre=%d,post=%d)\n"
+    "-q list    leave samples with this quality out of the rollup:\n"
+    "           warmup,clean,settle,fault,retry,interp, bad or all\n"
+    "-v         verbose: report every %d s (-vv: producers)\n"
+    "\n\tA site rollup is a line: bucket,sensors,samples followed by the\n"
+    "\tmedian over the sensors of each field (MassPM1 .. PartSize)\n"
+    , progname, AGG_MAJOR, AGG_MINOR, AGG_LISTEN, STREAM_PORT, AGG_LATENESS, AGG_BUCKET, AGG_CAPTURE, AGG_CAPTURE, AGG_REPORT);
+}
+
+/*********************************************************************
+* @brief parse the capture option dir[,pre=#,post=#]
+**********************************************************************/
+static void parse_capture(agg_par *a, char *option)
+{
+    char *const keys[] = {(char *) "pre", (char *) "post", NULL};
+    char *value, *p;
+
+    if ((p = strchr(option, ',')) != NULL) *p++ = 0x0;
+
+    strncpy(a->capture, option, sizeof(a->capture) - 1);
+
+    while (p && *p != 0x0) {
+
+        switch (getsubopt(&p, keys, &value)) {
+        case 0:
+            if (value == NULL) break;
+            a->capture_pre = (uint32_t) strtoul(value, NULL, 10);
+            continue;
+        case 1:
+            if (value == NULL) break;
+            a->capture_post = (uint32_t) strtoul(value, NULL, 10);
+            continue;
+        }
+
+        printf("Incorrect capture option. Use dir,pre=#,post=#\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* action capture of the rules */
+static void capture_action(const struct rule_event *ev, void *ctx)
+{
+    if (ev->state != RULE_CLEAR) Capture.trigger(ev->sensor, ev->ts, ev->rule);
+}
+
+static void signal_handler(int sig)
+{
+    Stop = 1;
+}
+
+/***********************
+ *  program starts here
+ **********************/
+int main(int argc, char *argv[])
+{
+    struct epoll_event ev, events[AGG_EVENTS];
+    struct sigaction sa;
+    producer *p, *lst[AGG_LISTEN];
+    double  t0, t1, c0, c1;
+    uint64_t s0;
+    agg_par a;
+    int opt, epfd, n;
+
+    strncpy(progname, argv[0], 19);
+    progname[19] = 0x0;
+
+    memset(&a, 0x0, sizeof(a));
+    a.lateness = AGG_LATENESS;
+    a.bucket = AGG_BUCKET;
+    a.capture_pre = AGG_CAPTURE;
+    a.capture_post = AGG_CAPTURE;
+
+    while ((opt = getopt(argc, argv, "l:L:b:o:e:k:q:vh")) != -1) {
+        switch (opt) {
+        case 'l':
+            if (a.nlisten == AGG_LISTEN) {
+                printf("At most %d listen addresses\n", AGG_LISTEN);
+                exit(EXIT_FAILURE);
+            }
+            strncpy(a.listen[a.nlisten++], optarg, 255);
+            break;
+        case 'L':  a.lateness = (uint32_t) strtoul(optarg, NULL, 10); break;
+        case 'b':  a.bucket = (uint32_t) strtoul(optarg, NULL, 10); break;
+        case 'o':  strncpy(a.out, optarg, sizeof(a.out) - 1); break;
+        case 'e':  strncpy(a.rules, optarg, sizeof(a.rules) - 1); break;
+        case 'k':  parse_capture(&a, optarg); break;
+        case 'q':
+            if (! sps_quality_mask(optarg, &a.quality)) {
+                printf("Incorrect quality %s. Use warmup,clean,settle,fault,retry,interp,bad or all\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'v':  a.verbose++; break;
+        case 'h':  usage(); exit(EXIT_SUCCESS);
+        default:   usage(); exit(EXIT_FAILURE);
+        }
+    }
+
+    if (a.bucket == 0) a.bucket = AGG_BUCKET;
+    if (a.nlisten == 0) snprintf(a.listen[a.nlisten++], 255, ":%s", STREAM_PORT);
+
+    if (a.out[0] != 0x0) {
+        if (strcmp(a.out, "-") == 0) {
+            Out = stdout;
+            OutCsv = true;
+        }
+        else if ((Out = fopen(a.out, "ab")) == NULL) {
+            printf("Can not open %s\n", a.out);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // the rings are sized for a sample per second
+    if (a.capture[0] != 0x0) {
+        if (Capture.open(a.capture, a.capture_pre, a.capture_post, 1, a.verbose) != STORE_OK) exit(EXIT_FAILURE);
+        Rules.action("capture", capture_action, NULL);
+    }
+
+    if (a.rules[0] != 0x0 && Rules.load(a.rules, a.verbose) != STORE_OK) exit(EXIT_FAILURE);
+
+    Heap = (producer **) malloc(sizeof(producer *) * 65536);
+    Slot = (int32_t *) malloc(sizeof(int32_t) * AGG_SENSORS);
+
+    if (Heap == NULL || Slot == NULL || (epfd = epoll_create1(0)) < 0) {
+        printf("Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(Slot, 0xff, sizeof(int32_t) * AGG_SENSORS);
+
+    for (int i = 0; i < a.nlisten; i++) {
+        lst[i] = (producer *) calloc(1, sizeof(producer));
+
+        if (lst[i] == NULL || (lst[i]->fd = stream_listen(a.listen[i])) < 0) {
+            printf("Can not listen on %s\n", a.listen[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        lst[i]->listener = true;
+        ev.events = EPOLLIN;
+        ev.data.ptr = lst[i];
+        epoll_ctl(epfd, EPOLL_CTL_ADD, lst[i]->fd, &ev);
+    }
+
+    memset(&sa, 0x0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("# bucket,sensors,samples,median of MassPM1,MassPM2,MassPM4,MassPM10,NumPM0,NumPM1,NumPM2,NumPM4,NumPM10,PartSize\n");
+    fflush(stdout);
+
+    t0 = time(NULL);
+    c0 = cpu_sec();
+    s0 = 0;
+
+    while (! Stop) {
+
+        if ((n = epoll_wait(epfd, events, AGG_EVENTS, 1000)) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            p = (producer *) events[i].data.ptr;
+
+            if (p->listener) accept_producer(epfd, p, &a);
+            else if (! read_producer(p, &a)) {
+                close_producer(epfd, p, &a);
+
+                // the queue stays in the heap until merged, then freed
+                if (p->qlen == 0) {
+                    free(p->q);
+                    free(p);
+                }
+            }
+        }
+
+        // merge when all that was waiting has been read, else the
+        // watermark moves on while other producers are not read yet
+        if (n < AGG_EVENTS) merge(&a, false);
+
+        if (a.verbose && (t1 = time(NULL)) >= t0 + AGG_REPORT) {
+            c1 = cpu_sec();
+            report(t1 - t0, c1 - c0, StSamples - s0);
+            t0 = t1;
+            c0 = c1;
+            s0 = StSamples;
+        }
+    }
+
+    // the rest, in order, and the last bucket
+    merge(&a, true);
+    bucket_close();
+
+    if (Out && ! OutCsv) fclose(Out);
+
+    for (int i = 0; i < a.nlisten; i++) {
+        close(lst[i]->fd);
+        if (a.listen[i][0] == '/' || strncmp(a.listen[i], "unix:", 5) == 0)
+            unlink(a.listen[i][0] == '/' ? a.listen[i] : a.listen[i] + 5);
+    }
+
+    printf("# %u connects, %llu samples, %llu merged, %llu late, %llu rollups, %llu left out, CPU %.3f s\n",
+        StConnects, (unsigned long long) StSamples, (unsigned long long) StMerged, (unsigned long long) StLate,
+        (unsigned long long) StBuckets, (unsigned long long) StExcluded, cpu_sec());
+
+    if (Rules.is_open()) {
+        struct rule_stats st;
+
+        Rules.stats(&st);
+        printf("# rules: %u rules, %u windows, %u sensors, %llu evaluated, %llu fired, %llu cleared, %.2f s (%.2f us per sample)\n",
+            st.rules, st.windows, st.sensors, (unsigned long long) st.evals, (unsigned long long) st.fired,
+            (unsigned long long) st.cleared, st.eval_time, st.samples ? st.eval_time * 1e6 / st.samples : 0);
+        Rules.close();
+    }
+
+    if (Capture.is_open()) {
+        struct capture_stats st;
+
+        Capture.close();
+        Capture.stats(&st);
+        printf("# capture: %u sensors, %u captures, %u extended, %u failed, %llu samples written, %llu bytes of rings\n",
+            st.sensors, st.captures, st.extended, st.failed, (unsigned long long) st.records,
+            (unsigned long long) st.memory);
+    }
+
+    return(EXIT_SUCCESS);
+}
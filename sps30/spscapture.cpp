@@ -0,0 +1,263 @@
+/**
+ * SPS30 event capture for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spscapture.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "spscapture.h"
+
+/* the ring of a sensor, the records follow in the same allocation */
+struct capture_ring
+{
+    uint32_t head;                  // next slot
+    uint32_t count;                 // records in the ring
+    int      fd;                    // capture file, -1 = none
+    uint32_t until;                 // end of the capture
+    uint32_t written;               // records in the file
+    struct capture_header hdr;
+    char     name[PATH_MAX];
+    struct capture_rec *rec;
+};
+
+/**
+ * @brief write all of a buffer
+ */
+static bool capture_write(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write(fd, p, len)) < 0) {
+            if (errno == EINTR) continue;
+            return(false);
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return(true);
+}
+
+SPScapture::SPScapture(void)
+{
+    _dir[0] = 0x0;
+    _capacity = 0;
+    _post = 0;
+    _rings = NULL;
+    _verbose = 0;
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief set up the capture
+ */
+int SPScapture::open(const char *dir, uint32_t pre, uint32_t post, uint32_t interval, int verbose)
+{
+    struct stat st;
+
+    if (stat(dir, &st) != 0 || ! S_ISDIR(st.st_mode)) {
+        printf("Capture: %s is not a directory\n", dir);
+        return(STORE_ERROR);
+    }
+
+    strncpy(_dir, dir, sizeof(_dir) - 1);
+    _dir[sizeof(_dir) - 1] = 0x0;
+    _capacity = pre * 60 / (interval > 0 ? interval : 1) + 1;
+    _post = post * 60;
+    _verbose = verbose;
+
+    if ((_rings = (struct capture_ring **) calloc(CAPTURE_SENSORS, sizeof(struct capture_ring *))) == NULL) {
+        printf("Capture: out of memory\n");
+        return(STORE_ERROR);
+    }
+
+    if (_verbose)
+        printf("Capture: %u samples before and %u s after a trigger, %lu bytes per sensor\n",
+            _capacity, _post, (unsigned long) (sizeof(struct capture_ring) + _capacity * sizeof(struct capture_rec)));
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add a sample to the ring of its sensor, and to the file during
+ * a capture
+ */
+void SPScapture::add(const struct sps_sample *s, uint32_t errors)
+{
+    struct capture_ring *r;
+    struct capture_rec *rec;
+    size_t len;
+
+    if (! is_open()) return;
+
+    // the ring of a new sensor, its size is fixed from now on
+    if ((r = _rings[s->sensor]) == NULL) {
+        len = sizeof(struct capture_ring) + _capacity * sizeof(struct capture_rec);
+
+        if ((r = (struct capture_ring *) calloc(1, len)) == NULL) return;
+
+        r->fd = -1;
+        r->rec = (struct capture_rec *) (r + 1);
+        _rings[s->sensor] = r;
+        _st.sensors++;
+        _st.memory += len;
+    }
+
+    rec = &r->rec[r->head];
+    rec->s = *s;
+    rec->errors = errors;
+    rec->reserved = 0;
+
+    if (++r->head == _capacity) r->head = 0;
+    if (r->count < _capacity) r->count++;
+
+    if (r->fd < 0) return;
+
+    if (! capture_write(r->fd, rec, sizeof(struct capture_rec))) {
+        printf("Capture: can not write %s\n", r->name);
+        _st.failed++;
+        finish(r);
+        return;
+    }
+
+    r->written++;
+    _st.records++;
+
+    if (s->ts >= r->until) finish(r);
+}
+
+/**
+ * @brief start (or extend) a capture of a sensor
+ */
+void SPScapture::trigger(uint16_t sensor, uint32_t ts, const char *rule)
+{
+    struct capture_ring *r;
+    struct capture_header *h;
+    char   buf[20];
+    time_t t = ts;
+    struct tm tm;
+    uint32_t first;
+    bool   ok;
+
+    // no samples of the sensor yet
+    if (! is_open() || (r = _rings[sensor]) == NULL) return;
+
+    if (r->fd > -1) {
+        r->until = ts + _post;
+        _st.extended++;
+        return;
+    }
+
+    gmtime_r(&t, &tm);
+    strftime(buf, sizeof(buf), "%Y%m%d-%H%M%S", &tm);
+    snprintf(r->name, sizeof(r->name), "%s/s%03u-%s.cap", _dir, sensor, buf);
+
+    if ((r->fd = ::open(r->name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        printf("Capture: can not create %s\n", r->name);
+        _st.failed++;
+        return;
+    }
+
+    h = &r->hdr;
+    memset(h, 0x0, sizeof(struct capture_header));
+    h->magic = CAPTURE_MAGIC;
+    h->version = CAPTURE_VERSION;
+    h->sensor = sensor;
+    h->rec_size = sizeof(struct capture_rec);
+    h->trigger = ts;
+    h->pre = r->count;
+    strncpy(h->rule, rule, CAPTURE_NAME - 1);
+
+    // the ring as it is, the oldest record first
+    first = r->count < _capacity ? 0 : r->head;
+
+    ok = capture_write(r->fd, h, sizeof(struct capture_header))
+        && capture_write(r->fd, &r->rec[first], (r->count - first) * sizeof(struct capture_rec))
+        && capture_write(r->fd, r->rec, first * sizeof(struct capture_rec));
+
+    if (! ok) {
+        printf("Capture: can not write %s\n", r->name);
+        _st.failed++;
+        ::close(r->fd);
+        r->fd = -1;
+        return;
+    }
+
+    r->written = r->count;
+    r->until = ts + _post;
+    _st.records += r->count;
+    _st.captures++;
+
+    if (_verbose) printf("Capture: %s started by %s with %u samples\n", r->name, rule, r->count);
+
+    if (_post == 0) finish(r);
+}
+
+/**
+ * @brief write the count and close the file of a capture
+ */
+void SPScapture::finish(struct capture_ring *r)
+{
+    r->hdr.count = r->written;
+
+    if (pwrite(r->fd, &r->hdr, sizeof(struct capture_header), 0) != sizeof(struct capture_header))
+        printf("Capture: can not complete %s\n", r->name);
+
+    ::close(r->fd);
+    r->fd = -1;
+
+    if (_verbose) printf("Capture: %s complete with %u samples\n", r->name, r->written);
+}
+
+void SPScapture::close()
+{
+    if (! is_open()) return;
+
+    for (int i = 0; i < CAPTURE_SENSORS; i++) {
+        if (_rings[i] == NULL) continue;
+
+        if (_rings[i]->fd > -1) finish(_rings[i]);
+        free(_rings[i]);
+    }
+
+    free(_rings);
+    _rings = NULL;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPScapture::stats(struct capture_stats *st)
+{
+    *st = _st;
+}
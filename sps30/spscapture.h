@@ -0,0 +1,146 @@
+/**
+ * SPS30 event capture header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Pre / post trigger capture of the raw samples around an event
+ * (option -k), like the trigger of an oscilloscope. It needs no sample
+ * store, so a unit that only keeps rollups or exports its samples still
+ * has the full resolution of a pollution event.
+ *
+ * Each sensor has a ring in memory with the last 'pre' minutes of
+ * samples, with the status register (in the flags) and the count of
+ * bus errors so far. The ring is allocated once with the first sample
+ * of the sensor and has a fixed size, a sample is written in its slot
+ * and nothing else is copied.
+ *
+ * The trigger is an alert rule with the action capture (see spsrule.h):
+ *
+ *  pm25: MassPM2 > 35 for 1m do capture
+ *
+ * On a trigger the ring is written as it is to a new file in the
+ * capture directory, then the samples of the next 'post' minutes are
+ * appended. A trigger during the post minutes extends the capture.
+ *
+ * A capture file, sNNN-YYYYMMDD-HHMMSS.cap (UTC of the trigger):
+ *
+ *  capture_header
+ *  capture_rec     pre records, the last one is the trigger sample
+ *  capture_rec     records after the trigger
+ *
+ * The count in the header is written when the capture is complete, 0
+ * means it was interrupted: the records up to the end of the file are
+ * valid. Read with spsquery -c file.
+ *********************************************************************
+*/
+#ifndef SPSCAPTURE_H
+#define SPSCAPTURE_H
+
+# include "spsstore.h"
+
+#define CAPTURE_MAGIC       0x5350534b      // "SPSK"
+#define CAPTURE_VERSION     1
+#define CAPTURE_SENSORS     65536
+#define CAPTURE_NAME        32
+
+/* one record, 56 bytes */
+struct capture_rec
+{
+    struct sps_sample s;
+    uint32_t errors;                // bus errors since the start
+    uint32_t reserved;
+};
+
+/* start of a capture file, 64 bytes */
+struct capture_header
+{
+    uint32_t magic;                 // CAPTURE_MAGIC
+    uint16_t version;               // CAPTURE_VERSION
+    uint16_t sensor;
+    uint32_t rec_size;              // sizeof(capture_rec)
+    uint32_t trigger;               // timestamp of the trigger
+    uint32_t pre;                   // records up to the trigger
+    uint32_t count;                 // all records, 0 = not complete
+    char     rule[CAPTURE_NAME];    // that triggered
+    uint32_t reserved[2];
+};
+
+/* statistics */
+struct capture_stats
+{
+    uint32_t sensors;               // with a ring
+    uint32_t captures;              // files written
+    uint32_t extended;              // triggers during a capture
+    uint32_t failed;                // files that could not be written
+    uint64_t records;               // written to files
+    uint64_t memory;                // bytes of the rings
+};
+
+struct capture_ring;
+
+class SPScapture
+{
+  public:
+
+    SPScapture(void);
+
+    /**
+     * @brief set up the capture
+     * @param dir      : directory for the capture files
+     * @param pre      : minutes before the trigger
+     * @param post     : minutes after the trigger
+     * @param interval : seconds between samples (to size the rings)
+     * @param verbose  : if > 0 progress messages are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *dir, uint32_t pre, uint32_t post, uint32_t interval, int verbose);
+
+    /**
+     * @brief add a sample to the ring of its sensor, and to the file
+     * during a capture
+     * @param errors : bus errors so far
+     */
+    void add(const struct sps_sample *s, uint32_t errors);
+
+    /**
+     * @brief start (or extend) a capture of a sensor
+     * @param ts   : time of the trigger
+     * @param rule : name of the rule
+     */
+    void trigger(uint16_t sensor, uint32_t ts, const char *rule);
+
+    /**
+     * @brief complete the captures and free the rings
+     */
+    void close();
+
+    bool is_open() {return(_rings != NULL);}
+
+    void stats(struct capture_stats *st);
+
+  private:
+    char     _dir[PATH_MAX - 64];
+    uint32_t _capacity;             // records per ring
+    uint32_t _post;                 // seconds
+    struct capture_ring **_rings;   // by sensor id
+    int      _verbose;
+    struct capture_stats _st;
+
+    void finish(struct capture_ring *r);
+};
+
+#endif /* SPSCAPTURE_H */
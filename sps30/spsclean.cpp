@@ -0,0 +1,225 @@
+/**
+ * SPS30 dose based fan cleaning for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsclean.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spsclean.h"
+
+SPSclean::SPSclean(void)
+{
+    _state = NULL;
+    _mapped = false;
+    _mass = CLEAN_MASS;
+    _num = CLEAN_NUM;
+    _max = CLEAN_MAX_DAYS * 86400;
+    _slot = 0;
+    _slots = 1;
+    _verbose = 0;
+    _prev = 0;
+    _slept = 0;
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief start the scheduler
+ */
+int SPSclean::open(const char *dir, uint16_t sensor, double mass, double num, uint32_t max,
+    uint16_t slot, uint16_t slots, int verbose)
+{
+    char   name[PATH_MAX];
+    struct stat st;
+    void   *p;
+    int    fd;
+
+    if (mass <= 0 || num <= 0 || max == 0 || slots == 0 || slot >= slots) {
+        printf("Clean: doses and max must be above 0, the slot below the slots\n");
+        return(STORE_ERROR);
+    }
+
+    _mass = mass;
+    _num = num;
+    _max = max * 86400;
+    _slot = slot;
+    _slots = slots;
+    _verbose = verbose;
+
+    if (dir == NULL) {
+        if ((_state = (struct clean_state *) calloc(1, sizeof(struct clean_state))) == NULL) {
+            printf("Clean: out of memory\n");
+            return(STORE_ERROR);
+        }
+    }
+    else {
+        snprintf(name, sizeof(name), "%s/s%03u.cln", dir, sensor);
+
+        if ((fd = ::open(name, O_RDWR | O_CREAT, 0644)) < 0) {
+            printf("Clean: can not open %s\n", name);
+            return(STORE_ERROR);
+        }
+
+        fstat(fd, &st);
+
+        if (st.st_size != 0 && st.st_size != sizeof(struct clean_state)) {
+            printf("Clean: %s has a different size, remove it to start at 0\n", name);
+            ::close(fd);
+            return(STORE_ERROR);
+        }
+
+        if (st.st_size == 0 && ftruncate(fd, sizeof(struct clean_state)) != 0) {
+            printf("Clean: can not extend %s\n", name);
+            ::close(fd);
+            return(STORE_ERROR);
+        }
+
+        p = mmap(NULL, sizeof(struct clean_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (p == MAP_FAILED) {
+            printf("Clean: can not map %s\n", name);
+            return(STORE_ERROR);
+        }
+
+        _state = (struct clean_state *) p;
+        _mapped = true;
+
+        if (_state->magic != 0 && (_state->magic != CLEAN_MAGIC || _state->version != CLEAN_VERSION)) {
+            printf("Clean: %s is not a dose file of this version\n", name);
+            close();
+            return(STORE_ERROR);
+        }
+    }
+
+    // new: the max time counts from the first sample
+    if (_state->magic == 0) {
+        _state->magic = CLEAN_MAGIC;
+        _state->version = CLEAN_VERSION;
+        _state->sensor = sensor;
+    }
+
+    if (_verbose)
+        printf("Clean: at %g ug/m3*h or %g #/cm3*h (now %.0f%% / %.0f%%), at least every %u days, slot %u of %u\n",
+            _mass, _num, _state->mass * 100 / _mass, _state->num * 100 / _num, max, _slot, _slots);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add the dose of a sample
+ */
+bool SPSclean::sample(const struct sps_sample *s)
+{
+    struct clean_state *c = _state;
+    uint32_t dt;
+
+    if (c == NULL) return(false);
+
+    if (c->last == 0) c->last = s->ts;
+
+    // the seconds the fan ran since the previous sample
+    if (_prev > 0 && s->ts > _prev) {
+        dt = s->ts - _prev;
+        if (dt > CLEAN_GAP) dt = CLEAN_GAP;
+        dt = dt > _slept ? dt - _slept : 0;
+
+        if (s->v.MassPM10 > 0) c->mass += s->v.MassPM10 * dt / 3600.0;
+        if (s->v.NumPM10 > 0) c->num += s->v.NumPM10 * dt / 3600.0;
+    }
+
+    _prev = s->ts;
+    _slept = 0;
+
+    if (s->ts < c->last + CLEAN_MIN) return(false);
+
+    if (c->mass < _mass && c->num < _num && s->ts < c->last + _max) return(false);
+
+    // wait for the slot of this sensor
+    if ((s->ts / CLEAN_SLOT) % _slots != _slot) {
+        _st.deferred++;
+        return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief a cleaning was started
+ */
+void SPSclean::done(uint32_t ts)
+{
+    struct clean_state *c = _state;
+
+    if (c == NULL) return;
+
+    if (c->mass >= _mass) _st.by_mass++;
+    else if (c->num >= _num) _st.by_num++;
+    else _st.by_time++;
+
+    if (_verbose)
+        printf("Clean: fan cleaning after %.1f h, dose %.0f ug/m3*h, %.0f #/cm3*h\n",
+            (ts - c->last) / 3600.0, c->mass, c->num);
+
+    c->mass = 0;
+    c->num = 0;
+    c->last = ts;
+    c->cleanings++;
+    _st.cleanings++;
+}
+
+/**
+ * @brief stop the scheduler, the dose is kept in the file
+ */
+void SPSclean::close()
+{
+    if (_state == NULL) return;
+
+    if (_mapped) {
+        msync(_state, sizeof(struct clean_state), MS_SYNC);
+        munmap(_state, sizeof(struct clean_state));
+    }
+    else
+        free(_state);
+
+    _state = NULL;
+    _mapped = false;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSclean::stats(struct clean_stats *st)
+{
+    *st = _st;
+
+    if (_state) {
+        st->mass = _state->mass * 100 / _mass;
+        st->num = _state->num * 100 / _num;
+    }
+}
@@ -0,0 +1,148 @@
+/**
+ * SPS30 dose based fan cleaning header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Fan cleaning after the particles that passed the SPS30 instead of
+ * after a fixed time (option -j). The dose is the sum over the samples
+ * of the concentration times the seconds the fan ran:
+ *
+ *  mass    MassPM10 in ug/m3 * hours
+ *  number  NumPM10 in #/cm3 * hours
+ *
+ * The seconds between two samples count, less the seconds the SPS30
+ * slept (-F, -p) and at most CLEAN_GAP (the program did not run). A
+ * cleaning is due when either dose is reached, or after max days in
+ * clean air, but not within CLEAN_MIN seconds of the previous one.
+ * The automatic cleaning of the SPS30 itself is switched off (-a 0).
+ *
+ * Staggering: the sensors of a site get a slot k of n (slot=k/n). The
+ * time is divided in periods of CLEAN_SLOT seconds, a sensor only
+ * cleans in the periods where (ts / CLEAN_SLOT) % n == k. So no two
+ * sensors clean at the same time, while a due cleaning waits at most
+ * n periods. A period is longer than a cleaning with the settling
+ * after it and than the longest sleep of -p.
+ *
+ * The cleaning window is marked in the samples with SPS_FLAG_CLEAN
+ * until the values are stable again (spsquality.h). With -F or -p the
+ * SPS30 is read until then before it sleeps.
+ *
+ * The dose is kept in the store directory (-o) in sNNN.cln, mapped in
+ * memory like the cube, so it survives a restart. Without a store it
+ * starts at 0. In a replay (-r) the cleanings are only counted, to
+ * tune the doses on recorded data.
+ *********************************************************************
+*/
+#ifndef SPSCLEAN_H
+#define SPSCLEAN_H
+
+# include "spsstore.h"
+
+#define CLEAN_MAGIC         0x5350534e      // "SPSN"
+#define CLEAN_VERSION       1
+
+#define CLEAN_MASS          2000            // ug/m3 * h, a week at 12 ug/m3
+#define CLEAN_NUM           15000           // #/cm3 * h, a week at 90 #/cm3
+#define CLEAN_MAX_DAYS      7               // in clean air
+#define CLEAN_MIN           3600            // seconds between cleanings
+#define CLEAN_SLOT          900             // seconds in a slot period
+#define CLEAN_GAP           3600            // seconds between samples at most
+
+/* kept in sNNN.cln */
+struct clean_state
+{
+    uint32_t magic;                 // CLEAN_MAGIC
+    uint16_t version;               // CLEAN_VERSION
+    uint16_t sensor;
+    double   mass;                  // dose since the last cleaning
+    double   num;
+    uint32_t last;                  // timestamp of the last cleaning
+    uint32_t cleanings;
+    uint32_t reserved[8];
+};
+
+/* statistics */
+struct clean_stats
+{
+    uint32_t cleanings;             // since start
+    uint32_t by_mass;
+    uint32_t by_num;
+    uint32_t by_time;
+    uint64_t deferred;              // samples due, waiting for the slot
+    double   mass;                  // current dose in percent
+    double   num;
+};
+
+class SPSclean
+{
+  public:
+
+    SPSclean(void);
+
+    /**
+     * @brief start the scheduler
+     * @param dir     : store directory for the dose (NULL = in memory)
+     * @param sensor  : sensor id
+     * @param mass    : dose of MassPM10 in ug/m3 * h
+     * @param num     : dose of NumPM10 in #/cm3 * h
+     * @param max     : days between cleanings at most
+     * @param slot    : slot of this sensor, 0 .. slots - 1
+     * @param slots   : sensors of the site
+     * @param verbose : if > 0 each cleaning is displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR invalid parameter or the file can not be used
+     */
+    int open(const char *dir, uint16_t sensor, double mass, double num, uint32_t max,
+        uint16_t slot, uint16_t slots, int verbose);
+
+    bool is_open() {return(_state != NULL);}
+
+    /**
+     * @brief the SPS30 slept (fan off) since the previous sample
+     */
+    void asleep(uint32_t seconds) {_slept += seconds;}
+
+    /**
+     * @brief add the dose of a sample
+     *
+     * @return true when a cleaning is due now
+     */
+    bool sample(const struct sps_sample *s);
+
+    /**
+     * @brief a cleaning was started: reset the dose
+     */
+    void done(uint32_t ts);
+
+    void close();
+
+    void stats(struct clean_stats *st);
+
+  private:
+    struct clean_state *_state;     // mapped, or allocated
+    bool     _mapped;
+    double   _mass, _num;
+    uint32_t _max;                  // seconds
+    uint16_t _slot, _slots;
+    int      _verbose;
+
+    uint32_t _prev;                 // timestamp of the previous sample
+    uint32_t _slept;
+
+    struct clean_stats _st;
+};
+
+#endif /* SPSCLEAN_H */
@@ -0,0 +1,243 @@
+/**
+ * SPS30 columnar segments for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spscol.h for the layout
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spscol.h"
+
+/**
+ * @brief round up to the column alignment
+ */
+static uint64_t col_align(uint64_t off)
+{
+    return((off + COL_ALIGN - 1) & ~((uint64_t) COL_ALIGN - 1));
+}
+
+/**
+ * @brief write the columnar file of one segment
+ * @param rd    : reader on the sensor
+ * @param first : first index entry of the segment
+ * @param last  : last index entry of the segment (exclusive)
+ * @param skipped : samples of corrupt blocks left out
+ */
+static int col_write(SPSread *rd, const char *dir, uint16_t sensor, uint32_t first, uint32_t last,
+    uint32_t *skipped)
+{
+    char    name[PATH_MAX], tmp[PATH_MAX + 8];
+    struct  col_header *hdr;
+    const struct store_idx *e;
+    const struct sps_sample *r;
+    uint8_t *buf;
+    uint32_t  *ts;
+    uint16_t  *fl;
+    float     *col[SPS_FIELDS];
+    uint64_t  off, len;
+    uint32_t  count = 0, n = 0;
+    int     fd, ret = STORE_ERROR;
+
+    for (uint32_t i = first; i < last; i++) count += rd->entry(i)->count;
+
+    // lay out the columns
+    if ((hdr = (struct col_header *) calloc(1, COL_HDR_SIZE)) == NULL) return(STORE_ERROR);
+
+    off = COL_HDR_SIZE;
+    hdr->offset[COL_TS] = off;
+    off = col_align(off + (uint64_t) count * sizeof(uint32_t));
+    hdr->offset[COL_FLAGS] = off;
+    off = col_align(off + (uint64_t) count * sizeof(uint16_t));
+
+    for (int f = 0; f < SPS_FIELDS; f++) {
+        hdr->offset[f] = off;
+        off = col_align(off + (uint64_t) count * sizeof(float));
+    }
+
+    len = off - COL_HDR_SIZE;
+
+    if ((buf = (uint8_t *) calloc(1, len)) == NULL) {
+        free(hdr);
+        return(STORE_ERROR);
+    }
+
+    ts = (uint32_t *) (buf + hdr->offset[COL_TS] - COL_HDR_SIZE);
+    fl = (uint16_t *) (buf + hdr->offset[COL_FLAGS] - COL_HDR_SIZE);
+    for (int f = 0; f < SPS_FIELDS; f++) col[f] = (float *) (buf + hdr->offset[f] - COL_HDR_SIZE);
+
+    // transpose the records
+    for (uint32_t i = first; i < last; i++) {
+        e = rd->entry(i);
+
+        // a corrupt block is left out
+        if ((r = rd->block(e)) == NULL) {
+            printf("Column: skipped corrupt block of segment %u, %u samples\n", e->seg, e->count);
+            continue;
+        }
+
+        for (uint32_t j = 0; j < e->count; j++, n++) {
+            ts[n] = r[j].ts;
+            fl[n] = r[j].flags;
+            for (int f = 0; f < SPS_FIELDS; f++) col[f][n] = sps_field(&r[j].v, f);
+        }
+    }
+
+    e = rd->entry(first);
+    hdr->magic = COL_MAGIC;
+    hdr->version = COL_VERSION;
+    hdr->sensor = sensor;
+    hdr->seg = e->seg;
+    hdr->count = n;
+    hdr->skipped = *skipped = count - n;
+    hdr->first_ts = e->first_ts;
+    hdr->last_ts = rd->entry(last - 1)->last_ts;
+
+    // write to temporary file and rename, a reader never sees half a file
+    store_col_name(name, sizeof(name), dir, sensor, e->seg);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+
+    if ((fd = ::open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        printf("Column: can not create %s\n", tmp);
+        goto done;
+    }
+
+    if (write(fd, hdr, COL_HDR_SIZE) != COL_HDR_SIZE || write(fd, buf, len) != (ssize_t) len
+        || fsync(fd) != 0 || rename(tmp, name) != 0) {
+        printf("Column: error writing %s\n", name);
+        ::close(fd);
+        unlink(tmp);
+        goto done;
+    }
+
+    ::close(fd);
+    ret = STORE_OK;
+
+done:
+    free(hdr);
+    free(buf);
+    return(ret);
+}
+
+/**
+ * @brief convert the complete segments of a sensor to columnar files
+ *
+ * @return number of files written or STORE_ERROR
+ */
+int col_convert(const char *dir, uint16_t sensor, int verbose)
+{
+    SPSread rd;
+    SPScol  col;
+    uint32_t i, j, count, skipped;
+    int     written = 0;
+
+    if (rd.open(dir, sensor) != STORE_OK) return(STORE_ERROR);
+
+    for (i = 0; i < rd.entries(); i = j) {
+
+        count = 0;
+        for (j = i; j < rd.entries() && rd.entry(j)->seg == rd.entry(i)->seg; j++)
+            count += rd.entry(j)->count;
+
+        // the last segment is still written
+        if (j == rd.entries()) break;
+
+        // already converted
+        if (col.open(dir, sensor, rd.entry(i)->seg) == STORE_OK && col.count() + col.skipped() == count)
+            continue;
+
+        col.close();
+
+        if (col_write(&rd, dir, sensor, i, j, &skipped) != STORE_OK) {
+            rd.close();
+            col.close();
+            return(STORE_ERROR);
+        }
+
+        if (verbose) printf("Column: sensor %d segment %u, %u samples, %u in corrupt blocks skipped\n", sensor,
+            rd.entry(i)->seg, count - skipped, skipped);
+        written++;
+    }
+
+    rd.close();
+    col.close();
+    return(written);
+}
+
+SPScol::SPScol(void)
+{
+    _map = NULL;
+    _maplen = 0;
+    _hdr = NULL;
+}
+
+/**
+ * @brief open the columnar file of a segment
+ */
+int SPScol::open(const char *dir, uint16_t sensor, uint32_t seg)
+{
+    char   name[PATH_MAX];
+    struct stat st;
+    void   *p;
+    int    fd;
+
+    close();
+
+    store_col_name(name, sizeof(name), dir, sensor, seg);
+
+    if ((fd = ::open(name, O_RDONLY)) < 0) return(STORE_ERROR);
+
+    fstat(fd, &st);
+
+    if (st.st_size < COL_HDR_SIZE) {
+        ::close(fd);
+        return(STORE_ERROR);
+    }
+
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED) return(STORE_ERROR);
+
+    _map = (uint8_t *) p;
+    _maplen = st.st_size;
+    _hdr = (const struct col_header *) _map;
+
+    if (_hdr->magic != COL_MAGIC || _hdr->version != COL_VERSION || _hdr->sensor != sensor
+        || _hdr->offset[SPS_FIELDS - 1] + (uint64_t) _hdr->count * sizeof(float) > _maplen) {
+        close();
+        return(STORE_ERROR);
+    }
+
+    return(STORE_OK);
+}
+
+void SPScol::close()
+{
+    if (_map) munmap(_map, _maplen);
+    _map = NULL;
+    _maplen = 0;
+    _hdr = NULL;
+}
@@ -0,0 +1,118 @@
+/**
+ * SPS30 columnar segment header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Columnar copy of a completed segment for analytical scans.
+ *
+ * A query on one field of a row segment reads all 48 bytes of each
+ * sample. The columnar file keeps each field in its own array, so such
+ * a scan reads 4 bytes per sample:
+ *
+ *  sNNN_TTTTTTTTTT.col  next to the segment with the same name
+ *
+ *  COL_HDR_SIZE bytes   : col_header
+ *  timestamp column     : uint32_t[count]
+ *  flags column         : uint16_t[count]
+ *  field columns        : float[count] for each of the SPS_FIELDS
+ *
+ * Each column starts at a multiple of COL_ALIGN, so a mapped column
+ * is aligned for vector loads and only its own pages are read.
+ *
+ * The files are created by spsquery -C from segments that are
+ * complete and removed together with the segment by expire(). A
+ * corrupt block of the segment is left out, like the other readers do.
+ * count has the samples written, skipped those of the corrupt blocks.
+ *********************************************************************
+*/
+#ifndef SPSCOL_H
+#define SPSCOL_H
+
+# include "spsstore.h"
+
+#define COL_MAGIC           0x53505343      // "SPSC"
+#define COL_VERSION         1
+#define COL_HDR_SIZE        4096
+#define COL_ALIGN           4096            // column alignment
+
+/* column numbers, the fields are 0 - (SPS_FIELDS - 1) */
+#define COL_TS              SPS_FIELDS
+#define COL_FLAGS           (SPS_FIELDS + 1)
+#define COL_COLUMNS         (SPS_FIELDS + 2)
+
+/* header of a columnar file */
+struct col_header
+{
+    uint32_t magic;                 // COL_MAGIC
+    uint16_t version;               // COL_VERSION
+    uint16_t sensor;                // sensor id
+    uint32_t seg;                   // segment id
+    uint32_t count;                 // samples
+    uint32_t first_ts;
+    uint32_t last_ts;
+    uint64_t offset[COL_COLUMNS];   // byte offset of each column
+    uint32_t skipped;               // samples of corrupt blocks left out
+    uint32_t reserved[7];
+};
+
+/**
+ * @brief convert the complete segments of a sensor to columnar files
+ * @param dir     : store directory
+ * @param sensor  : sensor id
+ * @param verbose : if > 0 progress messages are displayed
+ *
+ * Segments that already have an up to date columnar file are skipped.
+ *
+ * @return number of files written or STORE_ERROR
+ */
+int col_convert(const char *dir, uint16_t sensor, int verbose);
+
+/**
+ * Reads one columnar file.
+ */
+class SPScol
+{
+  public:
+
+    SPScol(void);
+
+    /**
+     * @brief open the columnar file of a segment
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error (e.g. not converted yet)
+     */
+    int open(const char *dir, uint16_t sensor, uint32_t seg);
+
+    void close();
+
+    const struct col_header *header() {return(_hdr);}
+    uint32_t count() {return(_hdr ? _hdr->count : 0);}
+    uint32_t skipped() {return(_hdr ? _hdr->skipped : 0);}
+
+    /**
+     * @brief access a column
+     */
+    const uint32_t *ts() {return((const uint32_t *) (_map + _hdr->offset[COL_TS]));}
+    const uint16_t *flags() {return((const uint16_t *) (_map + _hdr->offset[COL_FLAGS]));}
+    const float *field(int f) {return((const float *) (_map + _hdr->offset[f]));}
+
+  private:
+    uint8_t  *_map;
+    size_t   _maplen;
+    const struct col_header *_hdr;
+};
+
+#endif /* SPSCOL_H */
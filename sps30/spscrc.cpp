@@ -0,0 +1,218 @@
+/**
+ * SPS30 CRC32C for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spscrc.h
+ *
+ * As in spskern.cpp the hardware versions are compiled with a target
+ * attribute, so no special compiler flags are needed.
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include "spscrc.h"
+
+#if defined(__x86_64__)
+# define CRC_SSE42
+# include <nmmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+# define CRC_ARMV8
+# include <sys/auxv.h>
+# include <asm/hwcap.h>
+#endif
+
+/* reflected Castagnoli polynomial */
+#define CRC32C_POLY 0x82f63b78
+
+typedef uint32_t (*crc_fn)(uint32_t crc, const uint8_t *p, size_t len);
+
+/*********************************************************************
+ *  slice-by-8
+ *********************************************************************/
+
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief fill the tables: [0] is the classic byte table, [k] is the
+ * CRC of a byte followed by k zero bytes
+ */
+static void crc_init_table()
+{
+    uint32_t c;
+
+    for (int i = 0; i < 256; i++) {
+        c = i;
+        for (int j = 0; j < 8; j++) c = (c >> 1) ^ (c & 1 ? CRC32C_POLY : 0);
+        crc_table[0][i] = c;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        c = crc_table[0][i];
+        for (int k = 1; k < 8; k++) {
+            c = (c >> 8) ^ crc_table[0][c & 0xff];
+            crc_table[k][i] = c;
+        }
+    }
+}
+
+static uint32_t crc_soft(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint32_t lo, hi;
+
+    pthread_once(&crc_once, crc_init_table);
+
+    // align to 8 bytes
+    for (; len > 0 && ((uintptr_t) p & 7); len--)
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+
+    // 8 bytes at a time, as little endian words
+    for (; len >= 8; len -= 8, p += 8) {
+        lo = (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24) ^ crc;
+        hi = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t) p[7] << 24;
+
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+              crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+              crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+    }
+
+    while (len--) crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+
+    return(crc);
+}
+
+/*********************************************************************
+ *  SSE4.2
+ *********************************************************************/
+#ifdef CRC_SSE42
+
+__attribute__((target("sse4.2")))
+static uint32_t crc_sse42(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t c = crc, w;
+
+    for (; len > 0 && ((uintptr_t) p & 7); len--) c = _mm_crc32_u8((uint32_t) c, *p++);
+
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&w, p, 8);
+        c = _mm_crc32_u64(c, w);
+    }
+
+    while (len--) c = _mm_crc32_u8((uint32_t) c, *p++);
+
+    return((uint32_t) c);
+}
+
+#endif /* CRC_SSE42 */
+
+/*********************************************************************
+ *  ARMv8 (64 bit, e.g. Raspberry Pi 3 / 4 / 5 with a 64 bit OS)
+ *********************************************************************/
+#ifdef CRC_ARMV8
+
+__attribute__((target("+crc")))
+static uint32_t crc_armv8(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t w;
+
+    for (; len > 0 && ((uintptr_t) p & 7); len--) crc = __builtin_aarch64_crc32cb(crc, *p++);
+
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&w, p, 8);
+        crc = __builtin_aarch64_crc32cx(crc, w);
+    }
+
+    while (len--) crc = __builtin_aarch64_crc32cb(crc, *p++);
+
+    return(crc);
+}
+
+#endif /* CRC_ARMV8 */
+
+/*********************************************************************
+ *  dispatch
+ *********************************************************************/
+
+static crc_fn crc_impl = NULL;
+static const char *crc_impl_name = NULL;
+
+/**
+ * @brief select the version
+ */
+int crc32c_select(const char *name)
+{
+    crc_fn fn = crc_soft;
+    const char *n = "soft";
+
+#ifdef CRC_SSE42
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse4.2")) {
+        fn = crc_sse42;
+        n = "sse4.2";
+    }
+#endif
+
+#ifdef CRC_ARMV8
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        fn = crc_armv8;
+        n = "armv8";
+    }
+#endif
+
+    if (name && strcasecmp(name, n) != 0) {
+        if (strcasecmp(name, "soft") != 0) return(-1);
+
+        fn = crc_soft;
+        n = "soft";
+    }
+
+    crc_impl_name = n;
+    crc_impl = fn;
+
+    return(0);
+}
+
+/**
+ * @brief name of the version in use
+ */
+const char *crc32c_name()
+{
+    if (crc_impl == NULL) crc32c_select(NULL);
+
+    return(crc_impl_name);
+}
+
+/**
+ * @brief calculate or continue a CRC32C
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    // the same on each thread, so a race on the first call is harmless
+    if (crc_impl == NULL) crc32c_select(NULL);
+
+    return(~crc_impl(~crc, (const uint8_t *) buf, len));
+}
@@ -0,0 +1,58 @@
+/**
+ * SPS30 CRC32C header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * CRC32C (Castagnoli) to detect corruption of stored data.
+ *
+ * The CRC instructions of ARMv8 or SSE4.2 are used when the CPU has
+ * them, else a table driven slice-by-8 version. All give the same
+ * result. A CRC can be continued over more buffers:
+ *
+ *  crc = crc32c(0, a, len_a);
+ *  crc = crc32c(crc, b, len_b);   // same as over a followed by b
+ *********************************************************************
+*/
+#ifndef SPSCRC_H
+#define SPSCRC_H
+
+# include <stdint.h>
+# include <stddef.h>
+
+/**
+ * @brief calculate or continue a CRC32C
+ * @param crc : 0 to start or the result of a previous call
+ * @param buf : data
+ * @param len : length of data
+ *
+ * @return the CRC32C
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * @brief select the version
+ * @param name : NULL for the best on this CPU, or soft / sse4.2 / armv8
+ *
+ * @return
+ *  0 success
+ *  -1 not available on this CPU
+ */
+int crc32c_select(const char *name);
+
+/**
+ * @brief name of the version in use
+ */
+const char *crc32c_name();
+
+#endif /* SPSCRC_H */
@@ -0,0 +1,355 @@
+/**
+ * SPS30 rollup cube for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spscube.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spscube.h"
+
+/* bins: 4 per octave from 2^CUBE_EXP_MIN */
+#define CUBE_EXP_MIN    -4
+#define CUBE_SUB        4
+
+static const uint32_t cube_bucket_size[CUBE_TIERS] = {3600, 86400};
+static const uint32_t cube_cells[CUBE_TIERS] = {CUBE_HOURS, CUBE_DAYS};
+
+/**
+ * @brief bucket size of a tier in seconds
+ */
+uint32_t cube_bucket(int tier)
+{
+    return(cube_bucket_size[tier]);
+}
+
+/**
+ * @brief the bin of a value: exponent and the top 2 bits of the mantissa
+ */
+static inline int cube_bin(float v)
+{
+    uint32_t b;
+    int i;
+
+    if (! (v > 0)) return(0);       // also NaN
+
+    memcpy(&b, &v, sizeof(b));
+    i = ((int) ((b >> 23) & 0xff) - 127 - CUBE_EXP_MIN) * CUBE_SUB + (int) ((b >> 21) & 3);
+
+    if (i < 0) return(0);
+    if (i >= CUBE_BINS) return(CUBE_BINS - 1);
+    return(i);
+}
+
+/**
+ * @brief lower bound of a bin
+ */
+static double cube_bin_low(int i)
+{
+    return(ldexp(1.0 + (i % CUBE_SUB) / (double) CUBE_SUB, i / CUBE_SUB + CUBE_EXP_MIN));
+}
+
+/**
+ * @brief estimate a percentile from the sketch
+ */
+float cube_quantile(const struct cube_field *f, double p)
+{
+    double rank, lo, hi, v;
+    uint64_t cum = 0;
+    int i;
+
+    if (f->count == 0) return(0);
+
+    rank = p * f->count;
+
+    for (i = 0; i < CUBE_BINS - 1; i++) {
+        if (cum + f->bin[i] >= rank && f->bin[i] > 0) break;
+        cum += f->bin[i];
+    }
+
+    // interpolate in the bin, within what was seen
+    lo = i == 0 ? f->min : cube_bin_low(i);
+    hi = i == CUBE_BINS - 1 ? f->max : cube_bin_low(i + 1);
+    if (lo < f->min) lo = f->min;
+    if (hi > f->max) hi = f->max;
+
+    v = f->bin[i] ? lo + (hi - lo) * (rank - cum) / f->bin[i] : lo;
+
+    return((float) (v < lo ? lo : v > hi ? hi : v));
+}
+
+/**
+ * @brief add the statistics of a cell to another
+ */
+void cube_merge(struct cube_cell *dst, const struct cube_cell *src)
+{
+    struct cube_field *d;
+    const struct cube_field *s;
+
+    if (src->ts == 0) return;
+    if (dst->ts == 0 || src->ts < dst->ts) dst->ts = src->ts;
+
+    for (int k = 0; k < SPS_FIELDS; k++) {
+        d = &dst->f[k];
+        s = &src->f[k];
+
+        if (s->count == 0) continue;
+
+        if (d->count == 0 || s->min < d->min) d->min = s->min;
+        if (d->count == 0 || s->max > d->max) d->max = s->max;
+        d->count += s->count;
+        d->sum += s->sum;
+
+        for (int i = 0; i < CUBE_BINS; i++) d->bin[i] += s->bin[i];
+    }
+}
+
+SPScube::SPScube(void)
+{
+    _fd = -1;
+    _map = NULL;
+    _maplen = 0;
+    _hdr = NULL;
+    _cell[0] = _cell[1] = NULL;
+    _quality = 0;
+    _verbose = 0;
+}
+
+/**
+ * @brief open the cube of a sensor
+ */
+int SPScube::open(const char *dir, uint16_t sensor, bool write, uint16_t quality, int verbose)
+{
+    struct cube_header h;
+    struct stat st;
+    char   name[PATH_MAX];
+    bool   create;
+    void   *p;
+
+    _quality = quality;
+    _verbose = verbose;
+    snprintf(name, sizeof(name), "%s/s%03u.cub", dir, sensor);
+
+    if ((_fd = ::open(name, write ? O_RDWR | O_CREAT : O_RDONLY, 0644)) < 0) {
+        if (write) printf("Cube: can not open %s\n", name);
+        return(STORE_ERROR);
+    }
+
+    fstat(_fd, &st);
+    create = (st.st_size == 0);
+    _maplen = CUBE_HDR_SIZE + (size_t) (CUBE_HOURS + CUBE_DAYS) * sizeof(struct cube_cell);
+
+    if (create) {
+        if (! write) {
+            close();
+            return(STORE_ERROR);
+        }
+
+        // allocate all blocks now, the cube never grows
+        if (posix_fallocate(_fd, 0, _maplen) != 0) {
+            printf("Cube: can not allocate %lu bytes for %s\n", (unsigned long) _maplen, name);
+            close();
+            unlink(name);
+            return(STORE_ERROR);
+        }
+    }
+    else if ((size_t) st.st_size != _maplen) {
+        printf("Cube: %s has a different size, remove it to rebuild\n", name);
+        close();
+        return(STORE_ERROR);
+    }
+
+    p = mmap(NULL, _maplen, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _fd, 0);
+
+    if (p == MAP_FAILED) {
+        printf("Cube: can not map %s\n", name);
+        _map = NULL;
+        close();
+        return(STORE_ERROR);
+    }
+
+    _map = (uint8_t *) p;
+    _hdr = (struct cube_header *) _map;
+    _cell[CUBE_HOUR] = (struct cube_cell *) (_map + CUBE_HDR_SIZE);
+    _cell[CUBE_DAY] = _cell[CUBE_HOUR] + CUBE_HOURS;
+
+    if (create) {
+        memset(&h, 0x0, sizeof(h));
+        h.magic = CUBE_MAGIC;
+        h.version = CUBE_VERSION;
+        h.sensor = sensor;
+        h.cell_size = sizeof(struct cube_cell);
+        h.cells[CUBE_HOUR] = CUBE_HOURS;
+        h.cells[CUBE_DAY] = CUBE_DAYS;
+        *_hdr = h;
+    }
+    else if (_hdr->magic != CUBE_MAGIC || _hdr->version != CUBE_VERSION || _hdr->sensor != sensor
+        || _hdr->cell_size != sizeof(struct cube_cell)) {
+        printf("Cube: %s is not a valid cube, remove it to rebuild\n", name);
+        close();
+        return(STORE_ERROR);
+    }
+
+    if (write && catchup(dir) != STORE_OK) {
+        close();
+        return(STORE_ERROR);
+    }
+
+    return(STORE_OK);
+}
+
+/* callback of SPSread::read */
+static bool cube_sample(const struct sps_sample *s, void *ctx)
+{
+    ((SPScube *) ctx)->add(s);
+    return(true);
+}
+
+/**
+ * @brief add the samples of the store after the last one in the cube
+ */
+int SPScube::catchup(const char *dir)
+{
+    SPSread rd;
+    uint64_t before = _hdr->samples;
+    long   n;
+
+    // no samples stored yet
+    if (rd.open(dir, _hdr->sensor) != STORE_OK) return(STORE_OK);
+
+    if (_hdr->last < UINT32_MAX && (n = rd.read(_hdr->last + 1, UINT32_MAX, cube_sample, this)) < 0) {
+        printf("Cube: error during reading the store\n");
+        rd.close();
+        return(STORE_ERROR);
+    }
+
+    rd.close();
+
+    if (_verbose)
+        printf("Cube: sensor %u, %llu samples, %llu added from the store\n", _hdr->sensor,
+            (unsigned long long) _hdr->samples, (unsigned long long) (_hdr->samples - before));
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add a sample to its hour and day
+ */
+void SPScube::add(const struct sps_sample *s)
+{
+    struct cube_cell *c;
+    struct cube_field *f;
+    uint32_t start;
+    float  v;
+
+    if (! is_open() || (s->flags & _quality)) return;
+
+    for (int t = 0; t < CUBE_TIERS; t++) {
+        start = s->ts - s->ts % cube_bucket_size[t];
+        c = &_cell[t][(s->ts / cube_bucket_size[t]) % cube_cells[t]];
+
+        // a later bucket: reuse the cell. An earlier one is gone already
+        if (c->ts != start) {
+            if (c->ts > start) continue;
+
+            memset(c, 0x0, sizeof(struct cube_cell));
+            c->ts = start;
+        }
+
+        for (int k = 0; k < SPS_FIELDS; k++) {
+            f = &c->f[k];
+            v = sps_field(&s->v, k);
+
+            if (f->count == 0 || v < f->min) f->min = v;
+            if (f->count == 0 || v > f->max) f->max = v;
+            f->count++;
+            f->sum += v;
+            f->bin[cube_bin(v)]++;
+        }
+    }
+
+    if (s->ts > _hdr->last) _hdr->last = s->ts;
+    _hdr->samples++;
+}
+
+/**
+ * @brief get the cell of a bucket
+ */
+const struct cube_cell *SPScube::cell(int tier, uint32_t ts)
+{
+    const struct cube_cell *c;
+
+    if (! is_open()) return(NULL);
+
+    c = &_cell[tier][(ts / cube_bucket_size[tier]) % cube_cells[tier]];
+
+    return(c->ts == ts - ts % cube_bucket_size[tier] && c->ts != 0 ? c : NULL);
+}
+
+/**
+ * @brief call cb for each cell with samples between from and to
+ */
+long SPScube::read(int tier, uint32_t from, uint32_t to, cube_cb cb, void *ctx)
+{
+    const struct cube_cell *c;
+    uint32_t b = cube_bucket_size[tier];
+    uint64_t ts;
+    long   n = 0;
+
+    if (! is_open()) return(0);
+
+    // not before the oldest cell that can be kept
+    if (_hdr->last > (uint64_t) b * cube_cells[tier] && from < _hdr->last - b * cube_cells[tier])
+        from = _hdr->last - b * cube_cells[tier];
+    if (to > _hdr->last) to = _hdr->last;
+
+    for (ts = from - from % b; ts <= to; ts += b) {
+        if ((c = cell(tier, (uint32_t) ts)) == NULL) continue;
+
+        n++;
+        if (! cb(c, ctx)) break;
+    }
+
+    return(n);
+}
+
+void SPScube::close()
+{
+    if (_map) {
+        if (_hdr && _fd > -1) msync(_map, _maplen, MS_SYNC);
+        munmap(_map, _maplen);
+    }
+
+    if (_fd > -1) ::close(_fd);
+
+    _fd = -1;
+    _map = NULL;
+    _hdr = NULL;
+    _cell[0] = _cell[1] = NULL;
+}
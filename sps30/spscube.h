@@ -0,0 +1,174 @@
+/**
+ * SPS30 rollup cube header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Statistics per hour and per day (UTC) of a sensor, updated with each
+ * sample (option -U), so a dashboard reads a few cells instead of
+ * scanning the samples. Unlike the rollups (spsrollup.h), which are
+ * built later in the background, a cell is complete at once and also
+ * has a sketch of the distribution for percentiles.
+ *
+ * A cell holds per field the count, sum, min, max and a histogram of
+ * CUBE_BINS bins on a log scale: 4 bins per octave from 1/16 to 4096,
+ * smaller and larger values are in the first and last bin. A bin is
+ * 14 - 25% wide, the percentiles are interpolated in the bin.
+ *
+ * The cube is one file per sensor in the store directory, sNNN.cub,
+ * allocated completely on creation and mapped in memory:
+ *
+ *  CUBE_HDR_SIZE bytes : cube_header
+ *  CUBE_HOURS cells    : hours,  cell at (ts / 3600) % CUBE_HOURS
+ *  CUBE_DAYS cells     : days,   cell at (ts / 86400) % CUBE_DAYS
+ *
+ * A cell is cleared when it is reused for a later bucket, so the cube
+ * keeps the last CUBE_HOURS hours and CUBE_DAYS days. The header has
+ * the timestamp of the last sample added. On open the samples stored
+ * after it are added from the store, so a new cube is built from the
+ * whole store and a restart misses nothing. Rebuild by removing the
+ * file. Samples with the quality flags of -q are left out, live and
+ * from the store alike.
+ *
+ * A reader maps the same file and sees the cells while they are
+ * updated (a cell may be read halfway through an update).
+ *********************************************************************
+*/
+#ifndef SPSCUBE_H
+#define SPSCUBE_H
+
+# include "spsstore.h"
+
+#define CUBE_MAGIC          0x53505343      // "SPSC"
+#define CUBE_VERSION        1
+#define CUBE_HDR_SIZE       4096
+#define CUBE_BINS           64
+#define CUBE_HOURS          (24 * 92)       // 3 months of hours
+#define CUBE_DAYS           (366 * 2)       // 2 years of days
+
+/* tiers */
+#define CUBE_TIERS          2
+#define CUBE_HOUR           0
+#define CUBE_DAY            1
+
+/* statistics of one field in a bucket */
+struct cube_field
+{
+    double   sum;
+    uint32_t count;
+    float    min;
+    float    max;
+    uint32_t bin[CUBE_BINS];
+};
+
+/* a bucket */
+struct cube_cell
+{
+    uint32_t ts;                        // start of bucket, 0 = empty
+    uint32_t reserved;
+    struct cube_field f[SPS_FIELDS];
+};
+
+struct cube_header
+{
+    uint32_t magic;                     // CUBE_MAGIC
+    uint16_t version;                   // CUBE_VERSION
+    uint16_t sensor;
+    uint32_t cell_size;                 // sizeof(cube_cell)
+    uint32_t cells[CUBE_TIERS];         // CUBE_HOURS, CUBE_DAYS
+    uint32_t last;                      // timestamp of the last sample added
+    uint64_t samples;                   // samples added
+};
+
+/**
+ * @brief bucket size of a tier in seconds
+ */
+uint32_t cube_bucket(int tier);
+
+/**
+ * @brief add the statistics of a cell to another (e.g. a week of days)
+ */
+void cube_merge(struct cube_cell *dst, const struct cube_cell *src);
+
+/**
+ * @brief estimate a percentile from the sketch
+ * @param p : 0 - 1, e.g. 0.95
+ */
+float cube_quantile(const struct cube_field *f, double p);
+
+/**
+ * Maintains or reads the cube of one sensor.
+ */
+typedef bool (*cube_cb)(const struct cube_cell *c, void *ctx);
+
+class SPScube
+{
+  public:
+
+    SPScube(void);
+
+    /**
+     * @brief open the cube of a sensor
+     * @param dir     : store directory
+     * @param sensor  : sensor id
+     * @param write   : create if needed and add the samples of the
+     *                  store after the last one in the cube
+     * @param quality : SPS_FLAG_xxx of the samples to leave out (-q)
+     * @param verbose : if > 0 progress messages are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *dir, uint16_t sensor, bool write, uint16_t quality, int verbose);
+
+    /**
+     * @brief add a sample to its hour and day, unless it has one of the
+     * quality flags given to open()
+     */
+    void add(const struct sps_sample *s);
+
+    /**
+     * @brief get the cell of a bucket
+     * @param ts : any time in the bucket
+     *
+     * @return the cell or NULL when there are no samples
+     */
+    const struct cube_cell *cell(int tier, uint32_t ts);
+
+    /**
+     * @brief call cb for each cell with samples between from and to
+     *
+     * @return number of cells
+     */
+    long read(int tier, uint32_t from, uint32_t to, cube_cb cb, void *ctx);
+
+    void close();
+
+    bool is_open() {return(_map != NULL);}
+
+    const struct cube_header *header() {return(_hdr);}
+
+  private:
+    int      _fd;
+    uint8_t  *_map;
+    size_t   _maplen;
+    struct cube_header *_hdr;
+    struct cube_cell *_cell[CUBE_TIERS];
+    uint16_t _quality;                  // flags of the samples left out
+    int      _verbose;
+
+    int  catchup(const char *dir);
+};
+
+#endif /* SPSCUBE_H */
@@ -0,0 +1,218 @@
+/**
+ * SPS30 report by exception for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsdeadband.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "spsdeadband.h"
+
+SPSdeadband::SPSdeadband(void)
+{
+    _open = false;
+    _max = DEADBAND_MAX;
+    _pivot_set = false;
+    _held = false;
+    memset(_abs, 0x0, sizeof(_abs));
+    memset(_rel, 0x0, sizeof(_rel));
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief set the deadbands
+ */
+int SPSdeadband::open(char *spec, int verbose)
+{
+    bool   set[SPS_FIELDS] = {false};
+    float  abs_all = 0, rel_all = 0;
+    char   *tok, *save, *val, *end;
+    int    f;
+
+    for (tok = strtok_r(spec, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+
+        if ((val = strchr(tok, '=')) == NULL) {
+            printf("Deadband: missing value in %s\n", tok);
+            return(STORE_ERROR);
+        }
+
+        *val++ = 0x0;
+
+        if (strcasecmp(tok, "abs") == 0) abs_all = strtof(val, &end);
+        else if (strcasecmp(tok, "rel") == 0) rel_all = strtof(val, &end) / 100;
+        else if (strcasecmp(tok, "max") == 0) _max = (uint32_t) strtoul(val, &end, 10);
+        else if ((f = sps_field_lookup(tok)) >= 0) {
+            _abs[f] = strtof(val, &end);
+            _rel[f] = 0;
+            if (*end == '/') _rel[f] = strtof(end + 1, &end) / 100;
+            set[f] = true;
+        }
+        else {
+            printf("Deadband: unknown %s, use abs, rel, max or a field\n", tok);
+            return(STORE_ERROR);
+        }
+
+        if (*end != 0x0 || end == val) {
+            printf("Deadband: invalid value %s of %s\n", val, tok);
+            return(STORE_ERROR);
+        }
+    }
+
+    for (f = 0; f < SPS_FIELDS; f++) {
+        if (! set[f]) {
+            _abs[f] = abs_all;
+            _rel[f] = rel_all;
+        }
+
+        if (_abs[f] < 0 || _rel[f] < 0) {
+            printf("Deadband: %s can not be negative\n", sps_field_name[f]);
+            return(STORE_ERROR);
+        }
+
+        if (verbose)
+            printf("Deadband: %-9s %g or %g%%\n", sps_field_name[f], _abs[f], _rel[f] * 100);
+    }
+
+    if (verbose) printf("Deadband: a report at least every %u s\n", _max);
+
+    _open = true;
+    return(STORE_OK);
+}
+
+/**
+ * @brief start a line at a reported sample
+ */
+void SPSdeadband::pivot(const struct sps_sample *s)
+{
+    _pivot = *s;
+    _pivot_set = true;
+    _held = false;
+
+    for (int k = 0; k < SPS_FIELDS; k++) {
+        _up[k] = HUGE_VAL;
+        _lo[k] = -HUGE_VAL;
+    }
+}
+
+/**
+ * @brief whether the line from the pivot to a sample is in the door
+ */
+bool SPSdeadband::inside(const struct sps_sample *s)
+{
+    double dt = (double) s->ts - _pivot.ts, g;
+
+    for (int k = 0; k < SPS_FIELDS; k++) {
+        g = (sps_field(&s->v, k) - sps_field(&_pivot.v, k)) / dt;
+        if (g > _up[k] || g < _lo[k]) return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief narrow the door to the lines within the deadband of a sample
+ */
+void SPSdeadband::narrow(const struct sps_sample *s)
+{
+    double dt = (double) s->ts - _pivot.ts, v, e, a;
+
+    for (int k = 0; k < SPS_FIELDS; k++) {
+        v = sps_field(&s->v, k);
+        a = sps_field(&_pivot.v, k);
+        e = fabs(v) * _rel[k];
+        if (e < _abs[k]) e = _abs[k];
+
+        if ((v + e - a) / dt < _up[k]) _up[k] = (v + e - a) / dt;
+        if ((v - e - a) / dt > _lo[k]) _lo[k] = (v - e - a) / dt;
+    }
+}
+
+/**
+ * @brief offer a sample
+ */
+int SPSdeadband::sample(const struct sps_sample *s, struct sps_sample out[2])
+{
+    const struct sps_sample *last = _held ? &_prev : &_pivot;
+    int    n = 0;
+
+    _st.samples++;
+
+    if (! _pivot_set) {
+        pivot(s);
+        out[n++] = *s;
+    }
+    // not later: nothing to draw
+    else if (s->ts <= last->ts) {
+        return(0);
+    }
+    else if ((s->flags & SPS_FLAG_STATUS) != (last->flags & SPS_FLAG_STATUS)) {
+        if (_held) out[n++] = _prev;
+        pivot(s);
+        out[n++] = *s;
+        _st.status++;
+    }
+    else {
+        // the previous sample ends the line
+        if (_held && ! inside(s)) {
+            out[n++] = _prev;
+            pivot(&_prev);
+        }
+
+        narrow(s);
+        _prev = *s;
+        _held = true;
+
+        if (s->ts - _pivot.ts >= _max) {
+            out[n++] = *s;
+            pivot(s);
+            _st.heartbeats++;
+        }
+    }
+
+    _st.reported += n;
+    return(n);
+}
+
+/**
+ * @brief get the last sample when it was not reported
+ */
+bool SPSdeadband::flush(struct sps_sample *out)
+{
+    if (! _held) return(false);
+
+    *out = _prev;
+    pivot(&_prev);
+    _st.reported++;
+
+    return(true);
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSdeadband::stats(struct deadband_stats *st)
+{
+    *st = _st;
+}
@@ -0,0 +1,120 @@
+/**
+ * SPS30 report by exception header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Report by exception (option -y): of the samples only those are
+ * displayed and exported (MQTT, InfluxDB, the aggregator and the web
+ * server) that are needed to draw the signal within a deadband. The
+ * store, the circular file, the rules and the capture still get every
+ * sample.
+ *
+ * The deadband of a field is the larger of an absolute value and a
+ * percentage of the value. A line drawn between two reported samples
+ * is within the deadband of every sample in between, for every field.
+ *
+ * This uses the swinging door algorithm. From the last reported
+ * sample (the pivot), each sample narrows the range of slopes (the
+ * door) of lines that pass within its deadband. A sample can end a line
+ * when its slope from the pivot is in the door of the samples before
+ * it. When it is not, the previous sample is reported and becomes the
+ * new pivot. So a sample is reported one sample late, with its own
+ * timestamp.
+ *
+ * A sample is also reported when the status register changes and when
+ * nothing was reported for 'max' seconds (heartbeat).
+ *
+ * The option is a list:
+ *
+ *  abs=#        absolute deadband of all fields       (default 0)
+ *  rel=#        percentage of the value of all fields (default 0)
+ *  max=#        seconds without a report at most      (default 300)
+ *  field=#[/#]  absolute and percentage of a field, e.g. MassPM2=0.5/2
+ *
+ * With a deadband of 0 only samples on a straight line are left out.
+ *********************************************************************
+*/
+#ifndef SPSDEADBAND_H
+#define SPSDEADBAND_H
+
+# include "spsstore.h"
+
+#define DEADBAND_MAX        300             // seconds of silence
+
+/* statistics */
+struct deadband_stats
+{
+    uint64_t samples;               // offered
+    uint64_t reported;
+    uint64_t heartbeats;            // reported because of max
+    uint64_t status;                // reported because of the status
+};
+
+class SPSdeadband
+{
+  public:
+
+    SPSdeadband(void);
+
+    /**
+     * @brief set the deadbands
+     * @param spec    : see above, e.g. abs=0.1,rel=2,max=600,NumPM0=5
+     * @param verbose : if > 0 the deadbands are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error in spec (a message is displayed)
+     */
+    int open(char *spec, int verbose);
+
+    /**
+     * @brief offer a sample
+     * @param out : to store the samples to report, oldest first
+     *
+     * @return number of samples in out (0 - 2)
+     */
+    int sample(const struct sps_sample *s, struct sps_sample out[2]);
+
+    /**
+     * @brief get the last sample when it was not reported (on close)
+     *
+     * @return true when out is set
+     */
+    bool flush(struct sps_sample *out);
+
+    bool is_open() {return(_open);}
+
+    void stats(struct deadband_stats *st);
+
+  private:
+    bool     _open;
+    float    _abs[SPS_FIELDS];
+    float    _rel[SPS_FIELDS];      // fraction
+    uint32_t _max;
+
+    bool     _pivot_set;
+    struct sps_sample _pivot;       // last reported
+    bool     _held;                 // _prev is not reported
+    struct sps_sample _prev;
+    double   _up[SPS_FIELDS];       // the door: lowest upper slope
+    double   _lo[SPS_FIELDS];       // highest lower slope
+
+    struct deadband_stats _st;
+
+    void pivot(const struct sps_sample *s);
+    bool inside(const struct sps_sample *s);
+    void narrow(const struct sps_sample *s);
+};
+
+#endif /* SPSDEADBAND_H */
@@ -0,0 +1,399 @@
+/**
+ * SPS30 parallel query engine for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsengine.h
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <float.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spsengine.h"
+#include "spszip.h"
+
+struct eng_sensor;
+
+/* the query, shared by all tasks */
+struct eng_query
+{
+    const char *dir;
+    uint32_t from;
+    uint32_t to;
+    bool     fields[SPS_FIELDS];
+    struct eng_pred pred;
+    SPSpool  *pool;
+};
+
+/* a segment task */
+struct eng_seg
+{
+    struct eng_sensor *sn;
+    uint32_t first;             // first index entry
+    uint32_t last;              // last index entry (exclusive)
+    struct store_agg agg;       // partial result
+    uint64_t index, scanned, skipped, samples, corrupt;
+    int      err;
+};
+
+/* a sensor task */
+struct eng_sensor
+{
+    struct eng_query *q;
+    uint16_t sensor;
+    struct store_idx *idx;      // copy of the index
+    uint32_t n;
+    struct eng_seg *seg;
+    uint32_t nseg;
+    int      err;
+};
+
+/* how the predicate applies to a block */
+#define PRED_NONE   0
+#define PRED_SOME   1
+#define PRED_ALL    2
+
+/**
+ * @brief parse a predicate like MassPM2>50
+ */
+int eng_parse_pred(const char *s, struct eng_pred *pred)
+{
+    char name[32];
+    const char *p;
+
+    if ((p = strpbrk(s, "<>")) == NULL || p - s >= (int) sizeof(name)) return(STORE_ERROR);
+
+    memcpy(name, s, p - s);
+    name[p - s] = 0x0;
+
+    if ((pred->field = sps_field_lookup(name)) < 0) return(STORE_ERROR);
+
+    pred->op = *p;
+    pred->value = strtof(p + 1, NULL);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief check the predicate on the min / max of a block
+ */
+static int pred_block(const struct eng_pred *pred, const struct store_idx *e)
+{
+    float mn, mx;
+
+    if (pred->field < 0) return(PRED_ALL);
+
+    mn = e->min[pred->field];
+    mx = e->max[pred->field];
+
+    if (pred->op == '>') {
+        if (mn > pred->value) return(PRED_ALL);
+        if (mx <= pred->value) return(PRED_NONE);
+    }
+    else {
+        if (mx < pred->value) return(PRED_ALL);
+        if (mn >= pred->value) return(PRED_NONE);
+    }
+
+    return(PRED_SOME);
+}
+
+/**
+ * @brief check the predicate on a sample
+ */
+static inline bool pred_sample(const struct eng_pred *pred, const struct sps_sample *s)
+{
+    float f;
+
+    if (pred->field < 0) return(true);
+
+    f = sps_field(&s->v, pred->field);
+
+    return(pred->op == '>' ? f > pred->value : f < pred->value);
+}
+
+/**
+ * @brief map a segment file
+ */
+static const uint8_t *map_seg(const char *dir, uint16_t sensor, uint32_t seg, size_t *len)
+{
+    char   name[PATH_MAX];
+    struct stat st;
+    void   *p;
+    int    fd;
+
+    store_seg_name(name, sizeof(name), dir, sensor, seg);
+
+    if ((fd = open(name, O_RDONLY)) < 0) return(NULL);
+
+    fstat(fd, &st);
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) return(NULL);
+
+    *len = st.st_size;
+    return((const uint8_t *) p);
+}
+
+/**
+ * @brief segment task : aggregate the blocks of one segment
+ */
+static void seg_task(void *arg, int worker)
+{
+    struct eng_seg *sg = (struct eng_seg *) arg;
+    struct eng_query *q = sg->sn->q;
+    const struct store_idx *e;
+    const struct store_blk_header *bh;
+    const struct sps_sample *r;
+    const uint8_t *map = NULL;
+    struct  zip_reader *zip = NULL;
+    size_t  len = 0;
+    float   f;
+    int     p;
+
+    store_agg_init(&sg->agg);
+
+    for (uint32_t i = sg->first; i < sg->last; i++) {
+        e = &sg->sn->idx[i];
+
+        if ((p = pred_block(&q->pred, e)) == PRED_NONE) {
+            sg->skipped++;
+            continue;
+        }
+
+        // completely in range and all match : the index entry is enough
+        if (p == PRED_ALL && e->first_ts >= q->from && e->last_ts <= q->to) {
+            store_agg_idx(&sg->agg, e);
+            sg->index++;
+            continue;
+        }
+
+        // read the block, the segment is only mapped if needed, or
+        // opened if it has been compressed
+        if (map == NULL && zip == NULL && (map = map_seg(q->dir, sg->sn->sensor, e->seg, &len)) == NULL
+            && (zip = zip_open(q->dir, sg->sn->sensor, e->seg)) == NULL) {
+            sg->err = 1;
+            return;
+        }
+
+        if (zip) bh = zip_block(zip, e->offset);
+        else if (e->offset + e->length > len) {
+            sg->err = 1;
+            break;
+        }
+        else bh = (const struct store_blk_header *) (map + e->offset);
+
+        // a corrupt block is skipped, not the query
+        if (bh == NULL || store_blk_check(bh, e) != STORE_OK) {
+            sg->corrupt++;
+            continue;
+        }
+
+        r = (const struct sps_sample *) (bh + 1);
+
+        for (uint32_t j = 0; j < e->count; j++) {
+            if (r[j].ts < q->from || r[j].ts > q->to || ! pred_sample(&q->pred, &r[j])) continue;
+
+            for (int k = 0; k < SPS_FIELDS; k++) {
+                if (! q->fields[k]) continue;
+
+                f = sps_field(&r[j].v, k);
+                if (f < sg->agg.min[k]) sg->agg.min[k] = f;
+                if (f > sg->agg.max[k]) sg->agg.max[k] = f;
+                sg->agg.sum[k] += f;
+            }
+
+            sg->agg.count++;
+        }
+
+        sg->scanned++;
+        sg->samples += e->count;
+    }
+
+    if (map) munmap((void *) map, len);
+    zip_close(zip);
+}
+
+/**
+ * @brief sensor task : read the index and add a task per segment
+ */
+static void sensor_task(void *arg, int worker)
+{
+    struct eng_sensor *sn = (struct eng_sensor *) arg;
+    struct eng_query *q = sn->q;
+    char   name[PATH_MAX];
+    struct stat st;
+    uint32_t lo, hi, mid, i, j;
+    int    fd;
+
+    store_idx_name(name, sizeof(name), q->dir, sn->sensor);
+
+    if ((fd = open(name, O_RDONLY)) < 0) {
+        sn->err = 1;
+        return;
+    }
+
+    fstat(fd, &st);
+    sn->n = st.st_size / sizeof(struct store_idx);
+
+    if (sn->n == 0) {
+        close(fd);
+        return;
+    }
+
+    sn->idx = (struct store_idx *) malloc(sn->n * sizeof(struct store_idx));
+    sn->seg = (struct eng_seg *) calloc(sn->n, sizeof(struct eng_seg));
+
+    if (sn->idx == NULL || sn->seg == NULL ||
+        pread(fd, sn->idx, sn->n * sizeof(struct store_idx), 0) != (ssize_t) (sn->n * sizeof(struct store_idx))) {
+        close(fd);
+        sn->err = 1;
+        sn->n = 0;
+        return;
+    }
+
+    close(fd);
+
+    // first block with last_ts >= from
+    lo = 0;
+    hi = sn->n;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (sn->idx[mid].last_ts < q->from) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // a task per segment with blocks in range
+    for (i = lo; i < sn->n && sn->idx[i].first_ts <= q->to; i = j) {
+
+        for (j = i; j < sn->n && sn->idx[j].seg == sn->idx[i].seg && sn->idx[j].first_ts <= q->to; j++);
+
+        sn->seg[sn->nseg].sn = sn;
+        sn->seg[sn->nseg].first = i;
+        sn->seg[sn->nseg].last = j;
+
+        if (q->pool->submit(seg_task, &sn->seg[sn->nseg]) != 0) {
+            sn->err = 1;
+            return;
+        }
+
+        sn->nseg++;
+    }
+}
+
+/**
+ * @brief current time in seconds
+ */
+static double now_sec()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/**
+ * @brief aggregate the samples of sensors between from and to (inclusive)
+ */
+int eng_aggregate(const char *dir, const uint16_t *sensors, int n, uint32_t from, uint32_t to,
+                  const bool *fields, const struct eng_pred *pred, int threads,
+                  struct store_agg *result, struct eng_stats *st)
+{
+    SPSpool pool;
+    struct eng_query q;
+    struct eng_sensor *sn;
+    struct eng_stats s;
+    double start = now_sec();
+    int    ret = STORE_OK;
+
+    memset(&s, 0x0, sizeof(s));
+
+    q.dir = dir;
+    q.from = from;
+    q.to = to;
+    memcpy(q.fields, fields, sizeof(q.fields));
+    q.pool = &pool;
+
+    if (pred) q.pred = *pred;
+    else q.pred.field = -1;
+
+    if ((sn = (struct eng_sensor *) calloc(n, sizeof(struct eng_sensor))) == NULL) return(STORE_ERROR);
+
+    if (pool.start(threads) != 0) {
+        free(sn);
+        return(STORE_ERROR);
+    }
+
+    for (int i = 0; i < n; i++) {
+        sn[i].q = &q;
+        sn[i].sensor = sensors[i];
+
+        if (pool.submit(sensor_task, &sn[i]) != 0) sn[i].err = 1;
+    }
+
+    pool.wait();
+    pool.stats(&s.pool);
+    pool.stop();
+
+    // merge the partial results
+    for (int i = 0; i < n; i++) {
+        store_agg_init(&result[i]);
+
+        if (sn[i].err) {
+            printf("Engine: error reading sensor %d\n", sn[i].sensor);
+            ret = STORE_ERROR;
+        }
+
+        for (uint32_t j = 0; j < sn[i].nseg; j++) {
+            struct eng_seg *sg = &sn[i].seg[j];
+
+            if (sg->err) {
+                printf("Engine: error reading sensor %d segment %u\n", sn[i].sensor, sn[i].idx[sg->first].seg);
+                ret = STORE_ERROR;
+            }
+
+            store_agg_merge(&result[i], &sg->agg);
+            s.blocks_index += sg->index;
+            s.blocks_scanned += sg->scanned;
+            s.blocks_skipped += sg->skipped;
+            s.samples_scanned += sg->samples;
+            s.blocks_corrupt += sg->corrupt;
+        }
+
+        s.samples += result[i].count;
+        s.segments += sn[i].nseg;
+
+        free(sn[i].idx);
+        free(sn[i].seg);
+    }
+
+    s.sensors = n;
+    s.elapsed = now_sec() - start;
+
+    if (st) *st = s;
+
+    free(sn);
+    return(ret);
+}
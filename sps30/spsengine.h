@@ -0,0 +1,95 @@
+/**
+ * SPS30 parallel query engine header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Aggregates over many sensors and segments in parallel.
+ *
+ * For each sensor a task reads the index and adds a task per segment
+ * that has blocks in the time range. The segment tasks are spread over
+ * the workers of a work-stealing pool (spspool.h).
+ *
+ * The time range and an optional predicate on a field (e.g. MassPM2 > 50)
+ * are first applied to the index entries:
+ *
+ *  - a block outside the range or of which the min / max show that no
+ *    sample matches the predicate is skipped
+ *  - a block inside the range of which all samples match is taken from
+ *    the index entry
+ *  - only the other blocks are read, and only the selected fields.
+ *    A block with a wrong CRC is skipped and counted
+ *
+ * so a segment file is only read when it has such a block. Each
+ * segment task has its own partial aggregate, which are merged per
+ * sensor at the end.
+ *********************************************************************
+*/
+#ifndef SPSENGINE_H
+#define SPSENGINE_H
+
+# include "spsstore.h"
+# include "spspool.h"
+
+/* predicate on a field */
+struct eng_pred
+{
+    int   field;            // field index or -1 for none
+    char  op;               // '>' or '<'
+    float value;
+};
+
+/* statistics of a query */
+struct eng_stats
+{
+    uint32_t sensors;           // sensors queried
+    uint32_t segments;          // segment tasks
+    uint64_t blocks_index;      // blocks taken from the index
+    uint64_t blocks_scanned;    // blocks read
+    uint64_t blocks_skipped;    // blocks skipped on the predicate
+    uint64_t blocks_corrupt;    // blocks skipped on a wrong CRC
+    uint64_t samples_scanned;   // samples read
+    uint64_t samples;           // samples in the result
+    double   elapsed;           // seconds
+    struct pool_stats pool;
+};
+
+/**
+ * @brief parse a predicate like MassPM2>50
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int eng_parse_pred(const char *s, struct eng_pred *pred);
+
+/**
+ * @brief aggregate the samples of sensors between from and to (inclusive)
+ * @param dir     : store directory
+ * @param sensors : sensor ids
+ * @param n       : number of sensors
+ * @param fields  : SPS_FIELDS flags, the fields to aggregate when read
+ * @param pred    : predicate or NULL
+ * @param threads : worker threads, 0 = number of CPUs
+ * @param result  : n aggregates, one per sensor
+ * @param st      : statistics (or NULL)
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error (a sensor or segment could not be read)
+ */
+int eng_aggregate(const char *dir, const uint16_t *sensors, int n, uint32_t from, uint32_t to,
+                  const bool *fields, const struct eng_pred *pred, int threads,
+                  struct store_agg *result, struct eng_stats *st);
+
+#endif /* SPSENGINE_H */
@@ -0,0 +1,579 @@
+/**
+ * SPS30 history downsampling for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spshist.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <math.h>
+#include "spshist.h"
+#include "spsrollup.h"
+
+/* JSON bytes of a point at most: ",4294967295" and ",-FLT_MAX.000" */
+#define HIST_JSON_POINT     (11 + 46)
+
+/* state of a downsampling */
+typedef struct hist_state
+{
+    struct hist_par *p;
+    int      nf;
+    uint32_t buckets;
+    double   span;                      // seconds in range
+    uint64_t source;                    // points read
+    bool     oom;
+    uint32_t rollup_last;               // timestamp of the last rollup read
+
+    /* output per field */
+    uint32_t *ot[SPS_FIELDS];
+    float    *ov[SPS_FIELDS];
+    uint32_t on[SPS_FIELDS];
+    uint32_t cap;
+
+    int64_t  cur;                       // bucket being filled (-1 = none)
+    bool     first;                     // first point seen
+    uint32_t last_t;                    // last point
+    float    last_v[SPS_FIELDS];
+
+    /* lttb: bucket P waits for the mean of bucket C */
+    uint32_t *pt, *ct;                  // timestamps
+    float    *pv, *cv;                  // values, nf per point
+    uint32_t pn, cn, pcap, ccap;
+    bool     have_p;
+    double   a_t[SPS_FIELDS];           // point chosen before P
+    double   a_v[SPS_FIELDS];
+
+    /* minmax: the current bucket */
+    float    mn[SPS_FIELDS], mx[SPS_FIELDS];
+    uint32_t mnt[SPS_FIELDS], mxt[SPS_FIELDS];
+    bool     mm_any;
+} hist_state;
+
+/**
+ * @brief decode %xx and + of a query value
+ */
+static void url_decode(char *dst, const char *src, int len)
+{
+    int i = 0;
+    unsigned v;
+
+    while (*src && *src != '&' && i < len - 1) {
+        if (*src == '%' && src[1] && src[2] && sscanf(src + 1, "%2x", &v) == 1) {
+            dst[i++] = (char) v;
+            src += 3;
+        }
+        else {
+            dst[i++] = *src == '+' ? ' ' : *src;
+            src++;
+        }
+    }
+
+    dst[i] = 0x0;
+}
+
+/**
+ * @brief a time: seconds since epoch, or before now when negative
+ */
+static uint32_t hist_time(const char *val, time_t now)
+{
+    long t = strtol(val, NULL, 10);
+
+    return(t < 0 ? (uint32_t) (now + t) : (uint32_t) t);
+}
+
+/**
+ * @brief parse the query string of a request
+ */
+int hist_parse(const char *query, struct hist_par *p, const char **err)
+{
+    char   key[16], val[256], *f, *save;
+    time_t now = time(NULL);
+    const char *q = query, *eq;
+    bool   from_set = false;
+    int    i;
+
+    memset(p, 0x0, sizeof(struct hist_par));
+    p->to = (uint32_t) now;
+    p->points = HIST_POINTS;
+    p->mode = HIST_LTTB;
+    p->tier = HIST_AUTO;
+    p->field[0] = sps_field_lookup("MassPM2");
+    p->nfields = 1;
+
+    while (*q) {
+        if ((eq = strchr(q, '=')) == NULL) break;
+
+        snprintf(key, sizeof(key), "%.*s", (int) (eq - q) < 15 ? (int) (eq - q) : 15, q);
+        url_decode(val, eq + 1, sizeof(val));
+
+        if (strcmp(key, "from") == 0) {
+            p->from = hist_time(val, now);
+            from_set = true;
+        }
+        else if (strcmp(key, "to") == 0) p->to = hist_time(val, now);
+        else if (strcmp(key, "points") == 0) p->points = (uint32_t) strtoul(val, NULL, 10);
+        else if (strcmp(key, "fields") == 0) {
+            p->nfields = 0;
+
+            for (f = strtok_r(val, ",", &save); f; f = strtok_r(NULL, ",", &save)) {
+                if ((i = sps_field_lookup(f)) < 0) {
+                    *err = "unknown field";
+                    return(STORE_ERROR);
+                }
+                if (p->nfields < SPS_FIELDS) p->field[p->nfields++] = i;
+            }
+        }
+        else if (strcmp(key, "mode") == 0) {
+            if (strcasecmp(val, "lttb") == 0) p->mode = HIST_LTTB;
+            else if (strcasecmp(val, "minmax") == 0) p->mode = HIST_MINMAX;
+            else {
+                *err = "mode is lttb or minmax";
+                return(STORE_ERROR);
+            }
+        }
+        else if (strcmp(key, "tier") == 0) {
+            if (strcasecmp(val, "auto") == 0) p->tier = HIST_AUTO;
+            else if (strcasecmp(val, "raw") == 0) p->tier = HIST_RAW;
+            else if (strcasecmp(val, "minute") == 0) p->tier = ROLLUP_MINUTE;
+            else if (strcasecmp(val, "hour") == 0) p->tier = ROLLUP_HOUR;
+            else {
+                *err = "tier is auto, raw, minute or hour";
+                return(STORE_ERROR);
+            }
+        }
+        else if (strcmp(key, "format") == 0) p->binary = strcasecmp(val, "bin") == 0;
+
+        if ((q = strchr(eq, '&')) == NULL) break;
+        q++;
+    }
+
+    if (! from_set) p->from = p->to > HIST_RANGE ? p->to - HIST_RANGE : 0;
+
+    if (p->nfields == 0 || p->from > p->to || p->points < 3 || p->points > HIST_POINTS_MAX) {
+        *err = "need fields, from <= to and 3 - 100000 points";
+        return(STORE_ERROR);
+    }
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add a point to the output of a field
+ */
+static void emit(hist_state *h, int f, uint32_t t, float v)
+{
+    if (h->on[f] < h->cap) {
+        h->ot[f][h->on[f]] = t;
+        h->ov[f][h->on[f]++] = v;
+    }
+}
+
+/**
+ * @brief LTTB: choose the point of a bucket per field
+ * @param c_t, c_v : third point (mean of the next bucket or last point)
+ */
+static void lttb_select(hist_state *h, const uint32_t *t, const float *v, uint32_t n,
+    const double *c_t, const double *c_v)
+{
+    double area, best, at, av;
+    uint32_t sel;
+
+    for (int f = 0; f < h->nf; f++) {
+        at = h->a_t[f];
+        av = h->a_v[f];
+        best = -1;
+        sel = 0;
+
+        for (uint32_t i = 0; i < n; i++) {
+            area = (at - c_t[f]) * (v[i * h->nf + f] - av) - (at - t[i]) * (c_v[f] - av);
+            if (area < 0) area = -area;
+
+            if (area > best) {
+                best = area;
+                sel = i;
+            }
+        }
+
+        emit(h, f, t[sel], v[sel * h->nf + f]);
+        h->a_t[f] = t[sel];
+        h->a_v[f] = v[sel * h->nf + f];
+    }
+}
+
+/**
+ * @brief LTTB: mean of the current bucket
+ */
+static void lttb_mean(hist_state *h, double *m_t, double *m_v)
+{
+    double st = 0;
+
+    for (int f = 0; f < h->nf; f++) m_v[f] = 0;
+
+    for (uint32_t i = 0; i < h->cn; i++) {
+        st += h->ct[i];
+        for (int f = 0; f < h->nf; f++) m_v[f] += h->cv[i * h->nf + f];
+    }
+
+    for (int f = 0; f < h->nf; f++) {
+        m_t[f] = st / h->cn;
+        m_v[f] /= h->cn;
+    }
+}
+
+/**
+ * @brief LTTB: the current bucket is complete, choose in the waiting one
+ */
+static void lttb_bucket(hist_state *h)
+{
+    double m_t[SPS_FIELDS], m_v[SPS_FIELDS];
+    uint32_t *t, n;
+    float *v;
+
+    if (h->have_p) {
+        lttb_mean(h, m_t, m_v);
+        lttb_select(h, h->pt, h->pv, h->pn, m_t, m_v);
+    }
+
+    // the current bucket waits for the next
+    t = h->pt; h->pt = h->ct; h->ct = t;
+    v = h->pv; h->pv = h->cv; h->cv = v;
+    n = h->pcap; h->pcap = h->ccap; h->ccap = n;
+    h->pn = h->cn;
+    h->cn = 0;
+    h->have_p = true;
+}
+
+/**
+ * @brief minmax: output the current bucket
+ */
+static void minmax_bucket(hist_state *h)
+{
+    for (int f = 0; f < h->nf; f++) {
+        if (h->mnt[f] < h->mxt[f]) {
+            emit(h, f, h->mnt[f], h->mn[f]);
+            emit(h, f, h->mxt[f], h->mx[f]);
+        }
+        else if (h->mnt[f] > h->mxt[f]) {
+            emit(h, f, h->mxt[f], h->mx[f]);
+            emit(h, f, h->mnt[f], h->mn[f]);
+        }
+        else emit(h, f, h->mnt[f], h->mn[f]);
+    }
+
+    h->mm_any = false;
+}
+
+/**
+ * @brief add a point: a sample (mn = mx = mean) or a rollup
+ */
+static void hist_add(hist_state *h, uint32_t t, const float *mn, const float *mx, const float *mean)
+{
+    int64_t b;
+    void *np;
+
+    if (t < h->p->from || t > h->p->to || h->oom) return;
+
+    h->source++;
+    b = (int64_t) ((t - h->p->from) * (double) h->buckets / h->span);
+
+    if (h->p->mode == HIST_MINMAX) {
+        if (b != h->cur && h->mm_any) minmax_bucket(h);
+        h->cur = b;
+
+        for (int f = 0; f < h->nf; f++) {
+            if (! h->mm_any || mn[f] < h->mn[f]) {
+                h->mn[f] = mn[f];
+                h->mnt[f] = t;
+            }
+            if (! h->mm_any || mx[f] > h->mx[f]) {
+                h->mx[f] = mx[f];
+                h->mxt[f] = t;
+            }
+        }
+
+        h->mm_any = true;
+        return;
+    }
+
+    // LTTB: the first point is always included
+    if (! h->first) {
+        h->first = true;
+
+        for (int f = 0; f < h->nf; f++) {
+            emit(h, f, t, mean[f]);
+            h->a_t[f] = t;
+            h->a_v[f] = mean[f];
+        }
+
+        return;
+    }
+
+    if (b != h->cur && h->cn > 0) lttb_bucket(h);
+    h->cur = b;
+
+    if (h->cn == h->ccap) {
+        h->ccap = h->ccap ? h->ccap * 2 : 256;
+
+        if ((np = realloc(h->ct, h->ccap * sizeof(uint32_t))) == NULL) {
+            h->oom = true;
+            return;
+        }
+        h->ct = (uint32_t *) np;
+
+        if ((np = realloc(h->cv, h->ccap * h->nf * sizeof(float))) == NULL) {
+            h->oom = true;
+            return;
+        }
+        h->cv = (float *) np;
+    }
+
+    h->ct[h->cn] = t;
+    memcpy(&h->cv[h->cn * h->nf], mean, h->nf * sizeof(float));
+    h->cn++;
+
+    h->last_t = t;
+    memcpy(h->last_v, mean, h->nf * sizeof(float));
+}
+
+/**
+ * @brief the last buckets and the last point
+ */
+static void hist_finish(hist_state *h)
+{
+    double m_t[SPS_FIELDS], m_v[SPS_FIELDS];
+
+    if (h->p->mode == HIST_MINMAX) {
+        if (h->mm_any) minmax_bucket(h);
+        return;
+    }
+
+    if (h->cn == 0) return;
+
+    for (int f = 0; f < h->nf; f++) {
+        m_t[f] = h->last_t;
+        m_v[f] = h->last_v[f];
+    }
+
+    if (h->have_p) {
+        lttb_mean(h, m_t, m_v);
+        lttb_select(h, h->pt, h->pv, h->pn, m_t, m_v);
+
+        for (int f = 0; f < h->nf; f++) {
+            m_t[f] = h->last_t;
+            m_v[f] = h->last_v[f];
+        }
+    }
+
+    // the current bucket without its last point, then the last point
+    if (h->cn > 1) lttb_select(h, h->ct, h->cv, h->cn - 1, m_t, m_v);
+
+    for (int f = 0; f < h->nf; f++) emit(h, f, h->last_t, h->last_v[f]);
+}
+
+/* callbacks of rollup_read and SPSread::read */
+static bool hist_rollup(const struct sps_rollup *r, void *ctx)
+{
+    hist_state *h = (hist_state *) ctx;
+    float mn[SPS_FIELDS], mx[SPS_FIELDS], mean[SPS_FIELDS];
+
+    for (int f = 0; f < h->nf; f++) {
+        mn[f] = r->min[h->p->field[f]];
+        mx[f] = r->max[h->p->field[f]];
+        mean[f] = r->mean[h->p->field[f]];
+    }
+
+    hist_add(h, r->ts, mn, mx, mean);
+    h->rollup_last = r->ts;
+
+    return(! h->oom);
+}
+
+static bool hist_sample(const struct sps_sample *s, void *ctx)
+{
+    hist_state *h = (hist_state *) ctx;
+    float v[SPS_FIELDS];
+
+    for (int f = 0; f < h->nf; f++) v[f] = sps_field(&s->v, h->p->field[f]);
+
+    hist_add(h, s->ts, v, v, v);
+
+    return(! h->oom);
+}
+
+/**
+ * @brief encode the result as JSON
+ */
+static char *hist_json(hist_state *h, uint16_t sensor, int tier, double ms, size_t *len)
+{
+    static const char *tier_name[] = {"raw", "minute", "hour"};
+    size_t size = 512, n;
+    char *buf, *p;
+    int  f;
+
+    // sized for the widest values, a bad stored value is 39 digits
+    for (f = 0; f < h->nf; f++) size += 64 + (size_t) h->on[f] * HIST_JSON_POINT;
+
+    if ((buf = (char *) malloc(size)) == NULL) return(NULL);
+
+    p = buf;
+    p += sprintf(p, "{\"sensor\":%u,\"from\":%u,\"to\":%u,\"tier\":\"%s\",\"mode\":\"%s\",\"source\":%llu,"
+        "\"ms\":%.2f,\"series\":[", sensor, h->p->from, h->p->to, tier_name[tier + 1],
+        h->p->mode == HIST_LTTB ? "lttb" : "minmax", (unsigned long long) h->source, ms);
+
+    for (f = 0; f < h->nf; f++) {
+        p += sprintf(p, "%s{\"field\":\"%s\",\"t\":[", f ? "," : "", sps_field_name[h->p->field[f]]);
+
+        for (n = 0; n < h->on[f]; n++) p += sprintf(p, n ? ",%u" : "%u", h->ot[f][n]);
+
+        p += sprintf(p, "],\"v\":[");
+
+        // JSON has no nan / inf
+        for (n = 0; n < h->on[f]; n++) {
+            if (! isfinite(h->ov[f][n])) p += sprintf(p, n ? ",null" : "null");
+            else p += sprintf(p, h->p->field[f] == SPS_FIELDS - 1 ? (n ? ",%.3f" : "%.3f") : (n ? ",%.2f" : "%.2f"),
+                h->ov[f][n]);
+        }
+
+        p += sprintf(p, "]}");
+    }
+
+    p += sprintf(p, "]}\n");
+
+    *len = p - buf;
+    return(buf);
+}
+
+/**
+ * @brief encode the result as binary
+ */
+static char *hist_bin(hist_state *h, int tier, size_t *len)
+{
+    struct hist_bin_header *hdr;
+    struct hist_bin_series *s;
+    size_t size = sizeof(struct hist_bin_header);
+    char *buf, *p;
+
+    for (int f = 0; f < h->nf; f++) size += sizeof(struct hist_bin_series) + h->on[f] * 8;
+
+    if ((buf = (char *) malloc(size)) == NULL) return(NULL);
+
+    hdr = (struct hist_bin_header *) buf;
+    hdr->magic = HIST_MAGIC;
+    hdr->nfields = h->nf;
+    hdr->tier = tier + 1;
+    hdr->from = h->p->from;
+    hdr->to = h->p->to;
+    p = buf + sizeof(struct hist_bin_header);
+
+    for (int f = 0; f < h->nf; f++) {
+        s = (struct hist_bin_series *) p;
+        s->field = h->p->field[f];
+        s->reserved = 0;
+        s->n = h->on[f];
+        p += sizeof(struct hist_bin_series);
+
+        memcpy(p, h->ot[f], h->on[f] * sizeof(uint32_t));
+        p += h->on[f] * sizeof(uint32_t);
+        memcpy(p, h->ov[f], h->on[f] * sizeof(float));
+        p += h->on[f] * sizeof(float);
+    }
+
+    *len = size;
+    return(buf);
+}
+
+/**
+ * @brief downsample and encode a range
+ */
+int hist_run(SPSread *rd, const char *dir, uint16_t sensor, struct hist_par *p, char **out, size_t *len)
+{
+    struct timespec t0, t1;
+    hist_state h;
+    double width;
+    uint32_t raw_from = p->from;
+    int tier = p->tier, ret = STORE_OK;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    memset(&h, 0x0, sizeof(h));
+    h.p = p;
+    h.nf = p->nfields;
+    h.cur = -1;
+    h.span = (double) p->to - p->from + 1;
+    h.buckets = p->mode == HIST_LTTB ? p->points - 2 : p->points / 2;
+    h.cap = p->points + 2;
+
+    for (int f = 0; f < h.nf; f++) {
+        h.ot[f] = (uint32_t *) malloc(h.cap * sizeof(uint32_t));
+        h.ov[f] = (float *) malloc(h.cap * sizeof(float));
+        if (h.ot[f] == NULL || h.ov[f] == NULL) h.oom = true;
+    }
+
+    // the coarsest tier with enough rollups per bucket
+    if (tier == HIST_AUTO) {
+        width = h.span / h.buckets;
+
+        if (width >= HIST_PER_BUCKET * rollup_bucket(ROLLUP_HOUR)) tier = ROLLUP_HOUR;
+        else if (width >= HIST_PER_BUCKET * rollup_bucket(ROLLUP_MINUTE)) tier = ROLLUP_MINUTE;
+        else tier = HIST_RAW;
+    }
+
+    // the rollups, then the samples after the last rollup
+    if (tier != HIST_RAW && ! h.oom) {
+        if (rollup_read(dir, sensor, tier, p->from, p->to, hist_rollup, &h) > 0)
+            raw_from = h.rollup_last + rollup_bucket(tier);
+        else if (p->tier == HIST_AUTO)
+            tier = HIST_RAW;
+    }
+
+    if (raw_from <= p->to && ! h.oom) {
+        rd->refresh();
+        rd->read(raw_from, p->to, hist_sample, &h);
+    }
+
+    hist_finish(&h);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (h.oom) ret = STORE_ERROR;
+    else if (p->binary) {
+        if ((*out = hist_bin(&h, tier, len)) == NULL) ret = STORE_ERROR;
+    }
+    else {
+        if ((*out = hist_json(&h, sensor, tier, (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6,
+            len)) == NULL) ret = STORE_ERROR;
+    }
+
+    for (int f = 0; f < h.nf; f++) {
+        free(h.ot[f]);
+        free(h.ov[f]);
+    }
+
+    free(h.pt); free(h.ct);
+    free(h.pv); free(h.cv);
+
+    return(ret);
+}
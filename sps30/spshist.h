@@ -0,0 +1,118 @@
+/**
+ * SPS30 history downsampling header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Reduces a time range of the store to a number of points per field
+ * for a chart, served by the web server (spshttp.h) as:
+ *
+ *  GET /api/history?from=&to=&fields=MassPM2,NumPM0&points=1000
+ *                   &mode=lttb|minmax&tier=auto|raw|minute|hour
+ *                   &format=json|bin
+ *
+ * from and to are seconds since epoch, or before now when negative
+ * (from=-2592000 is the last 30 days). The defaults are the last day,
+ * MassPM2, 1000 points, lttb, auto and json.
+ *
+ * The range is divided in equal buckets of time:
+ *
+ *  lttb    Largest-Triangle-Three-Buckets: per bucket the point that
+ *          makes the largest triangle with the point chosen in the
+ *          previous bucket and the mean of the next bucket. The first
+ *          and last point are always included.
+ *  minmax  per bucket the minimum and the maximum, in time order.
+ *
+ * Both need one pass over the samples and keep at most two buckets in
+ * memory. With tier=auto the coarsest rollup tier (spsrollup.h) that
+ * still has 4 rollups per bucket is read instead of the raw samples:
+ * a month at 1000 points reads 43200 minute rollups instead of 2.6
+ * million samples. Samples after the last rollup are read from the
+ * store. When there are no rollups the raw samples are used.
+ *
+ * json: {"sensor":1,"from":..,"to":..,"tier":"minute","mode":"lttb",
+ *        "source":43200,"series":[{"field":"MassPM2","t":[..],"v":[..]}]}
+ *
+ * bin:  struct hist_bin_header, then per field a struct hist_bin_series
+ *       followed by n timestamps (uint32_t) and n values (float)
+ *********************************************************************
+*/
+#ifndef SPSHIST_H
+#define SPSHIST_H
+
+# include "spsstore.h"
+
+#define HIST_POINTS         1000            // default points per field
+#define HIST_POINTS_MAX     100000
+#define HIST_RANGE          86400           // default range (seconds)
+#define HIST_PER_BUCKET     4               // rollups per bucket for auto tier
+#define HIST_MAGIC          0x53505348      // "SPSH"
+
+/* mode */
+#define HIST_LTTB           0
+#define HIST_MINMAX         1
+
+/* tier */
+#define HIST_AUTO           -2
+#define HIST_RAW            -1              // else ROLLUP_MINUTE / ROLLUP_HOUR
+
+/* a request */
+struct hist_par
+{
+    uint32_t from, to;          // inclusive
+    int      field[SPS_FIELDS]; // fields asked for
+    int      nfields;
+    uint32_t points;            // per field
+    int      mode;              // HIST_LTTB or HIST_MINMAX
+    int      tier;              // HIST_AUTO, HIST_RAW or rollup tier
+    bool     binary;            // bin instead of json
+};
+
+/* binary reply */
+struct hist_bin_header
+{
+    uint32_t magic;             // HIST_MAGIC
+    uint16_t nfields;
+    uint16_t tier;              // 0 = raw, else 1 + rollup tier
+    uint32_t from, to;
+};
+
+struct hist_bin_series
+{
+    uint16_t field;             // see sps_field_name
+    uint16_t reserved;
+    uint32_t n;                 // points
+};
+
+/**
+ * @brief parse the query string of a request
+ * @param query : e.g. from=-3600&fields=MassPM1,MassPM2
+ * @param err   : set to a message on error
+ *
+ * @return STORE_OK or STORE_ERROR
+ */
+int hist_parse(const char *query, struct hist_par *p, const char **err);
+
+/**
+ * @brief downsample and encode a range
+ * @param rd     : open reader of the store
+ * @param dir    : store directory (rollups)
+ * @param sensor : sensor id
+ * @param out    : set to the reply (malloc'ed, free when done)
+ * @param len    : set to the length of the reply
+ *
+ * @return STORE_OK or STORE_ERROR (out of memory)
+ */
+int hist_run(SPSread *rd, const char *dir, uint16_t sensor, struct hist_par *p, char **out, size_t *len);
+
+#endif /* SPSHIST_H */
@@ -0,0 +1,249 @@
+/**
+ * SPS30 housekeeping for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spshouse.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/timex.h>
+#include "spshouse.h"
+
+static const char *house_name[HOUSE_TASKS] = {"status", "clean", "device", "clock"};
+
+/**
+ * @brief monotonic time in seconds
+ */
+static double house_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/**
+ * @brief system time in seconds
+ */
+static double house_wall()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+SPShouse::SPShouse(void)
+{
+    _sensor = NULL;
+    memset(_rate, 0x0, sizeof(_rate));
+    memset(_next, 0x0, sizeof(_next));
+    _interval = 0;
+    _verbose = 0;
+    _status = 0;
+    _clock_ok = true;
+    _serial[0] = 0x0;
+    memset(&_version, 0x0, sizeof(_version));
+    _wall = _mono = 0;
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief start housekeeping
+ */
+uint32_t SPShouse::open(SPS30 *sensor, const uint32_t rate[HOUSE_TASKS], uint32_t interval, int verbose)
+{
+    uint32_t errors = 0;
+    double now = house_now();
+
+    _sensor = sensor;
+    _interval = interval;
+    _verbose = verbose;
+
+    for (int t = 0; t < HOUSE_TASKS; t++) _rate[t] = rate[t];
+
+    // the status register needs firmware 2.2
+    if (_rate[HOUSE_T_STATUS] > 0 && ! _sensor->FWCheck(2,2)) {
+        if (_verbose) printf("House: status polls need firmware 2.2, switched off\n");
+        _rate[HOUSE_T_STATUS] = 0;
+    }
+
+    // the device as it is now
+    if (_sensor->GetSerialNumber(_serial, sizeof(_serial)) != ERR_OK) _serial[0] = 0x0;
+    if (_sensor->GetVersion(&_version) != ERR_OK) memset(&_version, 0x0, sizeof(_version));
+
+    for (int t = 0; t < HOUSE_TASKS; t++) {
+        if (_rate[t] == 0) continue;
+
+        if (t != HOUSE_T_DEVICE && ! task(t)) errors++;
+        _next[t] = now + _rate[t];
+
+        if (_verbose) printf("House: %s every %u s\n", house_name[t], _rate[t]);
+    }
+
+    return(errors);
+}
+
+/**
+ * @brief run one task
+ *
+ * @return false on a bus error
+ */
+bool SPShouse::task(int t)
+{
+    struct timex tx;
+    uint32_t val;
+    uint8_t  st;
+    SPS30_version v;
+    char     serial[35];
+    double   wall, mono, step;
+    bool     ok = true, sync;
+
+    _st.runs[t]++;
+
+    switch (t) {
+    case HOUSE_T_STATUS:
+        // out of range: an error bit is set
+        switch (_sensor->GetStatusReg(&st)) {
+        case ERR_OK:
+        case ERR_OUTOFRANGE:
+            if (st != 0 && st != _status) {
+                _st.changes[t]++;
+                if (_verbose) printf("House: status register 0x%02x\n", st);
+            }
+            _status = st;
+            break;
+        default:
+            ok = false;
+        }
+        break;
+
+    case HOUSE_T_CLEAN:
+        if (_sensor->GetAutoCleanInt(&val) != ERR_OK) ok = false;
+        else if (val != _interval) {
+            _st.changes[t]++;
+            printf("House: automatic clean interval was %u s, set to %u s again\n", val, _interval);
+            if (_sensor->SetAutoCleanInt(_interval) != ERR_OK) ok = false;
+        }
+        break;
+
+    case HOUSE_T_DEVICE:
+        if (_sensor->GetSerialNumber(serial, sizeof(serial)) != ERR_OK ||
+            _sensor->GetVersion(&v) != ERR_OK) {
+            ok = false;
+            break;
+        }
+
+        if (strcmp(serial, _serial) != 0 || v.major != _version.major || v.minor != _version.minor) {
+            _st.changes[t]++;
+            printf("House: SPS30 %s firmware %d.%d is now %s firmware %d.%d\n", _serial,
+                _version.major, _version.minor, serial, v.major, v.minor);
+            strcpy(_serial, serial);
+            _version = v;
+        }
+        break;
+
+    case HOUSE_T_CLOCK:
+        // synchronized by NTP, and not before this version
+        memset(&tx, 0x0, sizeof(tx));
+        sync = adjtimex(&tx) != TIME_ERROR && ! (tx.status & STA_UNSYNC);
+
+        wall = house_wall();
+        mono = house_now();
+
+        if (_mono > 0) {
+            step = (wall - _wall) - (mono - _mono);
+
+            if (fabs(step) > HOUSE_STEP) {
+                _st.changes[t]++;
+                if (_verbose) printf("House: the system clock stepped %.1f s\n", step);
+            }
+        }
+
+        _wall = wall;
+        _mono = mono;
+
+        sync = sync && wall >= HOUSE_EPOCH;
+
+        if (sync != _clock_ok && _verbose)
+            printf("House: the system clock is %ssynchronized\n", sync ? "" : "not ");
+
+        _clock_ok = sync;
+        break;
+    }
+
+    if (! ok) _st.errors[t]++;
+
+    return(ok);
+}
+
+/**
+ * @brief run the tasks that are due and fit in the time left
+ */
+uint32_t SPShouse::run(double window)
+{
+    double start = house_now(), now = start;
+    uint32_t errors = 0;
+
+    if (_sensor == NULL) return(0);
+
+    for (int t = 0; t < HOUSE_TASKS; t++) {
+        if (_rate[t] == 0 || now < _next[t]) continue;
+
+        // a task takes a few ms, leave a margin for the read
+        if (now - start + HOUSE_MARGIN > window) {
+            _st.yielded++;
+            continue;
+        }
+
+        if (! task(t)) errors++;
+
+        now = house_now();
+        _next[t] = now + _rate[t];
+    }
+
+    return(errors);
+}
+
+/**
+ * @brief the flags of the last runs
+ */
+uint16_t SPShouse::flags()
+{
+    uint16_t f = 0;
+
+    if (_status != 0) f |= SPS_FLAG_FAULT;
+    if (! _clock_ok) f |= SPS_FLAG_CLOCK;
+
+    return(f);
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPShouse::stats(struct house_stats *st)
+{
+    *st = _st;
+}
@@ -0,0 +1,133 @@
+/**
+ * SPS30 housekeeping header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Housekeeping of the SPS30 apart from reading the values (option -g).
+ * Without -g there is none, except the status task when the status
+ * flags of a sample are used: displayed (-E), captured (-k), stored or
+ * exported, or checked by the rules. Each task runs at its own rate:
+ *
+ *  status  read and clear the status register      HOUSE_STATUS s
+ *  clean   check the automatic clean interval      HOUSE_CLEAN s
+ *          and set it again when it changed
+ *  device  check the serial number and firmware    HOUSE_DEVICE s
+ *          against those at the start (the SPS30
+ *          was replaced or reset)
+ *  clock   check the system clock is synchronized  HOUSE_CLOCK s
+ *          (NTP) and did not step
+ *
+ * The results are kept, so every sample gets the last status register
+ * and SPS_FLAG_FAULT / SPS_FLAG_CLOCK without a bus transfer. The error
+ * bits of the status register stay set until it is cleared, so a fault
+ * between two polls is not missed, only seen later. Before, -E read
+ * and cleared the status register with every sample.
+ *
+ * Housekeeping yields to the measurement: run() is called after a
+ * sample with the seconds until the next read and only starts a task
+ * when it ends HOUSE_MARGIN seconds before that. A task that does not
+ * fit waits for the next call. It is never run while the SPS30 sleeps.
+ *
+ * A rate of 0 switches a task off. The status register needs firmware
+ * 2.2 or higher, else that task is off.
+ *********************************************************************
+*/
+#ifndef SPSHOUSE_H
+#define SPSHOUSE_H
+
+# include "sps30lib.h"
+# include "spsstore.h"
+
+#define HOUSE_STATUS        60              // seconds between tasks
+#define HOUSE_CLEAN         3600
+#define HOUSE_DEVICE        3600
+#define HOUSE_CLOCK         60
+#define HOUSE_MARGIN        0.2             // seconds before the next read
+#define HOUSE_STEP          2               // seconds the clock may step
+#define HOUSE_EPOCH         1767225600      // 2026-01-01, an earlier clock is not set
+
+/* tasks */
+#define HOUSE_TASKS         4
+#define HOUSE_T_STATUS      0
+#define HOUSE_T_CLEAN       1
+#define HOUSE_T_DEVICE      2
+#define HOUSE_T_CLOCK       3
+
+/* statistics */
+struct house_stats
+{
+    uint32_t runs[HOUSE_TASKS];
+    uint32_t errors[HOUSE_TASKS];   // bus errors
+    uint32_t changes[HOUSE_TASKS];  // fault, restored, replaced, step
+    uint32_t yielded;               // tasks that waited for a read
+};
+
+class SPShouse
+{
+  public:
+
+    SPShouse(void);
+
+    /**
+     * @brief start housekeeping, the first runs are done now
+     * @param sensor   : the SPS30
+     * @param rate     : seconds between runs of each task (0 = off)
+     * @param interval : automatic clean interval to keep
+     * @param verbose  : if > 0 the changes are displayed
+     *
+     * @return bus errors of the first runs
+     */
+    uint32_t open(SPS30 *sensor, const uint32_t rate[HOUSE_TASKS], uint32_t interval, int verbose);
+
+    bool is_open() {return(_sensor != NULL);}
+
+    /**
+     * @brief run the tasks that are due and fit in the time left
+     * @param window : seconds until the next read of the values
+     *
+     * @return bus errors
+     */
+    uint32_t run(double window);
+
+    /**
+     * @brief the status register of the last poll
+     */
+    uint8_t status() {return(_status);}
+
+    /**
+     * @brief SPS_FLAG_FAULT and / or SPS_FLAG_CLOCK of the last runs
+     */
+    uint16_t flags();
+
+    void stats(struct house_stats *st);
+
+  private:
+    SPS30    *_sensor;
+    uint32_t _rate[HOUSE_TASKS];
+    double   _next[HOUSE_TASKS];    // monotonic time a task is due
+    uint32_t _interval;
+    int      _verbose;
+
+    uint8_t  _status;
+    bool     _clock_ok;
+    char     _serial[35];
+    SPS30_version _version;
+    double   _wall, _mono;          // at the last clock check
+
+    struct house_stats _st;
+
+    bool task(int t);
+};
+
+#endif /* SPSHOUSE_H */
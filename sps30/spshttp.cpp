@@ -0,0 +1,718 @@
+/**
+ * SPS30 web server for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spshttp.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "spshttp.h"
+#include "spsstream.h"
+#include "spshist.h"
+
+/* the dashboard */
+static const char http_page[] =
+"<!DOCTYPE html>\n"
+"<html><head><meta charset=\"utf-8\"><meta name=\"viewport\" content=\"width=device-width\">\n"
+"<title>SPS30</title>\n"
+"<style>\n"
+"body{font-family:sans-serif;margin:1em;background:#fafafa;color:#222}\n"
+"#pm{font-size:4em;font-weight:bold}#state{color:#888}\n"
+"table{border-collapse:collapse;margin-top:1em}td{padding:2px 12px;text-align:right}\n"
+"td:first-child{text-align:left;color:#555}canvas{border:1px solid #ddd;background:#fff;margin-top:1em}\n"
+"</style></head><body>\n"
+"<h2>SPS30 sensor <span id=\"sensor\"></span></h2>\n"
+"<div><span id=\"pm\">-</span> &micro;g/m3 PM2.5 <span id=\"state\">connecting</span></div>\n"
+"<canvas id=\"chart\" width=\"720\" height=\"240\"></canvas>\n"
+"<table id=\"values\"></table>\n"
+"<script>\n"
+"var names=['MassPM1','MassPM2','MassPM4','MassPM10','NumPM0','NumPM1','NumPM2','NumPM4','NumPM10','PartSize'];\n"
+"var units=['&micro;g/m3','&micro;g/m3','&micro;g/m3','&micro;g/m3','#/cm3','#/cm3','#/cm3','#/cm3','#/cm3','&micro;m'];\n"
+"var colors=['#4a90d9','#d0021b','#f5a623','#7ed321'],hist=[],max=600;\n"
+"var t=document.getElementById('values');\n"
+"for(var i=0;i<names.length;i++)t.insertRow().innerHTML='<td>'+names[i]+'</td><td id=\"v'+i+'\">-</td><td>'+units[i]+'</td>';\n"
+"function draw(){var c=document.getElementById('chart'),g=c.getContext('2d'),w=c.width,h=c.height,top=1;\n"
+" g.clearRect(0,0,w,h);hist.forEach(function(s){for(var f=0;f<4;f++)if(s.v[f]>top)top=s.v[f];});\n"
+" g.fillStyle='#888';g.fillText(top.toFixed(1),2,10);\n"
+" for(var f=0;f<4;f++){g.strokeStyle=colors[f];g.beginPath();\n"
+"  hist.forEach(function(s,i){var x=i*w/max,y=h-s.v[f]*(h-12)/top;if(i)g.lineTo(x,y);else g.moveTo(x,y);});\n"
+"  g.stroke();g.fillStyle=colors[f];g.fillText(names[f],60+f*80,10);}}\n"
+"var es=new EventSource('events');\n"
+"es.onopen=function(){document.getElementById('state').textContent='';};\n"
+"es.onerror=function(){document.getElementById('state').textContent='reconnecting';};\n"
+"es.addEventListener('sample',function(e){var s=JSON.parse(e.data);\n"
+" document.getElementById('sensor').textContent=s.sensor;\n"
+" document.getElementById('pm').textContent=s.v[1].toFixed(1);\n"
+" document.getElementById('state').textContent=new Date(s.ts*1000).toLocaleTimeString()+(s.status?' status 0x'+s.status.toString(16):'');\n"
+" for(var i=0;i<names.length;i++)document.getElementById('v'+i).textContent=s.v[i].toFixed(i<4||i==9?2:1);\n"
+" hist.push(s);if(hist.length>max)hist.shift();draw();});\n"
+"</script></body></html>\n";
+
+SPShttp::SPShttp(void)
+{
+    _addr[0] = 0x0;
+    _sensor = 0;
+    _verbose = 0;
+    _fd = -1;
+    _wake[0] = _wake[1] = -1;
+    _ev = NULL;
+    _wpos = _last = 0;
+    _last_time = 0;
+    _cl = NULL;
+    _dir[0] = 0x0;
+    _hist = false;
+    _jput = _jrun = _jget = 0;
+    _hrunning = false;
+    _running = _stop = false;
+    memset(&_st, 0x0, sizeof(_st));
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_hcond, NULL);
+}
+
+/**
+ * @brief serve /api/history from a store
+ */
+void SPShttp::history(const char *dir)
+{
+    strncpy(_dir, dir, sizeof(_dir) - 1);
+}
+
+/**
+ * @brief start the web server
+ */
+int SPShttp::open(const char *addr, uint16_t sensor, int verbose)
+{
+    strncpy(_addr, addr, sizeof(_addr) - 1);
+    _sensor = sensor;
+    _verbose = verbose;
+
+    _ev = (char *) malloc(HTTP_EVENTS);
+    _cl = (struct http_client *) malloc(HTTP_MAX * sizeof(struct http_client));
+
+    if (_ev == NULL || _cl == NULL) {
+        printf("Web: out of memory\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    for (int i = 0; i < HTTP_MAX; i++) _cl[i].fd = -1;
+
+    if ((_fd = stream_listen(addr)) < 0) {
+        printf("Web: can not listen on %s\n", addr);
+        close();
+        return(STORE_ERROR);
+    }
+
+    if (pipe(_wake) != 0) {
+        printf("Web: can not create pipe\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    fcntl(_wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(_wake[1], F_SETFL, O_NONBLOCK);
+    fcntl(_fd, F_SETFL, O_NONBLOCK);
+
+    // the store may still be empty, the reader catches up with refresh()
+    if (_dir[0] != 0x0) _hist = _rd.open(_dir, sensor) == STORE_OK;
+
+    _last_time = time(NULL);
+    _stop = false;
+
+    if (_hist) {
+        if (pthread_create(&_hthread, NULL, hist_thread, this) != 0) {
+            printf("Web: can not start history queries\n");
+            close();
+            return(STORE_ERROR);
+        }
+
+        _hrunning = true;
+    }
+
+    if (pthread_create(&_thread, NULL, thread, this) != 0) {
+        printf("Web: can not start server\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    _running = true;
+
+    if (_verbose) printf("Web: dashboard on %s\n", addr);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add an event to the ring (lock is held)
+ */
+void SPShttp::put_event(const char *ev, int len)
+{
+    uint32_t off = _wpos % HTTP_EVENTS;
+    uint32_t first = (uint32_t) len < HTTP_EVENTS - off ? len : HTTP_EVENTS - off;
+
+    memcpy(_ev + off, ev, first);
+    if (first < (uint32_t) len) memcpy(_ev, ev + first, len - first);
+
+    _last = _wpos;
+    _wpos += len;
+    _last_time = time(NULL);
+}
+
+/**
+ * @brief encode a sample as an event for all viewers
+ */
+void SPShttp::sample(const struct sps_sample *s)
+{
+    char   ev[HTTP_EVENT_MAX];
+    struct timespec t0, t1;
+    int    len;
+
+    if (! _running) return;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    len = snprintf(ev, sizeof(ev), "event: sample\nid: %u\ndata: {\"ts\":%u,\"sensor\":%u,\"status\":%u,"
+        "\"quality\":%u,\"v\":[%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f]}\n\n",
+        s->ts, s->ts, s->sensor, s->flags & SPS_FLAG_STATUS, s->flags >> 8,
+        s->v.MassPM1, s->v.MassPM2, s->v.MassPM4, s->v.MassPM10,
+        s->v.NumPM0, s->v.NumPM1, s->v.NumPM2, s->v.NumPM4, s->v.NumPM10, s->v.PartSize);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    pthread_mutex_lock(&_lock);
+    put_event(ev, len);
+    _st.events++;
+    _st.encode_time += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    pthread_mutex_unlock(&_lock);
+
+    // wake the thread, a full pipe is awake already
+    if (write(_wake[1], "", 1) < 0) {}
+}
+
+/**
+ * @brief accept a connection
+ */
+void SPShttp::accept_client()
+{
+    struct http_client *c;
+    int fd, i;
+
+    if ((fd = accept4(_fd, NULL, NULL, SOCK_NONBLOCK)) < 0) return;
+
+    for (i = 0; i < HTTP_MAX; i++) {
+        if (_cl[i].fd < 0) break;
+    }
+
+    if (i == HTTP_MAX) {
+        ::close(fd);
+
+        pthread_mutex_lock(&_lock);
+        _st.refused++;
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+
+    c = &_cl[i];
+    c->fd = fd;
+    c->state = HTTP_REQUEST;
+    c->reqlen = 0;
+    c->hlen = c->hpos = 0;
+    c->body = c->own = NULL;
+    c->blen = c->bpos = 0;
+    c->epos = 0;
+}
+
+/**
+ * @brief prepare a reply, the connection is closed after it is sent
+ * @param own : body to free when done (or NULL)
+ */
+void SPShttp::reply(struct http_client *c, int code, const char *type, const char *body, size_t len, char *own)
+{
+    const char *reason;
+
+    switch (code) {
+    case 200: reason = "OK"; break;
+    case 400: reason = "Bad Request"; break;
+    case 404: reason = "Not Found"; break;
+    case 405: reason = "Method Not Allowed"; break;
+    case 503: reason = "Service Unavailable"; break;
+    default:  reason = "Internal Server Error"; break;
+    }
+
+    c->hlen = snprintf(c->hdr, sizeof(c->hdr), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n"
+        "Content-Length: %lu\r\nConnection: close\r\nAccess-Control-Allow-Origin: *\r\n\r\n",
+        code, reason, type, (unsigned long) len);
+    c->hpos = 0;
+    c->body = body;
+    c->blen = len;
+    c->bpos = 0;
+    c->own = own;
+    c->state = HTTP_REPLY;
+}
+
+/**
+ * @brief handle a request
+ */
+void SPShttp::route(struct http_client *c, const char *path, const char *query)
+{
+    if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0) {
+        reply(c, 200, "text/html; charset=utf-8", http_page, sizeof(http_page) - 1, NULL);
+        return;
+    }
+
+    if (strcmp(path, "/events") == 0) {
+        c->hlen = snprintf(c->hdr, sizeof(c->hdr), "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+            "Cache-Control: no-cache\r\nConnection: keep-alive\r\nAccess-Control-Allow-Origin: *\r\n\r\n"
+            "retry: %d\n\n", HTTP_RETRY);
+        c->hpos = 0;
+        c->state = HTTP_STREAM;
+
+        // start with the newest sample, so the values show at once
+        pthread_mutex_lock(&_lock);
+        c->epos = _last;
+        if (++_st.viewers > _st.viewers_max) _st.viewers_max = _st.viewers;
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+
+    if (strcmp(path, "/api/history") == 0 && _hist) {
+        struct http_job *j;
+        struct hist_par p;
+        const char *err;
+
+        if (hist_parse(query, &p, &err) != STORE_OK) {
+            reply(c, 400, "text/plain", err, strlen(err), NULL);
+            return;
+        }
+
+        pthread_mutex_lock(&_lock);
+
+        if (_jput - _jget == HTTP_HIST_QUEUE) {
+            _st.hist_busy++;
+            pthread_mutex_unlock(&_lock);
+            reply(c, 503, "text/plain", "busy, try again\n", 16, NULL);
+            return;
+        }
+
+        j = &_job[_jput++ % HTTP_HIST_QUEUE];
+        j->client = c - _cl;
+        j->p = p;
+        j->out = NULL;
+        pthread_cond_signal(&_hcond);
+        pthread_mutex_unlock(&_lock);
+
+        // not polled until history_done() has the reply
+        c->state = HTTP_HISTORY;
+        return;
+    }
+
+    reply(c, 404, "text/plain", "not found\n", 10, NULL);
+}
+
+/**
+ * @brief read the request of a connection
+ *
+ * @return false to close
+ */
+bool SPShttp::read_request(struct http_client *c)
+{
+    char method[8], path[HTTP_REQ], *q;
+    ssize_t r;
+
+    r = read(c->fd, c->req + c->reqlen, sizeof(c->req) - 1 - c->reqlen);
+
+    if (r <= 0) return(r < 0 && (errno == EAGAIN || errno == EINTR));
+
+    c->reqlen += r;
+    c->req[c->reqlen] = 0x0;
+
+    // only the request line and the end of the headers matter
+    if (strstr(c->req, "\r\n\r\n") == NULL && strstr(c->req, "\n\n") == NULL) {
+        if (c->reqlen < sizeof(c->req) - 1) return(true);
+
+        reply(c, 400, "text/plain", "request too long\n", 17, NULL);
+        return(true);
+    }
+
+    pthread_mutex_lock(&_lock);
+    _st.requests++;
+    pthread_mutex_unlock(&_lock);
+
+    if (sscanf(c->req, "%7s %1023s", method, path) != 2) {
+        reply(c, 400, "text/plain", "bad request\n", 12, NULL);
+        return(true);
+    }
+
+    if (strcmp(method, "GET") != 0) {
+        reply(c, 405, "text/plain", "only GET\n", 9, NULL);
+        return(true);
+    }
+
+    if (_verbose > 1) printf("Web: GET %s\n", path);
+
+    if ((q = strchr(path, '?')) != NULL) *q++ = 0x0;
+
+    route(c, path, q ? q : "");
+    return(true);
+}
+
+/**
+ * @brief send (part of) a reply
+ *
+ * @return false when done or on error: close
+ */
+bool SPShttp::send_reply(struct http_client *c)
+{
+    ssize_t r;
+
+    if (c->hpos < c->hlen) {
+        if ((r = send(c->fd, c->hdr + c->hpos, c->hlen - c->hpos, MSG_NOSIGNAL | MSG_DONTWAIT)) < 0)
+            return(errno == EAGAIN || errno == EINTR);
+
+        c->hpos += r;
+        if (c->hpos < c->hlen) return(true);
+    }
+
+    if (c->bpos < c->blen) {
+        if ((r = send(c->fd, c->body + c->bpos, c->blen - c->bpos, MSG_NOSIGNAL | MSG_DONTWAIT)) < 0)
+            return(errno == EAGAIN || errno == EINTR);
+
+        c->bpos += r;
+
+        pthread_mutex_lock(&_lock);
+        _st.bytes += r;
+        pthread_mutex_unlock(&_lock);
+
+        if (c->bpos < c->blen) return(true);
+    }
+
+    return(false);
+}
+
+/**
+ * @brief send waiting events from the ring
+ *
+ * @return false on error or when the viewer fell behind: close
+ */
+bool SPShttp::send_events(struct http_client *c)
+{
+    uint64_t w, w2;
+    uint32_t off, n;
+    ssize_t  r;
+
+    if (c->hpos < c->hlen) {
+        if ((r = send(c->fd, c->hdr + c->hpos, c->hlen - c->hpos, MSG_NOSIGNAL | MSG_DONTWAIT)) < 0)
+            return(errno == EAGAIN || errno == EINTR);
+
+        c->hpos += r;
+        if (c->hpos < c->hlen) return(true);
+    }
+
+    pthread_mutex_lock(&_lock);
+    w = _wpos;
+    pthread_mutex_unlock(&_lock);
+
+    while (c->epos < w) {
+
+        if (w - c->epos > HTTP_EVENTS) break;
+
+        off = c->epos % HTTP_EVENTS;
+        n = w - c->epos < HTTP_EVENTS - off ? w - c->epos : HTTP_EVENTS - off;
+
+        if ((r = send(c->fd, _ev + off, n, MSG_NOSIGNAL | MSG_DONTWAIT)) < 0)
+            return(errno == EAGAIN || errno == EINTR);
+
+        // the part sent may have been overwritten meanwhile
+        pthread_mutex_lock(&_lock);
+        w2 = _wpos;
+        _st.bytes += r;
+        pthread_mutex_unlock(&_lock);
+
+        if (w2 - c->epos > HTTP_EVENTS) break;
+
+        c->epos += r;
+        if ((uint32_t) r < n) return(true);
+    }
+
+    if (c->epos < w) {
+        pthread_mutex_lock(&_lock);
+        _st.slow++;
+        pthread_mutex_unlock(&_lock);
+
+        if (_verbose) printf("Web: viewer %d fell behind, closed\n", c->fd);
+        return(false);
+    }
+
+    return(true);
+}
+
+/**
+ * @brief close a connection
+ */
+void SPShttp::drop(struct http_client *c)
+{
+    if (c->state == HTTP_STREAM) {
+        pthread_mutex_lock(&_lock);
+        _st.viewers--;
+        pthread_mutex_unlock(&_lock);
+    }
+
+    free(c->own);
+    c->own = NULL;
+
+    ::close(c->fd);
+    c->fd = -1;
+}
+
+/**
+ * @brief reply to the history queries that are done
+ */
+void SPShttp::history_done()
+{
+    struct http_job *j;
+
+    pthread_mutex_lock(&_lock);
+
+    while (_jget != _jrun) {
+        j = &_job[_jget++ % HTTP_HIST_QUEUE];
+
+        if (j->ret != STORE_OK)
+            reply(&_cl[j->client], 500, "text/plain", "out of memory\n", 14, NULL);
+        else
+            reply(&_cl[j->client], 200, j->p.binary ? "application/octet-stream" : "application/json",
+                j->out, j->len, j->out);
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief the history thread : runs the queries in order
+ */
+void *SPShttp::hist_thread(void *arg)
+{
+    SPShttp *me = (SPShttp *) arg;
+    struct http_job *j;
+    struct timespec t0, t1;
+    sigset_t set;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_mutex_lock(&me->_lock);
+
+    while (! me->_stop) {
+
+        if (me->_jrun == me->_jput) {
+            pthread_cond_wait(&me->_hcond, &me->_lock);
+            continue;
+        }
+
+        // the job is not touched by the poll thread until it is done
+        j = &me->_job[me->_jrun % HTTP_HIST_QUEUE];
+        pthread_mutex_unlock(&me->_lock);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        j->ret = hist_run(&me->_rd, me->_dir, me->_sensor, &j->p, &j->out, &j->len);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        pthread_mutex_lock(&me->_lock);
+        me->_jrun++;
+        me->_st.hist++;
+        me->_st.hist_time += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+        // the poll thread sends the reply
+        if (write(me->_wake[1], "", 1) < 0) {}
+    }
+
+    pthread_mutex_unlock(&me->_lock);
+    return(NULL);
+}
+
+/**
+ * @brief the background thread : accepts connections, answers requests
+ * and sends the events
+ */
+void *SPShttp::thread(void *arg)
+{
+    SPShttp *me = (SPShttp *) arg;
+    struct pollfd pf[HTTP_MAX + 2];
+    struct http_client *c;
+    int    idx[HTTP_MAX + 2], n;
+    char   tmp[256];
+    sigset_t set;
+    uint64_t w;
+    ssize_t r;
+    bool   keep;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    while (! me->_stop) {
+
+        // the connections of finished history queries get their reply
+        me->history_done();
+
+        pthread_mutex_lock(&me->_lock);
+
+        // keep idle event streams open
+        if (me->_st.viewers > 0 && time(NULL) - me->_last_time >= HTTP_PING)
+            me->put_event(": ping\n\n", 8);
+
+        w = me->_wpos;
+        pthread_mutex_unlock(&me->_lock);
+
+        pf[0].fd = me->_wake[0];
+        pf[0].events = POLLIN;
+        pf[1].fd = me->_fd;
+        pf[1].events = POLLIN;
+        n = 2;
+
+        for (int i = 0; i < HTTP_MAX; i++) {
+            c = &me->_cl[i];
+            if (c->fd < 0 || c->state == HTTP_HISTORY) continue;
+
+            pf[n].fd = c->fd;
+
+            switch (c->state) {
+            case HTTP_REQUEST: pf[n].events = POLLIN; break;
+            case HTTP_REPLY:   pf[n].events = POLLOUT; break;
+            default:
+                pf[n].events = POLLIN;
+                if (c->hpos < c->hlen || c->epos < w) pf[n].events |= POLLOUT;
+                break;
+            }
+
+            idx[n++] = i;
+        }
+
+        if (poll(pf, n, 1000) <= 0) continue;
+
+        if (pf[0].revents) while (read(me->_wake[0], tmp, sizeof(tmp)) > 0);
+
+        if (pf[1].revents) me->accept_client();
+
+        for (int k = 2; k < n; k++) {
+            c = &me->_cl[idx[k]];
+
+            if (pf[k].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                me->drop(c);
+                continue;
+            }
+
+            keep = true;
+
+            if (pf[k].revents & POLLIN) {
+                if (c->state == HTTP_REQUEST) keep = me->read_request(c);
+
+                // a viewer sends nothing more, this is the end
+                else if ((r = read(c->fd, tmp, sizeof(tmp))) == 0) keep = false;
+                else if (r < 0 && errno != EAGAIN && errno != EINTR) keep = false;
+            }
+
+            // try to send at once, most replies fit in the socket buffer
+            if (keep && c->state == HTTP_REPLY) keep = me->send_reply(c);
+            else if (keep && c->state == HTTP_STREAM && (pf[k].revents & POLLOUT)) keep = me->send_events(c);
+
+            if (! keep) me->drop(c);
+        }
+    }
+
+    return(NULL);
+}
+
+/**
+ * @brief stop the web server
+ */
+void SPShttp::close()
+{
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_signal(&_hcond);
+    pthread_mutex_unlock(&_lock);
+
+    if (_running) {
+        if (write(_wake[1], "", 1) < 0) {}
+        pthread_join(_thread, NULL);
+        _running = false;
+    }
+
+    // a query that runs is finished first
+    if (_hrunning) {
+        pthread_join(_hthread, NULL);
+        _hrunning = false;
+    }
+
+    // replies of queries done, but not sent
+    for (; _jget != _jrun; _jget++) free(_job[_jget % HTTP_HIST_QUEUE].out);
+    _jput = _jrun = _jget = 0;
+
+    if (_cl) {
+        for (int i = 0; i < HTTP_MAX; i++) {
+            if (_cl[i].fd > -1) drop(&_cl[i]);
+        }
+    }
+
+    if (_fd > -1) {
+        ::close(_fd);
+
+        // remove a Unix socket
+        if (_addr[0] == '/' || strncmp(_addr, "unix:", 5) == 0)
+            unlink(_addr[0] == '/' ? _addr : _addr + 5);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (_wake[i] > -1) ::close(_wake[i]);
+        _wake[i] = -1;
+    }
+
+    _fd = -1;
+
+    free(_ev);
+    free(_cl);
+    _ev = NULL;
+    _cl = NULL;
+
+    if (_hist) _rd.close();
+    _hist = false;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPShttp::stats(struct http_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    pthread_mutex_unlock(&_lock);
+}
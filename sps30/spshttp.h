@@ -0,0 +1,192 @@
+/**
+ * SPS30 web server header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * A small web server in the monitor (option -W), so many people can
+ * watch the readings without each running sps30 against the sensor:
+ *
+ *  GET /           dashboard (HTML and JavaScript, built in)
+ *  GET /events     server-sent events, one 'sample' event per sample
+ *  GET /api/history
+ *                  a time range of the store, downsampled for a chart
+ *                  (see spshist.h), when sps30 also stores (-o)
+ *
+ * Each sample is encoded once, as JSON in an SSE event, into a ring
+ * of bytes that all viewers share. A viewer only has its position in
+ * the ring: sending is a send() from the ring, there is no copy or
+ * encoding per viewer. A viewer that falls more than HTTP_EVENTS
+ * bytes behind is disconnected; the browser reconnects by itself
+ * after the 'retry' time. When there are no samples a comment is
+ * sent every HTTP_PING seconds to keep proxies from closing the
+ * connection.
+ *
+ * One thread serves all connections with poll(), other requests are
+ * answered and closed (no keep-alive). A history query reads the
+ * store, which can take long for a raw range, so it runs on a second
+ * thread: the connection waits without being polled and the events
+ * keep flowing. At most HTTP_HIST_QUEUE queries wait or run, more are
+ * answered with 503.
+ *********************************************************************
+*/
+#ifndef SPSHTTP_H
+#define SPSHTTP_H
+
+# include <pthread.h>
+# include "spsstore.h"
+# include "spshist.h"
+
+#define HTTP_PORT           "8030"
+#define HTTP_MAX            512             // connections
+#define HTTP_REQ            1024            // longest request
+#define HTTP_EVENTS         65536           // bytes in the event ring
+#define HTTP_EVENT_MAX      512             // longest event
+#define HTTP_PING           15              // seconds between keep alives
+#define HTTP_RETRY          3000            // ms before a browser reconnects
+#define HTTP_HIST_QUEUE     8               // history queries waiting or running
+
+/* statistics of the web server */
+struct http_stats
+{
+    uint64_t requests;      // requests answered
+    uint64_t events;        // events encoded
+    uint64_t bytes;         // bytes sent
+    uint32_t viewers;       // event streams now
+    uint32_t viewers_max;   // most event streams at once
+    uint32_t slow;          // viewers disconnected for falling behind
+    uint32_t refused;       // connections refused (too many)
+    uint32_t hist;          // history queries answered
+    uint32_t hist_busy;     // history queries refused (queue full)
+    double   hist_time;     // seconds spent in history queries
+    double   encode_time;   // seconds spent in sample()
+};
+
+/* state of a connection */
+#define HTTP_REQUEST        0               // reading the request
+#define HTTP_REPLY          1               // sending a reply, then close
+#define HTTP_STREAM         2               // sending events
+#define HTTP_HISTORY        3               // history query on its thread
+
+/* a connection */
+struct http_client
+{
+    int      fd;                    // -1 = free
+    int      state;
+    char     req[HTTP_REQ];
+    uint32_t reqlen;
+    char     hdr[512];              // reply header (or event preamble)
+    uint32_t hlen, hpos;
+    const char *body;               // reply body
+    size_t   blen, bpos;
+    char     *own;                  // body to free when done (or NULL)
+    uint64_t epos;                  // next byte of the event ring
+};
+
+/* a history query */
+struct http_job
+{
+    int      client;                // index in the connections
+    struct hist_par p;
+    int      ret;                   // of hist_run()
+    char     *out;                  // reply (malloc'ed)
+    size_t   len;
+};
+
+class SPShttp
+{
+  public:
+
+    SPShttp(void);
+
+    /**
+     * @brief start the web server
+     * @param addr    : [host]:port, unix:/path or /path
+     * @param sensor  : sensor id (shown on the dashboard)
+     * @param verbose : if > 0 requests are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *addr, uint16_t sensor, int verbose);
+
+    /**
+     * @brief serve /api/history from a store, call before open()
+     * @param dir : store directory
+     */
+    void history(const char *dir);
+
+    /**
+     * @brief encode a sample as an event for all viewers
+     */
+    void sample(const struct sps_sample *s);
+
+    /**
+     * @brief stop the web server, all connections are closed
+     */
+    void close();
+
+    bool is_open() {return(_running);}
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct http_stats *st);
+
+  private:
+    char     _addr[256];
+    uint16_t _sensor;
+    int      _verbose;
+    int      _fd;                   // listening socket
+    int      _wake[2];              // pipe to wake the thread
+
+    char     *_ev;                  // event ring, HTTP_EVENTS bytes
+    uint64_t _wpos;                 // bytes written to the ring
+    uint64_t _last;                 // start of the newest event
+    time_t   _last_time;            // time of the newest event
+
+    struct http_client *_cl;        // HTTP_MAX
+
+    char     _dir[256];             // store for /api/history (empty = none)
+    SPSread  _rd;                   // only used by the history thread
+    bool     _hist;                 // _rd is open
+
+    /* history queries in order, ring of HTTP_HIST_QUEUE (lock is held):
+     * [_jget, _jrun) are done, [_jrun, _jput) wait or run */
+    struct http_job _job[HTTP_HIST_QUEUE];
+    uint32_t _jput, _jrun, _jget;
+    bool     _hrunning;
+    pthread_t _hthread;
+    pthread_cond_t _hcond;
+
+    struct http_stats _st;
+    bool     _running;
+    bool     _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+
+    void put_event(const char *ev, int len);
+    void accept_client();
+    bool read_request(struct http_client *c);
+    void route(struct http_client *c, const char *path, const char *query);
+    void reply(struct http_client *c, int code, const char *type, const char *body, size_t len, char *own);
+    bool send_reply(struct http_client *c);
+    bool send_events(struct http_client *c);
+    void drop(struct http_client *c);
+    void history_done();
+    static void *thread(void *arg);
+    static void *hist_thread(void *arg);
+};
+
+#endif /* SPSHTTP_H */
@@ -0,0 +1,534 @@
+/**
+ * SPS30 InfluxDB line protocol exporter for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsinflux.h
+ *
+ * A batch that failed is sent again as a whole. InfluxDB keeps one point
+ * per measurement, tag set and timestamp, so lines that arrive twice do
+ * no harm.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include "spsinflux.h"
+
+/* bits of the status register, as SPS_status in sps30lib.h */
+#define INFLUX_SPEED_ERROR  0x01
+#define INFLUX_LASER_ERROR  0x02
+#define INFLUX_FAN_ERROR    0x04
+
+/**
+ * @brief add an unsigned number
+ */
+static char *put_uint(char *p, uint64_t v)
+{
+    char tmp[20];
+    int  n = 0;
+
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (n) *p++ = tmp[--n];
+
+    return(p);
+}
+
+/**
+ * @brief add a float with at most 4 decimals (as %.4f without the
+ * trailing zeros)
+ *
+ * @return end of the number or NULL if it is not finite
+ */
+static char *put_float(char *p, float v)
+{
+    double d = v;
+    uint64_t sc;
+    uint32_t fr;
+    int n;
+
+    if (! (fabs(d) < 1e14)) return(NULL);
+
+    if (d < 0) {
+        *p++ = '-';
+        d = -d;
+    }
+
+    sc = (uint64_t) (d * 10000 + 0.5);
+    p = put_uint(p, sc / 10000);
+
+    if ((fr = sc % 10000) != 0) {
+        *p++ = '.';
+
+        for (n = 4; fr % 10 == 0; n--) fr /= 10;
+
+        for (int i = n - 1; i >= 0; i--) {
+            p[i] = '0' + fr % 10;
+            fr /= 10;
+        }
+        p += n;
+    }
+
+    return(p);
+}
+
+/**
+ * @brief add a string
+ */
+static char *put_str(char *p, const char *s)
+{
+    while (*s) *p++ = *s++;
+    return(p);
+}
+
+/**
+ * @brief add a tag key=value, escaping comma, space and equal sign
+ */
+static char *put_tag(char *p, char *end, const char *key, const char *value)
+{
+    if (value == NULL || *value == 0x0) return(p);
+
+    if (p + strlen(key) + 2 * strlen(value) + 2 >= end) {
+        printf("Influx: the %s tag is too long, left out\n", key);
+        return(p);
+    }
+
+    *p++ = ',';
+    p = put_str(p, key);
+    *p++ = '=';
+
+    for (; *value; value++) {
+        if (*value == ',' || *value == ' ' || *value == '=') *p++ = '\\';
+        *p++ = *value;
+    }
+
+    return(p);
+}
+
+/**
+ * @brief format a sample as a line
+ */
+int influx_line(char *buf, const char *prefix, int plen, const struct sps_sample *s)
+{
+    char *p = buf, *q;
+    int status = s->flags & SPS_FLAG_STATUS;
+    bool first = true;
+
+    memcpy(p, prefix, plen);
+    p += plen;
+    *p++ = ' ';
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        q = p;
+
+        if (! first) *q++ = ',';
+        q = put_str(q, sps_field_name[i]);
+        *q++ = '=';
+
+        // a NaN or infinity is left out, line protocol has no value for it
+        if ((q = put_float(q, sps_field(&s->v, i))) == NULL) continue;
+
+        p = q;
+        first = false;
+    }
+
+    if (! first) *p++ = ',';
+    p = put_str(p, "status=");
+    p = put_uint(p, status);
+    p = put_str(p, status & INFLUX_SPEED_ERROR ? "i,speed=true" : "i,speed=false");
+    p = put_str(p, status & INFLUX_LASER_ERROR ? ",laser=true" : ",laser=false");
+    p = put_str(p, status & INFLUX_FAN_ERROR ? ",fan=true" : ",fan=false");
+    p = put_str(p, ",quality=");
+    p = put_uint(p, s->flags >> 8);
+    p = put_str(p, "i ");
+
+    // nanoseconds
+    p = put_uint(p, s->ts);
+    p = put_str(p, "000000000\n");
+
+    return(p - buf);
+}
+
+SPSinflux::SPSinflux(void)
+{
+    _host[0] = _port[0] = 0x0;
+    _tcp = false;
+    _prefix[0] = 0x0;
+    _plen = 0;
+    _site[0] = _serial[0] = _firmware[0] = 0x0;
+    _flush = INFLUX_FLUSH;
+    _verbose = 0;
+    _fd = -1;
+    _retry = INFLUX_RETRY_MIN;
+    _buf = NULL;
+    _head = _tail = _sealed = 0;
+    _running = _stop = false;
+    memset(&_st, 0x0, sizeof(_st));
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+}
+
+/**
+ * @brief tags and batching
+ */
+void SPSinflux::policy(const char *site, const char *serial, const char *firmware, uint32_t flush)
+{
+    if (site) strncpy(_site, site, sizeof(_site) - 1);
+    if (serial) strncpy(_serial, serial, sizeof(_serial) - 1);
+    if (firmware) strncpy(_firmware, firmware, sizeof(_firmware) - 1);
+
+    _flush = flush > 0 ? flush : INFLUX_FLUSH;
+}
+
+/**
+ * @brief start the exporter
+ */
+int SPSinflux::open(const char *url, uint16_t sensor, int verbose)
+{
+    char  id[8], *p, *end = _prefix + sizeof(_prefix);
+    const char *u = url;
+
+    if (strncmp(u, "tcp://", 6) == 0) {
+        _tcp = true;
+        u += 6;
+    }
+    else if (strncmp(u, "udp://", 6) == 0) u += 6;
+
+    strncpy(_host, u, sizeof(_host) - 1);
+
+    if ((p = strrchr(_host, ':')) != NULL) {
+        *p++ = 0x0;
+        strncpy(_port, p, sizeof(_port) - 1);
+    }
+    else strcpy(_port, _tcp ? "8094" : "8089");
+
+    _verbose = verbose;
+
+    // measurement and tags are the same on each line
+    snprintf(id, sizeof(id), "%u", sensor);
+
+    p = put_str(_prefix, INFLUX_MEASUREMENT);
+    p = put_tag(p, end, "sensor", id);
+    p = put_tag(p, end, "serial", _serial);
+    p = put_tag(p, end, "site", _site);
+    p = put_tag(p, end, "firmware", _firmware);
+    _plen = p - _prefix;
+
+    if ((_buf = (struct influx_buf *) calloc(INFLUX_BUFFERS, sizeof(struct influx_buf))) == NULL) {
+        printf("Influx: out of memory\n");
+        return(STORE_ERROR);
+    }
+
+    // UDP does not connect, so errors in the address show here
+    if (! _tcp && connect_receiver() != STORE_OK) {
+        printf("Influx: can not use %s:%s\n", _host, _port);
+        close();
+        return(STORE_ERROR);
+    }
+
+    _stop = false;
+
+    if (pthread_create(&_thread, NULL, thread, this) != 0) {
+        printf("Influx: can not start exporter\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    _running = true;
+    return(STORE_OK);
+}
+
+/**
+ * @brief the batch being filled is ready to send (lock held)
+ */
+void SPSinflux::seal()
+{
+    if (_buf[_head].lines == 0 || _sealed >= INFLUX_BUFFERS - 1) return;
+
+    _head = (_head + 1) % INFLUX_BUFFERS;
+    _sealed++;
+
+    _buf[_head].len = 0;
+    _buf[_head].lines = 0;
+
+    pthread_cond_signal(&_cond);
+}
+
+/**
+ * @brief add a sample to the batch
+ */
+int SPSinflux::sample(const struct sps_sample *s)
+{
+    struct influx_buf *b;
+    struct timespec t0, t1;
+    int    ret = STORE_OK;
+
+    if (! _running) return(STORE_ERROR);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_mutex_lock(&_lock);
+
+    b = &_buf[_head];
+
+    if (b->len + INFLUX_LINE_MAX > INFLUX_BATCH) {
+        seal();
+        b = &_buf[_head];
+    }
+
+    // all buffers full: the receiver is slow or away
+    if (b->len + INFLUX_LINE_MAX > INFLUX_BATCH) {
+        _st.dropped++;
+        ret = STORE_ERROR;
+    }
+    else {
+        if (b->lines == 0) b->first = t0;
+
+        b->len += influx_line(b->data + b->len, _prefix, _plen, s);
+        b->lines++;
+        _st.lines++;
+
+        if (b->lines == 1) pthread_cond_signal(&_cond);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    _st.format_time += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    pthread_mutex_unlock(&_lock);
+    return(ret);
+}
+
+/**
+ * @brief create the socket (UDP) or connect (TCP)
+ */
+int SPSinflux::connect_receiver()
+{
+    struct addrinfo hints, *res, *ai;
+    struct timeval tv;
+
+    memset(&hints, 0x0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = _tcp ? SOCK_STREAM : SOCK_DGRAM;
+
+    if (getaddrinfo(_host, _port, &hints, &res) != 0) return(STORE_ERROR);
+
+    // a slow receiver blocks the thread, not sample()
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) continue;
+
+        setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        if (connect(_fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+
+        ::close(_fd);
+        _fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if (_fd < 0) return(STORE_ERROR);
+
+    if (_verbose && _tcp) printf("Influx: connected to %s:%s\n", _host, _port);
+    return(STORE_OK);
+}
+
+/**
+ * @brief send a batch, with UDP in datagrams ending on a line
+ */
+int SPSinflux::send_batch(struct influx_buf *b)
+{
+    size_t  pos = 0, len;
+    ssize_t r;
+
+    if (_fd < 0 && connect_receiver() != STORE_OK) return(STORE_ERROR);
+
+    while (pos < b->len) {
+        len = b->len - pos;
+
+        if (! _tcp && len > INFLUX_UDP_MAX) {
+            len = INFLUX_UDP_MAX;
+            while (len > 0 && b->data[pos + len - 1] != '\n') len--;
+            if (len == 0) len = (const char *) memchr(b->data + pos, '\n', b->len - pos) - (b->data + pos) + 1;
+        }
+
+        if ((r = send(_fd, b->data + pos, len, MSG_NOSIGNAL)) < 0) {
+            if (errno == EINTR) continue;
+
+            if (_verbose) printf("Influx: can not send to %s:%s (%s)\n", _host, _port, strerror(errno));
+
+            // UDP keeps the socket, ECONNREFUSED is only a notice
+            if (_tcp) {
+                ::close(_fd);
+                _fd = -1;
+            }
+            return(STORE_ERROR);
+        }
+
+        pos += r;
+        _st.packets++;
+    }
+
+    _st.bytes += b->len;
+    return(STORE_OK);
+}
+
+/**
+ * @brief the background thread : sends the sealed batches
+ */
+void *SPSinflux::thread(void *arg)
+{
+    SPSinflux *me = (SPSinflux *) arg;
+    struct influx_buf *b;
+    struct timespec now, ts;
+    sigset_t set;
+    int     ret;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_mutex_lock(&me->_lock);
+
+    while (! me->_stop) {
+
+        // seal the batch being filled when it is old enough
+        if (me->_sealed == 0) {
+            b = &me->_buf[me->_head];
+
+            if (b->lines == 0) {
+                pthread_cond_wait(&me->_cond, &me->_lock);
+                continue;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            if ((now.tv_sec - b->first.tv_sec) * 1000 + (now.tv_nsec - b->first.tv_nsec) / 1000000 < me->_flush) {
+                // the condition uses CLOCK_REALTIME
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += 100 * 1000000;
+                if (ts.tv_nsec >= 1000000000) {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000000000;
+                }
+                pthread_cond_timedwait(&me->_cond, &me->_lock, &ts);
+                continue;
+            }
+
+            me->seal();
+        }
+
+        b = &me->_buf[me->_tail];
+
+        pthread_mutex_unlock(&me->_lock);
+        ret = me->send_batch(b);
+        pthread_mutex_lock(&me->_lock);
+
+        if (ret == STORE_OK) {
+            me->_st.sent += b->lines;
+            me->_st.batches++;
+            me->_tail = (me->_tail + 1) % INFLUX_BUFFERS;
+            me->_sealed--;
+            me->_retry = INFLUX_RETRY_MIN;
+            continue;
+        }
+
+        // try again later, the batches wait
+        me->_st.retries++;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += me->_retry;
+
+        while (! me->_stop) {
+            if (pthread_cond_timedwait(&me->_cond, &me->_lock, &ts) != 0) break;
+        }
+
+        if ((me->_retry *= 2) > INFLUX_RETRY_MAX) me->_retry = INFLUX_RETRY_MAX;
+    }
+
+    pthread_mutex_unlock(&me->_lock);
+    return(NULL);
+}
+
+/**
+ * @brief stop the exporter
+ */
+void SPSinflux::close()
+{
+    struct influx_buf *b;
+
+    if (_running) {
+        pthread_mutex_lock(&_lock);
+        _stop = true;
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_lock);
+
+        pthread_join(_thread, NULL);
+        _running = false;
+
+        // one try for what is waiting, the rest is lost
+        seal();
+
+        while (_sealed > 0) {
+            b = &_buf[_tail];
+
+            if (send_batch(b) == STORE_OK) {
+                _st.sent += b->lines;
+                _st.batches++;
+            }
+            else _st.dropped += b->lines;
+
+            _tail = (_tail + 1) % INFLUX_BUFFERS;
+            _sealed--;
+            seal();
+        }
+
+        _st.dropped += _buf[_head].lines;
+    }
+
+    if (_fd > -1) ::close(_fd);
+    _fd = -1;
+
+    free(_buf);
+    _buf = NULL;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSinflux::stats(struct influx_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,173 @@
+/**
+ * SPS30 InfluxDB line protocol exporter header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Sends each sample as a line of InfluxDB line protocol:
+ *
+ *  sps30,sensor=1,serial=...,site=lab,firmware=2.2 MassPM1=10.83,...,
+ *      PartSize=0.52,status=0i,speed=false,laser=false,fan=false,
+ *      quality=0i <ns>
+ *
+ * quality is the upper byte of the flags (SPS_FLAG_xxx >> 8).
+ *
+ * to udp://host:port (e.g. the UDP listener of InfluxDB 1.x) or
+ * tcp://host:port (e.g. the socket_listener of Telegraf). For a test a
+ * local listener will do:
+ *
+ *  nc -lu 8089         or      nc -lk 8094
+ *
+ * Lines are formatted without printf or allocation into a batch
+ * buffer. A line is at most INFLUX_LINE_MAX bytes: the fields of the
+ * widest values (+-1e14 with 4 decimals) take up to INFLUX_FIELDS_MAX,
+ * a tag that does not fit in INFLUX_PREFIX_MAX is left out. A batch is sent when it is full or INFLUX_FLUSH ms old. With
+ * UDP a batch is split in datagrams of up to INFLUX_UDP_MAX bytes.
+ *
+ * Up to INFLUX_BUFFERS batches wait while the receiver is slow or away,
+ * a send that fails is retried with a growing delay. When all buffers
+ * are full sample() refuses new lines (backpressure), which are
+ * counted as dropped.
+ *********************************************************************
+*/
+#ifndef SPSINFLUX_H
+#define SPSINFLUX_H
+
+# include <pthread.h>
+# include "spsstore.h"
+
+#define INFLUX_MEASUREMENT  "sps30"
+#define INFLUX_BATCH        16384           // bytes in a batch
+#define INFLUX_BUFFERS      8               // batches waiting
+#define INFLUX_FLUSH        1000            // ms before a batch is sent
+#define INFLUX_UDP_MAX      1400            // bytes in a datagram
+#define INFLUX_FIELDS_MAX   384             // longest fields and timestamp
+#define INFLUX_PREFIX_MAX   256             // longest measurement and tags
+#define INFLUX_LINE_MAX     (INFLUX_PREFIX_MAX + INFLUX_FIELDS_MAX)
+#define INFLUX_RETRY_MIN    1               // seconds, doubled up to
+#define INFLUX_RETRY_MAX    30
+
+/* statistics of the exporter */
+struct influx_stats
+{
+    uint64_t lines;         // lines formatted
+    uint64_t sent;          // lines sent
+    uint64_t bytes;         // bytes sent
+    uint64_t dropped;       // lines refused or not sent at close
+    uint32_t batches;       // batches sent
+    uint32_t packets;       // datagrams or send() calls
+    uint32_t retries;       // failed sends
+    double   format_time;   // seconds spent in sample()
+};
+
+/* a batch of lines */
+struct influx_buf
+{
+    char     data[INFLUX_BATCH];
+    size_t   len;
+    uint32_t lines;
+    struct timespec first;  // time of the first line
+};
+
+/**
+ * @brief format a sample as a line
+ * @param buf    : at least INFLUX_LINE_MAX bytes
+ * @param prefix : measurement and tags
+ * @param plen   : length of prefix, less than INFLUX_PREFIX_MAX
+ *
+ * @return length of the line (ends with a newline)
+ */
+int influx_line(char *buf, const char *prefix, int plen, const struct sps_sample *s);
+
+class SPSinflux
+{
+  public:
+
+    SPSinflux(void);
+
+    /**
+     * @brief tags and batching, call before open()
+     * @param site     : site tag (NULL = none)
+     * @param serial   : serial number tag (NULL = none)
+     * @param firmware : firmware tag (NULL = none)
+     * @param flush    : ms before a batch is sent (0 = INFLUX_FLUSH)
+     */
+    void policy(const char *site, const char *serial, const char *firmware, uint32_t flush);
+
+    /**
+     * @brief start the exporter
+     * @param url     : udp://host:port or tcp://host:port
+     * @param sensor  : sensor id (tag)
+     * @param verbose : if > 0 connect messages are displayed
+     *
+     * @return
+     *  STORE_OK success (also if a TCP receiver can not be reached yet)
+     *  STORE_ERROR error
+     */
+    int open(const char *url, uint16_t sensor, int verbose);
+
+    /**
+     * @brief add a sample to the batch
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR all buffers are full, the line is dropped
+     */
+    int sample(const struct sps_sample *s);
+
+    /**
+     * @brief stop the exporter, send what is waiting (one try)
+     */
+    void close();
+
+    bool is_open() {return(_running);}
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct influx_stats *st);
+
+  private:
+    char     _host[256];
+    char     _port[8];
+    bool     _tcp;
+    char     _prefix[INFLUX_PREFIX_MAX];    // measurement and tags
+    int      _plen;
+    char     _site[64];
+    char     _serial[64];
+    char     _firmware[16];
+    uint32_t _flush;
+    int      _verbose;
+
+    int      _fd;                   // socket, -1 if not connected
+    uint32_t _retry;                // seconds before the next try
+
+    struct influx_buf *_buf;        // INFLUX_BUFFERS
+    uint32_t _head;                 // being filled
+    uint32_t _tail;                 // next to send
+    uint32_t _sealed;               // batches waiting
+
+    struct influx_stats _st;
+    bool     _running;
+    bool     _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t  _cond;
+
+    void seal();
+    int  connect_receiver();
+    int  send_batch(struct influx_buf *b);
+    static void *thread(void *arg);
+};
+
+#endif /* SPSINFLUX_H */
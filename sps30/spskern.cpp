@@ -0,0 +1,743 @@
+/**
+ * SPS30 aggregation kernels for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spskern.h
+ *
+ * The x86 versions are compiled with a target attribute per function,
+ * so no special compiler flags are needed and the AVX2 version is only
+ * called after checking the CPU.
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <float.h>
+#include "spskern.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# define KERN_X86
+# include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define KERN_NEON
+# include <arm_neon.h>
+#endif
+
+/**
+ * @brief reset a masked aggregate
+ */
+void kern_agg_init(struct kern_agg *agg)
+{
+    agg->count = 0;
+    agg->sum = 0;
+    agg->min = FLT_MAX;
+    agg->max = -FLT_MAX;
+}
+
+/**
+ * @brief bin of a value, the same in all versions: a NaN is in the
+ * first bin, like max(f, 0) of SSE2 / AVX2 and the conversion of NEON
+ */
+static inline int hist_bin(float x, float lo, float inv, int nbins)
+{
+    float f = (x - lo) * inv;
+
+    // also true for NaN, the cast of which is undefined
+    if (! (f >= 0)) f = 0;
+    if (f > nbins - 1) f = nbins - 1;
+
+    return((int) f);
+}
+
+/**
+ * @brief histogram of 4 bins at a time computed by a vector version.
+ *
+ * Measurements change slowly, so the same bin is incremented in a row
+ * and every increment waits for the previous one. Up to KERN_HIST_BINS
+ * bins each lane uses its own copy of the histogram to avoid that.
+ */
+#define KERN_HIST_BINS 256
+
+struct hist_sub
+{
+    uint32_t *bins;
+    int      nbins;
+    uint32_t sub[4][KERN_HIST_BINS];
+};
+
+static inline void hist_init(struct hist_sub *h, uint32_t *bins, int nbins)
+{
+    h->bins = bins;
+    h->nbins = nbins;
+    if (nbins <= KERN_HIST_BINS) memset(h->sub, 0x0, sizeof(uint32_t) * 4 * KERN_HIST_BINS);
+}
+
+static inline void hist_add4(struct hist_sub *h, const int32_t *b)
+{
+    if (h->nbins <= KERN_HIST_BINS) {
+        h->sub[0][b[0]]++;
+        h->sub[1][b[1]]++;
+        h->sub[2][b[2]]++;
+        h->sub[3][b[3]]++;
+    }
+    else {
+        h->bins[b[0]]++;
+        h->bins[b[1]]++;
+        h->bins[b[2]]++;
+        h->bins[b[3]]++;
+    }
+}
+
+static inline void hist_done(struct hist_sub *h)
+{
+    if (h->nbins > KERN_HIST_BINS) return;
+
+    for (int i = 0; i < h->nbins; i++)
+        h->bins[i] += h->sub[0][i] + h->sub[1][i] + h->sub[2][i] + h->sub[3][i];
+}
+
+/*********************************************************************
+ *  scalar
+ *********************************************************************/
+
+static double sum_scalar(const float *x, size_t n)
+{
+    double s = 0;
+
+    for (size_t i = 0; i < n; i++) s += x[i];
+
+    return(s);
+}
+
+static void minmax_scalar(const float *x, size_t n, float *min, float *max)
+{
+    float lo = x[0], hi = x[0];
+
+    for (size_t i = 1; i < n; i++) {
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+    }
+
+    *min = lo;
+    *max = hi;
+}
+
+static size_t count_gt_scalar(const float *x, size_t n, float thr)
+{
+    size_t c = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (x[i] > thr) c++;
+    }
+
+    return(c);
+}
+
+static void hist_scalar(const float *x, size_t n, float lo, float width, uint32_t *bins, int nbins)
+{
+    float inv = 1 / width;
+
+    for (size_t i = 0; i < n; i++) bins[hist_bin(x[i], lo, inv, nbins)]++;
+}
+
+static void range_scalar(const uint32_t *ts, const float *x, size_t n, uint32_t from, uint32_t to,
+                         struct kern_agg *agg)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (ts[i] < from || ts[i] > to) continue;
+
+        agg->count++;
+        agg->sum += x[i];
+        if (x[i] < agg->min) agg->min = x[i];
+        if (x[i] > agg->max) agg->max = x[i];
+    }
+}
+
+static const struct kern_ops kern_scalar = {
+    "scalar", sum_scalar, minmax_scalar, count_gt_scalar, hist_scalar, range_scalar
+};
+
+/*********************************************************************
+ *  SSE2 (4 lanes)
+ *********************************************************************/
+#ifdef KERN_X86
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static float hsum_sse2(__m128 v)
+{
+    float f[4];
+
+    _mm_storeu_ps(f, v);
+    return((f[0] + f[1]) + (f[2] + f[3]));
+}
+
+SSE2 static double sum_sse2(const float *x, size_t n)
+{
+    double s = 0;
+    size_t i = 0, end;
+
+    while (i + 8 <= n) {
+        __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 8 <= end; i += 8) {
+            a = _mm_add_ps(a, _mm_loadu_ps(x + i));
+            b = _mm_add_ps(b, _mm_loadu_ps(x + i + 4));
+        }
+
+        s += hsum_sse2(_mm_add_ps(a, b));
+    }
+
+    for (; i < n; i++) s += x[i];
+
+    return(s);
+}
+
+SSE2 static void minmax_sse2(const float *x, size_t n, float *min, float *max)
+{
+    float lo[4], hi[4];
+    size_t i = 0;
+
+    if (n < 4) {
+        minmax_scalar(x, n, min, max);
+        return;
+    }
+
+    __m128 vlo = _mm_loadu_ps(x), vhi = vlo;
+
+    for (i = 4; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        vlo = _mm_min_ps(vlo, v);
+        vhi = _mm_max_ps(vhi, v);
+    }
+
+    _mm_storeu_ps(lo, vlo);
+    _mm_storeu_ps(hi, vhi);
+
+    for (int k = 1; k < 4; k++) {
+        if (lo[k] < lo[0]) lo[0] = lo[k];
+        if (hi[k] > hi[0]) hi[0] = hi[k];
+    }
+
+    for (; i < n; i++) {
+        if (x[i] < lo[0]) lo[0] = x[i];
+        if (x[i] > hi[0]) hi[0] = x[i];
+    }
+
+    *min = lo[0];
+    *max = hi[0];
+}
+
+SSE2 static size_t count_gt_sse2(const float *x, size_t n, float thr)
+{
+    __m128 t = _mm_set1_ps(thr);
+    uint32_t c[4];
+    size_t i = 0, end, total = 0;
+
+    while (i + 4 <= n) {
+        __m128i acc = _mm_setzero_si128();
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        // a true compare is all ones (-1) per lane
+        for (; i + 4 <= end; i += 4)
+            acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(x + i), t)));
+
+        _mm_storeu_si128((__m128i *) c, acc);
+        total += (size_t) c[0] + c[1] + c[2] + c[3];
+    }
+
+    for (; i < n; i++) {
+        if (x[i] > thr) total++;
+    }
+
+    return(total);
+}
+
+SSE2 static void hist_sse2(const float *x, size_t n, float lo, float width, uint32_t *bins, int nbins)
+{
+    float inv = 1 / width;
+    __m128 vlo = _mm_set1_ps(lo), vinv = _mm_set1_ps(inv);
+    __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps((float) (nbins - 1));
+    struct hist_sub h;
+    int32_t b[4];
+    size_t i;
+
+    hist_init(&h, bins, nbins);
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128 f = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), vlo), vinv);
+        f = _mm_min_ps(_mm_max_ps(f, zero), top);
+        _mm_storeu_si128((__m128i *) b, _mm_cvttps_epi32(f));
+        hist_add4(&h, b);
+    }
+
+    hist_done(&h);
+
+    for (; i < n; i++) bins[hist_bin(x[i], lo, inv, nbins)]++;
+}
+
+SSE2 static void range_sse2(const uint32_t *ts, const float *x, size_t n, uint32_t from, uint32_t to,
+                            struct kern_agg *agg)
+{
+    // SSE2 compares signed, flip the top bit for an unsigned compare
+    __m128i sign = _mm_set1_epi32((int) 0x80000000);
+    __m128i vfrom = _mm_xor_si128(_mm_set1_epi32((int) from), sign);
+    __m128i vto = _mm_xor_si128(_mm_set1_epi32((int) to), sign);
+    __m128 big = _mm_set1_ps(FLT_MAX), small = _mm_set1_ps(-FLT_MAX);
+    __m128 vlo = big, vhi = small;
+    float lo[4], hi[4];
+    uint32_t c[4];
+    size_t i = 0, end;
+
+    while (i + 4 <= n) {
+        __m128i cnt = _mm_setzero_si128();
+        __m128 s = _mm_setzero_ps();
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 4 <= end; i += 4) {
+            __m128i t = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (ts + i)), sign);
+            __m128i out = _mm_or_si128(_mm_cmplt_epi32(t, vfrom), _mm_cmpgt_epi32(t, vto));
+            __m128 m = _mm_castsi128_ps(_mm_andnot_si128(out, _mm_set1_epi32(-1)));
+            __m128 v = _mm_loadu_ps(x + i);
+
+            cnt = _mm_sub_epi32(cnt, _mm_castps_si128(m));
+            s = _mm_add_ps(s, _mm_and_ps(m, v));
+            vlo = _mm_min_ps(vlo, _mm_or_ps(_mm_and_ps(m, v), _mm_andnot_ps(m, big)));
+            vhi = _mm_max_ps(vhi, _mm_or_ps(_mm_and_ps(m, v), _mm_andnot_ps(m, small)));
+        }
+
+        _mm_storeu_si128((__m128i *) c, cnt);
+        agg->count += (uint64_t) c[0] + c[1] + c[2] + c[3];
+        agg->sum += hsum_sse2(s);
+    }
+
+    _mm_storeu_ps(lo, vlo);
+    _mm_storeu_ps(hi, vhi);
+
+    for (int k = 0; k < 4; k++) {
+        if (lo[k] < agg->min) agg->min = lo[k];
+        if (hi[k] > agg->max) agg->max = hi[k];
+    }
+
+    range_scalar(ts + i, x + i, n - i, from, to, agg);
+}
+
+static const struct kern_ops kern_sse2 = {
+    "sse2", sum_sse2, minmax_sse2, count_gt_sse2, hist_sse2, range_sse2
+};
+
+/*********************************************************************
+ *  AVX2 (8 lanes)
+ *********************************************************************/
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static float hsum_avx2(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    float f[4];
+
+    _mm_storeu_ps(f, s);
+    return((f[0] + f[1]) + (f[2] + f[3]));
+}
+
+AVX2 static double sum_avx2(const float *x, size_t n)
+{
+    double s = 0;
+    size_t i = 0, end;
+
+    while (i + 16 <= n) {
+        __m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps();
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 16 <= end; i += 16) {
+            a = _mm256_add_ps(a, _mm256_loadu_ps(x + i));
+            b = _mm256_add_ps(b, _mm256_loadu_ps(x + i + 8));
+        }
+
+        s += hsum_avx2(_mm256_add_ps(a, b));
+    }
+
+    for (; i < n; i++) s += x[i];
+
+    return(s);
+}
+
+AVX2 static void minmax_avx2(const float *x, size_t n, float *min, float *max)
+{
+    float lo[8], hi[8];
+    size_t i;
+
+    if (n < 8) {
+        minmax_scalar(x, n, min, max);
+        return;
+    }
+
+    __m256 vlo = _mm256_loadu_ps(x), vhi = vlo;
+
+    for (i = 8; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(x + i);
+        vlo = _mm256_min_ps(vlo, v);
+        vhi = _mm256_max_ps(vhi, v);
+    }
+
+    _mm256_storeu_ps(lo, vlo);
+    _mm256_storeu_ps(hi, vhi);
+
+    for (int k = 1; k < 8; k++) {
+        if (lo[k] < lo[0]) lo[0] = lo[k];
+        if (hi[k] > hi[0]) hi[0] = hi[k];
+    }
+
+    for (; i < n; i++) {
+        if (x[i] < lo[0]) lo[0] = x[i];
+        if (x[i] > hi[0]) hi[0] = x[i];
+    }
+
+    *min = lo[0];
+    *max = hi[0];
+}
+
+AVX2 static size_t count_gt_avx2(const float *x, size_t n, float thr)
+{
+    __m256 t = _mm256_set1_ps(thr);
+    uint32_t c[8];
+    size_t i = 0, end, total = 0;
+
+    while (i + 8 <= n) {
+        __m256i acc = _mm256_setzero_si256();
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 8 <= end; i += 8)
+            acc = _mm256_sub_epi32(acc, _mm256_castps_si256(
+                _mm256_cmp_ps(_mm256_loadu_ps(x + i), t, _CMP_GT_OQ)));
+
+        _mm256_storeu_si256((__m256i *) c, acc);
+        for (int k = 0; k < 8; k++) total += c[k];
+    }
+
+    for (; i < n; i++) {
+        if (x[i] > thr) total++;
+    }
+
+    return(total);
+}
+
+AVX2 static void hist_avx2(const float *x, size_t n, float lo, float width, uint32_t *bins, int nbins)
+{
+    float inv = 1 / width;
+    __m256 vlo = _mm256_set1_ps(lo), vinv = _mm256_set1_ps(inv);
+    __m256 zero = _mm256_setzero_ps(), top = _mm256_set1_ps((float) (nbins - 1));
+    struct hist_sub h;
+    int32_t b[8];
+    size_t i;
+
+    hist_init(&h, bins, nbins);
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256 f = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), vlo), vinv);
+        f = _mm256_min_ps(_mm256_max_ps(f, zero), top);
+        _mm256_storeu_si256((__m256i *) b, _mm256_cvttps_epi32(f));
+        hist_add4(&h, b);
+        hist_add4(&h, b + 4);
+    }
+
+    hist_done(&h);
+
+    for (; i < n; i++) bins[hist_bin(x[i], lo, inv, nbins)]++;
+}
+
+AVX2 static void range_avx2(const uint32_t *ts, const float *x, size_t n, uint32_t from, uint32_t to,
+                            struct kern_agg *agg)
+{
+    __m256i vfrom = _mm256_set1_epi32((int) from), vto = _mm256_set1_epi32((int) to);
+    __m256 big = _mm256_set1_ps(FLT_MAX), small = _mm256_set1_ps(-FLT_MAX);
+    __m256 vlo = big, vhi = small;
+    float lo[8], hi[8];
+    uint32_t c[8];
+    size_t i = 0, end;
+
+    while (i + 8 <= n) {
+        __m256i cnt = _mm256_setzero_si256();
+        __m256 s = _mm256_setzero_ps();
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 8 <= end; i += 8) {
+            __m256i t = _mm256_loadu_si256((const __m256i *) (ts + i));
+
+            // unsigned from <= t <= to : max(t, from) == t and min(t, to) == t
+            __m256i in = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(t, vfrom), t),
+                                          _mm256_cmpeq_epi32(_mm256_min_epu32(t, vto), t));
+            __m256 m = _mm256_castsi256_ps(in);
+            __m256 v = _mm256_loadu_ps(x + i);
+
+            cnt = _mm256_sub_epi32(cnt, in);
+            s = _mm256_add_ps(s, _mm256_and_ps(m, v));
+            vlo = _mm256_min_ps(vlo, _mm256_blendv_ps(big, v, m));
+            vhi = _mm256_max_ps(vhi, _mm256_blendv_ps(small, v, m));
+        }
+
+        _mm256_storeu_si256((__m256i *) c, cnt);
+        for (int k = 0; k < 8; k++) agg->count += c[k];
+        agg->sum += hsum_avx2(s);
+    }
+
+    _mm256_storeu_ps(lo, vlo);
+    _mm256_storeu_ps(hi, vhi);
+
+    for (int k = 0; k < 8; k++) {
+        if (lo[k] < agg->min) agg->min = lo[k];
+        if (hi[k] > agg->max) agg->max = hi[k];
+    }
+
+    range_scalar(ts + i, x + i, n - i, from, to, agg);
+}
+
+static const struct kern_ops kern_avx2 = {
+    "avx2", sum_avx2, minmax_avx2, count_gt_avx2, hist_avx2, range_avx2
+};
+
+#endif /* KERN_X86 */
+
+/*********************************************************************
+ *  NEON (4 lanes)
+ *********************************************************************/
+#ifdef KERN_NEON
+
+static float hsum_neon(float32x4_t v)
+{
+    float f[4];
+
+    vst1q_f32(f, v);
+    return((f[0] + f[1]) + (f[2] + f[3]));
+}
+
+static double sum_neon(const float *x, size_t n)
+{
+    double s = 0;
+    size_t i = 0, end;
+
+    while (i + 8 <= n) {
+        float32x4_t a = vdupq_n_f32(0), b = vdupq_n_f32(0);
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 8 <= end; i += 8) {
+            a = vaddq_f32(a, vld1q_f32(x + i));
+            b = vaddq_f32(b, vld1q_f32(x + i + 4));
+        }
+
+        s += hsum_neon(vaddq_f32(a, b));
+    }
+
+    for (; i < n; i++) s += x[i];
+
+    return(s);
+}
+
+static void minmax_neon(const float *x, size_t n, float *min, float *max)
+{
+    float lo[4], hi[4];
+    size_t i;
+
+    if (n < 4) {
+        minmax_scalar(x, n, min, max);
+        return;
+    }
+
+    float32x4_t vlo = vld1q_f32(x), vhi = vlo;
+
+    for (i = 4; i + 4 <= n; i += 4) {
+        float32x4_t v = vld1q_f32(x + i);
+        vlo = vminq_f32(vlo, v);
+        vhi = vmaxq_f32(vhi, v);
+    }
+
+    vst1q_f32(lo, vlo);
+    vst1q_f32(hi, vhi);
+
+    for (int k = 1; k < 4; k++) {
+        if (lo[k] < lo[0]) lo[0] = lo[k];
+        if (hi[k] > hi[0]) hi[0] = hi[k];
+    }
+
+    for (; i < n; i++) {
+        if (x[i] < lo[0]) lo[0] = x[i];
+        if (x[i] > hi[0]) hi[0] = x[i];
+    }
+
+    *min = lo[0];
+    *max = hi[0];
+}
+
+static size_t count_gt_neon(const float *x, size_t n, float thr)
+{
+    float32x4_t t = vdupq_n_f32(thr);
+    uint32_t c[4];
+    size_t i = 0, end, total = 0;
+
+    while (i + 4 <= n) {
+        uint32x4_t acc = vdupq_n_u32(0);
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 4 <= end; i += 4)
+            acc = vsubq_u32(acc, vcgtq_f32(vld1q_f32(x + i), t));
+
+        vst1q_u32(c, acc);
+        total += (size_t) c[0] + c[1] + c[2] + c[3];
+    }
+
+    for (; i < n; i++) {
+        if (x[i] > thr) total++;
+    }
+
+    return(total);
+}
+
+static void hist_neon(const float *x, size_t n, float lo, float width, uint32_t *bins, int nbins)
+{
+    float inv = 1 / width;
+    float32x4_t vlo = vdupq_n_f32(lo), vinv = vdupq_n_f32(inv);
+    float32x4_t zero = vdupq_n_f32(0), top = vdupq_n_f32((float) (nbins - 1));
+    struct hist_sub h;
+    int32_t b[4];
+    size_t i;
+
+    hist_init(&h, bins, nbins);
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        float32x4_t f = vmulq_f32(vsubq_f32(vld1q_f32(x + i), vlo), vinv);
+        f = vminq_f32(vmaxq_f32(f, zero), top);
+        vst1q_s32(b, vcvtq_s32_f32(f));
+        hist_add4(&h, b);
+    }
+
+    hist_done(&h);
+
+    for (; i < n; i++) bins[hist_bin(x[i], lo, inv, nbins)]++;
+}
+
+static void range_neon(const uint32_t *ts, const float *x, size_t n, uint32_t from, uint32_t to,
+                       struct kern_agg *agg)
+{
+    uint32x4_t vfrom = vdupq_n_u32(from), vto = vdupq_n_u32(to);
+    float32x4_t big = vdupq_n_f32(FLT_MAX), small = vdupq_n_f32(-FLT_MAX);
+    float32x4_t vlo = big, vhi = small;
+    float lo[4], hi[4];
+    uint32_t c[4];
+    size_t i = 0, end;
+
+    while (i + 4 <= n) {
+        uint32x4_t cnt = vdupq_n_u32(0);
+        float32x4_t s = vdupq_n_f32(0);
+
+        end = i + KERN_CHUNK < n ? i + KERN_CHUNK : n;
+
+        for (; i + 4 <= end; i += 4) {
+            uint32x4_t t = vld1q_u32(ts + i);
+            uint32x4_t m = vandq_u32(vcgeq_u32(t, vfrom), vcleq_u32(t, vto));
+            float32x4_t v = vld1q_f32(x + i);
+
+            cnt = vsubq_u32(cnt, m);
+            s = vaddq_f32(s, vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(v))));
+            vlo = vminq_f32(vlo, vbslq_f32(m, v, big));
+            vhi = vmaxq_f32(vhi, vbslq_f32(m, v, small));
+        }
+
+        vst1q_u32(c, cnt);
+        agg->count += (uint64_t) c[0] + c[1] + c[2] + c[3];
+        agg->sum += hsum_neon(s);
+    }
+
+    vst1q_f32(lo, vlo);
+    vst1q_f32(hi, vhi);
+
+    for (int k = 0; k < 4; k++) {
+        if (lo[k] < agg->min) agg->min = lo[k];
+        if (hi[k] > agg->max) agg->max = hi[k];
+    }
+
+    range_scalar(ts + i, x + i, n - i, from, to, agg);
+}
+
+static const struct kern_ops kern_neon = {
+    "neon", sum_neon, minmax_neon, count_gt_neon, hist_neon, range_neon
+};
+
+#endif /* KERN_NEON */
+
+/*********************************************************************
+ *  dispatch
+ *********************************************************************/
+
+/**
+ * @brief the available kernels, scalar first
+ */
+int kern_list(const struct kern_ops **list, int max)
+{
+    int n = 0;
+
+    if (n < max) list[n++] = &kern_scalar;
+
+#ifdef KERN_X86
+    __builtin_cpu_init();
+
+    if (n < max && __builtin_cpu_supports("sse2")) list[n++] = &kern_sse2;
+    if (n < max && __builtin_cpu_supports("avx2")) list[n++] = &kern_avx2;
+#endif
+
+#ifdef KERN_NEON
+    if (n < max) list[n++] = &kern_neon;
+#endif
+
+    return(n);
+}
+
+/**
+ * @brief select a set of kernels
+ * @param name : NULL for the best on this CPU, or scalar / sse2 / avx2 / neon
+ *
+ * @return the kernels or NULL if not available
+ */
+const struct kern_ops *kern_select(const char *name)
+{
+    const struct kern_ops *list[4];
+    int n = kern_list(list, 4);
+
+    // the last one is the best
+    if (name == NULL) return(list[n - 1]);
+
+    for (int i = 0; i < n; i++) {
+        if (strcasecmp(name, list[i]->name) == 0) return(list[i]);
+    }
+
+    return(NULL);
+}
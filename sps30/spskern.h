@@ -0,0 +1,98 @@
+/**
+ * SPS30 aggregation kernels header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Vectorized kernels over a column of float values (see spscol.h):
+ *
+ *  sum, min / max, count above a threshold, histogram and a count /
+ *  sum / min / max of the values with a timestamp in a range (masked).
+ *
+ * Versions:
+ *  scalar  plain loops, always available
+ *  sse2    x86 (baseline on x86_64)
+ *  avx2    x86, selected at run time if the CPU supports it
+ *  neon    ARM, when the compiler targets NEON (aarch64, or armv7l
+ *          where the makefile adds -mfpu=neon)
+ *
+ * kern_select() picks the best version for the CPU, or a version by
+ * name for testing. Sums are kept in float per lane for KERN_CHUNK
+ * values and then added in double, so they can differ from the scalar
+ * sum in the last digits.
+ *********************************************************************
+*/
+#ifndef SPSKERN_H
+#define SPSKERN_H
+
+# include <stdint.h>
+# include <stddef.h>
+
+/* values summed in float before adding to the double total */
+#define KERN_CHUNK      4096
+
+/* result of a masked aggregate */
+struct kern_agg
+{
+    uint64_t count;
+    double   sum;
+    float    min;
+    float    max;
+};
+
+/* one set of kernels */
+struct kern_ops
+{
+    const char *name;
+
+    /* sum of n values */
+    double (*sum)(const float *x, size_t n);
+
+    /* min and max of n values (n > 0) */
+    void   (*minmax)(const float *x, size_t n, float *min, float *max);
+
+    /* number of values above thr */
+    size_t (*count_gt)(const float *x, size_t n, float thr);
+
+    /* add the values to bins of width starting at lo, values outside
+     * are added to the first / last bin, a NaN to the first */
+    void   (*hist)(const float *x, size_t n, float lo, float width, uint32_t *bins, int nbins);
+
+    /* aggregate the values with from <= ts <= to (ts need not be sorted) */
+    void   (*range)(const uint32_t *ts, const float *x, size_t n, uint32_t from, uint32_t to,
+                    struct kern_agg *agg);
+};
+
+/**
+ * @brief select a set of kernels
+ * @param name : NULL for the best on this CPU, or scalar / sse2 / avx2 / neon
+ *
+ * @return the kernels or NULL if not available
+ */
+const struct kern_ops *kern_select(const char *name);
+
+/**
+ * @brief the available kernels (for the benchmark)
+ * @param list : to store the kernels, scalar first
+ * @param max  : size of list
+ *
+ * @return number of kernels
+ */
+int kern_list(const struct kern_ops **list, int max);
+
+/**
+ * @brief reset a masked aggregate
+ */
+void kern_agg_init(struct kern_agg *agg);
+
+#endif /* SPSKERN_H */
@@ -0,0 +1,316 @@
+/**
+ * spsload.cpp
+ *
+ * Load generator for the aggregator (spsagg)
+ *
+ * Simulates many SPS30 monitors, each sending one sample per (simulated)
+ * second. The sensors are spread over the connections, a connection
+ * sends its samples with a lag that changes now and then, so the
+ * aggregator receives them out of order and some of them late. Build
+ * with:
+ *      make spsload
+ *
+ * Examples:
+ *  1000 sensors over 1000 connections for 60 seconds
+ *      ./spsload -a localhost:7030 -n 1000 -t 60
+ *
+ *  1000 sensors over 50 connections, 60 times faster, lag up to 8 s
+ *      ./spsload -a /tmp/spsagg.sock -n 1000 -c 50 -s 60 -j 8
+ *
+ * *****************************************************************
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * version 1.0 / October 2026
+ *  - initial version
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include <unistd.h>
+# include <errno.h>
+# include <time.h>
+# include <signal.h>
+# include <sys/socket.h>
+# include "spsstream.h"
+
+#define LOAD_MAJOR 1
+#define LOAD_MINOR 0
+
+#define LOAD_SENSORS    1000
+#define LOAD_BUF        256             // samples sent at once
+#define LOAD_LAG_CHANGE 10              // one in # sends takes a new lag
+
+/* a connection */
+typedef struct load_conn
+{
+    int      fd;
+    uint32_t done;                      // sent up to (simulated ts)
+    uint32_t lag;                       // seconds behind
+    uint64_t sent;
+} load_conn;
+
+typedef struct load_par
+{
+    char     addr[256];
+    uint32_t sensors;
+    uint32_t conns;                     // 0 = one per sensor
+    double   speed;                     // simulated seconds per second
+    uint32_t seconds;                   // 0 = until interrupted
+    uint32_t jitter;                    // max lag in seconds
+} load_par;
+
+char progname[20];
+
+static volatile sig_atomic_t Stop = 0;
+
+/* random walk of each sensor: MassPM1 */
+static float *Walk;
+
+/*********************************************************************
+ * @brief time in seconds
+ *********************************************************************/
+static double now_sec()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/*********************************************************************
+ * @brief send a buffer completely
+ *********************************************************************/
+static int send_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+    ssize_t r;
+
+    while (len > 0) {
+        if ((r = send(fd, p, len, MSG_NOSIGNAL)) <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return(-1);
+        }
+
+        p += r;
+        len -= r;
+    }
+
+    return(0);
+}
+
+/*********************************************************************
+ * @brief next sample of a sensor, values in the usual order
+ *********************************************************************/
+static void make_sample(struct sps_sample *s, uint32_t ts, uint16_t sensor)
+{
+    float *w = &Walk[sensor];
+    float m;
+
+    *w += (float) (rand() % 201 - 100) / 100;
+    if (*w < 0.5) *w = 0.5;
+    if (*w > 200) *w = 200;
+    m = *w;
+
+    s->ts = ts;
+    s->sensor = sensor;
+    s->flags = 0;
+    s->v.MassPM1 = m;
+    s->v.MassPM2 = m * 1.06;
+    s->v.MassPM4 = m * 1.08;
+    s->v.MassPM10 = m * 1.09;
+    s->v.NumPM0 = m * 5.5;
+    s->v.NumPM1 = m * 6.6;
+    s->v.NumPM2 = m * 6.7;
+    s->v.NumPM4 = m * 6.71;
+    s->v.NumPM10 = m * 6.72;
+    s->v.PartSize = 0.4 + (float) (rand() % 30) / 100;
+}
+
+/*********************************************************************
+ * @brief send the samples of a connection up to a simulated time
+ *
+ * The sensors of connection c are c, c + conns, c + 2 * conns ..
+ *********************************************************************/
+static int send_upto(load_conn *c, int ci, uint32_t upto, load_par *a)
+{
+    struct sps_sample buf[LOAD_BUF];
+    int n = 0;
+
+    for (uint32_t t = c->done + 1; t <= upto; t++) {
+
+        for (uint32_t s = ci; s < a->sensors; s += a->conns) {
+            make_sample(&buf[n++], t, s + 1);
+
+            if (n == LOAD_BUF) {
+                if (send_all(c->fd, buf, sizeof(buf)) != 0) return(-1);
+                c->sent += n;
+                n = 0;
+            }
+        }
+
+        c->done = t;
+    }
+
+    if (n > 0) {
+        if (send_all(c->fd, buf, n * sizeof(struct sps_sample)) != 0) return(-1);
+        c->sent += n;
+    }
+
+    return(0);
+}
+
+/*********************************************************************
+* @brief usage information
+**********************************************************************/
+void usage()
+{
+    printf("%s [options]  (program version %d.%d)\n\n"
+    "-a addr    aggregator host:port, unix:/path or /path (default localhost:%s)\n"
+    "-n #       number of sensors                     (default %d)\n"
+    "-c #       number of connections                 (default one per sensor)\n"
+    "-s #       simulated seconds per second          (default 1)\n"
+    "-t #       seconds to run                        (default until ctrl-c)\n"
+    "-j #       max lag of a connection in seconds    (default 0)\n"
+    , progname, LOAD_MAJOR, LOAD_MINOR, STREAM_PORT, LOAD_SENSORS);
+}
+
+static void signal_handler(int sig)
+{
+    Stop = 1;
+}
+
+/***********************
+ *  program starts here
+ **********************/
+int main(int argc, char *argv[])
+{
+    struct stream_hello h;
+    struct sigaction sa;
+    load_conn *conn;
+    load_par a;
+    double   t0, el;
+    uint64_t sent = 0;
+    uint32_t start, sim;
+    int opt;
+
+    strncpy(progname, argv[0], 19);
+    progname[19] = 0x0;
+
+    memset(&a, 0x0, sizeof(a));
+    snprintf(a.addr, sizeof(a.addr), "localhost:%s", STREAM_PORT);
+    a.sensors = LOAD_SENSORS;
+    a.speed = 1;
+
+    while ((opt = getopt(argc, argv, "a:n:c:s:t:j:h")) != -1) {
+        switch (opt) {
+        case 'a':  strncpy(a.addr, optarg, sizeof(a.addr) - 1); break;
+        case 'n':  a.sensors = (uint32_t) strtoul(optarg, NULL, 10); break;
+        case 'c':  a.conns = (uint32_t) strtoul(optarg, NULL, 10); break;
+        case 's':  a.speed = strtod(optarg, NULL); break;
+        case 't':  a.seconds = (uint32_t) strtoul(optarg, NULL, 10); break;
+        case 'j':  a.jitter = (uint32_t) strtoul(optarg, NULL, 10); break;
+        case 'h':  usage(); exit(EXIT_SUCCESS);
+        default:   usage(); exit(EXIT_FAILURE);
+        }
+    }
+
+    if (a.sensors < 1 || a.sensors > 65535) {
+        printf("Number of sensors must be 1 - 65535\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (a.conns == 0 || a.conns > a.sensors) a.conns = a.sensors;
+    if (a.speed <= 0) a.speed = 1;
+
+    conn = (load_conn *) calloc(a.conns, sizeof(load_conn));
+    Walk = (float *) malloc(sizeof(float) * 65536);
+
+    if (conn == NULL || Walk == NULL) {
+        printf("Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < 65536; i++) Walk[i] = 5 + rand() % 20;
+
+    memset(&h, 0x0, sizeof(h));
+    h.magic = STREAM_MAGIC;
+    h.version = STREAM_VERSION;
+
+    start = (uint32_t) time(NULL);
+
+    for (uint32_t i = 0; i < a.conns; i++) {
+        if ((conn[i].fd = stream_connect(a.addr)) < 0) {
+            printf("Can not connect to %s (connection %u)\n", a.addr, i);
+            exit(EXIT_FAILURE);
+        }
+
+        h.sensors = (a.sensors - i + a.conns - 1) / a.conns;
+        snprintf(h.name, sizeof(h.name), "load-%u", i);
+
+        if (send_all(conn[i].fd, &h, sizeof(h)) != 0) {
+            printf("Can not send to %s\n", a.addr);
+            exit(EXIT_FAILURE);
+        }
+
+        conn[i].done = start;
+        conn[i].lag = a.jitter ? rand() % (a.jitter + 1) : 0;
+    }
+
+    memset(&sa, 0x0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("%u sensors over %u connections to %s, speed %.0f\n", a.sensors, a.conns, a.addr, a.speed);
+
+    t0 = now_sec();
+
+    while (! Stop) {
+        el = now_sec() - t0;
+
+        if (a.seconds && el >= a.seconds) break;
+
+        sim = start + (uint32_t) (el * a.speed);
+
+        for (uint32_t i = 0; i < a.conns && ! Stop; i++) {
+            load_conn *c = &conn[i];
+
+            if (sim < start + c->lag || sim - c->lag <= c->done) continue;
+
+            if (send_upto(c, i, sim - c->lag, &a) != 0) {
+                printf("Connection %u lost\n", i);
+                Stop = 1;
+                break;
+            }
+
+            // now and then a new lag
+            if (a.jitter && rand() % LOAD_LAG_CHANGE == 0) c->lag = rand() % (a.jitter + 1);
+        }
+
+        usleep(10000);
+    }
+
+    el = now_sec() - t0;
+
+    for (uint32_t i = 0; i < a.conns; i++) {
+        sent += conn[i].sent;
+        close(conn[i].fd);
+    }
+
+    printf("%llu samples sent in %.1f s (%.0f/s), simulated %u s\n", (unsigned long long) sent,
+        el, el > 0 ? sent / el : 0, (uint32_t) (el * a.speed));
+
+    return(EXIT_SUCCESS);
+}
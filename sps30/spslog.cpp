@@ -0,0 +1,479 @@
+/**
+ * SPS30 sample log server for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spslog.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include "spslog.h"
+#include "spsstream.h"
+
+/**
+ * @brief format a sample as a line
+ */
+int log_line(char *buf, uint64_t seq, const struct sps_sample *s)
+{
+    return(snprintf(buf, LOG_LINE, "%llu,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%u\n",
+        (unsigned long long) seq, s->sensor, s->ts,
+        s->v.MassPM1, s->v.MassPM2, s->v.MassPM4, s->v.MassPM10,
+        s->v.NumPM0, s->v.NumPM1, s->v.NumPM2, s->v.NumPM4, s->v.NumPM10,
+        s->v.PartSize, s->flags));
+}
+
+SPSlog::SPSlog(void)
+{
+    _addr[0] = _dir[0] = 0x0;
+    _sensor = 0;
+    _verbose = 0;
+    _fd = -1;
+    _wake[0] = _wake[1] = -1;
+    _ring = NULL;
+    _last = 0;
+    _count = 0;
+    _cl = NULL;
+    _running = _stop = false;
+    memset(&_st, 0x0, sizeof(_st));
+    pthread_mutex_init(&_lock, NULL);
+}
+
+/**
+ * @brief start serving
+ */
+int SPSlog::open(const char *addr, const char *dir, uint16_t sensor, int verbose)
+{
+    uint32_t n;
+
+    strncpy(_addr, addr, sizeof(_addr) - 1);
+    strncpy(_dir, dir, sizeof(_dir) - 1);
+    _sensor = sensor;
+    _verbose = verbose;
+
+    if (_rd.open(dir, sensor) != STORE_OK) {
+        printf("Log: can not read store %s\n", dir);
+        return(STORE_ERROR);
+    }
+
+    // the store is committed at open, continue after its last sample
+    if ((n = _rd.entries()) > 0) _last = _rd.entry(n - 1)->first_rec + _rd.entry(n - 1)->count;
+
+    _ring = (struct log_entry *) malloc(LOG_RING * sizeof(struct log_entry));
+    _cl = (struct log_client *) malloc(LOG_MAX * sizeof(struct log_client));
+
+    if (_ring == NULL || _cl == NULL) {
+        printf("Log: out of memory\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    for (int i = 0; i < LOG_MAX; i++) _cl[i].fd = -1;
+
+    if ((_fd = stream_listen(addr)) < 0) {
+        printf("Log: can not listen on %s\n", addr);
+        close();
+        return(STORE_ERROR);
+    }
+
+    if (pipe(_wake) != 0) {
+        printf("Log: can not create pipe\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    fcntl(_wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(_wake[1], F_SETFL, O_NONBLOCK);
+    fcntl(_fd, F_SETFL, O_NONBLOCK);
+
+    _stop = false;
+
+    if (pthread_create(&_thread, NULL, thread, this) != 0) {
+        printf("Log: can not start server\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    _running = true;
+
+    if (_verbose) printf("Log: serving sensor %d on %s after sequence number %llu\n", sensor, addr,
+        (unsigned long long) _last);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add a sample that was appended to the store
+ */
+void SPSlog::sample(const struct sps_sample *s, uint64_t seq)
+{
+    struct log_entry *e;
+
+    if (! _running) return;
+
+    pthread_mutex_lock(&_lock);
+
+    // the ring holds consecutive sequence numbers only
+    if (seq != _last + 1) _count = 0;
+
+    e = &_ring[seq % LOG_RING];
+    e->seq = seq;
+    e->s = *s;
+    _last = seq;
+    if (_count < LOG_RING) _count++;
+    _st.samples++;
+
+    pthread_mutex_unlock(&_lock);
+
+    // wake the thread, a full pipe is awake already
+    if (write(_wake[1], "", 1) < 0) {}
+}
+
+/**
+ * @brief accept a subscriber
+ */
+void SPSlog::accept_client()
+{
+    int fd, i;
+
+    if ((fd = accept4(_fd, NULL, NULL, SOCK_NONBLOCK)) < 0) return;
+
+    for (i = 0; i < LOG_MAX; i++) {
+        if (_cl[i].fd < 0) break;
+    }
+
+    if (i == LOG_MAX) {
+        if (write(fd, "# too many subscribers\n", 23) < 0) {}
+        ::close(fd);
+
+        pthread_mutex_lock(&_lock);
+        _st.refused++;
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+
+    _cl[i].fd = fd;
+    _cl[i].request = _cl[i].eof = false;
+    _cl[i].reqlen = 0;
+    _cl[i].next = 0;
+    _cl[i].len = _cl[i].pos = 0;
+
+    pthread_mutex_lock(&_lock);
+    _st.connects++;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief read the request line of a subscriber
+ *
+ * @return false to disconnect
+ */
+bool SPSlog::read_request(struct log_client *c)
+{
+    unsigned long long n;
+    ssize_t r;
+    char *p;
+
+    r = read(c->fd, c->req + c->reqlen, sizeof(c->req) - 1 - c->reqlen);
+
+    if (r <= 0) return(r < 0 && (errno == EAGAIN || errno == EINTR));
+
+    c->reqlen += r;
+    c->req[c->reqlen] = 0x0;
+
+    if ((p = strchr(c->req, '\n')) == NULL) {
+        // no line yet, but room left
+        if (c->reqlen < sizeof(c->req) - 1) return(true);
+    }
+    else *p = 0x0;
+
+    pthread_mutex_lock(&_lock);
+
+    if (sscanf(c->req, "after %llu", &n) == 1) c->next = n + 1;
+    else if (strncmp(c->req, "live", 4) == 0) c->next = _last + 1;
+    else {
+        _st.refused++;
+        pthread_mutex_unlock(&_lock);
+
+        if (write(c->fd, "# use: after N | live\n", 22) < 0) {}
+        return(false);
+    }
+
+    c->len = snprintf(c->buf, LOG_LINE, "# sensor %u, last %llu\n", _sensor, (unsigned long long) _last);
+
+    pthread_mutex_unlock(&_lock);
+
+    c->request = true;
+
+    if (_verbose) printf("Log: subscriber %d after %llu\n", c->fd, (unsigned long long) c->next - 1);
+
+    return(true);
+}
+
+/**
+ * @brief add lines from the store to the buffer of a subscriber
+ *
+ * @return false if the next sample is not in the store
+ */
+bool SPSlog::fill_store(struct log_client *c)
+{
+    const struct store_idx *e;
+    const struct sps_sample *r = NULL;
+    uint64_t rec = c->next - 1, skip = 0;
+    uint32_t i, j, n = 0;
+
+    _rd.refresh();
+
+    if ((i = _rd.find_rec(rec)) == _rd.entries()) return(false);
+
+    e = _rd.entry(i);
+
+    // expired or corrupt : skip to the next that is there
+    if (e->first_rec > rec) skip = e->first_rec;
+    else if ((r = _rd.block(e)) == NULL) skip = e->first_rec + e->count;
+
+    if (skip) {
+        c->len += snprintf(c->buf + c->len, LOG_LINE, "# gap %llu %llu\n",
+            (unsigned long long) c->next, (unsigned long long) skip);
+        c->next = skip + 1;
+
+        pthread_mutex_lock(&_lock);
+        _st.gaps++;
+        pthread_mutex_unlock(&_lock);
+        return(true);
+    }
+
+    for (j = rec - e->first_rec; j < e->count && c->len + LOG_LINE <= LOG_BUF; j++, n++)
+        c->len += log_line(c->buf + c->len, e->first_rec + j + 1, &r[j]);
+
+    c->next = e->first_rec + j + 1;
+
+    pthread_mutex_lock(&_lock);
+    _st.stored += n;
+    pthread_mutex_unlock(&_lock);
+
+    return(true);
+}
+
+/**
+ * @brief fill the buffer of a subscriber, from the ring or the store
+ */
+void SPSlog::fill(struct log_client *c)
+{
+    struct log_entry e;
+    uint64_t first;
+
+    while (c->len + LOG_LINE <= LOG_BUF) {
+
+        pthread_mutex_lock(&_lock);
+
+        // caught up
+        if (c->next > _last) {
+            pthread_mutex_unlock(&_lock);
+            return;
+        }
+
+        first = _last - _count + 1;
+
+        if (c->next >= first) {
+            e = _ring[c->next % LOG_RING];
+            _st.live++;
+            pthread_mutex_unlock(&_lock);
+
+            c->len += log_line(c->buf + c->len, e.seq, &e.s);
+            c->next++;
+            continue;
+        }
+
+        pthread_mutex_unlock(&_lock);
+
+        // not in the store (not committed) and no longer in the ring
+        if (! fill_store(c)) {
+            c->len += snprintf(c->buf + c->len, LOG_LINE, "# gap %llu %llu\n",
+                (unsigned long long) c->next, (unsigned long long) first - 1);
+            c->next = first;
+
+            pthread_mutex_lock(&_lock);
+            _st.gaps++;
+            pthread_mutex_unlock(&_lock);
+        }
+    }
+}
+
+/**
+ * @brief disconnect a subscriber
+ */
+void SPSlog::drop(struct log_client *c)
+{
+    if (_verbose) printf("Log: subscriber %d left at %llu\n", c->fd, (unsigned long long) c->next - 1);
+
+    ::close(c->fd);
+    c->fd = -1;
+}
+
+/**
+ * @brief the background thread : accepts subscribers and sends lines
+ */
+void *SPSlog::thread(void *arg)
+{
+    SPSlog *me = (SPSlog *) arg;
+    struct pollfd pf[LOG_MAX + 2];
+    struct log_client *c;
+    int    idx[LOG_MAX + 2], n;
+    char   tmp[256];
+    sigset_t set;
+    ssize_t r;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    while (! me->_stop) {
+
+        pf[0].fd = me->_wake[0];
+        pf[0].events = POLLIN;
+        pf[1].fd = me->_fd;
+        pf[1].events = POLLIN;
+        n = 2;
+
+        for (int i = 0; i < LOG_MAX; i++) {
+            c = &me->_cl[i];
+            if (c->fd < 0) continue;
+
+            if (c->request && c->pos == c->len) {
+                c->pos = c->len = 0;
+                me->fill(c);
+            }
+
+            pf[n].fd = c->fd;
+            pf[n].events = c->eof ? 0 : POLLIN;
+            if (c->pos < c->len) pf[n].events |= POLLOUT;
+            idx[n++] = i;
+        }
+
+        if (poll(pf, n, 1000) <= 0) continue;
+
+        if (pf[0].revents) while (read(me->_wake[0], tmp, sizeof(tmp)) > 0);
+
+        if (pf[1].revents) me->accept_client();
+
+        for (int k = 2; k < n; k++) {
+            c = &me->_cl[idx[k]];
+
+            if (pf[k].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                me->drop(c);
+                continue;
+            }
+
+            if (pf[k].revents & POLLIN) {
+                if (! c->request) {
+                    if (! me->read_request(c)) {
+                        me->drop(c);
+                        continue;
+                    }
+                }
+                // nothing more is expected: the subscriber may have
+                // closed its side (e.g. echo after 0 | nc), keep sending
+                else if ((r = read(c->fd, tmp, sizeof(tmp))) == 0) c->eof = true;
+                else if (r < 0 && errno != EAGAIN && errno != EINTR) {
+                    me->drop(c);
+                    continue;
+                }
+            }
+
+            if ((pf[k].revents & POLLOUT) && c->pos < c->len) {
+                r = send(c->fd, c->buf + c->pos, c->len - c->pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+                if (r < 0 && errno != EAGAIN && errno != EINTR) {
+                    me->drop(c);
+                    continue;
+                }
+
+                if (r > 0) {
+                    c->pos += r;
+
+                    pthread_mutex_lock(&me->_lock);
+                    me->_st.bytes += r;
+                    pthread_mutex_unlock(&me->_lock);
+                }
+            }
+        }
+    }
+
+    return(NULL);
+}
+
+/**
+ * @brief stop serving
+ */
+void SPSlog::close()
+{
+    if (_running) {
+        _stop = true;
+        if (write(_wake[1], "", 1) < 0) {}
+        pthread_join(_thread, NULL);
+        _running = false;
+    }
+
+    if (_cl) {
+        for (int i = 0; i < LOG_MAX; i++) {
+            if (_cl[i].fd > -1) ::close(_cl[i].fd);
+        }
+    }
+
+    if (_fd > -1) {
+        ::close(_fd);
+
+        // remove a Unix socket
+        if (_addr[0] == '/' || strncmp(_addr, "unix:", 5) == 0)
+            unlink(_addr[0] == '/' ? _addr : _addr + 5);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (_wake[i] > -1) ::close(_wake[i]);
+        _wake[i] = -1;
+    }
+
+    _fd = -1;
+    _rd.close();
+
+    free(_ring);
+    free(_cl);
+    _ring = NULL;
+    _cl = NULL;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSlog::stats(struct log_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    pthread_mutex_unlock(&_lock);
+}
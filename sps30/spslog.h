@@ -0,0 +1,160 @@
+/**
+ * SPS30 sample log server header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Serves the samples of the store to subscribers as a log (option -L).
+ *
+ * Each sample of a sensor has a sequence number: its position in the
+ * store of the sensor, starting at 1. It never changes and is never
+ * used again, also not after a restart or when old segments expired.
+ *
+ * A subscriber connects over TCP or a Unix socket (see spsstream.h for
+ * the address) and sends one line:
+ *
+ *  after N     all samples after sequence number N (0 = from the start)
+ *  live        only new samples
+ *
+ * It then receives a line per sample, until it disconnects:
+ *
+ *  seq,sensor,ts,MassPM1,..,PartSize,flags
+ *
+ * A subscriber that keeps the last sequence number it processed can
+ * reconnect with 'after N' and miss nothing (see spstail). Older
+ * samples are read from the store at full speed, the newest from a
+ * ring in memory that also holds the samples that are not committed
+ * yet. A subscriber that falls behind the ring continues from the
+ * store. When the samples asked for have expired, or are in a corrupt
+ * block, a line '# gap N M' tells which sequence numbers are skipped.
+ *********************************************************************
+*/
+#ifndef SPSLOG_H
+#define SPSLOG_H
+
+# include <pthread.h>
+# include "spsstore.h"
+
+#define LOG_PORT            "7031"
+#define LOG_MAX             16              // subscribers
+#define LOG_RING            8192            // newest samples in memory
+#define LOG_BUF             65536           // output buffer of a subscriber
+#define LOG_LINE            256             // longest line
+
+/* statistics of the log server */
+struct log_stats
+{
+    uint64_t samples;       // samples added
+    uint64_t stored;        // lines sent from the store
+    uint64_t live;          // lines sent from the ring
+    uint64_t bytes;         // bytes sent
+    uint32_t connects;      // subscribers accepted
+    uint32_t refused;       // subscribers refused (too many, bad request)
+    uint32_t gaps;          // gaps reported
+};
+
+/* a sample with its sequence number */
+struct log_entry
+{
+    uint64_t seq;
+    struct sps_sample s;
+};
+
+/* a subscriber */
+struct log_client
+{
+    int      fd;                    // -1 = free
+    bool     request;               // request line received
+    bool     eof;                   // subscriber closed its side
+    char     req[64];
+    uint32_t reqlen;
+    uint64_t next;                  // next sequence number to send
+    char     buf[LOG_BUF];          // lines not sent yet
+    uint32_t len, pos;
+};
+
+/**
+ * @brief format a sample as a line
+ * @param buf : at least LOG_LINE bytes
+ *
+ * @return length of the line (ends with a newline)
+ */
+int log_line(char *buf, uint64_t seq, const struct sps_sample *s);
+
+class SPSlog
+{
+  public:
+
+    SPSlog(void);
+
+    /**
+     * @brief start serving
+     * @param addr    : host:port, :port, unix:/path or /path
+     * @param dir     : store directory
+     * @param sensor  : sensor id
+     * @param verbose : if > 0 subscribers are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *addr, const char *dir, uint16_t sensor, int verbose);
+
+    /**
+     * @brief add a sample that was appended to the store
+     * @param seq : its sequence number (SPSstore::seq())
+     */
+    void sample(const struct sps_sample *s, uint64_t seq);
+
+    /**
+     * @brief stop serving, subscribers are disconnected
+     */
+    void close();
+
+    bool is_open() {return(_running);}
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct log_stats *st);
+
+  private:
+    char     _addr[256];
+    char     _dir[PATH_MAX - 32];
+    uint16_t _sensor;
+    int      _verbose;
+    int      _fd;                   // listening socket
+    int      _wake[2];              // pipe to wake the thread
+
+    struct log_entry *_ring;        // LOG_RING, by seq % LOG_RING
+    uint64_t _last;                 // newest sequence number
+    uint32_t _count;                // entries in ring
+
+    struct log_client *_cl;         // LOG_MAX
+    SPSread  _rd;
+
+    struct log_stats _st;
+    bool     _running;
+    bool     _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+
+    void accept_client();
+    bool read_request(struct log_client *c);
+    void fill(struct log_client *c);
+    bool fill_store(struct log_client *c);
+    void drop(struct log_client *c);
+    static void *thread(void *arg);
+};
+
+#endif /* SPSLOG_H */
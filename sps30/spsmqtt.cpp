@@ -0,0 +1,803 @@
+/**
+ * SPS30 MQTT publisher for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsmqtt.h
+ *
+ * Only the packets needed to publish are supported: CONNECT, CONNACK,
+ * PUBLISH (QoS 0 and 1), PUBACK, PINGREQ, PINGRESP and DISCONNECT.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "spsmqtt.h"
+
+/* packet types (upper 4 bits of the first byte) */
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        0x20
+#define MQTT_PUBLISH        0x30
+#define MQTT_PUBACK         0x40
+#define MQTT_PINGREQ        0xc0
+#define MQTT_PINGRESP       0xd0
+#define MQTT_DISCONNECT     0xe0
+
+/* bits of the status register, as SPS_status in sps30lib.h */
+#define MQTT_SPEED_ERROR    0x01
+#define MQTT_LASER_ERROR    0x02
+#define MQTT_FAN_ERROR      0x04
+
+static const char *mqtt_type_name[MQTT_TYPES] = {"sample", "agg", "status"};
+
+/**
+ * @brief add a string with a 2 byte length
+ */
+static uint8_t *put_str(uint8_t *p, const char *s, int len)
+{
+    *p++ = len >> 8;
+    *p++ = len & 0xff;
+    memcpy(p, s, len);
+    return(p + len);
+}
+
+/**
+ * @brief add the fixed header: type and remaining length
+ */
+static uint8_t *put_hdr(uint8_t *p, uint8_t type, uint32_t len)
+{
+    *p++ = type;
+
+    do {
+        *p = len & 0x7f;
+        len >>= 7;
+        if (len) *p |= 0x80;
+        p++;
+    } while (len);
+
+    return(p);
+}
+
+/**
+ * @brief expand a topic template
+ */
+static void topic_expand(char *buf, int len, const char *tmpl, uint16_t sensor, const char *type)
+{
+    const char *t = tmpl;
+    int n = 0;
+
+    while (*t && n < len - 1) {
+
+        if (strncmp(t, "{sensor}", 8) == 0) {
+            n += snprintf(buf + n, len - n, "%u", sensor);
+            t += 8;
+        }
+        else if (strncmp(t, "{type}", 6) == 0) {
+            n += snprintf(buf + n, len - n, "%s", type);
+            t += 6;
+        }
+        else buf[n++] = *t++;
+    }
+
+    buf[n < len ? n : len - 1] = 0x0;
+}
+
+/**
+ * @brief number of whole messages at the start of a buffer
+ * @param len : length of buffer, set to the length of these messages
+ */
+static uint32_t msg_count(const uint8_t *buf, size_t *len)
+{
+    struct mqtt_msg m;
+    size_t off = 0;
+    uint32_t n = 0;
+
+    while (off + sizeof(m) <= *len) {
+        memcpy(&m, buf + off, sizeof(m));
+        if (off + sizeof(m) + m.tlen + m.plen > *len) break;
+
+        off += sizeof(m) + m.tlen + m.plen;
+        n++;
+    }
+
+    *len = off;
+    return(n);
+}
+
+SPSmqtt::SPSmqtt(void)
+{
+    _host[0] = 0x0;
+    _port = MQTT_PORT;
+    _client[0] = 0x0;
+    strncpy(_tmpl, MQTT_TOPIC, sizeof(_tmpl) - 1);
+    _spool[0] = 0x0;
+    _qos = 0;
+    _agg_int = 0;
+    _sensor = 0;
+    _verbose = 0;
+    _fd = _spfd = -1;
+    _sppos = _spend = 0;
+    _pktid = 0;
+    _unacked = 0;
+    _connack = -1;
+    _last_tx = 0;
+    _queue = _batch = _out = NULL;
+    _qlen = _blen = _rxlen = 0;
+    _qcount = _bcount = 0;
+    _agg_start = 0;
+    _status = -1;
+    _running = _stop = false;
+    memset(&_st, 0x0, sizeof(_st));
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+}
+
+/**
+ * @brief connection settings
+ */
+void SPSmqtt::policy(const char *topic, int qos, const char *client, const char *spool, uint32_t agg)
+{
+    if (topic) strncpy(_tmpl, topic, sizeof(_tmpl) - 1);
+    if (client) strncpy(_client, client, sizeof(_client) - 1);
+    if (spool) strncpy(_spool, spool, sizeof(_spool) - 1);
+
+    _qos = qos > 0 ? 1 : 0;
+    _agg_int = agg;
+}
+
+/**
+ * @brief start the publisher
+ */
+int SPSmqtt::open(const char *host, uint16_t sensor, int verbose)
+{
+    struct mqtt_spool_header h;
+    struct stat st;
+    char   *p;
+
+    strncpy(_host, host, sizeof(_host) - 1);
+
+    if ((p = strrchr(_host, ':')) != NULL) {
+        *p++ = 0x0;
+        _port = (uint16_t) strtol(p, NULL, 10);
+    }
+
+    _sensor = sensor;
+    _verbose = verbose;
+
+    if (_client[0] == 0x0) snprintf(_client, sizeof(_client), "sps30-%u", sensor);
+
+    for (int i = 0; i < MQTT_TYPES; i++)
+        topic_expand(_topic[i], sizeof(_topic[i]), _tmpl, sensor, mqtt_type_name[i]);
+
+    _queue = (uint8_t *) malloc(MQTT_QUEUE);
+    _batch = (uint8_t *) malloc(MQTT_BATCH);
+    _out = (uint8_t *) malloc(MQTT_BATCH * 2);
+
+    if (_queue == NULL || _batch == NULL || _out == NULL) {
+        printf("MQTT: out of memory\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    // messages left in the spool are sent after the connect
+    if (_spool[0] != 0x0) {
+
+        if ((_spfd = ::open(_spool, O_RDWR | O_CREAT, 0644)) < 0 || fstat(_spfd, &st) != 0) {
+            printf("MQTT: can not open spool %s\n", _spool);
+            close();
+            return(STORE_ERROR);
+        }
+
+        if (pread(_spfd, &h, sizeof(h), 0) != sizeof(h) || h.magic != MQTT_SPOOL_MAGIC
+            || h.pos < sizeof(h) || h.pos > (uint64_t) st.st_size) {
+
+            if (st.st_size > 0) printf("MQTT: spool %s is not valid, restarted\n", _spool);
+
+            memset(&h, 0x0, sizeof(h));
+            h.magic = MQTT_SPOOL_MAGIC;
+            h.pos = sizeof(h);
+
+            if (ftruncate(_spfd, 0) != 0 || pwrite(_spfd, &h, sizeof(h), 0) != sizeof(h)) {
+                printf("MQTT: can not write spool %s\n", _spool);
+                close();
+                return(STORE_ERROR);
+            }
+
+            st.st_size = sizeof(h);
+        }
+
+        _sppos = h.pos;
+        _spend = st.st_size;
+
+        if (_verbose && _spend > _sppos)
+            printf("MQTT: %llu bytes in spool %s to send\n", (unsigned long long) (_spend - _sppos), _spool);
+    }
+
+    store_agg_init(&_agg);
+    _stop = false;
+
+    if (pthread_create(&_thread, NULL, thread, this) != 0) {
+        printf("MQTT: can not start publisher\n");
+        close();
+        return(STORE_ERROR);
+    }
+
+    _running = true;
+    return(STORE_OK);
+}
+
+/**
+ * @brief add a message to the queue (lock held)
+ */
+void SPSmqtt::queue(int type, const char *payload, int plen)
+{
+    struct mqtt_msg m;
+    size_t len;
+
+    m.type = type;
+    m.retain = (type == MQTT_STATUS);
+    m.tlen = strlen(_topic[type]);
+    m.plen = plen;
+
+    len = sizeof(m) + m.tlen + m.plen;
+
+    // keep the order: the queue goes to the spool first
+    if (_qlen + len > MQTT_QUEUE) queue_spool();
+
+    if (_qlen + len > MQTT_QUEUE) {
+        _st.dropped++;
+        return;
+    }
+
+    memcpy(_queue + _qlen, &m, sizeof(m));
+    memcpy(_queue + _qlen + sizeof(m), _topic[type], m.tlen);
+    memcpy(_queue + _qlen + sizeof(m) + m.tlen, payload, m.plen);
+
+    _qlen += len;
+    _qcount++;
+}
+
+/**
+ * @brief move the queue to the spool (lock held). Without a spool the
+ * messages are lost.
+ */
+void SPSmqtt::queue_spool()
+{
+    if (_qlen == 0) return;
+
+    spool_append(_queue, _qlen, _qcount);
+
+    _qlen = 0;
+    _qcount = 0;
+}
+
+/**
+ * @brief append messages to the spool (lock held)
+ */
+int SPSmqtt::spool_append(const uint8_t *buf, size_t len, uint32_t count)
+{
+    if (_spfd < 0 || _spend + len > MQTT_SPOOL_MAX) {
+        _st.dropped += count;
+        return(STORE_ERROR);
+    }
+
+    if (pwrite(_spfd, buf, len, _spend) != (ssize_t) len) {
+        printf("MQTT: can not write spool %s\n", _spool);
+        _st.dropped += count;
+        return(STORE_ERROR);
+    }
+
+    _spend += len;
+    _st.spooled += count;
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief the batch from the spool was sent (lock held)
+ */
+void SPSmqtt::spool_done()
+{
+    struct mqtt_spool_header h;
+
+    _sppos += _blen;
+
+    // all sent : start again at the beginning
+    if (_sppos >= _spend) {
+        _sppos = _spend = sizeof(h);
+        if (ftruncate(_spfd, _spend) != 0) printf("MQTT: can not truncate spool %s\n", _spool);
+    }
+
+    memset(&h, 0x0, sizeof(h));
+    h.magic = MQTT_SPOOL_MAGIC;
+    h.pos = _sppos;
+
+    if (pwrite(_spfd, &h, sizeof(h), 0) != sizeof(h)) printf("MQTT: can not write spool %s\n", _spool);
+}
+
+/**
+ * @brief publish a sample, status and aggregate
+ */
+void SPSmqtt::sample(const struct sps_sample *s)
+{
+    char   buf[MQTT_MSG_MAX];
+    struct timespec t0, t1;
+    int    n, status;
+
+    if (! _running) return;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    n = snprintf(buf, sizeof(buf), "{\"ts\":%u,\"sensor\":%u,\"MassPM1\":%.4f,\"MassPM2\":%.4f,"
+        "\"MassPM4\":%.4f,\"MassPM10\":%.4f,\"NumPM0\":%.4f,\"NumPM1\":%.4f,\"NumPM2\":%.4f,"
+        "\"NumPM4\":%.4f,\"NumPM10\":%.4f,\"PartSize\":%.4f,\"status\":%u,\"quality\":%u}", s->ts, s->sensor,
+        s->v.MassPM1, s->v.MassPM2, s->v.MassPM4, s->v.MassPM10, s->v.NumPM0, s->v.NumPM1,
+        s->v.NumPM2, s->v.NumPM4, s->v.NumPM10, s->v.PartSize, s->flags & SPS_FLAG_STATUS, s->flags >> 8);
+
+    pthread_mutex_lock(&_lock);
+
+    queue(MQTT_SAMPLE, buf, n);
+
+    // the status register, when it changed
+    status = s->flags & SPS_FLAG_STATUS;
+
+    if (status != _status) {
+        n = snprintf(buf, sizeof(buf), "{\"online\":true,\"ts\":%u,\"status\":%u,\"speed\":%s,"
+            "\"laser\":%s,\"fan\":%s}", s->ts, status,
+            status & MQTT_SPEED_ERROR ? "true" : "false",
+            status & MQTT_LASER_ERROR ? "true" : "false",
+            status & MQTT_FAN_ERROR ? "true" : "false");
+
+        queue(MQTT_STATUS, buf, n);
+        _status = status;
+    }
+
+    // min / mean / max per interval
+    if (_agg_int > 0) {
+
+        if (_agg.count > 0 && s->ts >= _agg_start + _agg_int) {
+            n = snprintf(buf, sizeof(buf), "{\"ts\":%u,\"sensor\":%u,\"count\":%llu", _agg_start,
+                s->sensor, (unsigned long long) _agg.count);
+
+            for (int i = 0; i < SPS_FIELDS; i++)
+                n += snprintf(buf + n, sizeof(buf) - n, ",\"%s\":[%.4f,%.4f,%.4f]", sps_field_name[i],
+                    _agg.min[i], _agg.sum[i] / _agg.count, _agg.max[i]);
+
+            n += snprintf(buf + n, sizeof(buf) - n, "}");
+
+            queue(MQTT_AGG, buf, n);
+            store_agg_init(&_agg);
+        }
+
+        if (_agg.count == 0) _agg_start = s->ts - s->ts % _agg_int;
+        store_agg_add(&_agg, s);
+    }
+
+    pthread_cond_signal(&_cond);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    _st.sample_time += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    _st.samples++;
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief send a buffer completely
+ */
+int SPSmqtt::send_all(const uint8_t *buf, size_t len)
+{
+    ssize_t r;
+
+    while (len > 0) {
+        if ((r = send(_fd, buf, len, MSG_NOSIGNAL)) <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return(STORE_ERROR);
+        }
+
+        buf += r;
+        len -= r;
+    }
+
+    _last_tx = time(NULL);
+    return(STORE_OK);
+}
+
+/**
+ * @brief read and handle packets from the broker
+ * @param timeout : milliseconds to wait for data
+ *
+ * @return
+ *  1  data handled
+ *  0  timeout
+ *  STORE_ERROR connection lost
+ */
+int SPSmqtt::receive(int timeout)
+{
+    struct pollfd pf;
+    uint32_t len;
+    ssize_t r;
+    size_t  i;
+    int     shift;
+
+    pf.fd = _fd;
+    pf.events = POLLIN;
+
+    if (poll(&pf, 1, timeout) <= 0) return(0);
+
+    if ((r = recv(_fd, _rx + _rxlen, sizeof(_rx) - _rxlen, 0)) <= 0) return(STORE_ERROR);
+    _rxlen += r;
+
+    // handle the complete packets
+    for (;;) {
+        len = 0;
+        shift = 0;
+
+        for (i = 1; i < _rxlen && i < 5; i++) {
+            len |= (_rx[i] & 0x7f) << shift;
+            shift += 7;
+            if (! (_rx[i] & 0x80)) break;
+        }
+
+        if (i >= _rxlen || i + 1 + len > _rxlen) break;
+        if (i + 1 + len > sizeof(_rx)) return(STORE_ERROR);
+
+        switch (_rx[0] & 0xf0) {
+        case MQTT_CONNACK:
+            _connack = len >= 2 ? _rx[i + 2] : 0xff;
+            break;
+        case MQTT_PUBACK:
+            if (_unacked > 0) _unacked--;
+            break;
+        }
+
+        _rxlen -= i + 1 + len;
+        memmove(_rx, _rx + i + 1 + len, _rxlen);
+    }
+
+    return(1);
+}
+
+/**
+ * @brief connect to the broker
+ */
+int SPSmqtt::connect_broker()
+{
+    struct addrinfo hints, *res, *ai;
+    struct timeval tv;
+    char   port[8], will[] = "{\"online\":false}", online[] = "{\"online\":true}";
+    uint8_t buf[512], *p;
+    uint32_t len;
+    int    one = 1;
+    time_t end;
+
+    memset(&hints, 0x0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port, sizeof(port), "%u", _port);
+
+    if (getaddrinfo(_host, port, &hints, &res) != 0) return(STORE_ERROR);
+
+    // a blocked send or connect does not stop the thread for long
+    tv.tv_sec = MQTT_ACK_WAIT;
+    tv.tv_usec = 0;
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) continue;
+
+        setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (::connect(_fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+
+        ::close(_fd);
+        _fd = -1;
+    }
+
+    freeaddrinfo(res);
+    if (_fd < 0) return(STORE_ERROR);
+
+    // CONNECT: clean session and a retained last will on the status topic
+    len = 10 + 2 + strlen(_client) + 2 + strlen(_topic[MQTT_STATUS]) + 2 + strlen(will);
+
+    p = put_hdr(buf, MQTT_CONNECT, len);
+    p = put_str(p, "MQTT", 4);
+    *p++ = 4;                                   // protocol level 3.1.1
+    *p++ = 0x02 | 0x04 | 0x20;                  // clean session, will, will retain
+    *p++ = MQTT_KEEPALIVE >> 8;
+    *p++ = MQTT_KEEPALIVE & 0xff;
+    p = put_str(p, _client, strlen(_client));
+    p = put_str(p, _topic[MQTT_STATUS], strlen(_topic[MQTT_STATUS]));
+    p = put_str(p, will, strlen(will));
+
+    _rxlen = 0;
+    _unacked = 0;
+    _connack = -1;
+
+    if (send_all(buf, p - buf) != STORE_OK) {
+        disconnect();
+        return(STORE_ERROR);
+    }
+
+    end = time(NULL) + MQTT_ACK_WAIT;
+
+    while (_connack < 0 && time(NULL) < end) {
+        if (receive(1000) < 0) break;
+    }
+
+    if (_connack != 0) {
+        if (_connack > 0) printf("MQTT: broker %s:%u refused the connection (%d)\n", _host, _port, _connack);
+        else if (_verbose) printf("MQTT: no answer from broker %s:%u\n", _host, _port);
+        disconnect();
+        return(STORE_ERROR);
+    }
+
+    // replaces the last will
+    len = 2 + strlen(_topic[MQTT_STATUS]) + strlen(online);
+    p = put_hdr(buf, MQTT_PUBLISH | 0x01, len);
+    p = put_str(p, _topic[MQTT_STATUS], strlen(_topic[MQTT_STATUS]));
+    memcpy(p, online, strlen(online));
+    p += strlen(online);
+
+    if (send_all(buf, p - buf) != STORE_OK) {
+        disconnect();
+        return(STORE_ERROR);
+    }
+
+    if (_verbose) printf("MQTT: connected to %s:%u as %s\n", _host, _port, _client);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief close the connection
+ */
+void SPSmqtt::disconnect()
+{
+    if (_fd > -1) ::close(_fd);
+    _fd = -1;
+}
+
+/**
+ * @brief wait for the PUBACKs of a batch
+ */
+int SPSmqtt::wait_acks()
+{
+    time_t end = time(NULL) + MQTT_ACK_WAIT;
+
+    while (_unacked > 0) {
+        if (time(NULL) >= end || receive(1000) < 0) return(STORE_ERROR);
+    }
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief send the messages in _batch as PUBLISH packets in one go
+ */
+int SPSmqtt::send_batch()
+{
+    struct mqtt_msg m;
+    const uint8_t *b = _batch;
+    uint8_t *p = _out;
+
+    for (uint32_t i = 0; i < _bcount; i++) {
+        memcpy(&m, b, sizeof(m));
+        b += sizeof(m);
+
+        p = put_hdr(p, MQTT_PUBLISH | _qos << 1 | m.retain, 2 + m.tlen + (_qos ? 2 : 0) + m.plen);
+        p = put_str(p, (const char *) b, m.tlen);
+        b += m.tlen;
+
+        if (_qos) {
+            if (++_pktid == 0) _pktid = 1;
+            *p++ = _pktid >> 8;
+            *p++ = _pktid & 0xff;
+        }
+
+        memcpy(p, b, m.plen);
+        p += m.plen;
+        b += m.plen;
+    }
+
+    _unacked += _qos ? _bcount : 0;
+
+    if (send_all(_out, p - _out) != STORE_OK) return(STORE_ERROR);
+
+    // handle PINGRESP etc. also with QoS 0
+    if (_qos) return(wait_acks());
+    while (receive(0) > 0);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief the background thread : connects and sends batches
+ */
+void *SPSmqtt::thread(void *arg)
+{
+    SPSmqtt *me = (SPSmqtt *) arg;
+    struct timespec ts;
+    uint8_t ping[2] = {MQTT_PINGREQ, 0};
+    bool    spool;
+    sigset_t set;
+    int     ret;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_mutex_lock(&me->_lock);
+
+    // when stopping, send what is queued if still connected
+    while (! me->_stop || (me->_fd > -1 && me->_qlen > 0 && me->_sppos >= me->_spend)) {
+
+        if (me->_fd < 0) {
+            pthread_mutex_unlock(&me->_lock);
+            ret = me->connect_broker();
+            pthread_mutex_lock(&me->_lock);
+
+            if (ret == STORE_OK) {
+                me->_st.connects++;
+                continue;
+            }
+
+            // memory stays bounded while the broker is away
+            me->queue_spool();
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += MQTT_RETRY;
+
+            while (! me->_stop) {
+                if (pthread_cond_timedwait(&me->_cond, &me->_lock, &ts) != 0) break;
+            }
+            continue;
+        }
+
+        // the spool first, the queue behind it to keep the order
+        if (me->_sppos < me->_spend) {
+            me->queue_spool();
+
+            me->_blen = me->_spend - me->_sppos;
+            if (me->_blen > MQTT_BATCH) me->_blen = MQTT_BATCH;
+
+            if (pread(me->_spfd, me->_batch, me->_blen, me->_sppos) != (ssize_t) me->_blen
+                || (me->_bcount = msg_count(me->_batch, &me->_blen)) == 0) {
+                printf("MQTT: spool %s is corrupt, discarded\n", me->_spool);
+                me->_blen = me->_spend - me->_sppos;
+                me->spool_done();
+                continue;
+            }
+
+            spool = true;
+        }
+        else if (me->_qlen > 0) {
+            memcpy(me->_batch, me->_queue, me->_qlen);
+            me->_blen = me->_qlen;
+            me->_bcount = me->_qcount;
+            me->_qlen = 0;
+            me->_qcount = 0;
+            spool = false;
+        }
+        else {
+            // nothing to send, wait for messages or the keep alive
+            ts.tv_sec = me->_last_tx + MQTT_KEEPALIVE / 2;
+            ts.tv_nsec = 0;
+
+            if (pthread_cond_timedwait(&me->_cond, &me->_lock, &ts) == ETIMEDOUT) {
+                pthread_mutex_unlock(&me->_lock);
+
+                if (me->send_all(ping, sizeof(ping)) != STORE_OK) me->disconnect();
+                else while (me->receive(0) > 0);
+
+                pthread_mutex_lock(&me->_lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_unlock(&me->_lock);
+        ret = me->send_batch();
+        pthread_mutex_lock(&me->_lock);
+
+        if (ret == STORE_OK) {
+            me->_st.published += me->_bcount;
+            me->_st.batches++;
+
+            if (spool) {
+                me->_st.replayed += me->_bcount;
+                me->spool_done();
+            }
+            continue;
+        }
+
+        // connection lost: a batch from the spool is sent again, a
+        // batch from the queue is added to the spool
+        if (me->_verbose) printf("MQTT: connection to %s:%u lost\n", me->_host, me->_port);
+
+        me->disconnect();
+        if (! spool) me->spool_append(me->_batch, me->_blen, me->_bcount);
+    }
+
+    pthread_mutex_unlock(&me->_lock);
+    return(NULL);
+}
+
+/**
+ * @brief stop the publisher
+ */
+void SPSmqtt::close()
+{
+    uint8_t buf[256], *p;
+    const char offline[] = "{\"online\":false}";
+
+    if (_running) {
+        pthread_mutex_lock(&_lock);
+        _stop = true;
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_lock);
+
+        pthread_join(_thread, NULL);
+        _running = false;
+    }
+
+    queue_spool();
+
+    // a clean disconnect does not publish the last will
+    if (_fd > -1) {
+        p = put_hdr(buf, MQTT_PUBLISH | 0x01, 2 + strlen(_topic[MQTT_STATUS]) + strlen(offline));
+        p = put_str(p, _topic[MQTT_STATUS], strlen(_topic[MQTT_STATUS]));
+        memcpy(p, offline, strlen(offline));
+        p += strlen(offline);
+        p = put_hdr(p, MQTT_DISCONNECT, 0);
+
+        send_all(buf, p - buf);
+        disconnect();
+    }
+
+    if (_spfd > -1) ::close(_spfd);
+    _spfd = -1;
+
+    free(_queue);
+    free(_batch);
+    free(_out);
+    _queue = _batch = _out = NULL;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSmqtt::stats(struct mqtt_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    pthread_mutex_unlock(&_lock);
+}
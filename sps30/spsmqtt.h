@@ -0,0 +1,194 @@
+/**
+ * SPS30 MQTT publisher header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * A small MQTT 3.1.1 client that publishes samples, aggregates and the
+ * device status, e.g. to a local mosquitto:
+ *
+ *  mosquitto_sub -v -t 'sps30/#'
+ *
+ * The topic is a template in which {sensor} is replaced by the sensor
+ * id and {type} by sample, agg or status. The payload is JSON. The
+ * status topic is retained and set to offline by the broker (last will)
+ * when the connection is lost.
+ *
+ * sample() only formats the message into a queue in memory, a thread
+ * sends it. Messages are sent in batches of up to MQTT_BATCH bytes, with
+ * QoS 1 a batch is done when the broker acknowledged all its messages.
+ *
+ * When the broker can not be reached (or the queue is full) messages are
+ * appended to a spool file. After a reconnect the spool is sent first,
+ * a batch at a time, so the memory used stays the same however long the
+ * broker was away. The spool survives a restart. Without a spool file
+ * messages are dropped when the queue is full.
+ *********************************************************************
+*/
+#ifndef SPSMQTT_H
+#define SPSMQTT_H
+
+# include <pthread.h>
+# include <limits.h>
+# include "spsstore.h"
+
+#define MQTT_PORT           1883
+#define MQTT_TOPIC          "sps30/{sensor}/{type}"
+#define MQTT_KEEPALIVE      60              // seconds
+#define MQTT_RETRY          5               // seconds between connects
+#define MQTT_ACK_WAIT       10              // seconds to wait for PUBACK
+#define MQTT_QUEUE          65536           // bytes queued in memory
+#define MQTT_BATCH          65536           // bytes sent at once
+#define MQTT_MSG_MAX        1024            // topic and payload
+#define MQTT_SPOOL_MAX      (64 * 1024 * 1024)  // bytes in spool file
+#define MQTT_SPOOL_MAGIC    0x53505351      // "SPSQ"
+
+/* message types, for {type} in the topic */
+#define MQTT_SAMPLE         0
+#define MQTT_AGG            1
+#define MQTT_STATUS         2
+#define MQTT_TYPES          3
+
+/* queued / spooled message, followed by topic and payload */
+struct mqtt_msg
+{
+    uint8_t  type;          // MQTT_SAMPLE, MQTT_AGG or MQTT_STATUS
+    uint8_t  retain;        // broker keeps the last one (status)
+    uint16_t tlen;          // topic length
+    uint16_t plen;          // payload length
+};
+
+/* header of the spool file */
+struct mqtt_spool_header
+{
+    uint32_t magic;         // MQTT_SPOOL_MAGIC
+    uint32_t reserved;
+    uint64_t pos;           // first message not yet sent
+};
+
+/* statistics of the publisher */
+struct mqtt_stats
+{
+    uint64_t samples;       // samples passed to sample()
+    uint64_t published;     // messages sent (and acknowledged with QoS 1)
+    uint64_t spooled;       // messages written to the spool
+    uint64_t replayed;      // messages sent from the spool
+    uint64_t dropped;       // messages lost (queue and spool full)
+    uint32_t connects;      // successful connects
+    uint32_t batches;       // batches sent
+    double   sample_time;   // seconds spent in sample()
+};
+
+class SPSmqtt
+{
+  public:
+
+    SPSmqtt(void);
+
+    /**
+     * @brief connection settings, call before open()
+     * @param topic    : topic template (NULL = MQTT_TOPIC)
+     * @param qos      : 0 or 1
+     * @param client   : client id (NULL = sps30-<sensor>)
+     * @param spool    : spool file (NULL = none)
+     * @param agg      : seconds between aggregates (0 = none)
+     */
+    void policy(const char *topic, int qos, const char *client, const char *spool, uint32_t agg);
+
+    /**
+     * @brief start the publisher
+     * @param host    : broker host[:port]
+     * @param sensor  : sensor id
+     * @param verbose : if > 0 connect messages are displayed
+     *
+     * @return
+     *  STORE_OK success (also if the broker can not be reached yet)
+     *  STORE_ERROR error
+     */
+    int open(const char *host, uint16_t sensor, int verbose);
+
+    /**
+     * @brief publish a sample, and the status when it changed, and the
+     * aggregate when the interval has passed
+     */
+    void sample(const struct sps_sample *s);
+
+    /**
+     * @brief stop the publisher. Messages that could not be sent are
+     * moved to the spool.
+     */
+    void close();
+
+    bool is_open() {return(_running);}
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct mqtt_stats *st);
+
+  private:
+    char     _host[256];
+    uint16_t _port;
+    char     _client[64];
+    char     _tmpl[128];
+    char     _topic[MQTT_TYPES][160];
+    char     _spool[PATH_MAX];
+    int      _qos;
+    uint32_t _agg_int;
+    uint16_t _sensor;
+    int      _verbose;
+
+    int      _fd;                   // socket, -1 if not connected
+    int      _spfd;                 // spool file, -1 if none
+    uint64_t _sppos;                // first message in spool not sent
+    uint64_t _spend;                // end of spool
+    uint16_t _pktid;                // last packet id
+    uint32_t _unacked;              // PUBACKs outstanding
+    int      _connack;              // return code, -1 = none yet
+    time_t   _last_tx;              // for keep alive
+
+    uint8_t  *_queue;               // messages waiting, in memory
+    size_t   _qlen;
+    uint32_t _qcount;
+    uint8_t  *_batch;               // messages being sent
+    size_t   _blen;
+    uint32_t _bcount;
+    uint8_t  *_out;                 // packets of a batch
+    uint8_t  _rx[256];              // received, not yet handled
+    size_t   _rxlen;
+
+    struct store_agg _agg;          // samples since _agg_start
+    uint32_t _agg_start;
+    int      _status;               // last status published, -1 = none
+
+    struct mqtt_stats _st;
+    bool     _running;
+    bool     _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t  _cond;
+
+    void queue(int type, const char *payload, int plen);
+    void queue_spool();
+    int  spool_append(const uint8_t *buf, size_t len, uint32_t count);
+    void spool_done();
+    int  connect_broker();
+    void disconnect();
+    int  send_batch();
+    int  wait_acks();
+    int  receive(int timeout);
+    int  send_all(const uint8_t *buf, size_t len);
+    static void *thread(void *arg);
+};
+
+#endif /* SPSMQTT_H */
@@ -0,0 +1,304 @@
+/**
+ * SPS30 thread pool for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spspool.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "spspool.h"
+
+/* worker number of the current thread, -1 if not a worker */
+static __thread int pool_self = -1;
+
+/* argument of a worker thread */
+struct pool_start
+{
+    SPSpool *pool;
+    int     self;
+};
+
+SPSpool::SPSpool(void)
+{
+    _threads = 0;
+    _queue = NULL;
+    _next = 0;
+    _pending = 0;
+    _queued = 0;
+    _stop = false;
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_work, NULL);
+    pthread_cond_init(&_idle, NULL);
+}
+
+/**
+ * @brief start the workers
+ * @param threads : number of workers, 0 = number of CPUs
+ */
+int SPSpool::start(int threads)
+{
+    struct pool_start *ps;
+
+    if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+    if ((_queue = (struct pool_queue *) calloc(threads, sizeof(struct pool_queue))) == NULL)
+        return(-1);
+
+    for (int i = 0; i < threads; i++) pthread_mutex_init(&_queue[i].lock, NULL);
+
+    _stop = false;
+
+    for (_threads = 0; _threads < threads; _threads++) {
+
+        if ((ps = (struct pool_start *) malloc(sizeof(struct pool_start))) == NULL) break;
+
+        ps->pool = this;
+        ps->self = _threads;
+
+        if (pthread_create(&_thread[_threads], NULL, worker, ps) != 0) {
+            free(ps);
+            break;
+        }
+    }
+
+    if (_threads == 0) {
+        printf("Pool: can not start threads\n");
+        return(-1);
+    }
+
+    return(0);
+}
+
+/**
+ * @brief add a task to queue q
+ */
+int SPSpool::push(int q, pool_fn fn, void *arg)
+{
+    struct pool_queue *pq = &_queue[q];
+    struct pool_task *t;
+    uint32_t n;
+
+    pthread_mutex_lock(&pq->lock);
+
+    // grow the ring buffer, keep the order
+    if (pq->count == pq->size) {
+        n = pq->size ? pq->size * 2 : 64;
+
+        if ((t = (struct pool_task *) malloc(n * sizeof(struct pool_task))) == NULL) {
+            pthread_mutex_unlock(&pq->lock);
+            return(-1);
+        }
+
+        for (uint32_t i = 0; i < pq->count; i++) t[i] = pq->task[(pq->head + i) % pq->size];
+
+        free(pq->task);
+        pq->task = t;
+        pq->size = n;
+        pq->head = 0;
+    }
+
+    t = &pq->task[(pq->head + pq->count) % pq->size];
+    t->fn = fn;
+    t->arg = arg;
+    pq->count++;
+
+    pthread_mutex_unlock(&pq->lock);
+
+    pthread_mutex_lock(&_lock);
+    _pending++;
+    _queued++;
+    pthread_cond_signal(&_work);
+    pthread_mutex_unlock(&_lock);
+
+    return(0);
+}
+
+/**
+ * @brief add a task
+ */
+int SPSpool::submit(pool_fn fn, void *arg)
+{
+    if (_threads == 0) return(-1);
+
+    // from a task of this pool : own queue, is taken first
+    if (pool_self > -1 && pool_self < _threads) return(push(pool_self, fn, arg));
+
+    return(push(__atomic_fetch_add(&_next, 1, __ATOMIC_RELAXED) % _threads, fn, arg));
+}
+
+/**
+ * @brief a task was taken from a queue
+ */
+void SPSpool::taken()
+{
+    pthread_mutex_lock(&_lock);
+    _queued--;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief get a task: newest of the own queue or oldest of another
+ *
+ * @return true if a task was found
+ */
+bool SPSpool::get(int self, struct pool_task *t)
+{
+    struct pool_queue *pq = &_queue[self];
+
+    pthread_mutex_lock(&pq->lock);
+
+    if (pq->count > 0) {
+        pq->count--;
+        *t = pq->task[(pq->head + pq->count) % pq->size];
+        pq->done++;
+        pthread_mutex_unlock(&pq->lock);
+        taken();
+        return(true);
+    }
+
+    pthread_mutex_unlock(&pq->lock);
+
+    // steal
+    for (int k = 1; k < _threads; k++) {
+        struct pool_queue *vq = &_queue[(self + k) % _threads];
+
+        pthread_mutex_lock(&vq->lock);
+
+        if (vq->count > 0) {
+            *t = vq->task[vq->head];
+            vq->head = (vq->head + 1) % vq->size;
+            vq->count--;
+            pthread_mutex_unlock(&vq->lock);
+
+            pthread_mutex_lock(&pq->lock);
+            pq->done++;
+            pq->stolen++;
+            pthread_mutex_unlock(&pq->lock);
+            taken();
+            return(true);
+        }
+
+        pthread_mutex_unlock(&vq->lock);
+    }
+
+    return(false);
+}
+
+/**
+ * @brief worker thread
+ */
+void *SPSpool::worker(void *arg)
+{
+    struct pool_start *ps = (struct pool_start *) arg;
+    SPSpool *p = ps->pool;
+    struct pool_task t;
+
+    pool_self = ps->self;
+    free(ps);
+
+    for (;;) {
+
+        // sleep until a task is queued
+        pthread_mutex_lock(&p->_lock);
+
+        while (p->_queued == 0 && ! p->_stop) pthread_cond_wait(&p->_work, &p->_lock);
+
+        if (p->_queued == 0 && p->_stop) {
+            pthread_mutex_unlock(&p->_lock);
+            break;
+        }
+
+        pthread_mutex_unlock(&p->_lock);
+
+        // another worker may have taken it
+        if (! p->get(pool_self, &t)) continue;
+
+        t.fn(t.arg, pool_self);
+
+        pthread_mutex_lock(&p->_lock);
+        if (--p->_pending == 0) pthread_cond_broadcast(&p->_idle);
+        pthread_mutex_unlock(&p->_lock);
+    }
+
+    return(NULL);
+}
+
+/**
+ * @brief wait until all tasks are done
+ */
+void SPSpool::wait()
+{
+    pthread_mutex_lock(&_lock);
+    while (_pending > 0) pthread_cond_wait(&_idle, &_lock);
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief stop the workers (after the tasks are done)
+ */
+void SPSpool::stop()
+{
+    if (_threads == 0) return;
+
+    wait();
+
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_broadcast(&_work);
+    pthread_mutex_unlock(&_lock);
+
+    for (int i = 0; i < _threads; i++) {
+        pthread_join(_thread[i], NULL);
+        pthread_mutex_destroy(&_queue[i].lock);
+        free(_queue[i].task);
+    }
+
+    free(_queue);
+    _queue = NULL;
+    _threads = 0;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSpool::stats(struct pool_stats *st)
+{
+    memset(st, 0x0, sizeof(struct pool_stats));
+    st->threads = _threads;
+
+    for (int i = 0; i < _threads; i++) {
+        pthread_mutex_lock(&_queue[i].lock);
+
+        st->tasks += _queue[i].done;
+        st->stolen += _queue[i].stolen;
+
+        if (i == 0 || _queue[i].done < st->min_done) st->min_done = _queue[i].done;
+        if (_queue[i].done > st->max_done) st->max_done = _queue[i].done;
+
+        pthread_mutex_unlock(&_queue[i].lock);
+    }
+}
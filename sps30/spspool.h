@@ -0,0 +1,124 @@
+/**
+ * SPS30 thread pool header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * A work-stealing thread pool.
+ *
+ * Each worker has its own queue of tasks. A worker takes the newest
+ * task from its own queue and, when that is empty, steals the oldest
+ * task from another worker. Tasks submitted from outside the pool are
+ * spread over the queues. Tasks of very different size (a segment that
+ * is answered from the index versus one that is scanned) are so
+ * balanced over the workers without a central queue.
+ *********************************************************************
+*/
+#ifndef SPSPOOL_H
+#define SPSPOOL_H
+
+# include <stdint.h>
+# include <pthread.h>
+
+#define POOL_MAX_THREADS    256
+
+/* a task, worker is the number of the worker running it */
+typedef void (*pool_fn)(void *arg, int worker);
+
+struct pool_task
+{
+    pool_fn fn;
+    void    *arg;
+};
+
+/* queue of one worker */
+struct pool_queue
+{
+    pthread_mutex_t lock;
+    struct pool_task *task;     // ring buffer
+    uint32_t size;              // allocated
+    uint32_t head;              // oldest (stolen from here)
+    uint32_t count;
+    uint64_t done;              // tasks run by this worker
+    uint64_t stolen;            // tasks stolen by this worker
+};
+
+/* statistics */
+struct pool_stats
+{
+    int      threads;
+    uint64_t tasks;             // tasks run
+    uint64_t stolen;            // tasks run by another worker than queued on
+    uint64_t min_done;          // least tasks run by a worker
+    uint64_t max_done;          // most tasks run by a worker
+};
+
+class SPSpool
+{
+  public:
+
+    SPSpool(void);
+
+    /**
+     * @brief start the workers
+     * @param threads : number of workers, 0 = number of CPUs
+     *
+     * @return
+     *  0 success
+     *  -1 error
+     */
+    int start(int threads);
+
+    /**
+     * @brief add a task. From a task it is added to the queue of
+     * the worker, else to the queues in turn.
+     *
+     * @return
+     *  0 success
+     *  -1 error (out of memory)
+     */
+    int submit(pool_fn fn, void *arg);
+
+    /**
+     * @brief wait until all tasks are done
+     */
+    void wait();
+
+    /**
+     * @brief stop the workers (after the tasks are done)
+     */
+    void stop();
+
+    void stats(struct pool_stats *st);
+
+    int threads() {return(_threads);}
+
+  private:
+    int      _threads;
+    struct pool_queue *_queue;
+    pthread_t _thread[POOL_MAX_THREADS];
+    uint32_t _next;             // next queue for outside submit
+    uint32_t _pending;          // tasks queued or running
+    uint32_t _queued;           // tasks queued
+    bool     _stop;
+    pthread_mutex_t _lock;      // protects _pending / _queued / _stop
+    pthread_cond_t  _work;      // tasks were added
+    pthread_cond_t  _idle;      // _pending became 0
+
+    static void *worker(void *arg);
+    bool get(int self, struct pool_task *t);
+    void taken();
+    int  push(int q, pool_fn fn, void *arg);
+};
+
+#endif /* SPSPOOL_H */
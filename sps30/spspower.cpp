@@ -0,0 +1,203 @@
+/**
+ * SPS30 adaptive power manager for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spspower.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "spspower.h"
+
+/* relative change of the samples at which the sleep is halfway */
+#define POWER_VAR_HALF      0.1
+
+/**
+ * @brief monotonic time in seconds
+ */
+static double power_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+SPSpower::SPSpower(void)
+{
+    _budget = 0;
+    _max = POWER_SLEEP_MAX;
+    _sleep = true;
+    _verbose = 0;
+    _t = 0;
+    _awake = true;
+    _reads = _stable = 0;
+    _run = 0;
+    _have_last = false;
+    _var = 0;
+    _settle = 0;
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief set the budget
+ */
+int SPSpower::open(double budget, uint32_t max, bool sleep, int verbose)
+{
+    double low = sleep ? POWER_SLEEP : POWER_IDLE;
+
+    if (budget <= low) {
+        printf("Power: a budget of %.2f mW is not above the %.2f mW of %s mode\n", budget, low,
+            sleep ? "sleep" : "idle");
+        return(STORE_ERROR);
+    }
+
+    _budget = budget;
+    _max = max;
+    _sleep = sleep;
+    _verbose = verbose;
+    _t = power_now();
+    _awake = true;
+
+    if (_verbose)
+        printf("Power: budget %.2f mW, %s mode between samples, at most %u s\n", _budget,
+            _sleep ? "sleep" : "idle (firmware below 2.0)", _max);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add the time since the last change of mode
+ *
+ * @return the time
+ */
+double SPSpower::account()
+{
+    double now = power_now(), dt = now - _t;
+
+    if (_awake) {
+        _st.awake += dt;
+        _st.energy += dt * POWER_MEASURE;
+    }
+    else {
+        _st.asleep += dt;
+        _st.energy += dt * (_sleep ? POWER_SLEEP : POWER_IDLE);
+    }
+
+    _t = now;
+    return(dt);
+}
+
+/**
+ * @brief the SPS30 was woken up
+ */
+uint32_t SPSpower::wake()
+{
+    account();
+    _awake = true;
+    _reads = 0;
+    _stable = 0;
+
+    // read from the first second until it is learned
+    return(_settle > 0 ? (uint32_t) (_settle * 3 / 4) : 0);
+}
+
+/**
+ * @brief values read while awake
+ */
+bool SPSpower::settled(const struct sps_values *v)
+{
+    double elapsed = power_now() - _t;
+    bool   stable;
+
+    if (_reads++ > 0) {
+        stable = sps_close(v, &_prev, POWER_STABLE_PCT, POWER_STABLE_ABS);
+
+        if (stable && _stable++ == 0) _run = elapsed;
+        else if (! stable) _stable = 0;
+    }
+
+    _prev = *v;
+
+    if (_stable >= 2) {
+        // where the values became stable, the first read at the latest
+        _settle = _settle > 0 ? 0.8 * _settle + 0.2 * _run : _run;
+        _st.settle = _settle;
+        return(true);
+    }
+
+    if (elapsed >= POWER_SETTLE_MAX) {
+        _st.timeouts++;
+        return(true);
+    }
+
+    return(false);
+}
+
+/**
+ * @brief the sample is taken, choose the sleep
+ */
+uint32_t SPSpower::asleep(const struct sps_values *v, uint32_t want)
+{
+    double low = _sleep ? POWER_SLEEP : POWER_IDLE;
+    double awake, shortest, r, calm, s;
+
+    awake = account();
+    _st.samples++;
+
+    // variability: relative change of PM2.5 mass and PM10 numbers
+    if (_have_last) {
+        r = fabs(v->MassPM2 - _last.MassPM2) / fmax(fabs(_last.MassPM2), 1);
+        r = fmax(r, fabs(v->NumPM10 - _last.NumPM10) / fmax(fabs(_last.NumPM10), 1));
+        _var = 0.7 * _var + 0.3 * r;
+    }
+
+    _last = *v;
+    _have_last = true;
+
+    // the shortest sleep that keeps the average of this cycle within the budget
+    shortest = _budget >= POWER_MEASURE ? 0 : awake * (POWER_MEASURE - _budget) / (_budget - low);
+
+    calm = 1 / (1 + _var / POWER_VAR_HALF);
+
+    if (want > 0) s = want > shortest ? want : shortest;
+    else s = shortest < _max ? shortest + (_max - shortest) * calm : shortest;
+
+    _st.sleep = s;
+    _awake = false;
+
+    if (_verbose)
+        printf("Power: settled in %.1f s, variability %.3f, sleep %.0f s (budget allows %.0f s)\n",
+            _settle, _var, s, shortest);
+
+    return((uint32_t) (s + 0.5));
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSpower::stats(struct power_stats *st)
+{
+    *st = _st;
+}
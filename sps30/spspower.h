@@ -0,0 +1,147 @@
+/**
+ * SPS30 adaptive power manager header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Duty cycling of the SPS30 within a power budget (option -p). Instead
+ * of the fixed wake-up delay of -F, the SPS30 is awake until its values
+ * are stable, one sample is taken and it goes to sleep for as long as
+ * the budget and the variability of the air require.
+ *
+ * Awake, the values are read every second and compared with the
+ * previous ones. They are stable when all mass and number
+ * concentrations changed less than POWER_STABLE_PCT percent (or
+ * POWER_STABLE_ABS) twice in a row. The time that took is learned: the
+ * first read after a wake-up is done at 3/4 of it, so the bus is not
+ * used while the fan and laser settle.
+ *
+ * The average power of a cycle is
+ *
+ *  (P_measure * awake + P_low * asleep) / (awake + asleep)
+ *
+ * so the budget sets the shortest sleep. Between that and the longest
+ * sleep (max) the sleep is chosen by the variability of MassPM2 and
+ * NumPM10 between samples: when the air changes the SPS30 sleeps short.
+ * With the adaptive sampler (-s) its interval is used instead, if the
+ * budget allows it.
+ *
+ * P_low is the sleep mode of firmware 2.0 and up. On older firmware the
+ * SPS30 is stopped (idle mode) instead, which uses more power. The
+ * powers are the typical values of the datasheet.
+ *
+ * The energy per sample is estimated from the time in each mode.
+ *********************************************************************
+*/
+#ifndef SPSPOWER_H
+#define SPSPOWER_H
+
+# include "spsstore.h"
+
+/* typical power of the SPS30 at 5 V in mW (datasheet) */
+#define POWER_MEASURE       300.0           // 60 mA
+#define POWER_IDLE          1.65            // 330 uA, stop()
+#define POWER_SLEEP         0.19            // 38 uA, sleep()
+
+#define POWER_SETTLE_MAX    30              // seconds awake at most
+#define POWER_STABLE_PCT    5.0             // change between reads
+#define POWER_STABLE_ABS    0.5
+#define POWER_SLEEP_MAX     600             // seconds, default max
+
+/* statistics */
+struct power_stats
+{
+    uint64_t samples;
+    uint32_t timeouts;              // not stable in POWER_SETTLE_MAX
+    double   settle;                // learned seconds to stable values
+    double   awake;                 // seconds in measurement mode
+    double   asleep;                // seconds in sleep or idle mode
+    double   energy;                // mJ
+    double   sleep;                 // last sleep chosen (s)
+};
+
+class SPSpower
+{
+  public:
+
+    SPSpower(void);
+
+    /**
+     * @brief set the budget
+     * @param budget  : average power in mW
+     * @param max     : seconds of sleep at most
+     * @param sleep   : true = sleep mode, false = idle mode (firmware < 2.0)
+     * @param verbose : if > 0 each cycle is displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR the budget is below the power of the low power mode
+     */
+    int open(double budget, uint32_t max, bool sleep, int verbose);
+
+    bool is_open() {return(_budget > 0);}
+
+    /**
+     * @brief use sleep mode (true) or idle mode
+     */
+    bool sleep_mode() {return(_sleep);}
+
+    /**
+     * @brief the SPS30 was woken up (or started)
+     *
+     * @return seconds to wait before the first read
+     */
+    uint32_t wake();
+
+    /**
+     * @brief values read while awake
+     *
+     * @return true when stable (or awake too long): take the sample
+     */
+    bool settled(const struct sps_values *v);
+
+    /**
+     * @brief the sample is taken, the SPS30 goes to sleep (or idle)
+     * @param v    : values of the sample
+     * @param want : seconds wanted by the adaptive sampler (spssampler.h)
+     *               instead of the own choice, 0 = none
+     *
+     * @return seconds to sleep
+     */
+    uint32_t asleep(const struct sps_values *v, uint32_t want = 0);
+
+    void stats(struct power_stats *st);
+
+  private:
+    double   _budget;               // mW
+    uint32_t _max;
+    bool     _sleep;
+    int      _verbose;
+
+    double   _t;                    // start of the current mode
+    bool     _awake;
+    int      _reads;                // since wake
+    int      _stable;               // stable reads in a row
+    double   _run;                  // when the stable reads started
+    struct sps_values _prev;        // previous read
+    struct sps_values _last;        // previous sample
+    bool     _have_last;
+    double   _var;                  // average relative change of samples
+    double   _settle;               // learned, 0 = not yet
+
+    struct power_stats _st;
+
+    double account();
+};
+
+#endif /* SPSPOWER_H */
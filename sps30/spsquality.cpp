@@ -0,0 +1,124 @@
+/**
+ * SPS30 sample quality for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsquality.h
+ */
+
+#include <string.h>
+#include <time.h>
+#include "spsquality.h"
+
+/**
+ * @brief monotonic time in seconds
+ */
+static double quality_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+SPSquality::SPSquality(void)
+{
+    _flags = 0;
+    _t = 0;
+    _min = 0;
+    _reads = _stable = 0;
+    _sum = 0;
+    _n = 0;
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief start(), clean() or wakeup() was done
+ */
+void SPSquality::event(uint16_t flag)
+{
+    if (_flags == 0) _st.periods++;
+
+    _flags |= flag;
+    _t = quality_now();
+    _reads = _stable = 0;
+
+    if (flag == SPS_FLAG_CLEAN) _min = QUALITY_CLEAN;
+}
+
+/**
+ * @brief values read
+ */
+uint16_t SPSquality::check(const struct sps_values *v)
+{
+    double elapsed;
+    bool   zero = true;
+
+    if (_flags == 0) return(0);
+
+    elapsed = quality_now() - _t;
+
+    // before the first measurement the values are 0
+    for (int k = 0; k < SPS_FIELDS && zero; k++) {
+        if (sps_field(v, k) != 0) zero = false;
+    }
+
+    if (_reads++ > 0 && ! zero && sps_close(v, &_prev, QUALITY_STABLE_PCT, QUALITY_STABLE_ABS))
+        _stable++;
+    else
+        _stable = 0;
+
+    _prev = *v;
+
+    if (elapsed >= _min && _stable >= QUALITY_STABLE) {
+        _sum += elapsed;
+        _n++;
+    }
+    else if (elapsed >= QUALITY_MAX)
+        _st.timeouts++;
+    else
+        return(_flags);
+
+    _flags = 0;
+    _min = 0;
+    return(0);
+}
+
+/**
+ * @brief count the quality flags of a sample
+ */
+void SPSquality::count(uint16_t flags)
+{
+    _st.samples++;
+
+    for (int i = 0; i < 8; i++) {
+        if (flags & (0x100 << i)) _st.flagged[i]++;
+    }
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSquality::stats(struct quality_stats *st)
+{
+    *st = _st;
+    st->stable = _n ? _sum / _n : 0;
+}
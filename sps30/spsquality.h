@@ -0,0 +1,110 @@
+/**
+ * SPS30 sample quality header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Every sample carries its quality in the upper byte of flags
+ * (SPS_FLAG_xxx in spssample.h), next to the status register in the
+ * lower byte:
+ *
+ *  warmup    read after start(), the values are not stable yet
+ *  clean     read during or after a fan cleaning, not stable yet
+ *  settle    read after wakeup() from sleep, not stable yet
+ *  fault     the status register reports a fan, laser or speed error
+ *  retry     the first read failed (e.g. a CRC error), read again.
+ *            When that fails too the sample is skipped
+ *  interp    not measured but interpolated (not set by sps30 itself)
+ *
+ * The end of warm-up, cleaning and settling is found in the samples
+ * instead of by a fixed delay: the values are stable when the mass and
+ * number concentrations of QUALITY_STABLE reads in a row changed less
+ * than QUALITY_STABLE_PCT percent (or QUALITY_STABLE_ABS) and are not
+ * all 0 (no measurement yet). A cleaning takes QUALITY_CLEAN seconds at
+ * least. After QUALITY_MAX seconds the values are taken as stable
+ * anyway, so reads far apart (-w) are not flagged for long.
+ *
+ * SPS_FLAG_BAD are the flags of values that can not be trusted. With
+ * -q the samples with the flags given are left out of the display,
+ * the exporters and the cube, spsagg -q leaves them out of the site
+ * rollup. The store, the circular file, the capture and the rules
+ * always get every sample.
+ *********************************************************************
+*/
+#ifndef SPSQUALITY_H
+#define SPSQUALITY_H
+
+# include "spsstore.h"
+
+#define QUALITY_STABLE      2               // stable reads in a row
+#define QUALITY_STABLE_PCT  5.0             // change between reads
+#define QUALITY_STABLE_ABS  0.5
+#define QUALITY_CLEAN       10              // seconds a fan cleaning takes
+#define QUALITY_MAX         30              // seconds until stable at most
+
+/* statistics */
+struct quality_stats
+{
+    uint64_t samples;               // output
+    uint64_t flagged[8];            // per bit of the upper byte
+    uint32_t periods;               // warm-up, cleaning or settle
+    uint32_t timeouts;              // not stable in QUALITY_MAX
+    double   stable;                // average seconds until stable
+};
+
+class SPSquality
+{
+  public:
+
+    SPSquality(void);
+
+    /**
+     * @brief start(), clean() or wakeup() was done
+     * @param flag : SPS_FLAG_WARMUP, SPS_FLAG_CLEAN or SPS_FLAG_SETTLE
+     */
+    void event(uint16_t flag);
+
+    /**
+     * @brief whether the values are not stable after an event
+     */
+    bool unstable() {return(_flags != 0);}
+
+    /**
+     * @brief values read, also those that are not output
+     *
+     * @return SPS_FLAG_WARMUP, SPS_FLAG_CLEAN and / or SPS_FLAG_SETTLE
+     * while not stable, else 0
+     */
+    uint16_t check(const struct sps_values *v);
+
+    /**
+     * @brief count the quality flags of a sample that is output
+     */
+    void count(uint16_t flags);
+
+    void stats(struct quality_stats *st);
+
+  private:
+    uint16_t _flags;                // of the current event(s)
+    double   _t;                    // start of the event
+    double   _min;                  // seconds unstable at least
+    int      _reads;                // since the event
+    int      _stable;               // stable reads in a row
+    struct sps_values _prev;
+    double   _sum;                  // seconds until stable
+    uint32_t _n;                    // periods that became stable
+
+    struct quality_stats _st;
+};
+
+#endif /* SPSQUALITY_H */
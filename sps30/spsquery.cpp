@@ -0,0 +1,1338 @@
+/*******************************************************************
+ *
+ * Query tool for the samples stored by the SPS30 monitor (option -o)
+ *
+ * Does not need the BCM2835 library or root permission. Build with:
+ *      make spsquery
+ *
+ * Examples:
+ *  PM2.5 of sensor 1 between 14:00 and 15:00
+ *      ./spsquery -d /data/sps -s 1 -f "2026-10-13 14:00" -t "2026-10-13 15:00" -F MassPM2
+ *
+ *  min / max / mean of all fields over all sensors in the store
+ *      ./spsquery -d /data/sps -a
+ *
+ *  hourly rollups of PM10 (needs option -K on the monitor)
+ *      ./spsquery -d /data/sps -r hour -F MassPM10
+ *
+ *  samples in a circular file (option -R on the monitor)
+ *      ./spsquery -R /data/sps.ring -F MassPM2
+ *
+ *  convert completed segments to columnar files and compare the scan
+ *  speed of PM2.5 and PM10 on rows and columns
+ *      ./spsquery -d /data/sps -C
+ *      ./spsquery -d /data/sps -b -F MassPM2,MassPM10
+ *
+ *  speed of the vector kernels on the PM2.5 column, threshold 25 ug/m3
+ *      ./spsquery -d /data/sps -k -F MassPM2 -x 25
+ *
+ *  PM10 of all sensors in October where PM2.5 was above 50, on all cores
+ *      ./spsquery -d /data/sps -a -j 0 -w "MassPM2>50" -F MassPM10 \
+ *          -f 2026-10-01 -t 2026-11-01
+ *
+ *  hourly PM2.5 with percentiles from the cube (option -U on the
+ *  monitor), then compare its speed with scanning the samples
+ *      ./spsquery -d /data/sps -u hour -F MassPM2 -f 2026-10-13
+ *      ./spsquery -d /data/sps -U
+ *
+ *  the samples around an alert, captured by the monitor (option -k)
+ *      ./spsquery -c /data/capture/s001-20261013-141502.cap
+ *
+ *  compression ratio and speed of zstd on raw samples and rollups, then
+ *  compress the sealed segments with level 9 (make spsquery ZSTD=yes)
+ *      ./spsquery -d /data/sps -Z
+ *      ./spsquery -d /data/sps -z 9
+ *
+ * *****************************************************************
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * version 1.0 / October 2026
+ *  - initial version
+ *  - read circular files (-R)
+ *  - convert to columnar files (-C) and scan benchmark (-b)
+ *  - benchmark of the vector kernels (-k)
+ *  - parallel aggregates over sensors (-j) with a predicate (-w)
+ *  - verify the CRC32C of segments and blocks (-V)
+ *  - compress sealed segments (-z) and zstd benchmark (-Z)
+ *  - hour and day statistics from the cube (-u) and benchmark (-U)
+ *  - read capture files (-c)
+ **********************************************************************/
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <time.h>
+# include <math.h>
+# include "spsstore.h"
+# include "spsrollup.h"
+# include "spsring.h"
+# include "spscol.h"
+# include "spskern.h"
+# include "spsengine.h"
+# include "spszip.h"
+# include "spscube.h"
+# include "spscapture.h"
+
+#define QUERY_MAJOR 1
+#define QUERY_MINOR 0
+
+/* default threshold for the count kernel (ug/m3) */
+#define KERN_THRESHOLD 25
+
+/* maximum sensors in a store */
+#define MAX_SENSORS 1024
+
+/* zstd benchmark: blocks per tier and levels */
+#define ZIP_BENCH_BLOCKS 512
+#define ZIP_BENCH_CHUNK  512                // rollups per buffer (64 KB)
+static const int zip_bench_levels[] = {1, 3, 9, 19};
+
+typedef struct query_par
+{
+    char     dir[PATH_MAX - 32];    // store directory
+    char     ring[PATH_MAX];        // circular file
+    char     capture[PATH_MAX];     // capture file
+    int      sensor;                // sensor id or -1 for all
+    uint32_t from;                  // start of range
+    uint32_t to;                    // end of range
+    bool     field[SPS_FIELDS];     // fields to display
+    bool     aggregate;             // aggregate only
+    int      tier;                  // rollup tier or -1 for samples
+    bool     convert;               // convert to columnar files
+    bool     bench;                 // row versus column benchmark
+    bool     kernels;               // kernel benchmark
+    float    threshold;             // for the count kernel
+    int      threads;               // parallel engine or -1
+    struct eng_pred pred;           // predicate for the engine
+    bool     verify;                // check CRCs
+    int      zip_level;             // compress sealed segments or -1
+    bool     zip_bench;             // zstd benchmark
+    int      cube;                  // cube tier or -1
+    bool     cube_bench;            // cube versus samples benchmark
+    int      verbose;               // verbose level
+} query_par;
+
+char progname[20];
+
+/*********************************************************************
+ * @brief current time in microseconds (for the timing)
+ *********************************************************************/
+static double now_us()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return(t.tv_sec * 1e6 + t.tv_nsec / 1e3);
+}
+
+/*********************************************************************
+ * @brief parse a time
+ * @param s : seconds since epoch or "YYYY-MM-DD [HH:MM[:SS]]" local time
+ *
+ * @return the time or exits on error
+ *********************************************************************/
+static uint32_t parse_time(const char *s)
+{
+    struct tm tm;
+    char *p;
+    unsigned long t;
+
+    t = strtoul(s, &p, 10);
+    if (*p == 0x0) return((uint32_t) t);
+
+    memset(&tm, 0x0, sizeof(tm));
+
+    if ((p = strptime(s, "%Y-%m-%d", &tm)) != NULL) {
+        while (*p == ' ' || *p == 'T') p++;
+
+        if (*p == 0x0 || strptime(p, "%H:%M:%S", &tm) != NULL || strptime(p, "%H:%M", &tm) != NULL) {
+            tm.tm_isdst = -1;
+            return((uint32_t) mktime(&tm));
+        }
+    }
+
+    printf("Invalid time %s. Use seconds or \"YYYY-MM-DD HH:MM:SS\"\n", s);
+    exit(EXIT_FAILURE);
+}
+
+/*********************************************************************
+ * @brief format a timestamp as local time
+ *********************************************************************/
+static void time_str(uint32_t ts, char *buf, int len)
+{
+    time_t t = ts;
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    strftime(buf, len, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+/*********************************************************************
+ * @brief display one sample (callback from SPSread::read)
+ *********************************************************************/
+static bool disp_sample(const struct sps_sample *s, void *ctx)
+{
+    query_par *q = (query_par *) ctx;
+    char buf[30];
+
+    time_str(s->ts, buf, sizeof(buf));
+    printf("%s,%u", buf, s->sensor);
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (q->field[i]) printf(",%.4f", sps_field(&s->v, i));
+    }
+
+    printf("\n");
+    return(true);
+}
+
+/*********************************************************************
+ * @brief display one rollup (callback from rollup_read)
+ *********************************************************************/
+static bool disp_rollup(const struct sps_rollup *r, void *ctx)
+{
+    query_par *q = (query_par *) ctx;
+    char buf[30];
+
+    time_str(r->ts, buf, sizeof(buf));
+    printf("%s,%u", buf, r->count);
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (q->field[i]) printf(",%.4f,%.4f,%.4f", r->min[i], r->max[i], r->mean[i]);
+    }
+
+    printf("\n");
+    return(true);
+}
+
+/*********************************************************************
+ * @brief display an aggregate
+ *********************************************************************/
+static void disp_agg(query_par *q, const char *label, struct store_agg *agg)
+{
+    printf("%s: %llu samples\n", label, (unsigned long long) agg->count);
+
+    if (agg->count == 0) return;
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (! q->field[i]) continue;
+
+        printf("  %-9s min %10.4f  max %10.4f  mean %10.4f\n", sps_field_name[i],
+            agg->min[i], agg->max[i], agg->sum[i] / agg->count);
+    }
+}
+
+/*********************************************************************
+ * @brief scan the selected fields of the rows of one segment
+ * @param rd    : reader on the sensor
+ * @param first : first index entry of the segment
+ * @param last  : last index entry (exclusive)
+ * @param agg   : to add the result
+ *********************************************************************/
+static int scan_rows(query_par *q, SPSread *rd, uint32_t first, uint32_t last, struct store_agg *agg)
+{
+    const struct store_idx *e;
+    const struct sps_sample *r;
+    float f;
+
+    for (uint32_t i = first; i < last; i++) {
+        e = rd->entry(i);
+
+        if ((r = rd->block(e)) == NULL) return(-1);
+
+        for (int k = 0; k < SPS_FIELDS; k++) {
+            if (! q->field[k]) continue;
+
+            for (uint32_t j = 0; j < e->count; j++) {
+                f = sps_field(&r[j].v, k);
+                if (f < agg->min[k]) agg->min[k] = f;
+                if (f > agg->max[k]) agg->max[k] = f;
+                agg->sum[k] += f;
+            }
+        }
+
+        agg->count += e->count;
+    }
+
+    return(0);
+}
+
+/*********************************************************************
+ * @brief scan the selected fields of a columnar file
+ *********************************************************************/
+static void scan_cols(query_par *q, SPScol *col, struct store_agg *agg)
+{
+    const float *c;
+    uint32_t n = col->count();
+
+    for (int k = 0; k < SPS_FIELDS; k++) {
+        if (! q->field[k]) continue;
+
+        c = col->field(k);
+
+        for (uint32_t j = 0; j < n; j++) {
+            if (c[j] < agg->min[k]) agg->min[k] = c[j];
+            if (c[j] > agg->max[k]) agg->max[k] = c[j];
+            agg->sum[k] += c[j];
+        }
+    }
+
+    agg->count += n;
+}
+
+/*********************************************************************
+ * @brief compare the scan speed of rows and columns of a sensor
+ *
+ * Only segments with a columnar file are used, so both scans see the
+ * same samples. The best of BENCH_RUNS passes is reported.
+ *********************************************************************/
+#define BENCH_RUNS 5
+
+static int bench_sensor(query_par *q, uint16_t sensor)
+{
+    SPSread rd;
+    SPScol  col;
+    struct store_agg ra, ca;
+    double start, t, trow = 0, tcol = 0;
+    uint32_t i, j;
+    int    fields = 0;
+
+    for (int k = 0; k < SPS_FIELDS; k++) if (q->field[k]) fields++;
+
+    if (rd.open(q->dir, sensor) != STORE_OK) {
+        printf("Can not open sensor %d in %s\n", sensor, q->dir);
+        return(-1);
+    }
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        store_agg_init(&ra);
+        store_agg_init(&ca);
+        t = 0;
+
+        // rows
+        for (i = 0; i < rd.entries(); i = j) {
+            for (j = i; j < rd.entries() && rd.entry(j)->seg == rd.entry(i)->seg; j++);
+
+            if (col.open(q->dir, sensor, rd.entry(i)->seg) != STORE_OK) continue;
+
+            start = now_us();
+            if (scan_rows(q, &rd, i, j, &ra) != 0) {
+                printf("Error during reading sensor %d\n", sensor);
+                col.close();
+                rd.close();
+                return(-1);
+            }
+            t += now_us() - start;
+        }
+
+        if (run == 0 || t < trow) trow = t;
+        t = 0;
+
+        // columns
+        for (i = 0; i < rd.entries(); i = j) {
+            for (j = i; j < rd.entries() && rd.entry(j)->seg == rd.entry(i)->seg; j++);
+
+            if (col.open(q->dir, sensor, rd.entry(i)->seg) != STORE_OK) continue;
+
+            start = now_us();
+            scan_cols(q, &col, &ca);
+            t += now_us() - start;
+        }
+
+        if (run == 0 || t < tcol) tcol = t;
+    }
+
+    col.close();
+
+    if (ca.count == 0) {
+        printf("sensor %d: no columnar files, convert with -C first\n", sensor);
+        rd.close();
+        return(0);
+    }
+
+    printf("sensor %d: %llu samples, %d fields, best of %d\n", sensor,
+        (unsigned long long) ca.count, fields, BENCH_RUNS);
+    printf("  rows    %10.1f us  %8.1f Msamples/s  %8.1f MB read\n", trow, ra.count / trow,
+        ra.count * (double) sizeof(struct sps_sample) / 1e6);
+    printf("  columns %10.1f us  %8.1f Msamples/s  %8.1f MB read\n", tcol, ca.count / tcol,
+        ca.count * (double) (fields * sizeof(float)) / 1e6);
+    printf("  speedup %.2f\n", trow / tcol);
+
+    // both must give the same answer
+    for (int k = 0; k < SPS_FIELDS; k++) {
+        if (q->field[k] && (ra.min[k] != ca.min[k] || ra.max[k] != ca.max[k] || ra.sum[k] != ca.sum[k]))
+            printf("  %s: row and column result differ\n", sps_field_name[k]);
+    }
+
+    rd.close();
+    return(0);
+}
+
+/*********************************************************************
+ * @brief load one field and the timestamps of all columnar files of a
+ * sensor into aligned buffers
+ * @param ts : to store the timestamp column (free after use)
+ * @param x  : to store the field column (free after use)
+ *
+ * @return number of samples or -1 on error
+ *********************************************************************/
+static long load_column(query_par *q, uint16_t sensor, int field, uint32_t **ts, float **x)
+{
+    SPSread rd;
+    SPScol  col;
+    uint32_t i, j;
+    size_t  n = 0, k = 0;
+    void    *p1, *p2;
+
+    if (rd.open(q->dir, sensor) != STORE_OK) return(-1);
+
+    for (int pass = 0; pass < 2; pass++) {
+
+        for (i = 0; i < rd.entries(); i = j) {
+            for (j = i; j < rd.entries() && rd.entry(j)->seg == rd.entry(i)->seg; j++);
+
+            if (col.open(q->dir, sensor, rd.entry(i)->seg) != STORE_OK) continue;
+
+            if (pass == 0) n += col.count();
+            else {
+                memcpy(*ts + k, col.ts(), col.count() * sizeof(uint32_t));
+                memcpy(*x + k, col.field(field), col.count() * sizeof(float));
+                k += col.count();
+            }
+        }
+
+        if (pass == 0) {
+            if (n == 0 || posix_memalign(&p1, 64, n * sizeof(uint32_t)) != 0) break;
+
+            if (posix_memalign(&p2, 64, n * sizeof(float)) != 0) {
+                free(p1);
+                n = 0;
+                break;
+            }
+
+            *ts = (uint32_t *) p1;
+            *x = (float *) p2;
+        }
+    }
+
+    col.close();
+    rd.close();
+    return((long) n);
+}
+
+/*********************************************************************
+ * @brief benchmark the kernels on the first selected field
+ *
+ * Each kernel is run BENCH_RUNS times and the best is reported in GB/s
+ * of column data, with the speedup against the scalar version. The
+ * results are checked against the scalar version.
+ *********************************************************************/
+#define HIST_BINS 64
+
+static int bench_kernels(query_par *q, uint16_t sensor)
+{
+    const struct kern_ops *list[4];
+    struct kern_agg agg[4];
+    uint32_t *ts = NULL, hist[4][HIST_BINS];
+    float   *x = NULL, mn[4], mx[4], width;
+    double  sum[4], best[5], start, t;
+    size_t  cnt[4];
+    int     field, nk;
+    long    n;
+    const char *ops[5] = {"sum", "minmax", "count_gt", "hist", "range"};
+
+    for (field = 0; field < SPS_FIELDS && ! q->field[field]; field++);
+
+    if (field == SPS_FIELDS) return(-1);
+
+    if ((n = load_column(q, sensor, field, &ts, &x)) <= 0) {
+        printf("sensor %d: no columnar files, convert with -C first\n", sensor);
+        return(n < 0 ? -1 : 0);
+    }
+
+    nk = kern_list(list, 4);
+
+    // histogram from 0 to the maximum
+    list[0]->minmax(x, n, &mn[0], &mx[0]);
+    width = mx[0] > 0 ? mx[0] / HIST_BINS : 1;
+
+    printf("sensor %d: %s, %ld samples, %.1f MB, best of %d (selected: %s)\n", sensor,
+        sps_field_name[field], n, n * sizeof(float) / 1e6, BENCH_RUNS, kern_select(NULL)->name);
+
+    for (int op = 0; op < 5; op++) {
+
+        for (int k = 0; k < nk; k++) {
+
+            best[k] = 0;
+
+            for (int run = 0; run < BENCH_RUNS; run++) {
+                memset(hist[k], 0x0, sizeof(hist[k]));
+                kern_agg_init(&agg[k]);
+                start = now_us();
+
+                switch (op) {
+                case 0: sum[k] = list[k]->sum(x, n); break;
+                case 1: list[k]->minmax(x, n, &mn[k], &mx[k]); break;
+                case 2: cnt[k] = list[k]->count_gt(x, n, q->threshold); break;
+                case 3: list[k]->hist(x, n, 0, width, hist[k], HIST_BINS); break;
+                case 4: list[k]->range(ts, x, n, q->from, q->to, &agg[k]); break;
+                }
+
+                t = now_us() - start;
+                if (run == 0 || t < best[k]) best[k] = t;
+            }
+
+            // same answer as scalar ?
+            bool ok = true;
+
+            switch (op) {
+            case 0: ok = fabs(sum[k] - sum[0]) <= 1e-5 * fabs(sum[0]) + 1e-3; break;
+            case 1: ok = mn[k] == mn[0] && mx[k] == mx[0]; break;
+            case 2: ok = cnt[k] == cnt[0]; break;
+            case 3: ok = memcmp(hist[k], hist[0], sizeof(hist[0])) == 0; break;
+            case 4: ok = agg[k].count == agg[0].count && agg[k].min == agg[0].min && agg[k].max == agg[0].max
+                      && fabs(agg[k].sum - agg[0].sum) <= 1e-5 * fabs(agg[0].sum) + 1e-3; break;
+            }
+
+            // bytes read : the range kernel also reads the timestamps
+            printf("  %-9s %-7s %9.1f us %7.2f GB/s %6.2fx%s\n", ops[op], list[k]->name, best[k],
+                n * (op == 4 ? 8.0 : 4.0) / (best[k] * 1e3), best[0] / best[k],
+                ok ? "" : "  result differs");
+        }
+    }
+
+    free(ts);
+    free(x);
+    return(0);
+}
+
+/*********************************************************************
+ * @brief display one cell of the cube (callback from SPScube::read)
+ *********************************************************************/
+static bool disp_cell(const struct cube_cell *c, void *ctx)
+{
+    query_par *q = (query_par *) ctx;
+    const struct cube_field *f;
+    char buf[30];
+
+    time_str(c->ts, buf, sizeof(buf));
+    printf("%s,%u", buf, c->f[0].count);
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (! q->field[i]) continue;
+
+        f = &c->f[i];
+        printf(",%.4f,%.4f,%.4f,%.4f,%.4f", f->min, f->max, f->sum / f->count,
+            cube_quantile(f, 0.5), cube_quantile(f, 0.95));
+    }
+
+    printf("\n");
+    return(true);
+}
+
+/*********************************************************************
+ * @brief add a cell to a total (callback from SPScube::read)
+ *********************************************************************/
+static bool merge_cell(const struct cube_cell *c, void *ctx)
+{
+    cube_merge((struct cube_cell *) ctx, c);
+    return(true);
+}
+
+/*********************************************************************
+ * @brief display the cells of a sensor, or with -a their total
+ *********************************************************************/
+static int query_cube(query_par *q, uint16_t sensor)
+{
+    SPScube cube;
+    struct cube_cell *total;
+    const struct cube_field *f;
+    double start = now_us();
+    long   n;
+
+    if (cube.open(q->dir, sensor, false, 0, q->verbose) != STORE_OK) {
+        printf("sensor %d: no cube, start the monitor with -U\n", sensor);
+        return(-1);
+    }
+
+    if (! q->aggregate) {
+        n = cube.read(q->cube, q->from, q->to, disp_cell, q);
+
+        if (q->verbose)
+            printf("# sensor %d: %ld cells (count, min, max, mean, p50, p95 per field), took %.1f us\n",
+                sensor, n, now_us() - start);
+
+        cube.close();
+        return(0);
+    }
+
+    if ((total = (struct cube_cell *) calloc(1, sizeof(struct cube_cell))) == NULL) {
+        cube.close();
+        return(-1);
+    }
+
+    n = cube.read(q->cube, q->from, q->to, merge_cell, total);
+
+    printf("sensor %d: %u samples in %ld cells\n", sensor, total->f[0].count, n);
+
+    for (int i = 0; i < SPS_FIELDS && total->f[0].count; i++) {
+        if (! q->field[i]) continue;
+
+        f = &total->f[i];
+        printf("  %-9s min %10.4f  max %10.4f  mean %10.4f  p50 %10.4f  p95 %10.4f\n", sps_field_name[i],
+            f->min, f->max, f->sum / f->count, cube_quantile(f, 0.5), cube_quantile(f, 0.95));
+    }
+
+    if (q->verbose) printf("  took %.1f us\n", now_us() - start);
+
+    free(total);
+    cube.close();
+    return(0);
+}
+
+/* result per bucket of the cube benchmark */
+typedef struct cube_bench
+{
+    uint32_t from;                  // start of the first bucket
+    uint32_t bucket;                // seconds
+    uint32_t n;                     // buckets
+    struct store_agg *agg;
+} cube_bench;
+
+static bool bench_cell(const struct cube_cell *c, void *ctx)
+{
+    cube_bench *b = (cube_bench *) ctx;
+    struct store_agg *a = &b->agg[(c->ts - b->from) / b->bucket];
+
+    a->count = c->f[0].count;
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        a->min[i] = c->f[i].min;
+        a->max[i] = c->f[i].max;
+        a->sum[i] = c->f[i].sum;
+    }
+
+    return(true);
+}
+
+static bool bench_sample(const struct sps_sample *s, void *ctx)
+{
+    cube_bench *b = (cube_bench *) ctx;
+
+    store_agg_add(&b->agg[(s->ts - b->from) / b->bucket], s);
+    return(true);
+}
+
+/*********************************************************************
+ * @brief compare the hour and day statistics from the cube with a
+ * scan of the samples and with the aggregate of the store (which uses
+ * the statistics in the block headers)
+ *********************************************************************/
+static int bench_cube(query_par *q, uint16_t sensor)
+{
+    static const char *tier_name[CUBE_TIERS] = {"hour", "day"};
+    SPScube cube;
+    SPSread rd;
+    cube_bench b[3];
+    uint32_t from, to, last, span, oldest, diff;
+    double best[3], start, t;
+
+    if (cube.open(q->dir, sensor, false, 0, q->verbose) != STORE_OK) {
+        printf("sensor %d: no cube, start the monitor with -U\n", sensor);
+        return(-1);
+    }
+
+    if (rd.open(q->dir, sensor) != STORE_OK) {
+        printf("Can not open sensor %d in %s\n", sensor, q->dir);
+        cube.close();
+        return(-1);
+    }
+
+    printf("sensor %d: best of %d\n", sensor, BENCH_RUNS);
+
+    for (int tier = 0; tier < CUBE_TIERS; tier++) {
+        // the buckets the cube still has
+        last = cube.header()->last;
+        span = cube_bucket(tier) * (cube.header()->cells[tier] - 1);
+        oldest = last - last % cube_bucket(tier);
+        oldest = oldest > span ? oldest - span : 0;
+        to = q->to < last ? q->to : last;
+        from = q->from > oldest ? q->from : oldest;
+        from -= from % cube_bucket(tier);
+
+        if (from > to) continue;
+
+        for (int m = 0; m < 3; m++) {
+            b[m].from = from;
+            b[m].bucket = cube_bucket(tier);
+            b[m].n = (to - from) / b[m].bucket + 1;
+            b[m].agg = (struct store_agg *) malloc(b[m].n * sizeof(struct store_agg));
+
+            if (b[m].agg == NULL) {
+                printf("out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+
+            for (int run = 0; run < BENCH_RUNS; run++) {
+                for (uint32_t i = 0; i < b[m].n; i++) store_agg_init(&b[m].agg[i]);
+
+                start = now_us();
+
+                switch (m) {
+                case 0: cube.read(tier, from, to, bench_cell, &b[m]); break;
+                case 1: rd.read(from, to, bench_sample, &b[m]); break;
+                case 2:
+                    for (uint32_t i = 0; i < b[m].n; i++) {
+                        t = from + i * b[m].bucket + b[m].bucket - 1;
+                        rd.aggregate(from + i * b[m].bucket, t < to ? (uint32_t) t : to, &b[m].agg[i]);
+                    }
+                    break;
+                }
+
+                t = now_us() - start;
+                if (run == 0 || t < best[m]) best[m] = t;
+            }
+        }
+
+        // the same counts, min, max and sums
+        diff = 0;
+
+        for (uint32_t i = 0; i < b[0].n; i++) {
+            for (int m = 1; m < 3; m++) {
+                if (b[0].agg[i].count != b[m].agg[i].count) { diff++; continue; }
+                if (b[0].agg[i].count == 0) continue;
+
+                for (int k = 0; k < SPS_FIELDS; k++) {
+                    if (b[0].agg[i].min[k] != b[m].agg[i].min[k] || b[0].agg[i].max[k] != b[m].agg[i].max[k]
+                        || fabs(b[0].agg[i].sum[k] - b[m].agg[i].sum[k]) > 1e-6 * fabs(b[0].agg[i].sum[k]) + 1e-3) {
+                        diff++;
+                        break;
+                    }
+                }
+            }
+        }
+
+        printf("  %-4s %6u buckets: cube %10.1f us, scan %10.1f us (%.0fx), aggregate %10.1f us (%.0fx)%s\n",
+            tier_name[tier], b[0].n, best[0], best[1], best[1] / best[0], best[2], best[2] / best[0],
+            diff ? "" : ", same result");
+        if (diff) printf("  %u buckets differ (samples added meanwhile, or stored before the cube)\n", diff);
+
+        for (int m = 0; m < 3; m++) free(b[m].agg);
+    }
+
+    rd.close();
+    cube.close();
+    return(0);
+}
+
+/*********************************************************************
+ * @brief query one sensor
+ *********************************************************************/
+static int query_sensor(query_par *q, uint16_t sensor)
+{
+    SPSread rd;
+    struct store_agg agg;
+    char label[30];
+    double start;
+    long n;
+
+    if (q->convert) {
+        start = now_us();
+
+        if ((n = col_convert(q->dir, sensor, q->verbose)) < 0) {
+            printf("Error during converting sensor %d\n", sensor);
+            return(-1);
+        }
+
+        printf("sensor %d: %ld columnar files written, took %.1f ms\n", sensor, n, (now_us() - start) / 1000);
+        return(0);
+    }
+
+    if (q->bench) return(bench_sensor(q, sensor));
+
+    if (q->kernels) return(bench_kernels(q, sensor));
+
+    if (q->cube_bench) return(bench_cube(q, sensor));
+
+    if (q->cube > -1) return(query_cube(q, sensor));
+
+    if (q->tier > -1) {
+        start = now_us();
+        n = rollup_read(q->dir, sensor, q->tier, q->from, q->to, disp_rollup, q);
+
+        if (q->verbose)
+            printf("# sensor %d: %ld rollups (count, min, max, mean per field), took %.1f us\n",
+                sensor, n, now_us() - start);
+
+        return(n < 0 ? -1 : 0);
+    }
+
+    if (rd.open(q->dir, sensor) != STORE_OK) {
+        printf("Can not open sensor %d in %s\n", sensor, q->dir);
+        return(-1);
+    }
+
+    start = now_us();
+
+    if (q->aggregate) {
+        store_agg_init(&agg);
+
+        if (rd.aggregate(q->from, q->to, &agg) != STORE_OK) {
+            printf("Error during reading sensor %d\n", sensor);
+            return(-1);
+        }
+
+        snprintf(label, sizeof(label), "sensor %d", sensor);
+        disp_agg(q, label, &agg);
+
+        if (q->verbose)
+            printf("  %u index entries, aggregate took %.1f us\n", rd.entries(), now_us() - start);
+    }
+    else {
+        n = rd.read(q->from, q->to, disp_sample, q);
+
+        if (n < 0) {
+            printf("Error during reading sensor %d\n", sensor);
+            return(-1);
+        }
+
+        if (q->verbose)
+            printf("# sensor %d: %ld samples, %u index entries, took %.1f us\n",
+                sensor, n, rd.entries(), now_us() - start);
+    }
+
+    rd.close();
+    return(0);
+}
+
+/*********************************************************************
+ * @brief add a sample to an aggregate (callback from SPSringread::read)
+ *********************************************************************/
+static bool agg_sample(const struct sps_sample *s, void *ctx)
+{
+    store_agg_add((struct store_agg *) ctx, s);
+    return(true);
+}
+
+/*********************************************************************
+ * @brief query a circular file
+ *********************************************************************/
+static int query_ring(query_par *q)
+{
+    SPSringread rd;
+    struct store_agg agg;
+    char label[30];
+    double start;
+    long n;
+
+    if (rd.open(q->ring) != STORE_OK) return(-1);
+
+    start = now_us();
+
+    if (q->aggregate) {
+        store_agg_init(&agg);
+        n = rd.read(q->from, q->to, agg_sample, &agg);
+        if (n >= 0) {
+            snprintf(label, sizeof(label), "sensor %d", rd.header()->sensor);
+            disp_agg(q, label, &agg);
+        }
+    }
+    else
+        n = rd.read(q->from, q->to, disp_sample, q);
+
+    if (n < 0) {
+        printf("Error during reading %s\n", q->ring);
+        rd.close();
+        return(-1);
+    }
+
+    if (q->verbose)
+        printf("# %s: %ld samples, %u records, %u days, took %.1f us\n", q->ring, n,
+            rd.header()->capacity, rd.header()->span / 86400, now_us() - start);
+
+    rd.close();
+    return(0);
+}
+
+/*********************************************************************
+ * @brief display a capture file: the samples with the status register
+ * and the bus errors, the trigger sample is marked with *
+ *********************************************************************/
+static int query_capture(query_par *q)
+{
+    struct capture_header h;
+    struct capture_rec rec;
+    struct store_agg agg;
+    char   buf[30];
+    uint32_t n = 0;
+    FILE   *fp;
+
+    if ((fp = fopen(q->capture, "rb")) == NULL) {
+        printf("Can not open %s\n", q->capture);
+        return(-1);
+    }
+
+    if (fread(&h, sizeof(h), 1, fp) != 1 || h.magic != CAPTURE_MAGIC || h.version != CAPTURE_VERSION
+        || h.rec_size != sizeof(struct capture_rec)) {
+        printf("%s is not a capture file\n", q->capture);
+        fclose(fp);
+        return(-1);
+    }
+
+    h.rule[CAPTURE_NAME - 1] = 0x0;
+    time_str(h.trigger, buf, sizeof(buf));
+    printf("# sensor %u, triggered by %s at %s, %u samples before%s\n", h.sensor, h.rule, buf, h.pre,
+        h.count ? "" : ", not complete");
+
+    store_agg_init(&agg);
+
+    // an incomplete capture is valid up to the end of the file
+    while ((h.count == 0 || n < h.count) && fread(&rec, sizeof(rec), 1, fp) == 1) {
+        n++;
+
+        if (rec.s.ts < q->from || rec.s.ts > q->to) continue;
+
+        if (q->aggregate) {
+            store_agg_add(&agg, &rec.s);
+            continue;
+        }
+
+        time_str(rec.s.ts, buf, sizeof(buf));
+        printf("%s%s,%u", n == h.pre ? "*" : "", buf, rec.s.sensor);
+
+        for (int i = 0; i < SPS_FIELDS; i++) {
+            if (q->field[i]) printf(",%.4f", sps_field(&rec.s.v, i));
+        }
+
+        printf(",0x%02x,%u\n", rec.s.flags & SPS_FLAG_STATUS, rec.errors);
+    }
+
+    fclose(fp);
+
+    if (q->aggregate) {
+        snprintf(buf, sizeof(buf), "sensor %u", h.sensor);
+        disp_agg(q, buf, &agg);
+    }
+
+    if (q->verbose) printf("# %s: %u samples, %u after the trigger\n", q->capture, n, n > h.pre ? n - h.pre : 0);
+
+    return(0);
+}
+
+/*********************************************************************
+ * @brief aggregate sensors in parallel with the query engine
+ * @param sensors : sensor ids
+ * @param n       : number of sensors
+ *********************************************************************/
+static int query_engine(query_par *q, uint16_t *sensors, int n)
+{
+    struct store_agg *agg, total;
+    struct eng_stats st;
+    char label[30];
+    int ret;
+
+    if ((agg = (struct store_agg *) malloc(n * sizeof(struct store_agg))) == NULL) return(-1);
+
+    ret = eng_aggregate(q->dir, sensors, n, q->from, q->to, q->field,
+                        q->pred.field < 0 ? NULL : &q->pred, q->threads, agg, &st);
+
+    store_agg_init(&total);
+
+    for (int i = 0; i < n; i++) {
+        snprintf(label, sizeof(label), "sensor %d", sensors[i]);
+        disp_agg(q, label, &agg[i]);
+        store_agg_merge(&total, &agg[i]);
+    }
+
+    if (n > 1) {
+        snprintf(label, sizeof(label), "all %d sensors", n);
+        disp_agg(q, label, &total);
+    }
+
+    if (q->verbose) {
+        printf("# %d threads, %u sensors, %u segments, took %.1f ms\n", st.pool.threads,
+            st.sensors, st.segments, st.elapsed * 1000);
+        printf("# blocks: %llu from index, %llu read, %llu skipped, %llu corrupt; %llu samples read, %.1f Msamples/s\n",
+            (unsigned long long) st.blocks_index, (unsigned long long) st.blocks_scanned,
+            (unsigned long long) st.blocks_skipped, (unsigned long long) st.blocks_corrupt,
+            (unsigned long long) st.samples_scanned, st.samples_scanned / st.elapsed / 1e6);
+        printf("# tasks: %llu, %llu stolen, %llu - %llu per thread\n", (unsigned long long) st.pool.tasks,
+            (unsigned long long) st.pool.stolen, (unsigned long long) st.pool.min_done,
+            (unsigned long long) st.pool.max_done);
+    }
+
+    free(agg);
+    return(ret == STORE_OK ? 0 : -1);
+}
+
+/*********************************************************************
+ * @brief check the CRCs of the segments and blocks of sensors
+ * @param sensors : sensor ids
+ * @param n       : number of sensors
+ *********************************************************************/
+static int verify_store(query_par *q, uint16_t *sensors, int n)
+{
+    struct store_verify_stats st;
+    int ret = 0;
+
+    memset(&st, 0x0, sizeof(st));
+
+    for (int i = 0; i < n; i++) {
+        if (store_verify(q->dir, sensors[i], &st) != STORE_OK) ret = -1;
+    }
+
+    printf("%d sensors, %u segments, %llu blocks: %llu corrupt, %llu without CRC\n", n, st.segments,
+        (unsigned long long) st.blocks, (unsigned long long) st.corrupt, (unsigned long long) st.no_crc);
+
+    if (q->verbose)
+        printf("# %.1f MB in %.1f ms, %.0f MB/s (crc32c %s)\n", st.bytes / 1e6, st.elapsed * 1000,
+            st.elapsed > 0 ? st.bytes / st.elapsed / 1e6 : 0, crc32c_name());
+
+    return(ret);
+}
+
+/*********************************************************************
+ * @brief compress the sealed segments of sensors
+ *********************************************************************/
+static int zip_store(query_par *q, uint16_t *sensors, int n)
+{
+    struct zip_stats st;
+    int ret = 0;
+
+    memset(&st, 0x0, sizeof(st));
+
+    for (int i = 0; i < n; i++) {
+        if (zip_segments(q->dir, sensors[i], q->zip_level, q->verbose, &st) < 0) ret = -1;
+    }
+
+    printf("%d sensors, %u segments compressed", n, st.segments);
+
+    if (st.segments > 0)
+        printf(": %.1f MB to %.1f MB, ratio %.1f (%.1f on disk), CPU %.3f s",
+            st.raw_bytes / 1e6, st.zip_bytes / 1e6, (double) st.raw_bytes / st.zip_bytes,
+            (double) st.disk_bytes / st.zip_bytes, st.cpu);
+
+    printf("\n");
+    return(ret);
+}
+
+/* buffers of one tier for the zstd benchmark */
+typedef struct zip_tier
+{
+    uint8_t *data;
+    size_t  *sizes;
+    size_t  len;
+    int     n;
+    int     max;
+} zip_tier;
+
+/**
+ * @brief add a buffer to a tier
+ */
+static bool zip_tier_add(zip_tier *t, const void *buf, size_t len)
+{
+    if (t->n >= t->max) return(false);
+
+    memcpy(t->data + t->len, buf, len);
+    t->sizes[t->n++] = len;
+    t->len += len;
+
+    return(true);
+}
+
+/* collects rollups in chunks (callback from rollup_read) */
+typedef struct zip_chunk
+{
+    zip_tier *t;
+    struct sps_rollup r[ZIP_BENCH_CHUNK];
+    int     n;
+} zip_chunk;
+
+static bool zip_rollup(const struct sps_rollup *r, void *ctx)
+{
+    zip_chunk *c = (zip_chunk *) ctx;
+
+    c->r[c->n++] = *r;
+
+    if (c->n < ZIP_BENCH_CHUNK) return(true);
+
+    c->n = 0;
+    return(zip_tier_add(c->t, c->r, sizeof(c->r)));
+}
+
+/*********************************************************************
+ * @brief compression ratio and speed of zstd per tier, level and with
+ * or without a dictionary
+ *
+ * Raw samples are compressed a block at a time as SPSzip does, rollups
+ * in chunks of ZIP_BENCH_CHUNK records.
+ *********************************************************************/
+static int zip_benchmark(query_par *q, uint16_t *sensors, int n)
+{
+    static const char *tier_name[] = {"raw", "minute", "hour"};
+    size_t  max = ZIP_BENCH_BLOCKS * (size_t) STORE_BLOCK_SIZE;
+    struct  zip_bench_result r;
+    const struct store_blk_header *bh;
+    const struct sps_sample *s;
+    const struct store_idx *e;
+    zip_tier t;
+    zip_chunk *c;
+    SPSread rd;
+    int ret = 0;
+
+    t.data = (uint8_t *) malloc(max);
+    t.sizes = (size_t *) malloc(ZIP_BENCH_BLOCKS * sizeof(size_t));
+    c = (zip_chunk *) malloc(sizeof(zip_chunk));
+
+    if (t.data == NULL || t.sizes == NULL || c == NULL) {
+        free(t.data);
+        free(t.sizes);
+        free(c);
+        return(-1);
+    }
+
+    printf("%-7s %5s %5s %8s %8s %9s %9s %9s\n", "tier", "level", "dict", "blocks", "MB",
+        "ratio", "comp MB/s", "dec MB/s");
+
+    for (int tier = 0; tier < 3; tier++) {
+        t.len = 0;
+        t.n = 0;
+        t.max = ZIP_BENCH_BLOCKS;
+
+        for (int i = 0; i < n && t.n < t.max; i++) {
+
+            if (tier == 0) {
+                if (rd.open(q->dir, sensors[i]) != STORE_OK) continue;
+
+                for (uint32_t j = rd.find(q->from); j < rd.entries() && t.n < t.max; j++) {
+                    e = rd.entry(j);
+                    if (e->first_ts > q->to) break;
+                    if ((s = rd.block(e)) == NULL) continue;
+
+                    bh = (const struct store_blk_header *) s - 1;
+                    zip_tier_add(&t, bh, sizeof(struct store_blk_header) + e->count * sizeof(struct sps_sample));
+                }
+
+                rd.close();
+            }
+            else {
+                c->t = &t;
+                c->n = 0;
+                rollup_read(q->dir, sensors[i], tier - 1, q->from, q->to, zip_rollup, c);
+            }
+        }
+
+        if (t.n < 2) {
+            printf("%-7s not enough data\n", tier_name[tier]);
+            continue;
+        }
+
+        for (unsigned l = 0; l < sizeof(zip_bench_levels) / sizeof(int); l++) {
+            for (int d = 0; d < 2; d++) {
+
+                if (zip_bench(t.data, t.sizes, t.n, zip_bench_levels[l], d, &r) != STORE_OK) {
+                    ret = -1;
+                    goto done;
+                }
+
+                printf("%-7s %5d %5s %8d %8.1f %9.2f %9.0f %9.0f", tier_name[tier], zip_bench_levels[l],
+                    d ? "yes" : "no", t.n, r.raw_bytes / 1e6, (double) r.raw_bytes / r.zip_bytes,
+                    r.comp_cpu > 0 ? r.raw_bytes / r.comp_cpu / 1e6 : 0,
+                    r.decomp_cpu > 0 ? r.raw_bytes / r.decomp_cpu / 1e6 : 0);
+
+                if (d && q->verbose) printf("  (train %.1f ms)", r.train_cpu * 1000);
+                printf("\n");
+            }
+        }
+    }
+
+    printf("\n\tMB/s is CPU time of one thread, a dictionary is trained on half of the blocks\n");
+
+done:
+    free(t.data);
+    free(t.sizes);
+    free(c);
+    return(ret);
+}
+
+/*********************************************************************
+* @brief usage information
+**********************************************************************/
+void usage()
+{
+    printf("%s [options]  (program version %d.%d)\n\n"
+    "-d dir     store directory                       (required)\n"
+    "-R file    read circular file instead of store directory\n"
+    "-c file    read a capture file (option -k of the monitor)\n"
+    "-s #       sensor id                             (default all)\n"
+    "-f time    start of range                        (default oldest)\n"
+    "-t time    end of range                          (default newest)\n"
+    "-F list    fields to display, comma separated    (default all)\n"
+    "-a         display min / max / mean only\n"
+    "-r tier    display rollups: minute or hour\n"
+    "-u tier    display the cube: hour or day, with percentiles (-a: total)\n"
+    "-U         benchmark the cube against a scan of the samples\n"
+    "-C         convert completed segments to columnar files\n"
+    "-b         benchmark scan of the fields on rows versus columns\n"
+    "-k         benchmark the vector kernels on the (first) field\n"
+    "-j #       with -a: threads of the parallel engine (0 = all CPUs)\n"
+    "-w pred    with -a: only samples where pred, e.g. MassPM2>50\n"
+    "-x value   threshold for the count kernel        (default %.0f)\n"
+    "-V         verify the checksums of the store, report corrupt blocks\n"
+    "-z level   compress the sealed segments with zstd (1 - 19)\n"
+    "-Z         benchmark zstd per tier and level, with and without dictionary\n"
+    "-v         verbose: display timing\n"
+    "\n\ttime is seconds since epoch or \"YYYY-MM-DD HH:MM:SS\" (local time)\n"
+    "\tfields: MassPM1 MassPM2 MassPM4 MassPM10 NumPM0 NumPM1 NumPM2\n"
+    "\t        NumPM4 NumPM10 PartSize\n"
+    , progname, QUERY_MAJOR, QUERY_MINOR, (double) KERN_THRESHOLD);
+}
+
+/*********************************************************************
+ * @brief parse a comma separated field list
+ *********************************************************************/
+static void parse_fields(query_par *q, char *option)
+{
+    char *tok, *save;
+    int f;
+
+    memset(q->field, 0x0, sizeof(q->field));
+
+    for (tok = strtok_r(option, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+
+        if ((f = sps_field_lookup(tok)) < 0) {
+            printf("Unknown field %s\n", tok);
+            exit(EXIT_FAILURE);
+        }
+
+        q->field[f] = true;
+    }
+}
+
+/***********************
+ *  program starts here
+ **********************/
+int main(int argc, char *argv[])
+{
+    int opt, n, ret = 0;
+    uint16_t sensors[MAX_SENSORS];
+    query_par q;
+
+    strncpy(progname, argv[0], 19);
+    progname[19] = 0x0;
+
+    memset(&q, 0x0, sizeof(q));
+    q.sensor = -1;
+    q.tier = -1;
+    q.to = UINT32_MAX;
+    q.threshold = KERN_THRESHOLD;
+    q.threads = -1;
+    q.pred.field = -1;
+    q.zip_level = -1;
+    q.cube = -1;
+    for (int i = 0; i < SPS_FIELDS; i++) q.field[i] = true;
+
+    while ((opt = getopt(argc, argv, "d:R:c:s:f:t:F:ar:u:UCbkx:j:w:Vz:Zvh")) != -1) {
+        switch (opt) {
+        case 'd':  strncpy(q.dir, optarg, sizeof(q.dir) - 1); break;
+        case 'R':  strncpy(q.ring, optarg, sizeof(q.ring) - 1); break;
+        case 'c':  strncpy(q.capture, optarg, sizeof(q.capture) - 1); break;
+        case 's':  q.sensor = (int) strtol(optarg, NULL, 10); break;
+        case 'f':  q.from = parse_time(optarg); break;
+        case 't':  q.to = parse_time(optarg); break;
+        case 'F':  parse_fields(&q, optarg); break;
+        case 'a':  q.aggregate = true; break;
+        case 'r':
+            if (strcasecmp(optarg, "minute") == 0) q.tier = ROLLUP_MINUTE;
+            else if (strcasecmp(optarg, "hour") == 0) q.tier = ROLLUP_HOUR;
+            else {
+                printf("Unknown rollup tier %s. Use minute or hour\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'u':
+            if (strcasecmp(optarg, "hour") == 0) q.cube = CUBE_HOUR;
+            else if (strcasecmp(optarg, "day") == 0) q.cube = CUBE_DAY;
+            else {
+                printf("Unknown cube tier %s. Use hour or day\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'U':  q.cube_bench = true; break;
+        case 'C':  q.convert = true; break;
+        case 'b':  q.bench = true; break;
+        case 'k':  q.kernels = true; break;
+        case 'x':  q.threshold = strtof(optarg, NULL); break;
+        case 'j':  q.threads = (int) strtol(optarg, NULL, 10); break;
+        case 'w':
+            if (eng_parse_pred(optarg, &q.pred) != STORE_OK) {
+                printf("Invalid predicate %s. Use e.g. MassPM2>50 or NumPM10<3\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'V':  q.verify = true; break;
+        case 'z':
+            q.zip_level = (int) strtol(optarg, NULL, 10);
+            if (q.zip_level < 1 || q.zip_level > 19) {
+                printf("Incorrect zstd level %s. Must be 1 - 19\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'Z':  q.zip_bench = true; break;
+        case 'v':  q.verbose++; break;
+        case 'h':  usage(); exit(EXIT_SUCCESS);
+        default:   usage(); exit(EXIT_FAILURE);
+        }
+    }
+
+    if (q.ring[0] != 0x0) return(query_ring(&q) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    if (q.capture[0] != 0x0) return(query_capture(&q) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+    if (q.dir[0] == 0x0) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    // parallel engine, verify or compression
+    if ((q.aggregate && (q.threads > -1 || q.pred.field > -1)) || q.verify || q.zip_level > -1 || q.zip_bench) {
+
+        if (q.sensor > -1) {
+            sensors[0] = q.sensor;
+            n = 1;
+        }
+        else if ((n = store_sensors(q.dir, sensors, MAX_SENSORS)) < 0) {
+            printf("Can not read store directory %s\n", q.dir);
+            exit(EXIT_FAILURE);
+        }
+
+        if (q.verify) return(verify_store(&q, sensors, n) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        if (q.zip_bench) return(zip_benchmark(&q, sensors, n) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        if (q.zip_level > -1) return(zip_store(&q, sensors, n) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+        if (q.threads < 0) q.threads = 1;
+
+        return(query_engine(&q, sensors, n) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (q.sensor > -1) return(query_sensor(&q, q.sensor) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+    if ((n = store_sensors(q.dir, sensors, MAX_SENSORS)) < 0) {
+        printf("Can not read store directory %s\n", q.dir);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (query_sensor(&q, sensors[i]) != 0) ret = EXIT_FAILURE;
+    }
+
+    return(ret);
+}
@@ -0,0 +1,204 @@
+/**
+ * SPS30 replay for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsreplay.h
+ */
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "spsreplay.h"
+
+/**
+ * @brief monotonic time in seconds
+ */
+static double mono_now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+SPSreplay::SPSreplay(void)
+{
+    _open = false;
+    _buf = NULL;
+    _n = _pos = 0;
+    _entry = _rec = 0;
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief add a sample of the circular file to the buffer
+ */
+bool SPSreplay::load(const struct sps_sample *s, void *ctx)
+{
+    SPSreplay *r = (SPSreplay *) ctx;
+    struct sps_sample *p;
+
+    if ((r->_n & (r->_n - 1)) == 0) {
+        p = (struct sps_sample *) realloc(r->_buf, (r->_n ? r->_n * 2 : 1024) * sizeof(struct sps_sample));
+        if (p == NULL) return(false);
+        r->_buf = p;
+    }
+
+    r->_buf[r->_n++] = *s;
+    return(true);
+}
+
+/**
+ * @brief open a source
+ */
+int SPSreplay::open(const char *source, uint16_t sensor, double speed, bool rebase,
+                    uint32_t from, uint32_t to)
+{
+    SPSringread ring;
+    struct stat st;
+
+    close();
+
+    _speed = speed;
+    _rebase = rebase;
+    _from = from;
+    _to = to;
+    _started = false;
+    memset(&_st, 0x0, sizeof(_st));
+
+    if (stat(source, &st) != 0) {
+        printf("Replay: can not find %s\n", source);
+        return(STORE_ERROR);
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        if (_rd.open(source, sensor) != STORE_OK) {
+            printf("Replay: can not open sensor %d in %s\n", sensor, source);
+            return(STORE_ERROR);
+        }
+
+        _entry = _rd.find(from);
+        _rec = 0;
+    }
+    else {
+        if (ring.open(source) != STORE_OK) return(STORE_ERROR);
+
+        // the writer may overwrite the oldest while replaying : take a copy
+        if (ring.read(from, to, load, this) < 0) {
+            ring.close();
+            return(STORE_ERROR);
+        }
+
+        ring.close();
+        _pos = 0;
+    }
+
+    _open = true;
+    return(STORE_OK);
+}
+
+/**
+ * @brief get the next sample from the source
+ */
+int SPSreplay::get(struct sps_sample *s)
+{
+    const struct store_idx *e;
+    const struct sps_sample *r;
+
+    // circular file
+    if (_buf) {
+        if (_pos >= _n) return(STORE_ERROR);
+        *s = _buf[_pos++];
+        return(STORE_OK);
+    }
+
+    // store directory, block by block
+    while (_entry < _rd.entries()) {
+        e = _rd.entry(_entry);
+
+        if (_rec >= e->count || (r = _rd.block(e)) == NULL) {
+            _entry++;
+            _rec = 0;
+            continue;
+        }
+
+        *s = r[_rec++];
+
+        if (s->ts < _from) continue;
+        if (s->ts > _to) return(STORE_ERROR);
+
+        return(STORE_OK);
+    }
+
+    return(STORE_ERROR);
+}
+
+/**
+ * @brief get the next sample, waits until it is due
+ */
+int SPSreplay::next(struct sps_sample *s)
+{
+    struct timespec ts;
+    double due, now;
+
+    if (! _open || get(s) != STORE_OK) return(STORE_ERROR);
+
+    if (! _started) {
+        _started = true;
+        _first_ts = s->ts;
+        _first_wall = mono_now();
+        _base = (uint32_t) time(NULL);
+    }
+
+    now = mono_now();
+
+    if (_speed > 0) {
+        due = _first_wall + (s->ts - _first_ts) / _speed;
+
+        if (due > now) {
+            ts.tv_sec = (time_t) (due - now);
+            ts.tv_nsec = (long) ((due - now - ts.tv_sec) * 1e9);
+            nanosleep(&ts, NULL);       // a signal ends it early
+        }
+        else if (now - due > _st.behind)
+            _st.behind = now - due;
+    }
+
+    if (_rebase) s->ts = _base + (s->ts - _first_ts);
+
+    _st.samples++;
+    return(STORE_OK);
+}
+
+void SPSreplay::stats(struct replay_stats *st)
+{
+    *st = _st;
+    st->elapsed = _started ? mono_now() - _first_wall : 0;
+}
+
+void SPSreplay::close()
+{
+    _rd.close();
+
+    if (_buf) free(_buf);
+    _buf = NULL;
+    _n = _pos = 0;
+    _open = false;
+}
@@ -0,0 +1,103 @@
+/**
+ * SPS30 replay header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Replays stored samples in place of the SPS30, so they go through the
+ * same output, store and export code as live measurements.
+ *
+ * The source is a store directory (option -o) or a circular file
+ * (option -R). The samples are returned at the recorded pace, N times
+ * faster or as fast as possible. The timestamps are kept or rebased to
+ * start at the current time, keeping their spacing.
+ *********************************************************************
+*/
+#ifndef SPSREPLAY_H
+#define SPSREPLAY_H
+
+# include "spsstore.h"
+# include "spsring.h"
+
+/* statistics of a replay */
+struct replay_stats
+{
+    uint64_t samples;       // samples returned
+    double   elapsed;       // seconds since the first sample
+    double   behind;        // most seconds a sample was late (consumer too slow)
+};
+
+class SPSreplay
+{
+  public:
+
+    SPSreplay(void);
+
+    /**
+     * @brief open a source
+     * @param source : store directory or circular file
+     * @param sensor : sensor id (store directory only)
+     * @param speed  : 1 = recorded pace, N = N times faster, 0 = no waiting
+     * @param rebase : if true the first sample gets the current time
+     * @param from   : first timestamp to replay
+     * @param to     : last timestamp to replay
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *source, uint16_t sensor, double speed, bool rebase,
+             uint32_t from, uint32_t to);
+
+    /**
+     * @brief get the next sample, waits until it is due
+     *
+     * @return
+     *  STORE_OK sample returned
+     *  STORE_ERROR end of data or error
+     */
+    int next(struct sps_sample *s);
+
+    void close();
+
+    void stats(struct replay_stats *st);
+
+    bool is_open() {return(_open);}
+
+  private:
+    bool     _open;
+    double   _speed;
+    bool     _rebase;
+    uint32_t _from, _to;
+
+    /* store directory */
+    SPSread  _rd;
+    uint32_t _entry;            // current index entry
+    uint32_t _rec;              // next record in block
+
+    /* circular file, loaded on open */
+    struct sps_sample *_buf;
+    uint64_t _n, _pos;
+
+    /* pacing */
+    bool     _started;
+    uint32_t _first_ts;         // timestamp of first sample
+    double   _first_wall;       // monotonic time of first sample
+    uint32_t _base;             // rebased time of first sample
+    struct replay_stats _st;
+
+    int get(struct sps_sample *s);
+    static bool load(const struct sps_sample *s, void *ctx);
+};
+
+#endif /* SPSREPLAY_H */
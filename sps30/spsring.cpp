@@ -0,0 +1,405 @@
+/**
+ * SPS30 circular sample file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsring.h for the layout
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spsring.h"
+
+/**
+ * @brief checksum (FNV-1a) of a header slot
+ */
+static uint32_t ring_check(const struct ring_header *hdr)
+{
+    const uint8_t *p = (const uint8_t *) hdr;
+    uint32_t h = 2166136261U;
+
+    for (size_t i = 0; i < offsetof(struct ring_header, check); i++) {
+        h ^= p[i];
+        h *= 16777619U;
+    }
+
+    return(h);
+}
+
+/**
+ * @brief select the valid header slot with the highest counter
+ */
+int ring_get_header(const uint8_t *map, struct ring_header *hdr)
+{
+    struct ring_header slot[2];
+    int    use = -1;
+
+    memcpy(&slot[0], map, sizeof(struct ring_header));
+    memcpy(&slot[1], map + RING_SLOT, sizeof(struct ring_header));
+
+    for (int i = 0; i < 2; i++) {
+        if (slot[i].magic != RING_MAGIC || slot[i].version != RING_VERSION) continue;
+        if (slot[i].check != ring_check(&slot[i])) continue;
+        if (use < 0 || slot[i].count > slot[use].count) use = i;
+    }
+
+    if (use < 0) return(STORE_ERROR);
+
+    *hdr = slot[use];
+    return(STORE_OK);
+}
+
+/**
+ * @brief map a file
+ */
+static uint8_t *ring_map(int fd, size_t len, bool write)
+{
+    void *p = mmap(NULL, len, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+    if (p == MAP_FAILED) return(NULL);
+    return((uint8_t *) p);
+}
+
+/*********************************************************************
+ *  writer
+ *********************************************************************/
+
+SPSring::SPSring(void)
+{
+    _fd = -1;
+    _map = NULL;
+    _maplen = 0;
+    _rec = NULL;
+    _verbose = 0;
+    _synced = 0;
+    memset(&_hdr, 0x0, sizeof(_hdr));
+}
+
+/**
+ * @brief open or create a circular file
+ * @param file     : file name
+ * @param sensor   : sensor id
+ * @param days     : days to keep
+ * @param interval : seconds between samples (to size the file)
+ * @param verbose  : if > 0 progress messages are displayed
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int SPSring::open(const char *file, uint16_t sensor, uint16_t days, uint32_t interval, int verbose)
+{
+    struct stat st;
+    uint64_t recovered = 0;
+    bool   create;
+
+    _verbose = verbose;
+
+    if (days == 0 || interval == 0) {
+        printf("Ring: invalid days or interval\n");
+        return(STORE_ERROR);
+    }
+
+    if ((_fd = ::open(file, O_RDWR | O_CREAT, 0644)) < 0) {
+        printf("Ring: can not open %s\n", file);
+        return(STORE_ERROR);
+    }
+
+    fstat(_fd, &st);
+    create = (st.st_size == 0);
+
+    if (create) {
+        memset(&_hdr, 0x0, sizeof(_hdr));
+        _hdr.magic = RING_MAGIC;
+        _hdr.version = RING_VERSION;
+        _hdr.sensor = sensor;
+        _hdr.capacity = (uint32_t) ((uint64_t) days * 86400 / interval + 1);
+        _hdr.rec_size = sizeof(struct ring_rec);
+        _hdr.span = (uint32_t) days * 86400;
+        _hdr.head = 1;          // a zero record is never valid
+
+        _maplen = RING_HDR_SIZE + (size_t) _hdr.capacity * sizeof(struct ring_rec);
+
+        // allocate all blocks now, the file can never fill the disk later
+        if (posix_fallocate(_fd, 0, _maplen) != 0) {
+            printf("Ring: can not allocate %lu bytes for %s\n", (unsigned long) _maplen, file);
+            close();
+            unlink(file);
+            return(STORE_ERROR);
+        }
+    }
+    else
+        _maplen = st.st_size;
+
+    if ((_map = ring_map(_fd, _maplen, true)) == NULL) {
+        printf("Ring: can not map %s\n", file);
+        close();
+        return(STORE_ERROR);
+    }
+
+    _rec = (struct ring_rec *) (_map + RING_HDR_SIZE);
+
+    if (create) {
+        put_header();
+        put_header();           // both slots valid
+    }
+    else {
+        if (ring_get_header(_map, &_hdr) != STORE_OK || _hdr.rec_size != sizeof(struct ring_rec)
+            || RING_HDR_SIZE + (size_t) _hdr.capacity * sizeof(struct ring_rec) > _maplen) {
+            printf("Ring: %s is not a valid circular file\n", file);
+            close();
+            return(STORE_ERROR);
+        }
+
+        // records written after the last header update
+        while (_rec[_hdr.head % _hdr.capacity].seq == _hdr.head) {
+            _hdr.head++;
+            recovered++;
+        }
+
+        if (recovered) put_header();
+    }
+
+    _synced = time(NULL);
+
+    if (_verbose)
+        printf("Ring: %s sensor %d, %u records, %u days, %llu stored (%llu recovered)\n",
+            file, _hdr.sensor, _hdr.capacity, _hdr.span / 86400,
+            (unsigned long long) (_hdr.head - 1 < _hdr.capacity ? _hdr.head - 1 : _hdr.capacity),
+            (unsigned long long) recovered);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief write the header to the slot not written last time
+ */
+void SPSring::put_header()
+{
+    _hdr.count++;
+    _hdr.check = ring_check(&_hdr);
+
+    memcpy(_map + (_hdr.count & 1) * RING_SLOT, &_hdr, sizeof(_hdr));
+}
+
+/**
+ * @brief add a sample, overwrites the oldest if the file is full
+ */
+int SPSring::append(struct sps_sample *s)
+{
+    struct ring_rec *r, *prev;
+
+    if (! is_open()) return(STORE_ERROR);
+
+    s->sensor = _hdr.sensor;
+
+    // keep the timestamps ordered, needed for the search by the reader
+    prev = &_rec[(_hdr.head - 1) % _hdr.capacity];
+    if (prev->seq == _hdr.head - 1 && s->ts < prev->s.ts) s->ts = prev->s.ts;
+
+    r = &_rec[_hdr.head % _hdr.capacity];
+
+    // invalidate, write, then validate with the sequence number
+    __atomic_store_n(&r->seq, RING_INVALID, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    r->s = *s;
+    __atomic_store_n(&r->seq, _hdr.head, __ATOMIC_RELEASE);
+
+    _hdr.head++;
+    put_header();
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief write the changed pages to disk if interval seconds passed
+ * @param interval : 0 = now
+ */
+int SPSring::sync(uint32_t interval)
+{
+    if (! is_open()) return(STORE_ERROR);
+
+    if (interval && time(NULL) - _synced < (time_t) interval) return(STORE_OK);
+
+    _synced = time(NULL);
+
+    if (msync(_map, _maplen, MS_SYNC) != 0) {
+        printf("Ring: error during sync\n");
+        return(STORE_ERROR);
+    }
+
+    return(STORE_OK);
+}
+
+void SPSring::close()
+{
+    if (_map) {
+        sync(0);
+        munmap(_map, _maplen);
+        _map = NULL;
+        _rec = NULL;
+    }
+
+    if (_fd > -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+/*********************************************************************
+ *  reader
+ *********************************************************************/
+
+SPSringread::SPSringread(void)
+{
+    _fd = -1;
+    _map = NULL;
+    _maplen = 0;
+    memset(&_hdr, 0x0, sizeof(_hdr));
+}
+
+/**
+ * @brief open a circular file for reading
+ */
+int SPSringread::open(const char *file)
+{
+    struct stat st;
+
+    if ((_fd = ::open(file, O_RDONLY)) < 0) {
+        printf("Ring: can not open %s\n", file);
+        return(STORE_ERROR);
+    }
+
+    fstat(_fd, &st);
+    _maplen = st.st_size;
+
+    if (_maplen < RING_HDR_SIZE || (_map = ring_map(_fd, _maplen, false)) == NULL) {
+        printf("Ring: can not map %s\n", file);
+        close();
+        return(STORE_ERROR);
+    }
+
+    if (get_header() != STORE_OK) {
+        printf("Ring: %s is not a valid circular file\n", file);
+        close();
+        return(STORE_ERROR);
+    }
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief get the latest header of the writer
+ */
+int SPSringread::get_header()
+{
+    if (ring_get_header(_map, &_hdr) != STORE_OK) return(STORE_ERROR);
+
+    if (_hdr.rec_size != sizeof(struct ring_rec) ||
+        RING_HDR_SIZE + (size_t) _hdr.capacity * sizeof(struct ring_rec) > _maplen)
+        return(STORE_ERROR);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief copy a record if it still holds sequence number seq
+ *
+ * @return true if valid
+ */
+static bool ring_get(const struct ring_rec *r, uint64_t seq, struct sps_sample *s)
+{
+    if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != seq) return(false);
+
+    *s = r->s;
+
+    // the writer may have started overwriting it during the copy
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return(__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == seq);
+}
+
+void SPSringread::close()
+{
+    if (_map) {
+        munmap(_map, _maplen);
+        _map = NULL;
+    }
+
+    if (_fd > -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+/**
+ * @brief call cb for each sample between from and to (inclusive),
+ * oldest first
+ *
+ * @return number of samples or STORE_ERROR
+ */
+long SPSringread::read(uint32_t from, uint32_t to, store_cb cb, void *ctx)
+{
+    const struct ring_rec *rec;
+    struct sps_sample s;
+    uint64_t head, tail, lo, hi, mid;
+    long   n = 0;
+
+    if (_map == NULL || get_header() != STORE_OK) return(STORE_ERROR);
+
+    rec = (const struct ring_rec *) (_map + RING_HDR_SIZE);
+    head = _hdr.head;
+    tail = head > _hdr.capacity ? head - _hdr.capacity : 1;
+
+    if (head == tail) return(0);
+
+    // only the last span seconds
+    if (ring_get(&rec[(head - 1) % _hdr.capacity], head - 1, &s) && s.ts > _hdr.span) {
+        if (from < s.ts - _hdr.span) from = s.ts - _hdr.span;
+    }
+
+    // binary search the oldest sample >= from, records that are
+    // overwritten meanwhile are at the old end
+    lo = tail;
+    hi = head;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+
+        if (! ring_get(&rec[mid % _hdr.capacity], mid, &s) || s.ts < from) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (uint64_t seq = lo; seq < head; seq++) {
+
+        if (! ring_get(&rec[seq % _hdr.capacity], seq, &s)) continue;
+        if (s.ts < from) continue;
+        if (s.ts > to) break;
+
+        n++;
+        if (! cb(&s, ctx)) break;
+    }
+
+    return(n);
+}
@@ -0,0 +1,188 @@
+/**
+ * SPS30 circular sample file header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * A circular file of fixed size for units that run unattended. It
+ * keeps the samples of the last N days and never grows.
+ *
+ * The file is allocated completely on creation:
+ *
+ *  RING_HDR_SIZE bytes  : two header slots
+ *  capacity records     : ring_rec, written at (seq % capacity)
+ *
+ * Each record has the sequence number (ordinal) of the sample. The
+ * record is invalidated before and the sequence number set after the
+ * sample is written, so a reader (or the writer after a crash) can tell
+ * a valid record from a torn or overwritten one.
+ *
+ * The head (next sequence number) is kept in two header slots that are
+ * written alternately, each with a counter and a checksum. A torn write
+ * can only damage one slot, the other is still valid. On open the
+ * writer continues after the last valid record, which may be beyond
+ * the head in the header.
+ *
+ * The file is mapped in memory, an append is a copy and the pages are
+ * written by the kernel or with sync().
+ *********************************************************************
+*/
+#ifndef SPSRING_H
+#define SPSRING_H
+
+# include <stdio.h>
+# include <stdint.h>
+# include <limits.h>
+# include <time.h>
+# include "spsstore.h"
+
+#define RING_MAGIC          0x53505352      // "SPSR"
+#define RING_VERSION        1
+#define RING_HDR_SIZE       4096            // header area
+#define RING_SLOT           512             // offset of the second slot
+#define RING_INVALID        UINT64_MAX      // record being written
+
+/* header slot */
+struct ring_header
+{
+    uint32_t magic;         // RING_MAGIC
+    uint16_t version;       // RING_VERSION
+    uint16_t sensor;        // sensor id
+    uint32_t capacity;      // number of records
+    uint32_t rec_size;      // sizeof(ring_rec)
+    uint32_t span;          // seconds to keep (N days)
+    uint32_t reserved;
+    uint64_t count;         // update counter, highest valid slot wins
+    uint64_t head;          // sequence number of next record
+    uint32_t reserved2[7];
+    uint32_t check;         // checksum of the fields above
+};
+
+/* one record, 56 bytes */
+struct ring_rec
+{
+    uint64_t seq;           // sequence number or RING_INVALID
+    struct sps_sample s;
+};
+
+/**
+ * Writes the samples of one sensor to a circular file.
+ */
+class SPSring
+{
+  public:
+
+    SPSring(void);
+
+    /**
+     * @brief open or create a circular file
+     * @param file     : file name
+     * @param sensor   : sensor id
+     * @param days     : days to keep
+     * @param interval : seconds between samples (to size the file)
+     * @param verbose  : if > 0 progress messages are displayed
+     *
+     * An existing file keeps its size, also if days / interval differ.
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *file, uint16_t sensor, uint16_t days, uint32_t interval, int verbose);
+
+    /**
+     * @brief add a sample, overwrites the oldest if the file is full
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int append(struct sps_sample *s);
+
+    /**
+     * @brief write the changed pages to disk if interval seconds passed
+     * @param interval : 0 = now
+     */
+    int sync(uint32_t interval);
+
+    void close();
+
+    bool is_open() {return(_map != NULL);}
+
+  private:
+    int      _fd;
+    uint8_t  *_map;
+    size_t   _maplen;
+    struct ring_rec *_rec;
+    struct ring_header _hdr;    // last written header
+    time_t   _synced;           // time of last sync
+    int      _verbose;
+
+    void put_header();
+};
+
+/**
+ * Reads a circular file, also while it is written.
+ */
+class SPSringread
+{
+  public:
+
+    SPSringread(void);
+
+    /**
+     * @brief open a circular file for reading
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *file);
+
+    void close();
+
+    /**
+     * @brief call cb for each sample between from and to (inclusive),
+     * oldest first. Only samples within the span of the newest are
+     * returned.
+     *
+     * @return number of samples or STORE_ERROR
+     */
+    long read(uint32_t from, uint32_t to, store_cb cb, void *ctx);
+
+    /**
+     * @brief get the header
+     */
+    const struct ring_header *header() {return(&_hdr);}
+
+  private:
+    int      _fd;
+    uint8_t  *_map;
+    size_t   _maplen;
+    struct ring_header _hdr;
+
+    int  get_header();
+};
+
+/**
+ * @brief select the valid header slot with the highest counter
+ * @param map : start of the file
+ * @param hdr : to store the header
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR no valid slot
+ */
+int ring_get_header(const uint8_t *map, struct ring_header *hdr);
+
+#endif /* SPSRING_H */
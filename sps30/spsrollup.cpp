@@ -0,0 +1,577 @@
+/**
+ * SPS30 rollup and retention for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsrollup.h for the layout
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <float.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include "spsrollup.h"
+
+/* bucket size and span of a file per tier */
+static const uint32_t bucket_size[ROLLUP_TIERS] = {60, 3600};
+static const uint32_t file_span[ROLLUP_TIERS] = {30 * 86400, 366 * 86400};
+
+/* rollups read per pread in rollup_read() */
+#define ROLLUP_CHUNK 256
+
+uint32_t rollup_bucket(int tier) {return(bucket_size[tier]);}
+uint32_t rollup_span(int tier) {return(file_span[tier]);}
+
+/**
+ * @brief create the name of a rollup file
+ */
+static void rollup_name(char *buf, int len, const char *dir, uint16_t sensor, int tier, uint32_t start)
+{
+    snprintf(buf, len, "%s/s%03u_r%04u_%010u.rol", dir, sensor, bucket_size[tier], start);
+}
+
+/**
+ * @brief find the first and last rollup file of a tier
+ *
+ * @return number of files
+ */
+static int rollup_files(const char *dir, uint16_t sensor, int tier, uint32_t *first, uint32_t *last)
+{
+    DIR *d;
+    struct dirent *de;
+    unsigned int s, b, start;
+    int n = 0;
+
+    *first = UINT32_MAX;
+    *last = 0;
+
+    if ((d = opendir(dir)) == NULL) return(0);
+
+    while ((de = readdir(d)) != NULL) {
+        if (sscanf(de->d_name, "s%u_r%u_%u.ro", &s, &b, &start) != 3) continue;
+        if (s != sensor || b != bucket_size[tier]) continue;
+
+        if (start < *first) *first = start;
+        if (start > *last) *last = start;
+        n++;
+    }
+
+    closedir(d);
+    return(n);
+}
+
+/**
+ * @brief read the rollups of a tier between from and to (inclusive)
+ *
+ * @return number of rollups or STORE_ERROR
+ */
+long rollup_read(const char *dir, uint16_t sensor, int tier, uint32_t from,
+                 uint32_t to, rollup_cb cb, void *ctx)
+{
+    char     name[PATH_MAX];
+    struct   sps_rollup r[ROLLUP_CHUNK];
+    uint32_t first, last, start, pos, end, i;
+    ssize_t  len;
+    long     cnt = 0;
+    int      fd;
+
+    if (rollup_files(dir, sensor, tier, &first, &last) == 0) return(0);
+
+    if (from < first) from = first;
+    if (to > last + file_span[tier] - 1) to = last + file_span[tier] - 1;
+
+    for (start = from - from % file_span[tier]; start <= to; start += file_span[tier]) {
+
+        rollup_name(name, sizeof(name), dir, sensor, tier, start);
+        if ((fd = open(name, O_RDONLY)) < 0) continue;
+
+        // records of this file that are in range
+        pos = (from > start ? from - start : 0) / bucket_size[tier];
+        end = (to - start < file_span[tier] ? to - start : file_span[tier] - 1) / bucket_size[tier];
+
+        while (pos <= end) {
+            len = pread(fd, r, sizeof(r), (off_t) pos * sizeof(struct sps_rollup));
+            if (len <= 0) break;
+
+            for (i = 0; i < len / sizeof(struct sps_rollup) && pos <= end; i++, pos++) {
+                if (r[i].count == 0) continue;
+                cnt++;
+                if (! cb(&r[i], ctx)) {
+                    close(fd);
+                    return(cnt);
+                }
+            }
+        }
+
+        close(fd);
+
+        // prevent wrap around
+        if (start > UINT32_MAX - file_span[tier]) break;
+    }
+
+    return(cnt);
+}
+
+/**
+ * @brief constructor and initialize variables
+ */
+SPSrollup::SPSrollup(void)
+{
+    _store = NULL;
+    _dir[0] = 0x0;
+    _sensor = 0;
+    _verbose = 0;
+    _keep[0] = ROLLUP_RAW_DAYS;
+    _keep[1] = ROLLUP_MINUTE_DAYS;
+    _keep[2] = ROLLUP_HOUR_DAYS;
+    memset(_done, 0x0, sizeof(_done));
+    memset(&_st, 0x0, sizeof(_st));
+    _running = _stop = false;
+    _fd = -1;
+    _fdtier = 0;
+    _fdstart = 0;
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+}
+
+/**
+ * @brief set the retention in days per tier (0 = forever)
+ */
+void SPSrollup::retention(uint16_t raw, uint16_t minute, uint16_t hour)
+{
+    _keep[0] = raw;
+    _keep[1] = minute;
+    _keep[2] = hour;
+}
+
+/**
+ * @brief start the background compactor
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int SPSrollup::start(SPSstore *store, const char *dir, uint16_t sensor, int verbose)
+{
+    _store = store;
+    strncpy(_dir, dir, sizeof(_dir) - 1);
+    _sensor = sensor;
+    _verbose = verbose;
+    _stop = false;
+
+    load_state();
+
+    if (pthread_create(&_thread, NULL, thread, this) != 0) {
+        printf("Rollup: can not start compactor\n");
+        return(STORE_ERROR);
+    }
+
+    _running = true;
+    return(STORE_OK);
+}
+
+/**
+ * @brief stop the background compactor
+ */
+void SPSrollup::stop()
+{
+    if (! _running) return;
+
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_lock);
+
+    pthread_join(_thread, NULL);
+    _running = false;
+}
+
+/**
+ * @brief the background thread
+ */
+void *SPSrollup::thread(void *arg)
+{
+    SPSrollup *me = (SPSrollup *) arg;
+    struct sched_param sp;
+    struct timespec ts;
+
+    sigset_t set;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    // only run when nothing else wants the CPU
+    memset(&sp, 0x0, sizeof(sp));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+
+    pthread_mutex_lock(&me->_lock);
+
+    while (! me->_stop) {
+        pthread_mutex_unlock(&me->_lock);
+        me->run();
+        pthread_mutex_lock(&me->_lock);
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += ROLLUP_INTERVAL;
+
+        while (! me->_stop) {
+            if (pthread_cond_timedwait(&me->_cond, &me->_lock, &ts) != 0) break;
+        }
+    }
+
+    pthread_mutex_unlock(&me->_lock);
+    return(NULL);
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSrollup::stats(struct rollup_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief load the progress per tier
+ */
+int SPSrollup::load_state()
+{
+    char name[PATH_MAX];
+    int fd;
+
+    memset(_done, 0x0, sizeof(_done));
+
+    snprintf(name, sizeof(name), "%s/s%03u.rst", _dir, _sensor);
+
+    if ((fd = open(name, O_RDONLY)) < 0) return(STORE_OK);
+
+    if (read(fd, _done, sizeof(_done)) != sizeof(_done)) memset(_done, 0x0, sizeof(_done));
+
+    close(fd);
+    return(STORE_OK);
+}
+
+/**
+ * @brief save the progress per tier (write to temp and rename)
+ */
+int SPSrollup::save_state()
+{
+    char name[PATH_MAX], tmp[PATH_MAX + 8];
+    int fd;
+
+    snprintf(name, sizeof(name), "%s/s%03u.rst", _dir, _sensor);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) return(STORE_ERROR);
+
+    if (write(fd, _done, sizeof(_done)) != sizeof(_done) || fsync(fd) != 0) {
+        close(fd);
+        return(STORE_ERROR);
+    }
+
+    close(fd);
+
+    if (rename(tmp, name) != 0) return(STORE_ERROR);
+
+    pthread_mutex_lock(&_lock);
+    _st.bytes_written += sizeof(_done);
+    pthread_mutex_unlock(&_lock);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief write a rollup record at its position
+ */
+int SPSrollup::put(int tier, struct sps_rollup *r)
+{
+    char name[PATH_MAX];
+    uint32_t start = r->ts - r->ts % file_span[tier];
+
+    // other file needed ?
+    if (_fd < 0 || _fdtier != tier || _fdstart != start) {
+
+        if (sync_out() != STORE_OK) return(STORE_ERROR);
+
+        rollup_name(name, sizeof(name), _dir, _sensor, tier, start);
+
+        if ((_fd = open(name, O_RDWR | O_CREAT, 0644)) < 0) {
+            printf("Rollup: can not open %s\n", name);
+            return(STORE_ERROR);
+        }
+
+        _fdtier = tier;
+        _fdstart = start;
+    }
+
+    if (pwrite(_fd, r, sizeof(struct sps_rollup),
+        (off_t) ((r->ts - start) / bucket_size[tier]) * sizeof(struct sps_rollup)) != sizeof(struct sps_rollup)) {
+        printf("Rollup: error during writing\n");
+        return(STORE_ERROR);
+    }
+
+    pthread_mutex_lock(&_lock);
+    _st.rollups++;
+    _st.bytes_written += sizeof(struct sps_rollup);
+    pthread_mutex_unlock(&_lock);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief make the current output file durable and close it
+ */
+int SPSrollup::sync_out()
+{
+    int ret = STORE_OK;
+
+    if (_fd < 0) return(STORE_OK);
+
+    if (fsync(_fd) != 0) ret = STORE_ERROR;
+
+    close(_fd);
+    _fd = -1;
+
+    return(ret);
+}
+
+/**
+ * @brief remove the rollup files of a tier that end before a time
+ */
+int SPSrollup::expire_tier(int tier, uint32_t before)
+{
+    char name[PATH_MAX];
+    uint32_t first, last, start;
+    int removed = 0;
+
+    if (rollup_files(_dir, _sensor, tier, &first, &last) == 0) return(0);
+
+    for (start = first; start <= last && start + file_span[tier] <= before; start += file_span[tier]) {
+        rollup_name(name, sizeof(name), _dir, _sensor, tier, start);
+        if (unlink(name) == 0) removed++;
+    }
+
+    pthread_mutex_lock(&_lock);
+    _st.expired += removed;
+    pthread_mutex_unlock(&_lock);
+
+    if (_verbose && removed)
+        printf("Rollup: removed %d files of %d seconds rollups\n", removed, bucket_size[tier]);
+
+    return(removed);
+}
+
+/* builds the rollups of one tier from samples or rollups of the tier below */
+struct rollup_acc
+{
+    SPSrollup *me;
+    int      tier;
+    uint32_t bucket;            // bucket size
+    struct   sps_rollup cur;    // bucket being build
+    double   sum[SPS_FIELDS];   // sum for mean
+    bool     have;              // cur has data
+    bool     error;
+};
+
+/**
+ * @brief close the current bucket and write it
+ */
+static void acc_emit(struct rollup_acc *a)
+{
+    for (int i = 0; i < SPS_FIELDS; i++) a->cur.mean[i] = a->sum[i] / a->cur.count;
+
+    if (a->me->put(a->tier, &a->cur) != STORE_OK) a->error = true;
+
+    a->have = false;
+}
+
+/**
+ * @brief start a new bucket
+ */
+static void acc_new(struct rollup_acc *a, uint32_t ts)
+{
+    a->cur.ts = ts - ts % a->bucket;
+    a->cur.count = 0;
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        a->cur.min[i] = FLT_MAX;
+        a->cur.max[i] = -FLT_MAX;
+        a->sum[i] = 0;
+    }
+
+    a->have = true;
+}
+
+/**
+ * @brief add a sample to the minute tier (callback from SPSread::read)
+ */
+static bool acc_sample(const struct sps_sample *s, void *ctx)
+{
+    struct rollup_acc *a = (struct rollup_acc *) ctx;
+    float f;
+
+    if (a->have && s->ts - s->ts % a->bucket != a->cur.ts) acc_emit(a);
+    if (! a->have) acc_new(a, s->ts);
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        f = sps_field(&s->v, i);
+        if (f < a->cur.min[i]) a->cur.min[i] = f;
+        if (f > a->cur.max[i]) a->cur.max[i] = f;
+        a->sum[i] += f;
+    }
+
+    a->cur.count++;
+
+    return(! a->error);
+}
+
+/**
+ * @brief add a rollup to the tier above (callback from rollup_read)
+ */
+static bool acc_rollup(const struct sps_rollup *r, void *ctx)
+{
+    struct rollup_acc *a = (struct rollup_acc *) ctx;
+
+    if (a->have && r->ts - r->ts % a->bucket != a->cur.ts) acc_emit(a);
+    if (! a->have) acc_new(a, r->ts);
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (r->min[i] < a->cur.min[i]) a->cur.min[i] = r->min[i];
+        if (r->max[i] > a->cur.max[i]) a->cur.max[i] = r->max[i];
+        a->sum[i] += (double) r->mean[i] * r->count;
+    }
+
+    a->cur.count += r->count;
+
+    return(! a->error);
+}
+
+/**
+ * @brief perform one compaction pass
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int SPSrollup::run()
+{
+    SPSread rd;
+    struct rollup_acc a;
+    struct timespec c0, c1;
+    uint32_t now, before;
+    int ret = STORE_OK;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+
+    memset(&a, 0x0, sizeof(a));
+    a.me = this;
+
+    // nothing stored yet
+    if (rd.open(_dir, _sensor) != STORE_OK) goto done;
+
+    /* minute tier from the samples. The last bucket read is not
+     * complete and is done again in the next pass */
+    a.tier = ROLLUP_MINUTE;
+    a.bucket = bucket_size[ROLLUP_MINUTE];
+
+    if (rd.read(_done[ROLLUP_MINUTE], UINT32_MAX, acc_sample, &a) < 0 || a.error) {
+        ret = STORE_ERROR;
+        goto done;
+    }
+
+    if (a.have) _done[ROLLUP_MINUTE] = a.cur.ts;
+    rd.close();
+
+    /* hour tier from the minute tier, only the complete hours */
+    a.tier = ROLLUP_HOUR;
+    a.bucket = bucket_size[ROLLUP_HOUR];
+    a.have = false;
+
+    if (_done[ROLLUP_MINUTE] > _done[ROLLUP_HOUR]) {
+
+        if (rollup_read(_dir, _sensor, ROLLUP_MINUTE, _done[ROLLUP_HOUR],
+            _done[ROLLUP_MINUTE] - 1, acc_rollup, &a) < 0 || a.error) {
+            ret = STORE_ERROR;
+            goto done;
+        }
+
+        if (a.have) {
+            if (a.cur.ts + a.bucket <= _done[ROLLUP_MINUTE]) {
+                acc_emit(&a);
+                _done[ROLLUP_HOUR] = a.cur.ts + a.bucket;
+            }
+            else
+                _done[ROLLUP_HOUR] = a.cur.ts;
+        }
+
+        if (a.error) {
+            ret = STORE_ERROR;
+            goto done;
+        }
+    }
+
+    // rollups must be on disk before the progress and before removing raw data
+    if (sync_out() != STORE_OK || save_state() != STORE_OK) {
+        printf("Rollup: could not save progress\n");
+        ret = STORE_ERROR;
+        goto done;
+    }
+
+    /* retention, never remove data that is not rolled up yet */
+    now = (uint32_t) time(NULL);
+
+    if (_keep[0] && _store) {
+        before = now - _keep[0] * 86400;
+        if (before > _done[ROLLUP_MINUTE]) before = _done[ROLLUP_MINUTE];
+        _store->expire(before);
+    }
+
+    if (_keep[1]) {
+        before = now - _keep[1] * 86400;
+        if (before > _done[ROLLUP_HOUR]) before = _done[ROLLUP_HOUR];
+        expire_tier(ROLLUP_MINUTE, before);
+    }
+
+    if (_keep[2]) expire_tier(ROLLUP_HOUR, now - _keep[2] * 86400);
+
+done:
+    sync_out();
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+
+    pthread_mutex_lock(&_lock);
+    _st.runs++;
+    _st.cpu += (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) / 1e9;
+    pthread_mutex_unlock(&_lock);
+
+    if (_verbose > 1) printf("Rollup: pass done, minutes until %u, hours until %u\n",
+        _done[ROLLUP_MINUTE], _done[ROLLUP_HOUR]);
+
+    return(ret);
+}
@@ -0,0 +1,172 @@
+/**
+ * SPS30 rollup and retention header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Tiered retention for the sample store:
+ *
+ *  raw samples      kept ROLLUP_RAW_DAYS (default)
+ *  1 minute rollups kept ROLLUP_MINUTE_DAYS
+ *  1 hour rollups   kept forever (unless set)
+ *
+ * A background thread with idle priority builds the rollups from the
+ * samples in the store, then removes the expired raw segments and
+ * rollup files. Only minutes that are complete (a later sample has been
+ * stored) are rolled up, so the work is incremental and a pass can be
+ * repeated after a crash without harm.
+ *
+ * Rollups are stored per sensor and tier in files that cover a fixed
+ * span of time:
+ *
+ *  sNNN_rBBBB_TTTTTTTTTT.rol
+ *
+ * where BBBB is the bucket size in seconds and T the start of the span.
+ * The record for a bucket is at a fixed position in the file, so no
+ * index is needed. A record with count 0 means no samples.
+ *
+ * The progress per tier is kept in sNNN.rst.
+ *********************************************************************
+*/
+#ifndef SPSROLLUP_H
+#define SPSROLLUP_H
+
+# include "spsstore.h"
+
+/* tiers */
+#define ROLLUP_TIERS        2
+#define ROLLUP_MINUTE       0
+#define ROLLUP_HOUR         1
+
+/* default retention in days, 0 = keep forever */
+#define ROLLUP_RAW_DAYS     30
+#define ROLLUP_MINUTE_DAYS  365
+#define ROLLUP_HOUR_DAYS    0
+
+/* seconds between compaction passes */
+#define ROLLUP_INTERVAL     60
+
+/* one rollup record, 128 bytes */
+struct sps_rollup
+{
+    uint32_t ts;                // start of bucket
+    uint32_t count;             // samples in bucket
+    float    min[SPS_FIELDS];
+    float    max[SPS_FIELDS];
+    float    mean[SPS_FIELDS];
+};
+
+/* statistics of the compactor */
+struct rollup_stats
+{
+    uint32_t runs;              // passes done
+    uint64_t rollups;           // rollup records written
+    uint64_t bytes_written;     // bytes written by the compactor
+    uint32_t expired;           // rollup files removed
+    double   cpu;               // CPU seconds used by the compactor
+};
+
+/**
+ * @brief bucket size and file span of a tier in seconds
+ */
+uint32_t rollup_bucket(int tier);
+uint32_t rollup_span(int tier);
+
+/**
+ * @brief read the rollups of a tier between from and to (inclusive)
+ * @param dir    : store directory
+ * @param sensor : sensor id
+ * @param tier   : ROLLUP_MINUTE or ROLLUP_HOUR
+ * @param cb     : called for each bucket with samples, return false to stop
+ *
+ * @return number of rollups or STORE_ERROR
+ */
+typedef bool (*rollup_cb)(const struct sps_rollup *r, void *ctx);
+long rollup_read(const char *dir, uint16_t sensor, int tier, uint32_t from,
+                 uint32_t to, rollup_cb cb, void *ctx);
+
+class SPSrollup
+{
+  public:
+
+    SPSrollup(void);
+
+    /**
+     * @brief set the retention in days per tier (0 = forever)
+     */
+    void retention(uint16_t raw, uint16_t minute, uint16_t hour);
+
+    /**
+     * @brief start the background compactor
+     * @param store   : open store that is written by this program
+     * @param dir     : store directory
+     * @param sensor  : sensor id
+     * @param verbose : if > 0 progress messages are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int start(SPSstore *store, const char *dir, uint16_t sensor, int verbose);
+
+    /**
+     * @brief stop the background compactor (waits for the current pass)
+     */
+    void stop();
+
+    /**
+     * @brief perform one compaction pass
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int run();
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct rollup_stats *st);
+
+    /**
+     * @brief write a rollup record at its position in the tier file
+     */
+    int put(int tier, struct sps_rollup *r);
+
+  private:
+    SPSstore *_store;
+    char     _dir[PATH_MAX - 32];
+    uint16_t _sensor;
+    int      _verbose;
+    uint16_t _keep[ROLLUP_TIERS + 1];   // retention raw, minute, hour
+    uint32_t _done[ROLLUP_TIERS];       // rolled up until (exclusive)
+    struct rollup_stats _st;
+    bool     _running;
+    bool     _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t  _cond;
+
+    /* current output file */
+    int      _fd;
+    int      _fdtier;
+    uint32_t _fdstart;
+
+    static void *thread(void *arg);
+    int  sync_out();
+    int  load_state();
+    int  save_state();
+    int  expire_tier(int tier, uint32_t before);
+};
+
+#endif /* SPSROLLUP_H */
@@ -0,0 +1,1040 @@
+/**
+ * SPS30 alert rule engine for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsrule.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "spsrule.h"
+
+/* opcodes */
+enum {
+    OP_CONST, OP_FIELD, OP_STATUS, OP_BIT,
+    OP_AVG, OP_MIN, OP_MAX, OP_DELTA, OP_RATE,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_NEG,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+    OP_AND, OP_OR, OP_NOT, OP_MARK
+};
+
+/* bits of the status register (STATUS_xxx in sps30lib.h) */
+#define BIT_SPEED   1
+#define BIT_LASER   2
+#define BIT_FAN     4
+
+/* actions */
+#define ACT_LOG     0
+#define ACT_EXEC    1
+#define ACT_SEND    2
+#define ACT_USER    3               // + index in _act
+
+/* state of a rule */
+#define ST_IDLE     0
+#define ST_PENDING  1               // cond true, waiting for 'for'
+#define ST_ACTIVE   2
+
+static const char *state_name[] = {"fire", "repeat", "clear"};
+
+/* a window of a sensor: ring of the samples in the window, positions
+ * are counters, the index is the position & (cap - 1) */
+struct rule_wstate
+{
+    uint32_t *ts;
+    float    *v;
+    uint64_t *mn, *mx;              // monotonic queues of positions
+    uint32_t cap;                   // power of 2
+    uint64_t head, tail;            // ring
+    uint64_t mnh, mnt, mxh, mxt;    // queues
+    double   sum;
+};
+
+struct rule_rstate
+{
+    uint8_t  state;
+    uint32_t since;                 // cond true since (pending)
+    uint32_t last;                  // last event
+};
+
+struct rule_sensor
+{
+    struct rule_wstate *w;          // _nwin
+    struct rule_rstate *r;          // _nrules
+};
+
+/*********************************************************************
+ *  compiler
+ *********************************************************************/
+
+/* parser state */
+typedef struct rule_parser
+{
+    char     *p;                    // next character
+    const char *err;
+    struct rule_instr *code;        // output
+    uint32_t n, cap;
+    int      depth, max_depth;      // stack
+    bool     mark;                  // MARK not emitted yet
+    SPSrule  *rule;
+} rule_parser;
+
+static void skip(rule_parser *ps)
+{
+    while (isspace((unsigned char) *ps->p)) ps->p++;
+}
+
+/**
+ * @brief is the next word w (not followed by a letter)
+ */
+static bool word(rule_parser *ps, const char *w)
+{
+    size_t len = strlen(w);
+
+    skip(ps);
+
+    if (strncasecmp(ps->p, w, len) != 0 || isalnum((unsigned char) ps->p[len]) || ps->p[len] == '_')
+        return(false);
+
+    ps->p += len;
+    return(true);
+}
+
+/**
+ * @brief is the next token the operator op
+ */
+static bool token(rule_parser *ps, const char *op)
+{
+    size_t len = strlen(op);
+
+    skip(ps);
+
+    if (strncmp(ps->p, op, len) != 0) return(false);
+
+    // < is not the start of <=
+    if (len == 1 && (*op == '<' || *op == '>') && ps->p[1] == '=') return(false);
+
+    ps->p += len;
+    return(true);
+}
+
+/**
+ * @brief add an instruction
+ * @param push : change of the stack depth
+ */
+static void emit(rule_parser *ps, uint8_t op, uint16_t arg, float value, int push)
+{
+    struct rule_instr *c;
+
+    if (ps->err) return;
+
+    if (ps->n == ps->cap) {
+        ps->cap = ps->cap ? ps->cap * 2 : 256;
+
+        if (ps->cap > RULE_CODE || (c = (struct rule_instr *) realloc(ps->code,
+            ps->cap * sizeof(struct rule_instr))) == NULL) {
+            ps->err = "too many instructions";
+            return;
+        }
+        ps->code = c;
+    }
+
+    ps->code[ps->n].op = op;
+    ps->code[ps->n].reserved = 0;
+    ps->code[ps->n].arg = arg;
+    ps->code[ps->n++].value = value;
+
+    ps->depth += push;
+    if (ps->depth > ps->max_depth) ps->max_depth = ps->depth;
+}
+
+/**
+ * @brief a duration: number with s, m or h
+ */
+static uint32_t duration(rule_parser *ps)
+{
+    char *end;
+    unsigned long d;
+
+    skip(ps);
+    d = strtoul(ps->p, &end, 10);
+
+    if (end == ps->p) {
+        ps->err = "duration expected";
+        return(0);
+    }
+
+    ps->p = end;
+
+    switch (*ps->p) {
+    case 'h': d *= 60;      // fall through
+    case 'm': d *= 60;      // fall through
+    case 's': ps->p++; break;
+    }
+
+    return((uint32_t) d);
+}
+
+static void expr(rule_parser *ps);
+
+/**
+ * @brief number, field, status bit, window function or ( expr )
+ */
+static void primary(rule_parser *ps)
+{
+    static const char *fn[] = {"avg", "min", "max", "delta", "rate"};
+    char name[RULE_NAME], *end;
+    uint32_t dur;
+    uint16_t q;
+    float  v;
+    int    i, f, w;
+
+    skip(ps);
+
+    if (token(ps, "(")) {
+        expr(ps);
+        if (! token(ps, ")")) ps->err = "missing )";
+        return;
+    }
+
+    v = strtof(ps->p, &end);
+
+    if (end != ps->p) {
+        ps->p = end;
+        emit(ps, OP_CONST, 0, v, 1);
+        return;
+    }
+
+    for (i = 0; i < RULE_NAME - 1 && (isalnum((unsigned char) *ps->p) || *ps->p == '_'); i++) name[i] = *ps->p++;
+    name[i] = 0x0;
+
+    if (i == 0) {
+        ps->err = "value expected";
+        return;
+    }
+
+    if ((f = sps_field_lookup(name)) >= 0) emit(ps, OP_FIELD, f, 0, 1);
+    else if (strcasecmp(name, "status") == 0) emit(ps, OP_STATUS, 0, 0, 1);
+    else if (strcasecmp(name, "speed") == 0) emit(ps, OP_BIT, BIT_SPEED, 0, 1);
+    else if (strcasecmp(name, "laser") == 0) emit(ps, OP_BIT, BIT_LASER, 0, 1);
+    else if (strcasecmp(name, "fan") == 0) emit(ps, OP_BIT, BIT_FAN, 0, 1);
+    else if (sps_quality_mask(name, &q) && q != 0) emit(ps, OP_BIT, q, 0, 1);
+    else {
+        for (i = 0; i < 5 && strcasecmp(name, fn[i]) != 0; i++);
+
+        if (i == 5) {
+            ps->err = "unknown name";
+            return;
+        }
+
+        // fn(field, dur)
+        if (! token(ps, "(")) {
+            ps->err = "( expected";
+            return;
+        }
+
+        skip(ps);
+        for (f = 0; f < RULE_NAME - 1 && (isalnum((unsigned char) *ps->p) || *ps->p == '_'); f++) name[f] = *ps->p++;
+        name[f] = 0x0;
+
+        if ((f = sps_field_lookup(name)) < 0) {
+            ps->err = "field expected";
+            return;
+        }
+
+        if (! token(ps, ",")) {
+            ps->err = ", expected";
+            return;
+        }
+
+        if ((dur = duration(ps)) == 0 && ! ps->err) ps->err = "duration must be > 0";
+
+        if (! token(ps, ")") && ! ps->err) ps->err = ") expected";
+
+        if (ps->err) return;
+
+        if ((w = ps->rule->window(f, dur)) < 0) {
+            ps->err = "too many windows";
+            return;
+        }
+
+        emit(ps, OP_AVG + i, w, 0, 1);
+    }
+}
+
+static void unary(rule_parser *ps)
+{
+    if (token(ps, "-")) {
+        unary(ps);
+        emit(ps, OP_NEG, 0, 0, 0);
+    }
+    else primary(ps);
+}
+
+static void product(rule_parser *ps)
+{
+    unary(ps);
+
+    while (! ps->err) {
+        if (token(ps, "*")) { unary(ps); emit(ps, OP_MUL, 0, 0, -1); }
+        else if (token(ps, "/")) { unary(ps); emit(ps, OP_DIV, 0, 0, -1); }
+        else break;
+    }
+}
+
+static void sum(rule_parser *ps)
+{
+    product(ps);
+
+    while (! ps->err) {
+        if (token(ps, "+")) { product(ps); emit(ps, OP_ADD, 0, 0, -1); }
+        else if (token(ps, "-")) { product(ps); emit(ps, OP_SUB, 0, 0, -1); }
+        else break;
+    }
+}
+
+static void compare(rule_parser *ps)
+{
+    static const char *ops[] = {"<=", ">=", "==", "!=", "<", ">"};
+    static const uint8_t code[] = {OP_LE, OP_GE, OP_EQ, OP_NE, OP_LT, OP_GT};
+
+    sum(ps);
+
+    for (int i = 0; i < 6; i++) {
+        if (! token(ps, ops[i])) continue;
+
+        // the left side of the first comparison is the value of an alert
+        if (ps->mark) {
+            emit(ps, OP_MARK, 0, 0, 0);
+            ps->mark = false;
+        }
+
+        sum(ps);
+        emit(ps, code[i], 0, 0, -1);
+        return;
+    }
+}
+
+static void negation(rule_parser *ps)
+{
+    if (word(ps, "not")) {
+        negation(ps);
+        emit(ps, OP_NOT, 0, 0, 0);
+    }
+    else compare(ps);
+}
+
+static void conjunction(rule_parser *ps)
+{
+    negation(ps);
+
+    while (! ps->err && word(ps, "and")) {
+        negation(ps);
+        emit(ps, OP_AND, 0, 0, -1);
+    }
+}
+
+static void expr(rule_parser *ps)
+{
+    conjunction(ps);
+
+    while (! ps->err && word(ps, "or")) {
+        conjunction(ps);
+        emit(ps, OP_OR, 0, 0, -1);
+    }
+}
+
+/**
+ * @brief the window of a field and duration, shared by all rules
+ *
+ * @return index or -1 when there are too many
+ */
+int SPSrule::window(int field, uint32_t dur)
+{
+    for (int i = 0; i < _nwin; i++) {
+        if (_win[i].field == field && _win[i].dur == dur) return(i);
+    }
+
+    if (_nwin == RULE_WINDOWS) return(-1);
+
+    _win[_nwin].field = field;
+    _win[_nwin].dur = dur;
+
+    return(_nwin++);
+}
+
+/**
+ * @brief open the socket of a send action: udp:host:port or unix:/path
+ */
+static int send_open(const char *addr)
+{
+    struct addrinfo hints, *res;
+    struct sockaddr_un un;
+    char   host[256], *port;
+    int    fd;
+
+    if (strncmp(addr, "unix:", 5) == 0) {
+        memset(&un, 0x0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strncpy(un.sun_path, addr + 5, sizeof(un.sun_path) - 1);
+
+        if ((fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) return(-1);
+
+        // the receiver may start later: connect at send
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        if (connect(fd, (struct sockaddr *) &un, sizeof(un)) != 0) {}
+        return(fd);
+    }
+
+    if (strncmp(addr, "udp:", 4) != 0) return(-1);
+
+    strncpy(host, addr + 4, sizeof(host) - 1);
+    host[sizeof(host) - 1] = 0x0;
+
+    if ((port = strrchr(host, ':')) == NULL) return(-1);
+    *port++ = 0x0;
+
+    memset(&hints, 0x0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0) return(-1);
+
+    if ((fd = socket(res->ai_family, SOCK_DGRAM, 0)) >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if (fd > -1) fcntl(fd, F_SETFL, O_NONBLOCK);
+    return(fd);
+}
+
+/**
+ * @brief compile a line of the rule file
+ */
+int SPSrule::compile(char *line, int lineno)
+{
+    struct rule_def *r, *nr;
+    rule_parser ps;
+    char   *c, *arg;
+    int    i;
+
+    if ((c = strchr(line, '#')) != NULL) *c = 0x0;
+    for (c = line; isspace((unsigned char) *c); c++);
+    if (*c == 0x0) return(STORE_OK);
+
+    if (_nrules == RULE_MAX) {
+        printf("Rule: line %d: more than %d rules\n", lineno, RULE_MAX);
+        return(STORE_ERROR);
+    }
+
+    if ((_nrules & 63) == 0) {
+        if ((nr = (struct rule_def *) realloc(_rules, (_nrules + 64) * sizeof(struct rule_def))) == NULL) {
+            printf("Rule: out of memory\n");
+            return(STORE_ERROR);
+        }
+        _rules = nr;
+    }
+
+    r = &_rules[_nrules];
+    memset(r, 0x0, sizeof(struct rule_def));
+    r->sensor = -1;
+    r->fd = -1;
+
+    memset(&ps, 0x0, sizeof(ps));
+    ps.code = _code;
+    ps.n = _ncode;
+    ps.cap = _capcode;
+    ps.rule = this;
+
+    // name[@sensor]:
+    for (i = 0; i < RULE_NAME - 1 && (isalnum((unsigned char) *c) || *c == '_' || *c == '-'); i++) r->name[i] = *c++;
+    r->name[i] = 0x0;
+
+    if (*c == '@') r->sensor = (int) strtol(c + 1, &c, 10);
+
+    if (i == 0 || *c != ':') ps.err = "name: expected";
+    else ps.p = c + 1;
+
+    // cond
+    if (! ps.err) {
+        r->cond = ps.n;
+        ps.mark = true;
+        expr(&ps);
+        r->cond_len = ps.n - r->cond;
+    }
+
+    // options, then the action
+    while (! ps.err) {
+        if (word(&ps, "for")) r->hold = duration(&ps);
+        else if (word(&ps, "repeat")) r->repeat = duration(&ps);
+        else if (word(&ps, "clear")) {
+            r->clear = ps.n;
+            ps.mark = false;
+            ps.depth = 0;
+            expr(&ps);
+            r->clear_len = ps.n - r->clear;
+        }
+        else if (word(&ps, "do")) break;
+        else ps.err = "for, clear, repeat or do expected";
+    }
+
+    if (! ps.err && ps.max_depth > RULE_STACK) ps.err = "expression too long";
+
+    if (! ps.err) {
+        skip(&ps);
+
+        for (arg = ps.p; *arg && ! isspace((unsigned char) *arg); arg++);
+        if (*arg) *arg++ = 0x0;
+        while (isspace((unsigned char) *arg)) arg++;
+        for (c = arg + strlen(arg); c > arg && isspace((unsigned char) c[-1]); c--) *(c - 1) = 0x0;
+
+        strncpy(r->arg, arg, RULE_ARG - 1);
+
+        if (strcasecmp(ps.p, "log") == 0) {
+            r->action = ACT_LOG;
+
+            // rules that log to the same file share it
+            for (i = 0; *arg && i < _nrules && r->fd < 0; i++) {
+                if (_rules[i].action == ACT_LOG && strcmp(_rules[i].arg, r->arg) == 0) r->fd = _rules[i].fd;
+            }
+
+            if (*arg && r->fd < 0 && (r->fd = ::open(arg, O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0)
+                ps.err = "can not open log file";
+        }
+        else if (strcasecmp(ps.p, "exec") == 0) {
+            r->action = ACT_EXEC;
+            if (*arg == 0x0) ps.err = "exec needs a command";
+        }
+        else if (strcasecmp(ps.p, "send") == 0) {
+            r->action = ACT_SEND;
+            if ((r->fd = send_open(arg)) < 0) ps.err = "can not open send address (udp:host:port or unix:/path)";
+        }
+        else {
+            for (i = 0; i < _nact && strcasecmp(ps.p, _act[i].name) != 0; i++);
+
+            if (i == _nact) ps.err = "unknown action";
+            else r->action = ACT_USER + i;
+        }
+    }
+
+    _code = ps.code;
+    _ncode = ps.n;
+    _capcode = ps.cap;
+
+    if (ps.err) {
+        printf("Rule: line %d: %s\n", lineno, ps.err);
+        for (i = 0; i < _nrules && r->fd > -1; i++) {
+            if (_rules[i].fd == r->fd) r->fd = -1;      // shared
+        }
+        if (r->fd > -1) ::close(r->fd);
+        return(STORE_ERROR);
+    }
+
+    if (_verbose)
+        printf("Rule: %s%s: %u + %u instructions, for %u s, repeat %u s\n", r->name,
+            r->sensor > -1 ? " (one sensor)" : "", r->cond_len, r->clear_len, r->hold, r->repeat);
+
+    _nrules++;
+    return(STORE_OK);
+}
+
+/*********************************************************************
+ *  engine
+ *********************************************************************/
+
+SPSrule::SPSrule(void)
+{
+    _rules = NULL;
+    _nrules = 0;
+    _code = NULL;
+    _ncode = _capcode = 0;
+    _nwin = 0;
+    _sn = NULL;
+    _nact = 0;
+    memset(_child, 0x0, sizeof(_child));
+    _verbose = 0;
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief add an action
+ */
+int SPSrule::action(const char *name, rule_action_cb cb, void *ctx)
+{
+    if (_nact == RULE_ACTIONS) return(STORE_ERROR);
+
+    strncpy(_act[_nact].name, name, RULE_NAME - 1);
+    _act[_nact].name[RULE_NAME - 1] = 0x0;
+    _act[_nact].cb = cb;
+    _act[_nact++].ctx = ctx;
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief compile a rule file
+ */
+int SPSrule::load(const char *file, int verbose)
+{
+    char   line[1024];
+    FILE   *fp;
+    int    lineno = 0, ret = STORE_OK;
+
+    _verbose = verbose;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        printf("Rule: can not open %s\n", file);
+        return(STORE_ERROR);
+    }
+
+    while (ret == STORE_OK && fgets(line, sizeof(line), fp) != NULL) ret = compile(line, ++lineno);
+
+    fclose(fp);
+
+    if (ret == STORE_OK && _nrules == 0) {
+        printf("Rule: no rules in %s\n", file);
+        ret = STORE_ERROR;
+    }
+
+    if (ret == STORE_OK && (_sn = (struct rule_sensor **) calloc(65536, sizeof(struct rule_sensor *))) == NULL) {
+        printf("Rule: out of memory\n");
+        ret = STORE_ERROR;
+    }
+
+    if (ret != STORE_OK) {
+        close();
+        return(ret);
+    }
+
+    _st.rules = _nrules;
+    _st.windows = _nwin;
+
+    if (_verbose) printf("Rule: %d rules, %d windows, %u instructions\n", _nrules, _nwin, _ncode);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief the state of a sensor, created at its first sample
+ */
+struct rule_sensor *SPSrule::sensor(uint16_t id)
+{
+    struct rule_sensor *sn;
+
+    if ((sn = _sn[id]) != NULL) return(sn);
+
+    if ((sn = (struct rule_sensor *) calloc(1, sizeof(struct rule_sensor))) == NULL) return(NULL);
+
+    sn->w = (struct rule_wstate *) calloc(_nwin ? _nwin : 1, sizeof(struct rule_wstate));
+    sn->r = (struct rule_rstate *) calloc(_nrules, sizeof(struct rule_rstate));
+
+    if (sn->w == NULL || sn->r == NULL) {
+        free(sn->w);
+        free(sn->r);
+        free(sn);
+        return(NULL);
+    }
+
+    _st.sensors++;
+    return(_sn[id] = sn);
+}
+
+/**
+ * @brief double the ring and the queues of a window
+ */
+static bool win_grow(struct rule_wstate *w)
+{
+    uint32_t cap = w->cap ? w->cap * 2 : 64, m = cap - 1, om = w->cap - 1;
+    uint32_t *ts = (uint32_t *) malloc(cap * sizeof(uint32_t));
+    float    *v = (float *) malloc(cap * sizeof(float));
+    uint64_t *mn = (uint64_t *) malloc(cap * sizeof(uint64_t));
+    uint64_t *mx = (uint64_t *) malloc(cap * sizeof(uint64_t));
+
+    if (ts == NULL || v == NULL || mn == NULL || mx == NULL) {
+        free(ts); free(v); free(mn); free(mx);
+        return(false);
+    }
+
+    // same positions, other index
+    for (uint64_t i = w->head; i < w->tail; i++) {
+        ts[i & m] = w->ts[i & om];
+        v[i & m] = w->v[i & om];
+    }
+
+    for (uint64_t i = w->mnh; i < w->mnt; i++) mn[i & m] = w->mn[i & om];
+    for (uint64_t i = w->mxh; i < w->mxt; i++) mx[i & m] = w->mx[i & om];
+
+    free(w->ts); free(w->v); free(w->mn); free(w->mx);
+
+    w->ts = ts;
+    w->v = v;
+    w->mn = mn;
+    w->mx = mx;
+    w->cap = cap;
+
+    return(true);
+}
+
+/**
+ * @brief add a value to a window and drop what is older than dur
+ */
+static inline bool win_add(struct rule_wstate *w, uint32_t ts, float v, uint32_t dur)
+{
+    uint32_t m;
+    uint64_t pos;
+
+    // expire
+    while (w->head < w->tail && ts >= dur && w->ts[w->head & (w->cap - 1)] <= ts - dur) {
+        m = w->cap - 1;
+        w->sum -= w->v[w->head & m];
+        if (w->mnh < w->mnt && w->mn[w->mnh & m] == w->head) w->mnh++;
+        if (w->mxh < w->mxt && w->mx[w->mxh & m] == w->head) w->mxh++;
+        w->head++;
+    }
+
+    if (w->tail - w->head == w->cap && ! win_grow(w)) return(false);
+
+    m = w->cap - 1;
+    pos = w->tail++;
+    w->ts[pos & m] = ts;
+    w->v[pos & m] = v;
+    w->sum += v;
+
+    // the queues keep the candidates for min and max
+    while (w->mnt > w->mnh && w->v[w->mn[(w->mnt - 1) & m] & m] >= v) w->mnt--;
+    w->mn[w->mnt++ & m] = pos;
+
+    while (w->mxt > w->mxh && w->v[w->mx[(w->mxt - 1) & m] & m] <= v) w->mxt--;
+    w->mx[w->mxt++ & m] = pos;
+
+    // start again from the values now and then, the sum drifts
+    if ((pos & 0xffff) == 0xffff) {
+        w->sum = 0;
+        for (uint64_t i = w->head; i < w->tail; i++) w->sum += w->v[i & m];
+    }
+
+    return(true);
+}
+
+/**
+ * @brief run the code of an expression
+ * @param value : set to the left side of the first comparison
+ */
+float SPSrule::eval(struct rule_sensor *sn, const struct sps_sample *s, uint32_t pc, uint32_t len, float *value)
+{
+    float st[RULE_STACK + 1];
+    const struct rule_instr *c = &_code[pc], *end = c + len;
+    struct rule_wstate *w;
+    uint32_t m;
+    int   sp = -1;
+    float old;
+
+    *value = NAN;
+
+    for ( ; c < end; c++) {
+        switch (c->op) {
+        case OP_CONST:  st[++sp] = c->value; break;
+        case OP_FIELD:  st[++sp] = sps_field(&s->v, c->arg); break;
+        case OP_STATUS: st[++sp] = (float) (s->flags & SPS_FLAG_STATUS); break;
+        case OP_BIT:    st[++sp] = (s->flags & c->arg) ? 1 : 0; break;
+
+        case OP_AVG: case OP_MIN: case OP_MAX: case OP_DELTA: case OP_RATE:
+            w = &sn->w[c->arg];
+            m = w->cap - 1;
+
+            if (w->tail == w->head) {
+                st[++sp] = 0;
+                break;
+            }
+
+            switch (c->op) {
+            case OP_AVG: st[++sp] = (float) (w->sum / (w->tail - w->head)); break;
+            case OP_MIN: st[++sp] = w->v[w->mn[w->mnh & m] & m]; break;
+            case OP_MAX: st[++sp] = w->v[w->mx[w->mxh & m] & m]; break;
+            case OP_DELTA: st[++sp] = w->v[(w->tail - 1) & m] - w->v[w->head & m]; break;
+            case OP_RATE:
+                old = w->v[w->head & m];
+                st[++sp] = old != 0 ? (w->v[(w->tail - 1) & m] - old) / old * 100 : 0;
+                break;
+            }
+            break;
+
+        case OP_ADD:  sp--; st[sp] += st[sp + 1]; break;
+        case OP_SUB:  sp--; st[sp] -= st[sp + 1]; break;
+        case OP_MUL:  sp--; st[sp] *= st[sp + 1]; break;
+        case OP_DIV:  sp--; st[sp] = st[sp + 1] != 0 ? st[sp] / st[sp + 1] : 0; break;
+        case OP_NEG:  st[sp] = -st[sp]; break;
+        case OP_LT:   sp--; st[sp] = st[sp] < st[sp + 1]; break;
+        case OP_LE:   sp--; st[sp] = st[sp] <= st[sp + 1]; break;
+        case OP_GT:   sp--; st[sp] = st[sp] > st[sp + 1]; break;
+        case OP_GE:   sp--; st[sp] = st[sp] >= st[sp + 1]; break;
+        case OP_EQ:   sp--; st[sp] = st[sp] == st[sp + 1]; break;
+        case OP_NE:   sp--; st[sp] = st[sp] != st[sp + 1]; break;
+        case OP_AND:  sp--; st[sp] = st[sp] != 0 && st[sp + 1] != 0; break;
+        case OP_OR:   sp--; st[sp] = st[sp] != 0 || st[sp + 1] != 0; break;
+        case OP_NOT:  st[sp] = st[sp] == 0; break;
+        case OP_MARK: *value = st[sp]; break;
+        }
+    }
+
+    if (isnan(*value)) *value = st[0];
+
+    _st.evals++;
+    return(st[0]);
+}
+
+/**
+ * @brief collect the exec actions that ended, only those: other
+ * children of the program are not waited for here
+ *
+ * @return a free slot or -1 when RULE_CHILDREN are running
+ */
+int SPSrule::reap()
+{
+    int slot = -1;
+
+    for (int i = 0; i < RULE_CHILDREN; i++) {
+        if (_child[i] > 0 && waitpid(_child[i], NULL, WNOHANG) != 0) _child[i] = 0;
+        if (_child[i] == 0 && slot < 0) slot = i;
+    }
+
+    return(slot);
+}
+
+/**
+ * @brief call the action of a rule
+ */
+void SPSrule::fire(struct rule_def *r, const struct sps_sample *s, int state, float value)
+{
+    struct rule_event ev;
+    char   buf[512], var[5][RULE_NAME + 32], **envp;
+    const char *argv[] = {"sh", "-c", r->arg, NULL};
+    pid_t  pid;
+    long   maxfd;
+    int    len, n, slot;
+
+    if (state == RULE_CLEAR) _st.cleared++;
+    else _st.fired++;
+
+    ev.rule = r->name;
+    ev.arg = r->arg;
+    ev.sensor = s->sensor;
+    ev.ts = s->ts;
+    ev.state = state;
+    ev.value = value;
+
+    switch (r->action) {
+    case ACT_LOG:
+    case ACT_SEND:
+        len = snprintf(buf, sizeof(buf), "ALERT %s sensor %u %s ts %u value %.3f\n", r->name, s->sensor,
+            state_name[state], s->ts, value);
+
+        if (r->fd < 0) {
+            fputs(buf, stdout);
+            fflush(stdout);
+        }
+        else if (r->action == ACT_LOG) {
+            if (write(r->fd, buf, len) != len) {}
+        }
+        else send(r->fd, buf, len, MSG_DONTWAIT);
+        break;
+
+    case ACT_EXEC:
+        if ((slot = reap()) < 0) {
+            _st.exec_dropped++;
+            break;
+        }
+
+        // the environment is made before fork(): the other threads may
+        // hold the malloc lock, so the child must not allocate
+        snprintf(var[0], sizeof(var[0]), "RULE=%s", r->name);
+        snprintf(var[1], sizeof(var[1]), "SENSOR=%u", s->sensor);
+        snprintf(var[2], sizeof(var[2]), "STATE=%s", state_name[state]);
+        snprintf(var[3], sizeof(var[3]), "TS=%u", s->ts);
+        snprintf(var[4], sizeof(var[4]), "VALUE=%.3f", value);
+
+        for (n = 0; environ[n] != NULL; n++);
+
+        if ((envp = (char **) malloc((n + 6) * sizeof(char *))) == NULL) {
+            _st.exec_dropped++;
+            break;
+        }
+
+        for (n = 0; n < 5; n++) envp[n] = var[n];
+
+        for (int i = 0; environ[i] != NULL; i++) {
+            if (strncmp(environ[i], "RULE=", 5) && strncmp(environ[i], "SENSOR=", 7) &&
+                strncmp(environ[i], "STATE=", 6) && strncmp(environ[i], "TS=", 3) &&
+                strncmp(environ[i], "VALUE=", 6)) envp[n++] = environ[i];
+        }
+
+        envp[n] = NULL;
+
+        // the command gets stdin, stdout and stderr, not the store,
+        // sockets and log files of sps30
+        if ((maxfd = sysconf(_SC_OPEN_MAX)) < 0) maxfd = 1024;
+
+        if ((pid = fork()) == 0) {
+            for (int fd = 3; fd < maxfd; fd++) ::close(fd);
+            execve("/bin/sh", (char * const *) argv, envp);
+            _exit(127);
+        }
+
+        free(envp);
+
+        if (pid > 0) _child[slot] = pid;
+        break;
+
+    default:
+        _act[r->action - ACT_USER].cb(&ev, _act[r->action - ACT_USER].ctx);
+        break;
+    }
+}
+
+/**
+ * @brief evaluate the rules of the sensor of a sample
+ */
+void SPSrule::sample(const struct sps_sample *s)
+{
+    struct timespec t0, t1;
+    struct rule_sensor *sn;
+    struct rule_rstate *st;
+    struct rule_def *r;
+    float  value, clear_value;
+    bool   cond;
+
+    if (_nrules == 0 || (sn = sensor(s->sensor)) == NULL) return;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    // the windows first, the rules see this sample in them
+    for (int i = 0; i < _nwin; i++) win_add(&sn->w[i], s->ts, sps_field(&s->v, _win[i].field), _win[i].dur);
+
+    for (int i = 0; i < _nrules; i++) {
+        r = &_rules[i];
+
+        if (r->sensor > -1 && r->sensor != s->sensor) continue;
+
+        st = &sn->r[i];
+        cond = eval(sn, s, r->cond, r->cond_len, &value) != 0;
+
+        switch (st->state) {
+        case ST_IDLE:
+            if (! cond) break;
+
+            st->since = s->ts;
+            st->state = ST_PENDING;
+            // fall through
+
+        case ST_PENDING:
+            if (! cond) st->state = ST_IDLE;
+            else if (s->ts - st->since >= r->hold) {
+                st->state = ST_ACTIVE;
+                st->last = s->ts;
+                fire(r, s, RULE_FIRE, value);
+            }
+            break;
+
+        case ST_ACTIVE:
+            if (r->clear_len ? eval(sn, s, r->clear, r->clear_len, &clear_value) != 0 : ! cond) {
+                st->state = ST_IDLE;
+                fire(r, s, RULE_CLEAR, value);
+            }
+            else if (r->repeat && s->ts - st->last >= r->repeat) {
+                st->last = s->ts;
+                fire(r, s, RULE_REPEAT, value);
+            }
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    _st.samples++;
+    _st.eval_time += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSrule::stats(struct rule_stats *st)
+{
+    *st = _st;
+}
+
+void SPSrule::close()
+{
+    struct rule_sensor *sn;
+
+    reap();
+
+    // a shared log file is closed with its first rule
+    for (int i = 0; i < _nrules; i++) {
+        if (_rules[i].fd < 0) continue;
+
+        ::close(_rules[i].fd);
+
+        for (int j = i + 1; j < _nrules; j++) {
+            if (_rules[j].fd == _rules[i].fd) _rules[j].fd = -1;
+        }
+    }
+
+    if (_sn) {
+        for (int id = 0; id < 65536; id++) {
+            if ((sn = _sn[id]) == NULL) continue;
+
+            for (int i = 0; i < _nwin; i++) {
+                free(sn->w[i].ts);
+                free(sn->w[i].v);
+                free(sn->w[i].mn);
+                free(sn->w[i].mx);
+            }
+
+            free(sn->w);
+            free(sn->r);
+            free(sn);
+        }
+    }
+
+    free(_sn);
+    free(_rules);
+    free(_code);
+
+    _sn = NULL;
+    _rules = NULL;
+    _code = NULL;
+    _nrules = 0;
+    _ncode = _capcode = 0;
+    _nwin = 0;
+}
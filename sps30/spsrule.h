@@ -0,0 +1,208 @@
+/**
+ * SPS30 alert rule engine header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Alert rules evaluated on each sample (option -e of sps30 and spsagg).
+ * A rule file has one rule per line, # starts a comment:
+ *
+ *  name[@sensor]: cond [for dur] [clear cond] [repeat dur] do action
+ *
+ *  pm25:     MassPM2 > 35 for 5m clear MassPM2 < 30 do log
+ *  pm10rise: rate(NumPM10, 1m) > 50 do exec /usr/local/bin/notify
+ *  fan@3:    fan or speed do send udp:alerts.local:7040
+ *
+ * cond is an expression of numbers, fields (MassPM1 .. PartSize),
+ * status (the status register), fan, laser, speed (its bits, 0 or 1),
+ * the quality flags warmup .. interp, bad and all (0 or 1, see
+ * spsquality.h) and window functions over the last dur of a field:
+ *
+ *  avg(f, dur)   min(f, dur)   max(f, dur)
+ *  delta(f, dur) change since the oldest sample in the window
+ *  rate(f, dur)  change in percent of the oldest sample
+ *
+ * with + - * / < <= > >= == != and or not and ( ). dur is a number
+ * with s, m or h (seconds if none).
+ *
+ * A rule fires when cond has been true for 'for' (default at once) and
+ * is then active until 'clear' is true (default: cond is false). It
+ * fires once (de-duplication), and again every 'repeat' while active
+ * when set. On clear the action is called once more.
+ *
+ * Actions:
+ *  log [file]        a line on stdout or appended to file
+ *  exec command      run with sh -c, with RULE, SENSOR, STATE, TS and
+ *                    VALUE in the environment (not waited for)
+ *  send addr         a datagram to udp:host:port or unix:/path
+ *  name [arg]        an action added by the program with action()
+ *
+ * The expressions are compiled to a bytecode for a small stack machine.
+ * The windows are shared by all rules that use the same field and
+ * duration, and are kept per sensor: a ring of the samples in the
+ * window with a running sum and monotonic queues for min and max, so
+ * a sample costs O(1) per window. A rule without @sensor applies to
+ * every sensor.
+ *********************************************************************
+*/
+#ifndef SPSRULE_H
+#define SPSRULE_H
+
+# include "spsstore.h"
+
+#define RULE_MAX            4096            // rules
+#define RULE_CODE           65536           // instructions of all rules
+#define RULE_WINDOWS        256             // distinct field / duration
+#define RULE_STACK          32              // stack of an expression
+#define RULE_NAME           32
+#define RULE_ARG            256
+#define RULE_ACTIONS        8               // added by the program
+#define RULE_CHILDREN       8               // exec at once
+
+/* state of an event */
+#define RULE_FIRE           0
+#define RULE_REPEAT         1
+#define RULE_CLEAR          2
+
+/* an alert, given to the action */
+struct rule_event
+{
+    const char *rule;               // name
+    const char *arg;                // argument of the action
+    uint16_t sensor;
+    uint32_t ts;                    // sample
+    int      state;                 // RULE_FIRE, RULE_REPEAT or RULE_CLEAR
+    float    value;                 // left side of the condition
+};
+
+typedef void (*rule_action_cb)(const struct rule_event *ev, void *ctx);
+
+/* statistics */
+struct rule_stats
+{
+    uint32_t rules;
+    uint32_t windows;
+    uint32_t sensors;
+    uint64_t samples;
+    uint64_t evals;                 // expressions evaluated
+    uint64_t fired;
+    uint64_t cleared;
+    uint32_t exec_dropped;          // too many commands running
+    double   eval_time;             // seconds in sample()
+};
+
+/* instruction */
+struct rule_instr
+{
+    uint8_t  op;
+    uint8_t  reserved;
+    uint16_t arg;                   // field, window or status bit
+    float    value;                 // constant
+};
+
+/* a compiled rule */
+struct rule_def
+{
+    char     name[RULE_NAME];
+    int      sensor;                // -1 = all
+    uint32_t cond, cond_len;        // code
+    uint32_t clear, clear_len;      // code, len 0 = not cond
+    uint32_t hold;                  // seconds cond must be true
+    uint32_t repeat;                // seconds between repeats, 0 = none
+    int      action;                // see spsrule.cpp
+    char     arg[RULE_ARG];
+    int      fd;                    // log file or socket
+};
+
+/* a window of a field */
+struct rule_window
+{
+    int      field;
+    uint32_t dur;
+};
+
+struct rule_sensor;
+
+class SPSrule
+{
+  public:
+
+    SPSrule(void);
+
+    /**
+     * @brief add an action, before load()
+     * @param name : used after 'do' in the rules
+     *
+     * @return STORE_OK or STORE_ERROR (too many)
+     */
+    int action(const char *name, rule_action_cb cb, void *ctx);
+
+    /**
+     * @brief compile a rule file
+     * @param verbose : if > 0 the rules are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error (a message with the line is displayed)
+     */
+    int load(const char *file, int verbose);
+
+    /**
+     * @brief evaluate the rules of the sensor of a sample
+     */
+    void sample(const struct sps_sample *s);
+
+    void close();
+
+    bool is_open() {return(_nrules > 0);}
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct rule_stats *st);
+
+    /**
+     * @brief the window of a field and duration (used by the compiler)
+     *
+     * @return index or -1 when there are too many
+     */
+    int  window(int field, uint32_t dur);
+
+  private:
+    struct rule_def *_rules;
+    int      _nrules;
+    struct rule_instr *_code;
+    uint32_t _ncode, _capcode;
+    struct rule_window _win[RULE_WINDOWS];
+    int      _nwin;
+    struct rule_sensor **_sn;       // by sensor id
+
+    struct {
+        char name[RULE_NAME];
+        rule_action_cb cb;
+        void *ctx;
+    } _act[RULE_ACTIONS];
+    int      _nact;
+
+    pid_t    _child[RULE_CHILDREN];  // exec running (0 = free)
+    int      _verbose;
+    struct rule_stats _st;
+
+    int  compile(char *line, int lineno);
+    struct rule_sensor *sensor(uint16_t id);
+    float eval(struct rule_sensor *sn, const struct sps_sample *s, uint32_t pc, uint32_t len, float *value);
+    void fire(struct rule_def *r, const struct sps_sample *s, int state, float value);
+    int  reap();
+};
+
+#endif /* SPSRULE_H */
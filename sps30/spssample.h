@@ -0,0 +1,186 @@
+/**
+ * SPS30 sample definitions for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * The measurement structure was moved here from sps30lib.h so the
+ * storage code and the offline tools can use it without needing the
+ * BCM2835 library.
+ *********************************************************************
+*/
+#ifndef SPSSAMPLE_H
+#define SPSSAMPLE_H
+
+# include <stdint.h>
+# include <string.h>
+# include <strings.h>
+
+/* structure to return all values */
+struct sps_values
+{
+    float   MassPM1;        // Mass Concentration PM1.0 [μg/m3]
+    float   MassPM2;        // Mass Concentration PM2.5 [μg/m3]
+    float   MassPM4;        // Mass Concentration PM4.0 [μg/m3]
+    float   MassPM10;       // Mass Concentration PM10 [μg/m3]
+    float   NumPM0;         // Number Concentration PM0.5 [#/cm3]
+    float   NumPM1;         // Number Concentration PM1.0 [#/cm3]
+    float   NumPM2;         // Number Concentration PM2.5 [#/cm3]
+    float   NumPM4;         // Number Concentration PM4.0 [#/cm3]
+    float   NumPM10;        // Number Concentration PM4.0 [#/cm3]
+    float   PartSize;       // Typical Particle Size [μm]
+};
+
+/* used to get single value */
+#define v_MassPM1 1
+#define v_MassPM2 2
+#define v_MassPM4 3
+#define v_MassPM10 4
+#define v_NumPM0 5
+#define v_NumPM1 6
+#define v_NumPM2 7
+#define v_NumPM4 8
+#define v_NumPM10 9
+#define v_PartSize 10
+
+/* number of values in sps_values */
+#define SPS_FIELDS 10
+
+/**
+ * A timestamped measurement as it is stored and exported.
+ * Fixed size of 48 bytes, no padding.
+ */
+struct sps_sample
+{
+    uint32_t ts;            // seconds since epoch (UTC)
+    uint16_t sensor;        // sensor id (option -i)
+    uint16_t flags;         // see SPS_FLAG_xxx
+    struct sps_values v;
+};
+
+/* lower byte of flags holds the status register (SPS_status) */
+#define SPS_FLAG_STATUS     0x00ff
+
+/* upper byte of flags holds the quality of the sample (spsquality.h) */
+#define SPS_FLAG_WARMUP     0x0100          // after start(), not stable yet
+#define SPS_FLAG_CLEAN      0x0200          // fan cleaning, not stable yet
+#define SPS_FLAG_SETTLE     0x0400          // after wakeup(), not stable yet
+#define SPS_FLAG_FAULT      0x0800          // status register not 0
+#define SPS_FLAG_RETRY      0x1000          // read again after a bus / CRC error
+#define SPS_FLAG_INTERP     0x2000          // interpolated, not measured
+#define SPS_FLAG_CLOCK      0x4000          // system clock not synchronized
+#define SPS_FLAG_QUALITY    0xff00
+
+/* the values can not be trusted */
+#define SPS_FLAG_BAD        (SPS_FLAG_WARMUP | SPS_FLAG_CLEAN | SPS_FLAG_SETTLE | SPS_FLAG_FAULT)
+
+/* names of the quality flags, for options and display */
+static const struct {const char *name; uint16_t flag;} sps_quality_name[] = {
+    {"warmup", SPS_FLAG_WARMUP}, {"clean", SPS_FLAG_CLEAN}, {"settle", SPS_FLAG_SETTLE},
+    {"fault", SPS_FLAG_FAULT}, {"retry", SPS_FLAG_RETRY}, {"interp", SPS_FLAG_INTERP},
+    {"clock", SPS_FLAG_CLOCK}, {"bad", SPS_FLAG_BAD}, {"all", SPS_FLAG_QUALITY}, {"none", 0}
+};
+
+/* names of the fields, same order as sps_values */
+static const char * const sps_field_name[SPS_FIELDS] = {
+    "MassPM1", "MassPM2", "MassPM4", "MassPM10",
+    "NumPM0", "NumPM1", "NumPM2", "NumPM4", "NumPM10", "PartSize"
+};
+
+/**
+ * @brief get a field from sps_values
+ * @param v : values
+ * @param f : field index (v_xxx - 1)
+ */
+static inline float sps_field(const struct sps_values *v, int f)
+{
+    return(((const float *) v)[f]);
+}
+
+/**
+ * @brief lookup a field index by name
+ * @param name : name of the field (e.g. MassPM2)
+ *
+ * @return
+ *  field index (v_xxx - 1)
+ *  -1 if unknown
+ */
+static inline int sps_field_lookup(const char *name)
+{
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (strcasecmp(name, sps_field_name[i]) == 0) return(i);
+    }
+
+    return(-1);
+}
+
+/**
+ * @brief translate a list of quality names to flags
+ * @param list : names separated by commas (e.g. warmup,clean or bad)
+ * @param mask : the flags
+ *
+ * @return
+ *  true ok
+ *  false a name is unknown
+ */
+static inline bool sps_quality_mask(const char *list, uint16_t *mask)
+{
+    const char *p = list, *e;
+    unsigned i, n = sizeof(sps_quality_name) / sizeof(sps_quality_name[0]);
+
+    *mask = 0;
+
+    while (*p != 0x0) {
+        if ((e = strchr(p, ',')) == NULL) e = p + strlen(p);
+
+        for (i = 0; i < n; i++) {
+            if (strlen(sps_quality_name[i].name) == (size_t) (e - p) &&
+                strncasecmp(p, sps_quality_name[i].name, e - p) == 0) break;
+        }
+
+        if (i == n) return(false);
+
+        *mask |= sps_quality_name[i].flag;
+        p = *e ? e + 1 : e;
+    }
+
+    return(true);
+}
+
+/**
+ * @brief whether the mass and number concentrations of two reads are
+ * the same within a percentage or an absolute difference
+ * @param a   : values
+ * @param b   : values to compare with
+ * @param pct : percent of b
+ * @param abs : difference
+ */
+static inline bool sps_close(const struct sps_values *a, const struct sps_values *b, float pct, float abs)
+{
+    float d, e;
+
+    for (int k = 0; k < SPS_FIELDS; k++) {
+        if (k == v_PartSize - 1) continue;
+
+        d = sps_field(a, k) - sps_field(b, k);
+        e = sps_field(b, k) * pct / 100;
+
+        if (d < 0) d = -d;
+        if (e < 0) e = -e;
+        if (d > e && d > abs) return(false);
+    }
+
+    return(true);
+}
+
+#endif /* SPSSAMPLE_H */
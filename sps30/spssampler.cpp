@@ -0,0 +1,130 @@
+/**
+ * SPS30 adaptive sampling rate for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spssampler.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "spssampler.h"
+
+/* weight of a sample in the moving average (about 5 samples) */
+#define SAMPLER_ALPHA       0.3
+
+SPSsampler::SPSsampler(void)
+{
+    _max = 0;
+    _rate = SAMPLER_RATE;
+    _var = SAMPLER_VAR;
+    _verbose = 0;
+    _interval = SAMPLER_MIN;
+    _have = false;
+    memset(_mean, 0x0, sizeof(_mean));
+    memset(_m2, 0x0, sizeof(_m2));
+    memset(&_st, 0x0, sizeof(_st));
+}
+
+/**
+ * @brief set the thresholds
+ */
+int SPSsampler::open(uint32_t max, double rate, double var, int verbose)
+{
+    if (max == 0) {
+        printf("Sampler: the interval must be 1 s or more\n");
+        return(STORE_ERROR);
+    }
+
+    _max = max;
+    _rate = rate;
+    _var = var;
+    _verbose = verbose;
+    _interval = SAMPLER_MIN;
+
+    if (_verbose)
+        printf("Sampler: 1 - %u s, 1 s when MassPM2 or NumPM10 change over %g%% per minute or vary over %g%%\n",
+            _max, _rate, _var);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief add a sample
+ */
+uint32_t SPSsampler::sample(const struct sps_sample *s)
+{
+    const int fields[2] = {v_MassPM2 - 1, v_NumPM10 - 1};
+    double x, p, d, rate = 0, cv = 0;
+    uint32_t dt, old = _interval;
+
+    _st.samples++;
+
+    for (int i = 0; i < 2; i++) {
+        x = sps_field(&s->v, fields[i]);
+
+        if (! _have) {
+            _mean[i] = x;
+            _m2[i] = 0;
+            continue;
+        }
+
+        // change per minute since the previous sample
+        p = sps_field(&_prev.v, fields[i]);
+        dt = s->ts > _prev.ts ? s->ts - _prev.ts : 1;
+        rate = fmax(rate, fabs(x - p) / fmax(fabs(p), 1) * 100 * 60 / dt);
+
+        // exponentially weighted mean and variance
+        d = x - _mean[i];
+        _mean[i] += SAMPLER_ALPHA * d;
+        _m2[i] = (1 - SAMPLER_ALPHA) * (_m2[i] + SAMPLER_ALPHA * d * d);
+        cv = fmax(cv, sqrt(_m2[i]) / fmax(fabs(_mean[i]), 1) * 100);
+    }
+
+    if (_have) {
+        if (rate > _rate || cv > _var) {
+            if (_interval > 1) _st.raises++;
+            _interval = SAMPLER_MIN;
+        }
+        else if (_interval < _max)
+            _interval = _interval * 2 < _max ? _interval * 2 : _max;
+    }
+
+    _prev = *s;
+    _have = true;
+
+    if (_interval == 1) _st.fast++;
+    _st.seconds += _interval;
+
+    if (_verbose > 1 && _interval != old)
+        printf("Sampler: rate %.1f%%/min, variation %.1f%%, interval %u s\n", rate, cv, _interval);
+
+    return(_interval);
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSsampler::stats(struct sampler_stats *st)
+{
+    *st = _st;
+}
@@ -0,0 +1,112 @@
+/**
+ * SPS30 adaptive sampling rate header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Adaptive sampling rate (option -s) in place of the fixed wait time of
+ * -w: a sample every second while MassPM2 or NumPM10 change, less
+ * often when they are stable, but at least one every 'max' seconds.
+ *
+ * After each sample the signal of both fields is checked:
+ *
+ *  rate      the change since the previous sample, in percent of the
+ *            previous value per minute
+ *  variance  the coefficient of variation (standard deviation / mean,
+ *            in percent) of a moving average over about 5 samples
+ *
+ * When either is above its threshold of either field, the next sample
+ * is taken after SAMPLER_MIN (the SPS30 has a new value every second). When
+ * both are below, the interval is doubled, up to max.
+ *
+ * Values below 1 (ug/m3 or #/cm3) count as 1 in the percentages, so
+ * noise in clean air does not raise the rate.
+ *
+ * With -F the SPS30 sleeps during intervals of SAMPLER_NAP seconds and
+ * more (it needs 4 s after a wake-up). With -p the interval is the wish
+ * of the sampler and the budget can make it longer. A replay (-r) with
+ * -s takes the samples the sampler would have taken, to tune the
+ * thresholds on recorded data.
+ *********************************************************************
+*/
+#ifndef SPSSAMPLER_H
+#define SPSSAMPLER_H
+
+# include "spsstore.h"
+
+#define SAMPLER_MIN         1               // seconds between samples at least
+#define SAMPLER_MAX         60              // seconds between samples at most
+#define SAMPLER_RATE        20              // percent per minute
+#define SAMPLER_VAR         10              // percent
+#define SAMPLER_NAP         10              // with -F: sleep from this interval
+
+/* statistics */
+struct sampler_stats
+{
+    uint64_t samples;
+    uint64_t fast;                  // followed by an interval of 1 s
+    uint32_t raises;                // from a longer interval to 1 s
+    uint64_t seconds;               // covered by the intervals
+};
+
+class SPSsampler
+{
+  public:
+
+    SPSsampler(void);
+
+    /**
+     * @brief set the thresholds
+     * @param max     : seconds between samples at most
+     * @param rate    : percent per minute
+     * @param var     : percent
+     * @param verbose : if > 1 each change of interval is displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR max is 0
+     */
+    int open(uint32_t max, double rate, double var, int verbose);
+
+    bool is_open() {return(_max > 0);}
+
+    /**
+     * @brief add a sample
+     *
+     * @return seconds until the next sample
+     */
+    uint32_t sample(const struct sps_sample *s);
+
+    /**
+     * @brief seconds until the next sample
+     */
+    uint32_t interval() {return(_interval);}
+
+    void stats(struct sampler_stats *st);
+
+  private:
+    uint32_t _max;
+    double   _rate;
+    double   _var;
+    int      _verbose;
+
+    uint32_t _interval;
+    bool     _have;
+    struct sps_sample _prev;
+    double   _mean[2];              // MassPM2, NumPM10
+    double   _m2[2];                // moving variance
+
+    struct sampler_stats _st;
+};
+
+#endif /* SPSSAMPLER_H */
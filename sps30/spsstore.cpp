@@ -0,0 +1,1319 @@
+/**
+ * SPS30 sample store for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsstore.h for the layout
+ *  - group commit with optional staging on tmpfs
+ *  - CRC32C of segment header and blocks, store_verify()
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <float.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spsstore.h"
+#include "spszip.h"
+
+/**
+ * @brief reset an aggregate
+ */
+void store_agg_init(struct store_agg *agg)
+{
+    agg->count = 0;
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        agg->min[i] = FLT_MAX;
+        agg->max[i] = -FLT_MAX;
+        agg->sum[i] = 0;
+    }
+}
+
+/**
+ * @brief add a sample to an aggregate
+ */
+void store_agg_add(struct store_agg *agg, const struct sps_sample *s)
+{
+    float f;
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        f = sps_field(&s->v, i);
+        if (f < agg->min[i]) agg->min[i] = f;
+        if (f > agg->max[i]) agg->max[i] = f;
+        agg->sum[i] += f;
+    }
+
+    agg->count++;
+}
+
+/**
+ * @brief add the summary of an index entry to an aggregate
+ */
+void store_agg_idx(struct store_agg *agg, const struct store_idx *e)
+{
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (e->min[i] < agg->min[i]) agg->min[i] = e->min[i];
+        if (e->max[i] > agg->max[i]) agg->max[i] = e->max[i];
+        agg->sum[i] += e->sum[i];
+    }
+
+    agg->count += e->count;
+}
+
+/**
+ * @brief merge two aggregates
+ */
+void store_agg_merge(struct store_agg *agg, const struct store_agg *a)
+{
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        if (a->min[i] < agg->min[i]) agg->min[i] = a->min[i];
+        if (a->max[i] > agg->max[i]) agg->max[i] = a->max[i];
+        agg->sum[i] += a->sum[i];
+    }
+
+    agg->count += a->count;
+}
+
+/**
+ * @brief create the name of an index file
+ */
+void store_idx_name(char *buf, int len, const char *dir, uint16_t sensor)
+{
+    snprintf(buf, len, "%s/s%03u.idx", dir, sensor);
+}
+
+/**
+ * @brief create the name of a segment file
+ */
+void store_seg_name(char *buf, int len, const char *dir, uint16_t sensor, uint32_t seg)
+{
+    snprintf(buf, len, "%s/s%03u_%010u.seg", dir, sensor, seg);
+}
+
+/**
+ * @brief create the name of a columnar file (see spscol.h)
+ */
+void store_col_name(char *buf, int len, const char *dir, uint16_t sensor, uint32_t seg)
+{
+    snprintf(buf, len, "%s/s%03u_%010u.col", dir, sensor, seg);
+}
+
+void store_zip_name(char *buf, int len, const char *dir, uint16_t sensor, uint32_t seg)
+{
+    snprintf(buf, len, "%s/s%03u_%010u.zsg", dir, sensor, seg);
+}
+
+/**
+ * @brief CRC32C of a block: the records and the header fields before crc
+ */
+uint32_t store_blk_crc(const struct store_blk_header *bh)
+{
+    uint32_t crc;
+
+    // records first, so the writer can keep a running CRC of them
+    crc = crc32c(0, bh + 1, bh->count * sizeof(struct sps_sample));
+
+    return(crc32c(crc, bh, offsetof(struct store_blk_header, crc)));
+}
+
+/**
+ * @brief check a block against its index entry and CRC
+ */
+int store_blk_check(const struct store_blk_header *bh, const struct store_idx *e)
+{
+    if (bh->magic != STORE_BLK_MAGIC || bh->count > STORE_BLOCK_RECS || bh->count < e->count
+        || bh->first_ts != e->first_ts || bh->first_rec != e->first_rec) return(STORE_ERROR);
+
+    if ((bh->flags & STORE_BLK_CRC) && bh->count == e->count && bh->crc != store_blk_crc(bh))
+        return(STORE_ERROR);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief display a range of corrupt blocks
+ */
+static void verify_report(uint16_t sensor, const struct store_idx *first, const struct store_idx *last)
+{
+    printf("Store: sensor %d segment %u blocks %u - %u (timestamps %u - %u) are corrupt\n",
+        sensor, first->seg, (first->offset - STORE_HDR_SIZE) / STORE_BLOCK_SIZE,
+        (last->offset - STORE_HDR_SIZE) / STORE_BLOCK_SIZE, first->first_ts, last->last_ts);
+}
+
+/**
+ * @brief check the CRCs of all segments of a sensor
+ */
+int store_verify(const char *dir, uint16_t sensor, struct store_verify_stats *st)
+{
+    char    name[PATH_MAX];
+    struct  stat fs;
+    struct  store_idx *idx = NULL;
+    const struct store_seg_header *sh;
+    const struct store_blk_header *bh;
+    const struct store_idx *bad = NULL;
+    struct  zip_reader *z;
+    struct  timespec t0, t1;
+    uint8_t *buf = NULL;
+    size_t  len = 0;
+    uint32_t n, i, j;
+    int     fd, ret = STORE_OK;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    store_idx_name(name, sizeof(name), dir, sensor);
+
+    if ((fd = ::open(name, O_RDONLY)) < 0) {
+        printf("Store: can not open index %s\n", name);
+        return(STORE_ERROR);
+    }
+
+    fstat(fd, &fs);
+    n = fs.st_size / sizeof(struct store_idx);
+
+    if (n > 0 && ((idx = (struct store_idx *) malloc(n * sizeof(struct store_idx))) == NULL ||
+        pread(fd, idx, n * sizeof(struct store_idx), 0) != (ssize_t) (n * sizeof(struct store_idx)))) {
+        printf("Store: can not read index %s\n", name);
+        ::close(fd);
+        free(idx);
+        return(STORE_ERROR);
+    }
+
+    ::close(fd);
+    st->bytes += n * sizeof(struct store_idx);
+
+    // a segment at a time, read in one go
+    for (i = 0; i < n; i = j) {
+
+        for (j = i; j < n && idx[j].seg == idx[i].seg; j++);
+
+        store_seg_name(name, sizeof(name), dir, sensor, idx[i].seg);
+
+        // compressed segment
+        if (access(name, F_OK) != 0 && (z = zip_open(dir, sensor, idx[i].seg)) != NULL) {
+            st->segments++;
+            st->bytes += zip_get_header(z)->zip_bytes + ZIP_HDR_SIZE;
+
+            for (uint32_t k = i; k < j; k++) {
+                st->blocks++;
+
+                if ((bh = zip_block(z, idx[k].offset)) != NULL && store_blk_check(bh, &idx[k]) == STORE_OK) {
+                    if (! (bh->flags & STORE_BLK_CRC)) st->no_crc++;
+
+                    if (bad) verify_report(sensor, bad, &idx[k - 1]);
+                    bad = NULL;
+                    continue;
+                }
+
+                st->corrupt++;
+                ret = STORE_ERROR;
+                if (bad == NULL) bad = &idx[k];
+            }
+
+            if (bad) verify_report(sensor, bad, &idx[j - 1]);
+            bad = NULL;
+            zip_close(z);
+            continue;
+        }
+
+        if ((fd = ::open(name, O_RDONLY)) < 0 || fstat(fd, &fs) != 0) {
+            printf("Store: can not open segment %s\n", name);
+            if (fd > -1) ::close(fd);
+            ret = STORE_ERROR;
+            continue;
+        }
+
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        if ((size_t) fs.st_size > len) {
+            free(buf);
+            len = fs.st_size;
+
+            if ((buf = (uint8_t *) malloc(len)) == NULL) {
+                ::close(fd);
+                free(idx);
+                return(STORE_ERROR);
+            }
+        }
+
+        if (pread(fd, buf, fs.st_size, 0) != fs.st_size) {
+            printf("Store: can not read segment %s\n", name);
+            ::close(fd);
+            ret = STORE_ERROR;
+            continue;
+        }
+
+        ::close(fd);
+        st->segments++;
+        st->bytes += fs.st_size;
+
+        sh = (const struct store_seg_header *) buf;
+
+        if (fs.st_size < STORE_HDR_SIZE || sh->magic != STORE_MAGIC || sh->sensor != sensor
+            || sh->seg != idx[i].seg || (sh->version >= 2 &&
+            sh->crc != crc32c(0, sh, offsetof(struct store_seg_header, crc)))) {
+            printf("Store: header of segment %s is corrupt\n", name);
+            ret = STORE_ERROR;
+        }
+
+        for (uint32_t k = i; k < j; k++) {
+            st->blocks++;
+            bh = (const struct store_blk_header *) (buf + idx[k].offset);
+
+            if (idx[k].offset + idx[k].length <= (size_t) fs.st_size && store_blk_check(bh, &idx[k]) == STORE_OK) {
+                if (! (bh->flags & STORE_BLK_CRC)) st->no_crc++;
+
+                if (bad) verify_report(sensor, bad, &idx[k - 1]);
+                bad = NULL;
+                continue;
+            }
+
+            st->corrupt++;
+            ret = STORE_ERROR;
+            if (bad == NULL) bad = &idx[k];
+        }
+
+        if (bad) verify_report(sensor, bad, &idx[j - 1]);
+        bad = NULL;
+    }
+
+    free(buf);
+    free(idx);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    st->elapsed += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    return(ret);
+}
+
+/**
+ * @brief find the sensors in a store directory
+ * @param dir  : store directory
+ * @param list : to store the sensor ids (sorted)
+ * @param max  : size of list
+ *
+ * @return number of sensors found or STORE_ERROR
+ */
+int store_sensors(const char *dir, uint16_t *list, int max)
+{
+    DIR *d;
+    struct dirent *de;
+    unsigned int sensor;
+    char c;
+    int n = 0, i;
+
+    if ((d = opendir(dir)) == NULL) return(STORE_ERROR);
+
+    while ((de = readdir(d)) != NULL && n < max) {
+
+        // must be sNNN.idx
+        if (sscanf(de->d_name, "s%u.id%c", &sensor, &c) != 2 || c != 'x') continue;
+        if (sensor > 0xffff) continue;
+
+        // insert sorted
+        for (i = n++; i > 0 && list[i-1] > sensor; i--) list[i] = list[i-1];
+        list[i] = (uint16_t) sensor;
+    }
+
+    closedir(d);
+
+    return(n);
+}
+
+/*******************************************************************
+ * writer
+ *******************************************************************/
+
+/**
+ * @brief constructor and initialize variables
+ */
+SPSstore::SPSstore(void)
+{
+    _dir[0] = 0x0;
+    _sensor = 0;
+    _verbose = 0;
+    _idxfd = _segfd = -1;
+    _seg = _blk = _idxpos = 0;
+    _pending = _first_pending = 0;
+    _pending_since = _opened = 0;
+    _interval = STORE_COMMIT_INT;
+    _size = 0;
+    _stage[0] = 0x0;
+    _stagefd = -1;
+    _block = NULL;
+    _blkcrc = 0;
+    memset(&_idx, 0x0, sizeof(_idx));
+    memset(&_st, 0x0, sizeof(_st));
+    pthread_mutex_init(&_lock, NULL);
+}
+
+/**
+ * @brief monotonic time in seconds
+ */
+static time_t mono_sec()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return(t.tv_sec);
+}
+
+/**
+ * @brief set the group commit policy (call before open)
+ * @param interval : maximum seconds a sample stays uncommitted
+ * @param size     : commit after this number of samples (0 = block full)
+ * @param stage    : directory on tmpfs to stage samples (NULL = none)
+ */
+void SPSstore::policy(uint32_t interval, uint32_t size, const char *stage)
+{
+    _interval = interval;
+    _size = size;
+
+    if (stage) strncpy(_stage, stage, sizeof(_stage) - 1);
+    else _stage[0] = 0x0;
+}
+
+/**
+ * @brief open (or create) the store for a sensor
+ * @param dir     : directory (must exist)
+ * @param sensor  : sensor id
+ * @param verbose : if > 0 progress messages are displayed
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int SPSstore::open(const char *dir, uint16_t sensor, int verbose)
+{
+    char    name[PATH_MAX];
+    struct  stat st;
+    struct  store_blk_header *bh;
+    off_t   n;
+
+    if (is_open()) close();
+
+    strncpy(_dir, dir, sizeof(_dir) - 1);
+    _sensor = sensor;
+    _verbose = verbose;
+
+    if (_block == NULL) {
+        if (posix_memalign((void **) &_block, 4096, STORE_BLOCK_SIZE) != 0) {
+            printf("Store: out of memory\n");
+            _block = NULL;
+            return(STORE_ERROR);
+        }
+    }
+
+    store_idx_name(name, sizeof(name), _dir, _sensor);
+
+    _idxfd = ::open(name, O_RDWR | O_CREAT, 0644);
+
+    if (_idxfd < 0) {
+        printf("Store: can not open index %s\n", name);
+        return(STORE_ERROR);
+    }
+
+    fstat(_idxfd, &st);
+    n = st.st_size / sizeof(struct store_idx);
+    _pending = _first_pending = 0;
+    _opened = mono_sec();
+
+    // empty store
+    if (n == 0) {
+        _idxpos = 0;
+        _idx.count = 0;
+        _seg = 0;
+
+        if (_verbose) printf("Store: created new store for sensor %d in %s\n", _sensor, _dir);
+        return(open_stage());
+    }
+
+    // read last index entry
+    if (pread(_idxfd, &_idx, sizeof(_idx), (n - 1) * sizeof(_idx)) != sizeof(_idx)) {
+        printf("Store: can not read index %s\n", name);
+        close();
+        return(STORE_ERROR);
+    }
+
+    _seg = _idx.seg;
+    _blk = (_idx.offset - STORE_HDR_SIZE) / STORE_BLOCK_SIZE;
+
+    if (open_seg(_seg, false) != STORE_OK) {
+        close();
+        return(STORE_ERROR);
+    }
+
+    // continue with the partial block
+    if (_idx.flags & STORE_IDX_PARTIAL) {
+
+        if (pread(_segfd, _block, STORE_BLOCK_SIZE, _idx.offset) != STORE_BLOCK_SIZE) {
+            printf("Store: can not read last block\n");
+            close();
+            return(STORE_ERROR);
+        }
+
+        _idxpos = n - 1;
+        _first_pending = _idx.count;
+
+        bh = (struct store_blk_header *) _block;
+        _blkcrc = crc32c(0, bh + 1, _idx.count * sizeof(struct sps_sample));
+
+        if (store_blk_check(bh, &_idx) != STORE_OK)
+            printf("Store: last block of sensor %d is corrupt, continuing\n", _sensor);
+    }
+    else {
+        // next block starts a new one
+        _idxpos = n;
+        _idx.first_rec += _idx.count;
+        _idx.count = 0;
+        _blk++;
+    }
+
+    if (_verbose) printf("Store: opened sensor %d in %s with %ld blocks\n", _sensor, _dir, (long) n);
+
+    return(open_stage());
+}
+
+/**
+ * @brief open the staging file and commit samples left in it
+ */
+int SPSstore::open_stage()
+{
+    char    name[PATH_MAX];
+    struct  store_stage_header hdr;
+    struct  sps_sample *r = NULL;
+    struct  stat st;
+    uint64_t committed;
+    ssize_t n = 0;
+    int     ret = STORE_OK;
+
+    if (_stage[0] == 0x0) return(STORE_OK);
+
+    snprintf(name, sizeof(name), "%s/s%03u.stage", _stage, _sensor);
+
+    if ((_stagefd = ::open(name, O_RDWR | O_CREAT, 0644)) < 0) {
+        printf("Store: can not open staging file %s\n", name);
+        return(STORE_ERROR);
+    }
+
+    // samples left by a previous run
+    fstat(_stagefd, &st);
+
+    if (pread(_stagefd, &hdr, sizeof(hdr), 0) == sizeof(hdr) && hdr.magic == STORE_STAGE_MAGIC
+        && hdr.sensor == _sensor && st.st_size > (off_t) sizeof(hdr)) {
+
+        n = (st.st_size - sizeof(hdr)) / sizeof(struct sps_sample);
+        r = (struct sps_sample *) malloc(n * sizeof(struct sps_sample));
+
+        if (r == NULL || pread(_stagefd, r, n * sizeof(struct sps_sample), sizeof(hdr))
+            != (ssize_t) (n * sizeof(struct sps_sample))) n = 0;
+    }
+
+    reset_stage();
+
+    // add the ones that were not committed yet
+    committed = _idx.first_rec + _idx.count;
+
+    for (ssize_t i = 0; i < n; i++) {
+        if (hdr.first_rec + i < committed) continue;
+        if (add(&r[i]) != STORE_OK) ret = STORE_ERROR;
+    }
+
+    if (_pending > 0) {
+        if (_verbose) printf("Store: recovered %d samples from %s\n", _pending, name);
+        if (commit() != STORE_OK) ret = STORE_ERROR;
+    }
+
+    if (r) free(r);
+
+    return(ret);
+}
+
+/**
+ * @brief empty the staging file after a commit
+ */
+void SPSstore::reset_stage()
+{
+    struct store_stage_header hdr;
+
+    if (_stagefd < 0) return;
+
+    memset(&hdr, 0x0, sizeof(hdr));
+    hdr.magic = STORE_STAGE_MAGIC;
+    hdr.sensor = _sensor;
+    hdr.first_rec = _idx.first_rec + _idx.count;
+
+    // truncate first : a crash in between leaves committed samples
+    // with the old header, which are skipped on recovery
+    if (ftruncate(_stagefd, sizeof(hdr)) != 0 ||
+        pwrite(_stagefd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+        lseek(_stagefd, sizeof(hdr), SEEK_SET) < 0)
+        printf("Store: error on staging file\n");
+}
+
+/**
+ * @brief open a segment
+ * @param seg    : segment id
+ * @param create : if true create a new segment
+ */
+int SPSstore::open_seg(uint32_t seg, bool create)
+{
+    char name[PATH_MAX];
+    struct store_seg_header *hdr;
+
+    if (_segfd > -1) ::close(_segfd);
+
+    store_seg_name(name, sizeof(name), _dir, _sensor, seg);
+
+    if (create) {
+        _segfd = ::open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (_segfd > -1) {
+            // header is written with the area that follows it
+            hdr = (struct store_seg_header *) calloc(1, STORE_HDR_SIZE);
+            if (hdr == NULL) return(STORE_ERROR);
+
+            hdr->magic = STORE_MAGIC;
+            hdr->version = STORE_VERSION;
+            hdr->sensor = _sensor;
+            hdr->seg = seg;
+            hdr->block_size = STORE_BLOCK_SIZE;
+            hdr->rec_size = sizeof(struct sps_sample);
+            hdr->crc = crc32c(0, hdr, offsetof(struct store_seg_header, crc));
+
+            // reserve the complete segment (sparse), so only the
+            // changed pages of a block have to be written
+            if (pwrite(_segfd, hdr, STORE_HDR_SIZE, 0) != STORE_HDR_SIZE ||
+                ftruncate(_segfd, STORE_HDR_SIZE + STORE_SEG_BLOCKS * STORE_BLOCK_SIZE) != 0) {
+                ::close(_segfd);
+                _segfd = -1;
+            }
+
+            free(hdr);
+            _st.writes++;
+            _st.bytes_written += STORE_HDR_SIZE;
+        }
+    }
+    else
+        _segfd = ::open(name, O_RDWR);
+
+    if (_segfd < 0) {
+        printf("Store: can not open segment %s\n", name);
+        return(STORE_ERROR);
+    }
+
+    _seg = seg;
+
+    if (_verbose > 1) printf("Store: segment %s\n", name);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief start a new block
+ * @param ts : timestamp of first sample
+ */
+void SPSstore::new_block(uint32_t ts)
+{
+    struct store_blk_header *bh = (struct store_blk_header *) _block;
+    uint64_t first_rec = _idx.first_rec + _idx.count;
+
+    memset(_block, 0x0, STORE_BLOCK_SIZE);
+    _first_pending = 0;
+    _blkcrc = 0;
+    bh->magic = STORE_BLK_MAGIC;
+    bh->first_ts = ts;
+    bh->first_rec = first_rec;
+
+    memset(&_idx, 0x0, sizeof(_idx));
+    _idx.first_ts = ts;
+    _idx.first_rec = first_rec;
+    _idx.length = STORE_BLOCK_SIZE;
+    _idx.flags = STORE_IDX_PARTIAL;
+    _idx.seg = _seg;
+    _idx.offset = STORE_HDR_SIZE + _blk * STORE_BLOCK_SIZE;
+
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        _idx.min[i] = FLT_MAX;
+        _idx.max[i] = -FLT_MAX;
+    }
+}
+
+/**
+ * @brief append a sample
+ * @param s : sample to add
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int SPSstore::append(struct sps_sample *s)
+{
+    int ret;
+
+    if (! is_open()) return(STORE_ERROR);
+
+    pthread_mutex_lock(&_lock);
+    ret = add(s);
+    pthread_mutex_unlock(&_lock);
+
+    return(ret);
+}
+
+/**
+ * @brief add a sample to the current block (lock is held)
+ */
+int SPSstore::add(struct sps_sample *s)
+{
+    struct store_blk_header *bh = (struct store_blk_header *) _block;
+    struct sps_sample *r;
+    float f;
+
+    s->sensor = _sensor;
+
+    // keep the timestamps ordered, needed for the binary search
+    if (_idxpos > 0 || _idx.count > 0) {
+        if (s->ts < _idx.last_ts) s->ts = _idx.last_ts;
+    }
+
+    // a full block of which the commit failed: try again first
+    if (_idx.count == STORE_BLOCK_RECS && next_block() != STORE_OK) return(STORE_ERROR);
+
+    // need a new block ?
+    if (_idx.count == 0) {
+
+        // need a new segment ?
+        if (_segfd < 0 || _blk >= STORE_SEG_BLOCKS) {
+            _blk = 0;
+            if (open_seg(s->ts, true) != STORE_OK) return(STORE_ERROR);
+        }
+
+        new_block(s->ts);
+    }
+
+    r = (struct sps_sample *) (_block + sizeof(struct store_blk_header));
+    r[_idx.count] = *s;
+    _blkcrc = crc32c(_blkcrc, &r[_idx.count], sizeof(struct sps_sample));
+
+    // update index entry
+    for (int i = 0; i < SPS_FIELDS; i++) {
+        f = sps_field(&s->v, i);
+        if (f < _idx.min[i]) _idx.min[i] = f;
+        if (f > _idx.max[i]) _idx.max[i] = f;
+        _idx.sum[i] += f;
+    }
+
+    _idx.last_ts = s->ts;
+    _idx.count++;
+    bh->count = _idx.count;
+    bh->last_ts = s->ts;
+
+    if (_pending++ == 0) _pending_since = mono_sec();
+
+    _st.samples++;
+    _st.bytes_in += sizeof(struct sps_sample);
+
+    // stage on tmpfs until committed
+    if (_stagefd > -1) {
+        if (write(_stagefd, s, sizeof(struct sps_sample)) != sizeof(struct sps_sample))
+            printf("Store: error on staging file\n");
+    }
+
+    // block full : commit and move to next
+    if (_idx.count == STORE_BLOCK_RECS) return(next_block());
+
+    if ((_size && _pending >= _size) || mono_sec() - _pending_since >= (time_t) _interval)
+        return(commit());
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief commit the full block and move to the next. When the commit
+ * fails the block stays full and add() refuses samples until it works
+ */
+int SPSstore::next_block()
+{
+    _idx.flags &= ~STORE_IDX_PARTIAL;
+
+    if (commit() != STORE_OK) return(STORE_ERROR);
+
+    _idxpos++;
+    _blk++;
+    _idx.first_rec += _idx.count;
+    _idx.count = 0;
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief write part of the current block
+ * @param from : offset in block (page aligned)
+ * @param len  : number of bytes (page aligned)
+ */
+int SPSstore::write_range(uint32_t from, uint32_t len)
+{
+    if (pwrite(_segfd, _block + from, len, _idx.offset + from) != (ssize_t) len) {
+        printf("Store: error writing block\n");
+        return(STORE_ERROR);
+    }
+
+    _st.writes++;
+    _st.bytes_written += len;
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief group commit: write the changed pages of the current block
+ * and its index entry, then make them durable with one sync per file.
+ */
+int SPSstore::commit()
+{
+    struct store_blk_header *bh = (struct store_blk_header *) _block;
+    uint32_t from, to;
+    time_t   risk;
+
+    if (_pending == 0) return(STORE_OK);
+
+    // the records are already in _blkcrc, add the header
+    bh->flags |= STORE_BLK_CRC;
+    bh->crc = crc32c(_blkcrc, bh, offsetof(struct store_blk_header, crc));
+
+    // pages with new records, the first page also holds the block header
+    from = sizeof(struct store_blk_header) + _first_pending * sizeof(struct sps_sample);
+    from &= ~(STORE_PAGE - 1);
+    to = sizeof(struct store_blk_header) + _idx.count * sizeof(struct sps_sample);
+    to = (to + STORE_PAGE - 1) & ~(STORE_PAGE - 1);
+
+    if (from > 0) {
+        if (write_range(0, STORE_PAGE) != STORE_OK) return(STORE_ERROR);
+    }
+
+    if (write_range(from, to - from) != STORE_OK) return(STORE_ERROR);
+
+    // the index entry is written after the block it points to
+    if (pwrite(_idxfd, &_idx, sizeof(_idx), _idxpos * sizeof(_idx)) != sizeof(_idx)) {
+        printf("Store: error writing index\n");
+        return(STORE_ERROR);
+    }
+
+    if (fdatasync(_segfd) != 0 || fdatasync(_idxfd) != 0) {
+        printf("Store: error during sync\n");
+        return(STORE_ERROR);
+    }
+
+    risk = mono_sec() - _pending_since;
+    if (risk > (time_t) _st.max_risk) _st.max_risk = (uint32_t) risk;
+
+    _st.writes++;
+    _st.bytes_written += sizeof(_idx);
+    _st.commits++;
+
+    _pending = 0;
+    _first_pending = _idx.count;
+
+    reset_stage();
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief commit the pending samples now
+ */
+int SPSstore::flush()
+{
+    int ret;
+
+    if (! is_open()) return(STORE_ERROR);
+
+    pthread_mutex_lock(&_lock);
+    ret = commit();
+    pthread_mutex_unlock(&_lock);
+
+    return(ret);
+}
+
+/**
+ * @brief commit the pending samples if the interval has passed
+ */
+int SPSstore::sync()
+{
+    int ret = STORE_OK;
+
+    if (! is_open()) return(STORE_ERROR);
+
+    pthread_mutex_lock(&_lock);
+
+    if (_pending > 0 && mono_sec() - _pending_since >= (time_t) _interval)
+        ret = commit();
+
+    pthread_mutex_unlock(&_lock);
+
+    return(ret);
+}
+
+/**
+ * @brief get the write statistics
+ */
+void SPSstore::stats(struct store_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    st->interval = _interval;
+    st->elapsed = (uint32_t) (mono_sec() - _opened);
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief remove segments of which all samples are before a time
+ * @param before : timestamp
+ *
+ * @return number of segments removed or STORE_ERROR
+ */
+int SPSstore::expire(uint32_t before)
+{
+    char    name[PATH_MAX], tmp[PATH_MAX + 8];
+    struct  store_idx *e = NULL;
+    struct  stat st;
+    struct  dirent *de;
+    DIR     *d;
+    uint32_t n, i, j, k = 0, seg;
+    unsigned int sensor, id;
+    int     fd, r, ret = STORE_ERROR, removed = 0;
+
+    if (! is_open()) return(STORE_ERROR);
+
+    pthread_mutex_lock(&_lock);
+
+    fstat(_idxfd, &st);
+    n = st.st_size / sizeof(struct store_idx);
+
+    if (n == 0) {
+        pthread_mutex_unlock(&_lock);
+        return(0);
+    }
+
+    if ((e = (struct store_idx *) malloc(n * sizeof(struct store_idx))) == NULL) goto done;
+    if (pread(_idxfd, e, n * sizeof(struct store_idx), 0) != (ssize_t) (n * sizeof(struct store_idx))) goto done;
+
+    // find the leading segments that are completely before 'before'
+    for (i = 0; i < n; i = j) {
+
+        if (e[i].seg == _seg) break;
+
+        for (j = i; j < n && e[j].seg == e[i].seg; j++);
+
+        if (e[j-1].last_ts >= before) break;
+        k = j;
+    }
+
+    if (k > 0) {
+        // write new index and swap
+        store_idx_name(name, sizeof(name), _dir, _sensor);
+        snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+
+        if ((fd = ::open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) goto done;
+
+        if (write(fd, &e[k], (n - k) * sizeof(struct store_idx)) != (ssize_t) ((n - k) * sizeof(struct store_idx))
+            || fsync(fd) != 0 || rename(tmp, name) != 0) {
+            ::close(fd);
+            unlink(tmp);
+            printf("Store: could not rewrite index %s\n", name);
+            goto done;
+        }
+
+        ::close(_idxfd);
+        _idxfd = fd;
+        _idxpos -= k;
+
+        _st.writes++;
+        _st.bytes_written += (n - k) * sizeof(struct store_idx);
+    }
+
+    // remove the segments before the first in the index.
+    // This also cleans up after a crash between rename and unlink.
+    seg = (k < n) ? e[k].seg : _seg;
+
+    if ((d = opendir(_dir)) != NULL) {
+        while ((de = readdir(d)) != NULL) {
+            if (sscanf(de->d_name, "s%u_%u.se", &sensor, &id) != 2) continue;
+            if (sensor != _sensor || id >= seg) continue;
+
+            store_seg_name(name, sizeof(name), _dir, _sensor, id);
+            r = unlink(name);
+
+            store_zip_name(name, sizeof(name), _dir, _sensor, id);
+            if (unlink(name) == 0 || r == 0) removed++;
+
+            store_col_name(name, sizeof(name), _dir, _sensor, id);
+            unlink(name);
+        }
+        closedir(d);
+    }
+
+    _st.expired += removed;
+    ret = removed;
+
+    if (_verbose && removed) printf("Store: removed %d segments of sensor %d\n", removed, _sensor);
+
+done:
+    pthread_mutex_unlock(&_lock);
+    if (e) free(e);
+    return(ret);
+}
+
+/**
+ * @brief flush and close the store
+ */
+void SPSstore::close()
+{
+    if (_idxfd > -1) {
+        flush();
+        pthread_mutex_lock(&_lock);
+        ::close(_idxfd);
+        _idxfd = -1;
+        pthread_mutex_unlock(&_lock);
+    }
+
+    if (_segfd > -1) {
+        ::close(_segfd);
+        _segfd = -1;
+    }
+
+    if (_stagefd > -1) {
+        ::close(_stagefd);
+        _stagefd = -1;
+    }
+
+    if (_block) {
+        free(_block);
+        _block = NULL;
+    }
+}
+
+/*******************************************************************
+ * reader
+ *******************************************************************/
+
+/**
+ * @brief constructor and initialize variables
+ */
+SPSread::SPSread(void)
+{
+    _dir[0] = 0x0;
+    _sensor = 0;
+    _idxfd = -1;
+    _idx = NULL;
+    _n = 0;
+    _idxlen = 0;
+    _mseg = 0;
+    _map = NULL;
+    _maplen = 0;
+    _ino = 0;
+    _checked = NULL;
+    _checked_count = 0;
+    _corrupt = 0;
+    _zip = NULL;
+}
+
+/**
+ * @brief open the store of a sensor for reading
+ * @param dir    : store directory
+ * @param sensor : sensor id
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int SPSread::open(const char *dir, uint16_t sensor)
+{
+    char name[PATH_MAX];
+
+    close();
+
+    strncpy(_dir, dir, sizeof(_dir) - 1);
+    _sensor = sensor;
+
+    store_idx_name(name, sizeof(name), _dir, _sensor);
+
+    if ((_idxfd = ::open(name, O_RDONLY)) < 0) return(STORE_ERROR);
+
+    return(refresh());
+}
+
+/**
+ * @brief (re)map the index file
+ */
+int SPSread::refresh()
+{
+    char name[PATH_MAX];
+    struct stat st;
+    void *p;
+
+    if (_idxfd < 0) return(STORE_ERROR);
+
+    // index replaced by expire() : reopen
+    store_idx_name(name, sizeof(name), _dir, _sensor);
+
+    if (stat(name, &st) == 0 && _ino != 0 && st.st_ino != _ino) {
+        ::close(_idxfd);
+        if ((_idxfd = ::open(name, O_RDONLY)) < 0) return(STORE_ERROR);
+        if (_idx) munmap((void *) _idx, _idxlen);
+        _idx = NULL;
+        _checked = NULL;
+        _idxlen = 0;
+    }
+
+    fstat(_idxfd, &st);
+    _ino = st.st_ino;
+
+    if ((size_t) st.st_size == _idxlen) return(STORE_OK);
+
+    if (_idx) munmap((void *) _idx, _idxlen);
+    _idx = NULL;
+    _n = 0;
+    _idxlen = 0;
+    _checked = NULL;
+
+    if (st.st_size < (off_t) sizeof(struct store_idx)) return(STORE_OK);
+
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, _idxfd, 0);
+    if (p == MAP_FAILED) return(STORE_ERROR);
+
+    _idx = (const struct store_idx *) p;
+    _idxlen = st.st_size;
+    _n = _idxlen / sizeof(struct store_idx);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief close the reader
+ */
+void SPSread::close()
+{
+    if (_map) munmap(_map, _maplen);
+    _map = NULL;
+    _maplen = 0;
+
+    zip_close(_zip);
+    _zip = NULL;
+
+    if (_idx) munmap((void *) _idx, _idxlen);
+    _idx = NULL;
+    _idxlen = 0;
+    _n = 0;
+    _checked = NULL;
+
+    if (_idxfd > -1) ::close(_idxfd);
+    _idxfd = -1;
+    _ino = 0;
+}
+
+/**
+ * @brief map a segment file
+ * @param seg : segment id
+ */
+int SPSread::map_seg(uint32_t seg)
+{
+    char name[PATH_MAX];
+    struct stat st;
+    int fd;
+    void *p;
+
+    if (_map) munmap(_map, _maplen);
+    _map = NULL;
+    _maplen = 0;
+
+    zip_close(_zip);
+    _zip = NULL;
+
+    store_seg_name(name, sizeof(name), _dir, _sensor, seg);
+
+    if ((fd = ::open(name, O_RDONLY)) < 0) {
+
+        // compressed by SPSzip
+        if ((_zip = zip_open(_dir, _sensor, seg)) == NULL) return(STORE_ERROR);
+
+        _mseg = seg;
+        return(STORE_OK);
+    }
+
+    fstat(fd, &st);
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED) return(STORE_ERROR);
+
+    _map = (uint8_t *) p;
+    _maplen = st.st_size;
+    _mseg = seg;
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief binary search the first index entry with last_ts >= ts
+ *
+ * @return entry number (entries() if none)
+ */
+uint32_t SPSread::find(uint32_t ts)
+{
+    uint32_t lo = 0, hi = _n, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (_idx[mid].last_ts < ts) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return(lo);
+}
+
+/**
+ * @brief binary search the index entry that holds a record
+ *
+ * @return entry number or entries() if not committed yet
+ */
+uint32_t SPSread::find_rec(uint64_t rec)
+{
+    uint32_t lo = 0, hi = _n, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (_idx[mid].first_rec + _idx[mid].count <= rec) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return(lo);
+}
+
+/**
+ * @brief get the records of the block of an index entry
+ *
+ * @return pointer to the first record or NULL on error
+ */
+const struct sps_sample *SPSread::block(const struct store_idx *e)
+{
+    const struct store_blk_header *bh;
+
+    // segment still growing or other segment
+    if ((_map == NULL && _zip == NULL) || _mseg != e->seg || (_map && e->offset + e->length > _maplen)) {
+        if (map_seg(e->seg) != STORE_OK) return(NULL);
+        if (_map && e->offset + e->length > _maplen) return(NULL);
+    }
+
+    if (_zip) {
+        if ((bh = zip_block(_zip, e->offset)) == NULL) {
+            printf("Store: sensor %d segment %u block %u can not be decompressed, skipped\n", _sensor, e->seg,
+                (e->offset - STORE_HDR_SIZE) / STORE_BLOCK_SIZE);
+            _corrupt++;
+            _checked = NULL;
+            return(NULL);
+        }
+    }
+    else
+        bh = (const struct store_blk_header *) (_map + e->offset);
+
+    // check once, not on each call for the same block
+    if (e != _checked || e->count != _checked_count) {
+
+        if (store_blk_check(bh, e) != STORE_OK) {
+            printf("Store: sensor %d segment %u block %u is corrupt, skipped\n", _sensor, e->seg,
+                (e->offset - STORE_HDR_SIZE) / STORE_BLOCK_SIZE);
+            _corrupt++;
+            _checked = NULL;
+            return(NULL);
+        }
+
+        _checked = e;
+        _checked_count = e->count;
+    }
+
+    return((const struct sps_sample *) (bh + 1));
+}
+
+/**
+ * @brief call cb for each sample between from and to (inclusive)
+ *
+ * @return number of samples or STORE_ERROR
+ */
+long SPSread::read(uint32_t from, uint32_t to, store_cb cb, void *ctx)
+{
+    const struct sps_sample *r;
+    uint32_t i, j, lo, hi, mid;
+    long cnt = 0;
+
+    for (i = find(from); i < _n && _idx[i].first_ts <= to; i++) {
+
+        // skip a corrupt block
+        if ((r = block(&_idx[i])) == NULL) continue;
+
+        // first record >= from
+        lo = 0; hi = _idx[i].count;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (r[mid].ts < from) lo = mid + 1;
+            else hi = mid;
+        }
+
+        for (j = lo; j < _idx[i].count && r[j].ts <= to; j++) {
+            cnt++;
+            if (! cb(&r[j], ctx)) return(cnt);
+        }
+    }
+
+    return(cnt);
+}
+
+/**
+ * @brief aggregate all samples between from and to (inclusive)
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error
+ */
+int SPSread::aggregate(uint32_t from, uint32_t to, struct store_agg *agg)
+{
+    const struct sps_sample *r;
+    uint32_t i, j;
+
+    for (i = find(from); i < _n && _idx[i].first_ts <= to; i++) {
+
+        // completely in range : take from index
+        if (_idx[i].first_ts >= from && _idx[i].last_ts <= to) {
+            store_agg_idx(agg, &_idx[i]);
+            continue;
+        }
+
+        // else read the samples of this block, skip it if corrupt
+        if ((r = block(&_idx[i])) == NULL) continue;
+
+        for (j = 0; j < _idx[i].count; j++) {
+            if (r[j].ts >= from && r[j].ts <= to) store_agg_add(agg, &r[j]);
+        }
+    }
+
+    return(STORE_OK);
+}
@@ -0,0 +1,454 @@
+/**
+ * SPS30 sample store header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * The store keeps samples of one or more sensors in a directory.
+ *
+ * Each sensor has its own set of segment files and one index file:
+ *
+ *  sNNN_TTTTTTTTTT.seg  segment, named by sensor and first timestamp
+ *  sNNN.idx             sparse index, one entry per block
+ *
+ * A segment starts with a header of STORE_HDR_SIZE bytes followed by
+ * up to STORE_SEG_BLOCKS blocks of STORE_BLOCK_SIZE bytes. A block has
+ * a small header followed by time ordered sps_sample records.
+ * At 1Hz a block holds about 22 minutes and a segment about a day.
+ *
+ * Each index entry holds the first / last timestamp, the location of
+ * the block and the min / max / sum per field. A range query does a
+ * binary search on the index, and an aggregate over a range only needs
+ * to read the (at most 2) blocks that are partly in the range.
+ *
+ * To save the SD-card, new samples are kept in memory and written as a
+ * group commit: only the changed 4K pages of the block plus the index
+ * entry, followed by one fsync. A commit is done when the block is
+ * full, after 'size' samples or when the oldest uncommitted sample is
+ * 'interval' seconds old (the maximum data at risk). Optionally the
+ * samples are also staged in a file on tmpfs (e.g. /dev/shm) so they
+ * survive a crash of the program, and are committed on the next open.
+ *
+ * The segment header and each block carry a CRC32C (spscrc.h) to find
+ * corruption of the SD-card. The CRC of a block covers its records and
+ * the header fields before the CRC, and is updated with each commit.
+ * Readers skip a corrupt block, store_verify() checks a whole store.
+ *********************************************************************
+*/
+#ifndef SPSSTORE_H
+#define SPSSTORE_H
+
+# include <stdio.h>
+# include <stdint.h>
+# include <limits.h>
+# include <pthread.h>
+# include <sys/types.h>
+# include <time.h>
+# include "spssample.h"
+# include "spscrc.h"
+
+#define STORE_MAGIC         0x53505353      // "SPSS"
+#define STORE_BLK_MAGIC     0x53505342      // "SPSB"
+#define STORE_VERSION       2               // 2 = with CRC32C
+
+#define STORE_HDR_SIZE      4096            // segment header area
+#define STORE_BLOCK_SIZE    65536           // one block
+#define STORE_SEG_BLOCKS    64              // blocks in a segment
+#define STORE_PAGE          4096            // write alignment
+
+/* default commit policy */
+#define STORE_COMMIT_INT    60              // seconds
+#define STORE_STAGE_MAGIC   0x53505354      // "SPST"
+
+#define STORE_OK            0
+#define STORE_ERROR         -1
+
+/* segment header */
+struct store_seg_header
+{
+    uint32_t magic;         // STORE_MAGIC
+    uint16_t version;       // STORE_VERSION
+    uint16_t sensor;        // sensor id
+    uint32_t seg;           // segment id = first timestamp
+    uint32_t block_size;    // STORE_BLOCK_SIZE
+    uint32_t rec_size;      // sizeof(sps_sample)
+    uint32_t crc;           // CRC32C of the fields above (version 2)
+    uint32_t reserved[10];
+};
+
+/* block header */
+struct store_blk_header
+{
+    uint32_t magic;         // STORE_BLK_MAGIC
+    uint16_t count;         // records in block
+    uint16_t flags;
+    uint32_t first_ts;      // first timestamp
+    uint32_t last_ts;       // last timestamp
+    uint64_t first_rec;     // ordinal of first record in sensor log
+    uint32_t crc;           // CRC32C if STORE_BLK_CRC is set
+    uint32_t reserved[9];
+};
+
+/* block header flags */
+#define STORE_BLK_CRC       0x0001          // crc is valid
+
+/* records in a block */
+#define STORE_BLOCK_RECS ((STORE_BLOCK_SIZE - sizeof(struct store_blk_header)) / sizeof(struct sps_sample))
+
+/* index entry */
+struct store_idx
+{
+    uint32_t first_ts;      // first timestamp in block
+    uint32_t last_ts;       // last timestamp in block
+    uint32_t seg;           // segment id (= name of segment file)
+    uint32_t offset;        // byte offset of block in segment file
+    uint64_t first_rec;     // ordinal of first record in sensor log
+    uint16_t count;         // records in block
+    uint16_t flags;         // STORE_IDX_xxx
+    uint32_t length;        // stored length of the block
+    float    min[SPS_FIELDS];
+    float    max[SPS_FIELDS];
+    double   sum[SPS_FIELDS];
+};
+
+/* index entry flags */
+#define STORE_IDX_PARTIAL   0x0001          // block is not full yet
+
+/* aggregate over a range */
+struct store_agg
+{
+    uint64_t count;
+    float    min[SPS_FIELDS];
+    float    max[SPS_FIELDS];
+    double   sum[SPS_FIELDS];
+};
+
+/* result of store_verify() */
+struct store_verify_stats
+{
+    uint32_t segments;      // segment files checked
+    uint64_t blocks;        // blocks checked
+    uint64_t no_crc;        // blocks written before CRCs were added
+    uint64_t corrupt;       // blocks with a wrong CRC or header
+    uint64_t bytes;         // bytes read
+    double   elapsed;       // seconds
+};
+
+/* write statistics of the store */
+struct store_stats
+{
+    uint64_t samples;       // samples appended
+    uint64_t bytes_in;      // sample bytes appended
+    uint64_t bytes_written; // bytes written to segments and index
+    uint64_t writes;        // write calls
+    uint64_t commits;       // group commits (= fsync)
+    uint32_t expired;       // segments removed by expire()
+    uint32_t interval;      // configured commit interval (data at risk)
+    uint32_t max_risk;      // longest seconds a sample was uncommitted
+    uint32_t elapsed;       // seconds since open
+};
+
+/* header of the staging file */
+struct store_stage_header
+{
+    uint32_t magic;         // STORE_STAGE_MAGIC
+    uint16_t sensor;
+    uint16_t reserved;
+    uint64_t first_rec;     // ordinal of the first sample in the file
+};
+
+/* callback for each sample read, return false to stop */
+typedef bool (*store_cb)(const struct sps_sample *s, void *ctx);
+
+/**
+ * @brief reset an aggregate
+ */
+void store_agg_init(struct store_agg *agg);
+
+/**
+ * @brief add a sample / index entry / aggregate to an aggregate
+ */
+void store_agg_add(struct store_agg *agg, const struct sps_sample *s);
+void store_agg_idx(struct store_agg *agg, const struct store_idx *e);
+void store_agg_merge(struct store_agg *agg, const struct store_agg *a);
+
+/**
+ * @brief find the sensors in a store directory
+ * @param dir  : store directory
+ * @param list : to store the sensor ids (sorted)
+ * @param max  : size of list
+ *
+ * @return number of sensors found or STORE_ERROR
+ */
+int store_sensors(const char *dir, uint16_t *list, int max);
+
+/**
+ * @brief create the name of an index, segment or columnar file
+ */
+void store_idx_name(char *buf, int len, const char *dir, uint16_t sensor);
+void store_seg_name(char *buf, int len, const char *dir, uint16_t sensor, uint32_t seg);
+void store_col_name(char *buf, int len, const char *dir, uint16_t sensor, uint32_t seg);
+void store_zip_name(char *buf, int len, const char *dir, uint16_t sensor, uint32_t seg);
+
+/**
+ * @brief CRC32C of a block: the records and the header fields before crc
+ */
+uint32_t store_blk_crc(const struct store_blk_header *bh);
+
+/**
+ * @brief check a block against its index entry and CRC. The CRC is
+ * only checked when the block and index agree on the count, a block
+ * that is being written can be ahead of its index entry.
+ *
+ * @return
+ *  STORE_OK block is fine
+ *  STORE_ERROR block is corrupt
+ */
+int store_blk_check(const struct store_blk_header *bh, const struct store_idx *e);
+
+/**
+ * @brief check the CRCs of all segments of a sensor, reading each
+ * segment file in one go. Corrupt ranges are displayed.
+ * @param dir     : store directory
+ * @param sensor  : sensor id
+ * @param st      : statistics, added to
+ *
+ * @return
+ *  STORE_OK no corruption found
+ *  STORE_ERROR corruption found or files could not be read
+ */
+int store_verify(const char *dir, uint16_t sensor, struct store_verify_stats *st);
+
+/**
+ * Writes the samples of one sensor.
+ */
+class SPSstore
+{
+  public:
+
+    SPSstore(void);
+
+    /**
+     * @brief set the group commit policy (call before open)
+     * @param interval : maximum seconds a sample stays uncommitted
+     * @param size     : commit after this number of samples (0 = block full)
+     * @param stage    : directory on tmpfs to stage samples (NULL = none)
+     */
+    void policy(uint32_t interval, uint32_t size, const char *stage);
+
+    /**
+     * @brief open (or create) the store for a sensor
+     * @param dir     : directory (must exist)
+     * @param sensor  : sensor id
+     * @param verbose : if > 0 progress messages are displayed
+     *
+     * An incomplete block left by a previous run is continued and
+     * samples left in the staging file are committed.
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *dir, uint16_t sensor, int verbose);
+
+    /**
+     * @brief append a sample
+     * @param s : sample to add. The sensor id is set by the store.
+     *
+     * Timestamps must be increasing. A timestamp before the previous
+     * sample (clock set back) is stored as the previous timestamp.
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int append(struct sps_sample *s);
+
+    /**
+     * @brief commit the pending samples now
+     */
+    int flush();
+
+    /**
+     * @brief commit the pending samples if the interval has passed.
+     * To call regularly when no samples are appended.
+     */
+    int sync();
+
+    /**
+     * @brief flush and close the store
+     */
+    void close();
+
+    /**
+     * @brief remove segments of which all samples are before a time
+     * @param before : timestamp
+     *
+     * The index is rewritten to a temporary file and renamed, so a
+     * reader sees either the old or the new index. The segment files
+     * are removed after that. The current segment is never removed.
+     * Can be called from another thread than append().
+     *
+     * @return number of segments removed or STORE_ERROR
+     */
+    int expire(uint32_t before);
+
+    /**
+     * @brief get the write statistics
+     */
+    void stats(struct store_stats *st);
+
+    /**
+     * @brief sequence number of the last sample appended: its position
+     * in the store of the sensor, starting at 1 (0 = store is empty)
+     */
+    uint64_t seq() {return(_idx.first_rec + _idx.count);}
+
+    bool is_open() {return(_idxfd > -1);}
+
+  private:
+    char     _dir[PATH_MAX - 32];
+    uint16_t _sensor;
+    int      _verbose;
+    int      _idxfd;            // index file
+    int      _segfd;            // current segment file
+    uint32_t _seg;              // current segment id
+    uint32_t _blk;              // current block number in segment
+    uint32_t _idxpos;           // index entry number of current block
+    uint32_t _pending;          // uncommitted samples
+    uint32_t _first_pending;    // first uncommitted record in block
+    time_t   _pending_since;    // arrival of oldest uncommitted sample
+    time_t   _opened;           // time of open
+    uint32_t _interval;         // commit policy
+    uint32_t _size;
+    char     _stage[PATH_MAX - 32];
+    int      _stagefd;          // staging file
+    struct store_idx _idx;      // index entry of current block
+    uint8_t  *_block;           // current block
+    struct store_stats _st;     // statistics
+    uint32_t _blkcrc;           // CRC32C of the records in the block
+    pthread_mutex_t _lock;      // append() versus expire()
+
+    int  add(struct sps_sample *s);
+    int  open_seg(uint32_t seg, bool create);
+    void new_block(uint32_t ts);
+    int  commit();
+    int  next_block();
+    int  write_range(uint32_t from, uint32_t len);
+    int  open_stage();
+    void reset_stage();
+};
+
+struct zip_reader;                  // see spszip.h
+
+/**
+ * Reads the samples of one sensor.
+ */
+class SPSread
+{
+  public:
+
+    SPSread(void);
+
+    /**
+     * @brief open the store of a sensor for reading
+     * @param dir    : store directory
+     * @param sensor : sensor id
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int open(const char *dir, uint16_t sensor);
+
+    /**
+     * @brief pick up index entries added since open
+     */
+    int refresh();
+
+    void close();
+
+    /**
+     * @brief number of index entries / access an entry
+     */
+    uint32_t entries() {return(_n);}
+    const struct store_idx *entry(uint32_t i) {return(&_idx[i]);}
+
+    /**
+     * @brief binary search the first index entry with last_ts >= ts
+     *
+     * @return entry number (entries() if none)
+     */
+    uint32_t find(uint32_t ts);
+
+    /**
+     * @brief binary search the index entry that holds a record
+     * @param rec : ordinal of the record in the sensor log (from 0)
+     *
+     * @return entry number, the first entry after rec if it is not in
+     * the index (expired), entries() if rec is not committed yet
+     */
+    uint32_t find_rec(uint64_t rec);
+
+    /**
+     * @brief get the records of the block of an index entry
+     *
+     * @return pointer to the first record or NULL on error or when the
+     * block is corrupt
+     */
+    const struct sps_sample *block(const struct store_idx *e);
+
+    /**
+     * @brief number of corrupt blocks skipped
+     */
+    uint32_t corrupt() {return(_corrupt);}
+
+    /**
+     * @brief call cb for each sample between from and to (inclusive)
+     *
+     * @return number of samples or STORE_ERROR
+     */
+    long read(uint32_t from, uint32_t to, store_cb cb, void *ctx);
+
+    /**
+     * @brief aggregate all samples between from and to (inclusive)
+     *
+     * Blocks completely in the range are taken from the index.
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int aggregate(uint32_t from, uint32_t to, struct store_agg *agg);
+
+  private:
+    char     _dir[PATH_MAX - 32];
+    uint16_t _sensor;
+    int      _idxfd;
+    const struct store_idx *_idx;   // mapped index
+    uint32_t _n;                    // entries in index
+    size_t   _idxlen;               // mapped length
+    uint32_t _mseg;                 // mapped segment id
+    uint8_t  *_map;                 // mapped segment
+    size_t   _maplen;
+
+    ino_t    _ino;                  // index file, changed by expire()
+    const struct store_idx *_checked;   // last block checked
+    uint32_t _checked_count;
+    uint32_t _corrupt;              // corrupt blocks skipped
+    struct zip_reader *_zip;        // compressed segment (instead of _map)
+
+    int map_seg(uint32_t seg);
+};
+
+#endif /* SPSSTORE_H */
@@ -0,0 +1,439 @@
+/**
+ * SPS30 sample stream for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spsstream.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "spsstream.h"
+
+/**
+ * @brief split an address
+ * @param host : set to the host (TCP) or the path (Unix socket)
+ * @param port : set to the port (TCP)
+ *
+ * @return true for a Unix socket
+ */
+static bool stream_addr(const char *addr, char *host, int hlen, char *port, int plen)
+{
+    const char *p;
+
+    if (strncmp(addr, "unix:", 5) == 0 || addr[0] == '/') {
+        strncpy(host, addr[0] == '/' ? addr : addr + 5, hlen - 1);
+        host[hlen - 1] = 0x0;
+        return(true);
+    }
+
+    if ((p = strrchr(addr, ':')) != NULL) {
+        snprintf(host, hlen, "%.*s", (int) (p - addr), addr);
+        strncpy(port, p + 1, plen - 1);
+    }
+    else {
+        strncpy(host, addr, hlen - 1);
+        strncpy(port, STREAM_PORT, plen - 1);
+    }
+
+    host[hlen - 1] = port[plen - 1] = 0x0;
+    return(false);
+}
+
+/**
+ * @brief connect, giving up after STREAM_TIMEOUT seconds
+ */
+static int connect_wait(int fd, const struct sockaddr *sa, socklen_t len)
+{
+    struct pollfd pfd;
+    socklen_t elen = sizeof(int);
+    int    flags, err = 0;
+
+    if ((flags = fcntl(fd, F_GETFL)) < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return(-1);
+
+    if (connect(fd, sa, len) != 0) {
+        if (errno != EINPROGRESS && errno != EAGAIN) return(-1);
+
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+
+        while ((err = poll(&pfd, 1, STREAM_TIMEOUT * 1000)) < 0 && errno == EINTR);
+
+        if (err <= 0) return(-1);
+
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &elen) != 0 || err != 0) return(-1);
+    }
+
+    return(fcntl(fd, F_SETFL, flags));
+}
+
+/**
+ * @brief connect to an aggregator
+ */
+int stream_connect(const char *addr)
+{
+    char   host[256], port[16];
+    struct addrinfo hints, *res, *ai;
+    struct sockaddr_un un;
+    int    fd = -1, one = 1;
+
+    if (stream_addr(addr, host, sizeof(host), port, sizeof(port))) {
+        if (strlen(host) >= sizeof(un.sun_path)) return(-1);
+
+        memset(&un, 0x0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        memcpy(un.sun_path, host, strlen(host));
+
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return(-1);
+
+        if (connect_wait(fd, (struct sockaddr *) &un, sizeof(un)) != 0) {
+            ::close(fd);
+            return(-1);
+        }
+
+        return(fd);
+    }
+
+    memset(&hints, 0x0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0) return(-1);
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) continue;
+
+        if (connect_wait(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+    return(fd);
+}
+
+/**
+ * @brief listen for producers
+ */
+int stream_listen(const char *addr)
+{
+    char   host[256], port[16];
+    struct addrinfo hints, *res, *ai;
+    struct sockaddr_un un;
+    int    fd = -1, one = 1;
+
+    if (stream_addr(addr, host, sizeof(host), port, sizeof(port))) {
+        if (strlen(host) >= sizeof(un.sun_path)) return(-1);
+
+        memset(&un, 0x0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        memcpy(un.sun_path, host, strlen(host));
+
+        // left by a previous run
+        unlink(host);
+
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return(-1);
+
+        if (bind(fd, (struct sockaddr *) &un, sizeof(un)) != 0 || listen(fd, 128) != 0) {
+            ::close(fd);
+            return(-1);
+        }
+
+        return(fd);
+    }
+
+    memset(&hints, 0x0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0) return(-1);
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) continue;
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 128) == 0) break;
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+    return(fd);
+}
+
+/**
+ * @brief send a buffer completely
+ */
+static int send_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+    ssize_t r;
+
+    while (len > 0) {
+        if ((r = send(fd, p, len, MSG_NOSIGNAL)) <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return(STORE_ERROR);
+        }
+
+        p += r;
+        len -= r;
+    }
+
+    return(STORE_OK);
+}
+
+SPSstream::SPSstream(void)
+{
+    _addr[0] = 0x0;
+    _verbose = 0;
+    _fd = -1;
+    _ring = NULL;
+    _head = _count = 0;
+    _running = _stop = false;
+    memset(&_st, 0x0, sizeof(_st));
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+}
+
+/**
+ * @brief start sending to an aggregator
+ */
+int SPSstream::open(const char *addr, int verbose)
+{
+    snprintf(_addr, sizeof(_addr), "%s", addr);
+    _verbose = verbose;
+
+    if ((_ring = (struct sps_sample *) malloc(STREAM_RING * sizeof(struct sps_sample))) == NULL) {
+        printf("Stream: out of memory\n");
+        return(STORE_ERROR);
+    }
+
+    _stop = false;
+
+    if (pthread_create(&_thread, NULL, thread, this) != 0) {
+        printf("Stream: can not start sender\n");
+        free(_ring);
+        _ring = NULL;
+        return(STORE_ERROR);
+    }
+
+    _running = true;
+    return(STORE_OK);
+}
+
+/**
+ * @brief add a sample to the ring
+ */
+void SPSstream::sample(const struct sps_sample *s)
+{
+    if (! _running) return;
+
+    pthread_mutex_lock(&_lock);
+
+    _st.samples++;
+
+    if (_count == STREAM_RING) _st.dropped++;
+    else {
+        _ring[_head] = *s;
+        _head = (_head + 1) % STREAM_RING;
+        _count++;
+        pthread_cond_signal(&_cond);
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief connect and send the hello
+ */
+int SPSstream::connect_aggregator()
+{
+    struct stream_hello h;
+    struct timeval tv;
+
+    if ((_fd = stream_connect(_addr)) < 0) return(STORE_ERROR);
+
+    // a send to a stuck aggregator fails, so close() does not wait for it
+    tv.tv_sec = STREAM_TIMEOUT;
+    tv.tv_usec = 0;
+    setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    memset(&h, 0x0, sizeof(h));
+    h.magic = STREAM_MAGIC;
+    h.version = STREAM_VERSION;
+    h.sensors = 1;
+    gethostname(h.name, sizeof(h.name) - 1);
+
+    if (send_all(_fd, &h, sizeof(h)) != STORE_OK) {
+        ::close(_fd);
+        _fd = -1;
+        return(STORE_ERROR);
+    }
+
+    if (_verbose) printf("Stream: connected to %s\n", _addr);
+    return(STORE_OK);
+}
+
+/**
+ * @brief send n samples of the ring from tail (in one or two parts)
+ * @param tail : oldest slot, taken with the lock held
+ * @param n    : samples, taken with the lock held
+ */
+int SPSstream::send_ring(uint32_t tail, uint32_t n)
+{
+    uint32_t first = n < STREAM_RING - tail ? n : STREAM_RING - tail;
+
+    if (send_all(_fd, &_ring[tail], first * sizeof(struct sps_sample)) != STORE_OK) return(STORE_ERROR);
+
+    if (first < n && send_all(_fd, &_ring[0], (n - first) * sizeof(struct sps_sample)) != STORE_OK)
+        return(STORE_ERROR);
+
+    return(STORE_OK);
+}
+
+/**
+ * @brief the background thread : connects and sends the ring
+ */
+void *SPSstream::thread(void *arg)
+{
+    SPSstream *me = (SPSstream *) arg;
+    struct timespec ts;
+    sigset_t set;
+    uint32_t tail, n;
+    int     ret;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_mutex_lock(&me->_lock);
+
+    while (! me->_stop) {
+
+        if (me->_fd < 0) {
+            pthread_mutex_unlock(&me->_lock);
+            ret = me->connect_aggregator();
+            pthread_mutex_lock(&me->_lock);
+
+            if (ret == STORE_OK) {
+                me->_st.connects++;
+                continue;
+            }
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += STREAM_RETRY;
+
+            while (! me->_stop) {
+                if (pthread_cond_timedwait(&me->_cond, &me->_lock, &ts) != 0) break;
+            }
+            continue;
+        }
+
+        if (me->_count == 0) {
+            pthread_cond_wait(&me->_cond, &me->_lock);
+            continue;
+        }
+
+        // the oldest n samples are not touched by sample() while sending,
+        // _head and _count are, so take where they are with the lock held
+        n = me->_count;
+        tail = (me->_head + STREAM_RING - n) % STREAM_RING;
+
+        pthread_mutex_unlock(&me->_lock);
+        ret = me->send_ring(tail, n);
+        pthread_mutex_lock(&me->_lock);
+
+        if (ret == STORE_OK) {
+            me->_count -= n;
+            me->_st.sent += n;
+            continue;
+        }
+
+        if (me->_verbose) printf("Stream: connection to %s lost\n", me->_addr);
+
+        ::close(me->_fd);
+        me->_fd = -1;
+    }
+
+    pthread_mutex_unlock(&me->_lock);
+    return(NULL);
+}
+
+/**
+ * @brief stop sending
+ */
+void SPSstream::close()
+{
+    if (_running) {
+        pthread_mutex_lock(&_lock);
+        _stop = true;
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_lock);
+
+        pthread_join(_thread, NULL);
+        _running = false;
+
+        // one try for what is waiting
+        if (_count > 0 && _fd > -1 &&
+            send_ring((_head + STREAM_RING - _count) % STREAM_RING, _count) == STORE_OK) {
+            _st.sent += _count;
+            _count = 0;
+        }
+
+        _st.dropped += _count;
+        _count = 0;
+    }
+
+    if (_fd > -1) ::close(_fd);
+    _fd = -1;
+
+    free(_ring);
+    _ring = NULL;
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSstream::stats(struct stream_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    pthread_mutex_unlock(&_lock);
+}
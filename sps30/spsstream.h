@@ -0,0 +1,127 @@
+/**
+ * SPS30 sample stream header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Streams samples to the aggregator (spsagg) over TCP or a Unix socket.
+ *
+ * An address is host:port for TCP or unix:/path (or just /path) for a
+ * Unix socket. A producer sends a struct stream_hello and then each
+ * sample as a struct sps_sample (48 bytes, as stored). All producers
+ * and the aggregator are expected to have the same byte order.
+ *
+ * SPSstream is the producer side used by sps30 (option -G). Samples go
+ * into a ring in memory and a thread sends them, so a slow or missing
+ * aggregator does not block the measurements. It reconnects every
+ * STREAM_RETRY seconds, samples are dropped when the ring is full. A
+ * connect or send that takes more than STREAM_TIMEOUT seconds fails,
+ * so a stuck aggregator does not hold up the stop of sps30.
+ *********************************************************************
+*/
+#ifndef SPSSTREAM_H
+#define SPSSTREAM_H
+
+# include <pthread.h>
+# include "spsstore.h"
+
+#define STREAM_MAGIC        0x53505346      // "SPSF"
+#define STREAM_VERSION      1
+#define STREAM_PORT         "7030"
+#define STREAM_RING         4096            // samples waiting
+#define STREAM_RETRY        5               // seconds between connects
+#define STREAM_TIMEOUT      5               // seconds for a connect or a send
+
+/* sent first by a producer */
+struct stream_hello
+{
+    uint32_t magic;         // STREAM_MAGIC
+    uint16_t version;       // STREAM_VERSION
+    uint16_t sensors;       // number of sensors in this stream (info)
+    char     name[24];      // producer name, e.g. the host name
+};
+
+/* statistics of a producer */
+struct stream_stats
+{
+    uint64_t samples;       // samples passed to sample()
+    uint64_t sent;          // samples sent
+    uint64_t dropped;       // samples lost (ring full or not sent at close)
+    uint32_t connects;      // successful connects
+};
+
+/**
+ * @brief connect to an aggregator / listen for producers
+ * @param addr : host:port, unix:/path or /path
+ *
+ * @return socket or -1 on error
+ */
+int stream_connect(const char *addr);
+int stream_listen(const char *addr);
+
+class SPSstream
+{
+  public:
+
+    SPSstream(void);
+
+    /**
+     * @brief start sending to an aggregator
+     * @param addr    : host:port, unix:/path or /path
+     * @param verbose : if > 0 connect messages are displayed
+     *
+     * @return
+     *  STORE_OK success (also if the aggregator can not be reached yet)
+     *  STORE_ERROR error
+     */
+    int open(const char *addr, int verbose);
+
+    /**
+     * @brief add a sample to the ring
+     */
+    void sample(const struct sps_sample *s);
+
+    /**
+     * @brief stop sending, one try for what is waiting
+     */
+    void close();
+
+    bool is_open() {return(_running);}
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct stream_stats *st);
+
+  private:
+    char     _addr[256];
+    int      _verbose;
+    int      _fd;                   // -1 if not connected
+
+    struct sps_sample *_ring;       // STREAM_RING samples
+    uint32_t _head;                 // next to write
+    uint32_t _count;                // samples in ring
+
+    struct stream_stats _st;
+    bool     _running;
+    bool     _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t  _cond;
+
+    int  connect_aggregator();
+    int  send_ring(uint32_t tail, uint32_t n);
+    static void *thread(void *arg);
+};
+
+#endif /* SPSSTREAM_H */
@@ -0,0 +1,330 @@
+/**
+ * spstail.cpp
+ *
+ * Subscriber of the sample log of sps30 (option -L)
+ *
+ * Displays the samples with their sequence number and keeps the last
+ * sequence number processed in an offset file. After a restart, or
+ * when the connection is lost, it asks for the samples after that
+ * number, so none are missed. See spslog.h for the protocol. Build
+ * with:
+ *      make spstail
+ *
+ * Examples:
+ *  follow sps30 -o /data -L :7031, resume where the last run stopped
+ *      ./spstail -a localhost:7031 -o /var/tmp/sps.offset
+ *
+ *  everything in the store, stop when caught up, only count
+ *      ./spstail -a /tmp/sps.sock -n 0 -e -q
+ *
+ * *****************************************************************
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * version 1.0 / October 2026
+ *  - initial version
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include <unistd.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <time.h>
+# include <signal.h>
+# include "spslog.h"
+# include "spsstream.h"
+
+#define TAIL_MAJOR 1
+#define TAIL_MINOR 0
+
+#define TAIL_RETRY      2               // seconds between connects
+#define TAIL_READ       65536           // bytes read at once
+
+typedef struct tail_par
+{
+    char     addr[256];
+    char     offset[256];               // offset file (empty = none)
+    bool     after_set;                 // -n given
+    uint64_t after;                     // start after this number
+    bool     live;                      // -l
+    bool     quiet;                     // -q : only count
+    bool     until;                     // -e : stop when caught up
+    int      verbose;
+} tail_par;
+
+/* progress */
+typedef struct tail_state
+{
+    uint64_t last;                      // last sequence number processed
+    uint64_t target;                    // last at connect (-e)
+    uint64_t lines;
+    uint64_t duplicates;                // sent again after a reconnect
+    uint64_t missing;                   // not sent and not in a gap line
+    uint64_t gaps;                      // in gap lines
+    uint32_t connects;
+    bool     live;                      // asked for new samples only
+    int      offfd;
+    int      out_error;                 // errno of writing stdout, 0 = none
+} tail_state;
+
+char progname[20];
+
+static volatile sig_atomic_t Stop = 0;
+
+/*********************************************************************
+ * @brief time in seconds
+ *********************************************************************/
+static double now_sec()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/*********************************************************************
+ * @brief save the offset, in place so the file is never empty
+ *********************************************************************/
+static void save_offset(tail_state *t)
+{
+    char buf[24];
+
+    if (t->offfd < 0) return;
+
+    snprintf(buf, sizeof(buf), "%020llu\n", (unsigned long long) t->last);
+
+    if (pwrite(t->offfd, buf, 21, 0) != 21) printf("Can not write offset file\n");
+}
+
+/*********************************************************************
+ * @brief handle a line from the log
+ *********************************************************************/
+static void do_line(char *line, tail_par *a, tail_state *t)
+{
+    unsigned long long n, m;
+    unsigned s;
+    uint64_t seq;
+
+    if (line[0] == '#') {
+        if (sscanf(line, "# sensor %u, last %llu", &s, &n) == 2) {
+            t->target = n;
+
+            // new samples only: continue from here after a reconnect
+            if (t->live) t->last = n;
+            t->live = false;
+        }
+        else if (sscanf(line, "# gap %llu %llu", &n, &m) == 2) {
+            fprintf(stderr, "samples %llu to %llu are not available\n", n, m);
+            t->gaps += m - n + 1;
+            t->last = m;
+        }
+        else fprintf(stderr, "%s\n", line);
+        return;
+    }
+
+    seq = strtoull(line, NULL, 10);
+
+    if (seq <= t->last) {
+        t->duplicates++;
+        return;
+    }
+
+    if (seq != t->last + 1 && (t->lines > 0 || a->after_set || a->offset[0])) t->missing += seq - t->last - 1;
+
+    t->last = seq;
+    t->lines++;
+
+    if (! a->quiet) printf("%s\n", line);
+}
+
+/*********************************************************************
+ * @brief follow the log until the connection is lost
+ *
+ * @return true when done (-e)
+ *********************************************************************/
+static bool follow(int fd, tail_par *a, tail_state *t)
+{
+    static char buf[TAIL_READ + LOG_LINE];
+    char   req[64], *p, *nl;
+    size_t len = 0;
+    ssize_t r;
+    uint64_t before;
+
+    if (a->live && t->connects == 1 && ! a->after_set && a->offset[0] == 0x0) {
+        snprintf(req, sizeof(req), "live\n");
+        t->live = true;
+    }
+    else
+        snprintf(req, sizeof(req), "after %llu\n", (unsigned long long) t->last);
+
+    if (write(fd, req, strlen(req)) != (ssize_t) strlen(req)) return(false);
+
+    t->target = 0;
+
+    while (! Stop) {
+
+        if ((r = read(fd, buf + len, TAIL_READ)) <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return(false);
+        }
+
+        len += r;
+        p = buf;
+        before = t->last;
+
+        while ((nl = (char *) memchr(p, '\n', buf + len - p)) != NULL) {
+            *nl = 0x0;
+            do_line(p, a, t);
+            p = nl + 1;
+        }
+
+        // keep an incomplete line
+        len = buf + len - p;
+        memmove(buf, p, len);
+
+        // the reader of stdout is gone (e.g. | head) or it can not be
+        // written: stop, the lines of this read are not taken as done
+        errno = 0;
+
+        if (! a->quiet && (fflush(stdout) != 0 || ferror(stdout))) {
+            t->out_error = errno ? errno : EIO;
+            t->last = before;
+            Stop = 1;
+            return(true);
+        }
+
+        save_offset(t);
+
+        if (a->until && t->target > 0 && t->last >= t->target) return(true);
+    }
+
+    return(true);
+}
+
+/*********************************************************************
+* @brief usage information
+**********************************************************************/
+void usage()
+{
+    printf("%s [options]  (program version %d.%d)\n\n"
+    "-a addr    sps30 -L address: host:port or unix:/path (default localhost:%s)\n"
+    "-o file    keep the last sequence number in file and resume after it\n"
+    "-n #       start after sequence number # (0 = all in the store)\n"
+    "-l         start with new samples (when there is no offset)\n"
+    "-e         stop when caught up\n"
+    "-q         quiet: count the samples, do not display them\n"
+    "-v         verbose\n"
+    "\n\tOutput: seq,sensor,ts,MassPM1,..,PartSize,flags\n"
+    , progname, TAIL_MAJOR, TAIL_MINOR, LOG_PORT);
+}
+
+static void signal_handler(int sig)
+{
+    Stop = 1;
+}
+
+/***********************
+ *  program starts here
+ **********************/
+int main(int argc, char *argv[])
+{
+    struct sigaction sa;
+    tail_state t;
+    tail_par a;
+    char   buf[32];
+    double t0, el;
+    int    opt, fd;
+
+    strncpy(progname, argv[0], 19);
+    progname[19] = 0x0;
+
+    memset(&a, 0x0, sizeof(a));
+    memset(&t, 0x0, sizeof(t));
+    snprintf(a.addr, sizeof(a.addr), "localhost:%s", LOG_PORT);
+    t.offfd = -1;
+
+    while ((opt = getopt(argc, argv, "a:o:n:leqvh")) != -1) {
+        switch (opt) {
+        case 'a':  strncpy(a.addr, optarg, sizeof(a.addr) - 1); break;
+        case 'o':  strncpy(a.offset, optarg, sizeof(a.offset) - 1); break;
+        case 'n':  a.after = strtoull(optarg, NULL, 10); a.after_set = true; break;
+        case 'l':  a.live = true; break;
+        case 'e':  a.until = true; break;
+        case 'q':  a.quiet = true; break;
+        case 'v':  a.verbose++; break;
+        case 'h':  usage(); exit(EXIT_SUCCESS);
+        default:   usage(); exit(EXIT_FAILURE);
+        }
+    }
+
+    // the offset of the previous run, unless -n is given
+    if (a.offset[0] != 0x0) {
+        if ((t.offfd = open(a.offset, O_RDWR | O_CREAT, 0644)) < 0) {
+            printf("Can not open offset file %s\n", a.offset);
+            exit(EXIT_FAILURE);
+        }
+
+        memset(buf, 0x0, sizeof(buf));
+        if (! a.after_set && read(t.offfd, buf, sizeof(buf) - 1) > 0) t.last = strtoull(buf, NULL, 10);
+    }
+
+    if (a.after_set) t.last = a.after;
+
+    memset(&sa, 0x0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (a.verbose) fprintf(stderr, "following %s after %llu\n", a.addr, (unsigned long long) t.last);
+
+    t0 = now_sec();
+
+    while (! Stop) {
+
+        if ((fd = stream_connect(a.addr)) < 0) {
+            if (a.verbose) fprintf(stderr, "can not connect to %s, retry in %d s\n", a.addr, TAIL_RETRY);
+            sleep(TAIL_RETRY);
+            continue;
+        }
+
+        t.connects++;
+        if (a.verbose && t.connects > 1) fprintf(stderr, "reconnected after %llu\n", (unsigned long long) t.last);
+
+        if (follow(fd, &a, &t)) {
+            close(fd);
+            break;
+        }
+
+        close(fd);
+        if (a.verbose) fprintf(stderr, "connection lost after %llu\n", (unsigned long long) t.last);
+        if (! Stop) sleep(TAIL_RETRY);
+    }
+
+    el = now_sec() - t0;
+    save_offset(&t);
+
+    fprintf(stderr, "%llu samples in %.2f s (%.0f/s), last %llu, %u connects, %llu duplicates, %llu missing, %llu in gaps\n",
+        (unsigned long long) t.lines, el, el > 0 ? t.lines / el : 0, (unsigned long long) t.last,
+        t.connects, (unsigned long long) t.duplicates, (unsigned long long) t.missing, (unsigned long long) t.gaps);
+
+    // a closed pipe is a normal end
+    if (t.out_error != 0 && t.out_error != EPIPE) {
+        fprintf(stderr, "Can not write the output: %s\n", strerror(t.out_error));
+        return(EXIT_FAILURE);
+    }
+
+    return(EXIT_SUCCESS);
+}
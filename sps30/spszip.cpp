@@ -0,0 +1,796 @@
+/**
+ * SPS30 segment compression for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * ================ Disclaimer ===================================
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************
+ * version 1.0 / October 2026
+ *  - initial version, see spszip.h
+ *
+ * Without SPS_ZSTD (make ZSTD=yes) nothing is compressed and a .zsg
+ * file can not be read.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include "spszip.h"
+
+#ifdef SPS_ZSTD
+# include <zstd.h>
+# include <zdict.h>
+#endif
+
+/**
+ * @brief name of a dictionary file
+ */
+void zip_dict_name(char *buf, int len, const char *dir, uint32_t id)
+{
+    snprintf(buf, len, "%s/z%010u.dict", dir, id);
+}
+
+#ifdef SPS_ZSTD
+
+/**
+ * @brief CPU time of the thread in seconds
+ */
+static double cpu_sec()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/**
+ * @brief read a complete file
+ *
+ * @return malloc'ed buffer or NULL
+ */
+static uint8_t *read_file(const char *name, size_t *len)
+{
+    struct stat st;
+    uint8_t *buf;
+    int fd;
+
+    if ((fd = open(name, O_RDONLY)) < 0) return(NULL);
+
+    fstat(fd, &st);
+
+    if ((buf = (uint8_t *) malloc(st.st_size + 1)) != NULL &&
+        pread(fd, buf, st.st_size, 0) != st.st_size) {
+        free(buf);
+        buf = NULL;
+    }
+
+    close(fd);
+    *len = st.st_size;
+    return(buf);
+}
+
+/**
+ * @brief write a file completely or not at all
+ */
+static int write_file(const char *name, const void *buf, size_t len)
+{
+    char tmp[PATH_MAX + 8];
+    int fd;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) return(STORE_ERROR);
+
+    if (write(fd, buf, len) != (ssize_t) len || fsync(fd) != 0 || rename(tmp, name) != 0) {
+        close(fd);
+        unlink(tmp);
+        return(STORE_ERROR);
+    }
+
+    close(fd);
+    return(STORE_OK);
+}
+
+/*********************************************************************
+ *  compression
+ *********************************************************************/
+
+/**
+ * @brief load the newest dictionary in the directory
+ *
+ * @return malloc'ed dictionary or NULL if none
+ */
+static uint8_t *dict_load(const char *dir, uint32_t *id, size_t *len)
+{
+    char    name[PATH_MAX], best[PATH_MAX];
+    struct  dirent *de;
+    struct  stat st;
+    time_t  newest = 0;
+    uint32_t n;
+    DIR     *d;
+
+    if ((d = opendir(dir)) == NULL) return(NULL);
+
+    best[0] = 0x0;
+
+    while ((de = readdir(d)) != NULL) {
+        if (sscanf(de->d_name, "z%10u.dict", &n) != 1 || strlen(de->d_name) != 16) continue;
+
+        zip_dict_name(name, sizeof(name), dir, n);
+
+        if (stat(name, &st) == 0 && st.st_mtime >= newest) {
+            newest = st.st_mtime;
+            strcpy(best, name);
+            *id = n;
+        }
+    }
+
+    closedir(d);
+
+    if (best[0] == 0x0) return(NULL);
+
+    return(read_file(best, len));
+}
+
+/**
+ * @brief length of a block to compress: header and records
+ */
+static uint32_t blk_raw(const struct store_blk_header *bh)
+{
+    // keep a damaged block as it is, for store_verify()
+    if (bh->magic != STORE_BLK_MAGIC || bh->count > STORE_BLOCK_RECS) return(STORE_BLOCK_SIZE);
+
+    return(sizeof(struct store_blk_header) + bh->count * sizeof(struct sps_sample));
+}
+
+/**
+ * @brief train a dictionary on blocks of the sealed segments
+ *
+ * @return malloc'ed dictionary or NULL if not enough blocks
+ */
+static uint8_t *dict_train(const char *dir, uint16_t sensor, const struct store_idx *idx,
+                           uint32_t n, uint32_t *id, size_t *len, int verbose)
+{
+    char    name[PATH_MAX];
+    uint8_t *samples, *dict = NULL;
+    size_t  sizes[ZIP_TRAIN_MAX], total = 0, r, seglen;
+    uint8_t *seg = NULL;
+    uint32_t cur = 0;
+    int     ns = 0;
+
+    if ((samples = (uint8_t *) malloc((size_t) ZIP_TRAIN_MAX * STORE_BLOCK_SIZE)) == NULL) return(NULL);
+
+    // spread the blocks over the segments: every so many
+    for (uint32_t i = 0; i < n && ns < ZIP_TRAIN_MAX; i += (n + ZIP_TRAIN_MAX - 1) / ZIP_TRAIN_MAX) {
+
+        if (seg == NULL || idx[i].seg != cur) {
+            free(seg);
+            cur = idx[i].seg;
+            store_seg_name(name, sizeof(name), dir, sensor, cur);
+            if ((seg = read_file(name, &seglen)) == NULL) continue;
+        }
+
+        if (idx[i].offset + STORE_BLOCK_SIZE > seglen) continue;
+
+        r = blk_raw((const struct store_blk_header *) (seg + idx[i].offset));
+        memcpy(samples + total, seg + idx[i].offset, r);
+        sizes[ns++] = r;
+        total += r;
+    }
+
+    free(seg);
+
+    if (ns >= ZIP_TRAIN_MIN && (dict = (uint8_t *) malloc(ZIP_DICT_SIZE)) != NULL) {
+
+        *len = ZDICT_trainFromBuffer(dict, ZIP_DICT_SIZE, samples, sizes, ns);
+
+        if (ZDICT_isError(*len)) {
+            if (verbose) printf("Zip: can not train dictionary: %s\n", ZDICT_getErrorName(*len));
+            free(dict);
+            dict = NULL;
+        }
+        else {
+            *id = ZDICT_getDictID(dict, *len);
+            zip_dict_name(name, sizeof(name), dir, *id);
+
+            if (write_file(name, dict, *len) != STORE_OK) {
+                printf("Zip: can not write %s\n", name);
+                free(dict);
+                dict = NULL;
+            }
+            else if (verbose)
+                printf("Zip: trained dictionary %s on %d blocks\n", name, ns);
+        }
+    }
+
+    free(samples);
+    return(dict);
+}
+
+/**
+ * @brief compress one segment into a .zsg file and remove the .seg file
+ * @param idx  : index entries of the segment
+ * @param n    : number of entries
+ */
+static int zip_segment(const char *dir, uint16_t sensor, const struct store_idx *idx, uint32_t n,
+                       ZSTD_CCtx *cctx, uint32_t dict, int level, struct zip_stats *st)
+{
+    char    name[PATH_MAX], zname[PATH_MAX];
+    struct  zip_header *h;
+    struct  stat fs;
+    uint8_t *seg, *out;
+    size_t  seglen, pos, bound, r;
+    uint32_t b, raw;
+    int     ret = STORE_ERROR;
+
+    store_seg_name(name, sizeof(name), dir, sensor, idx[0].seg);
+    store_zip_name(zname, sizeof(zname), dir, sensor, idx[0].seg);
+
+    if (stat(name, &fs) != 0 || (seg = read_file(name, &seglen)) == NULL) return(STORE_ERROR);
+
+    bound = ZSTD_compressBound(STORE_BLOCK_SIZE);
+
+    if ((out = (uint8_t *) calloc(1, ZIP_HDR_SIZE + n * bound)) == NULL) {
+        free(seg);
+        return(STORE_ERROR);
+    }
+
+    h = (struct zip_header *) out;
+    pos = ZIP_HDR_SIZE;
+
+    if (seglen >= sizeof(struct store_seg_header)) memcpy(&h->hdr, seg, sizeof(h->hdr));
+
+    for (uint32_t i = 0; i < n; i++) {
+        b = (idx[i].offset - STORE_HDR_SIZE) / STORE_BLOCK_SIZE;
+
+        if (b >= STORE_SEG_BLOCKS || idx[i].offset + STORE_BLOCK_SIZE > seglen) goto done;
+
+        raw = blk_raw((const struct store_blk_header *) (seg + idx[i].offset));
+
+        r = ZSTD_compress2(cctx, out + pos, bound, seg + idx[i].offset, raw);
+
+        if (ZSTD_isError(r)) {
+            printf("Zip: can not compress %s: %s\n", name, ZSTD_getErrorName(r));
+            goto done;
+        }
+
+        h->block[b].offset = pos;
+        h->block[b].length = r;
+        h->block[b].raw = raw;
+        h->blocks++;
+        h->raw_bytes += raw;
+        h->zip_bytes += r;
+        pos += r;
+    }
+
+    h->magic = ZIP_MAGIC;
+    h->version = ZIP_VERSION;
+    h->sensor = sensor;
+    h->seg = idx[0].seg;
+    h->dict = dict;
+    h->level = level;
+    h->crc = crc32c(0, h, offsetof(struct zip_header, crc));
+
+    if (write_file(zname, out, pos) != STORE_OK) {
+        printf("Zip: can not write %s\n", zname);
+        goto done;
+    }
+
+    // expire() removed the segment meanwhile : remove ours as well
+    if (unlink(name) != 0) {
+        unlink(zname);
+        goto done;
+    }
+
+    if (st) {
+        st->segments++;
+        st->raw_bytes += h->raw_bytes;
+        st->zip_bytes += pos;
+        st->disk_bytes += fs.st_blocks * 512;
+    }
+
+    ret = STORE_OK;
+
+done:
+    free(seg);
+    free(out);
+    return(ret);
+}
+
+/**
+ * @brief compress the sealed segments of a sensor
+ */
+int zip_segments(const char *dir, uint16_t sensor, int level, int verbose, struct zip_stats *st)
+{
+    char    name[PATH_MAX];
+    struct  stat fs;
+    struct  store_idx *idx = NULL;
+    ZSTD_CCtx  *cctx = NULL;
+    ZSTD_CDict *cdict = NULL;
+    uint8_t *dict = NULL;
+    size_t  dlen = 0;
+    uint32_t n, sealed, i, j, id = 0;
+    double  cpu = cpu_sec();
+    int     fd, cnt = 0;
+
+    store_idx_name(name, sizeof(name), dir, sensor);
+
+    if ((fd = open(name, O_RDONLY)) < 0) return(0);
+
+    fstat(fd, &fs);
+    n = fs.st_size / sizeof(struct store_idx);
+
+    if (n == 0 || (idx = (struct store_idx *) malloc(n * sizeof(struct store_idx))) == NULL ||
+        pread(fd, idx, n * sizeof(struct store_idx), 0) != (ssize_t) (n * sizeof(struct store_idx))) {
+        close(fd);
+        free(idx);
+        return(n == 0 ? 0 : STORE_ERROR);
+    }
+
+    close(fd);
+
+    // the segment of the last entry is still written
+    for (sealed = n; sealed > 0 && idx[sealed - 1].seg == idx[n - 1].seg; sealed--);
+
+    if (sealed == 0) goto done;
+
+    if ((dict = dict_load(dir, &id, &dlen)) == NULL)
+        dict = dict_train(dir, sensor, idx, sealed, &id, &dlen, verbose);
+
+    if ((cctx = ZSTD_createCCtx()) == NULL) {
+        cnt = STORE_ERROR;
+        goto done;
+    }
+
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+    if (dict) {
+        if ((cdict = ZSTD_createCDict(dict, dlen, level)) == NULL) {
+            cnt = STORE_ERROR;
+            goto done;
+        }
+
+        ZSTD_CCtx_refCDict(cctx, cdict);
+    }
+    else
+        id = 0;
+
+    for (i = 0; i < sealed; i = j) {
+
+        for (j = i; j < sealed && idx[j].seg == idx[i].seg; j++);
+
+        // already compressed or expired
+        store_seg_name(name, sizeof(name), dir, sensor, idx[i].seg);
+        if (stat(name, &fs) != 0) continue;
+
+        if (zip_segment(dir, sensor, &idx[i], j - i, cctx, id, level, st) != STORE_OK) {
+            cnt = STORE_ERROR;
+            break;
+        }
+
+        cnt++;
+
+        if (verbose > 1) printf("Zip: compressed %s\n", name);
+    }
+
+done:
+    if (cdict) ZSTD_freeCDict(cdict);
+    if (cctx) ZSTD_freeCCtx(cctx);
+    free(dict);
+    free(idx);
+
+    if (st) st->cpu += cpu_sec() - cpu;
+
+    return(cnt);
+}
+
+/**
+ * @brief compress buffers one by one and decompress them again
+ */
+int zip_bench(const uint8_t *data, const size_t *sizes, int n, int level, bool dict,
+              struct zip_bench_result *r)
+{
+    ZSTD_CCtx  *cctx = ZSTD_createCCtx();
+    ZSTD_DCtx  *dctx = ZSTD_createDCtx();
+    ZSTD_CDict *cdict = NULL;
+    ZSTD_DDict *ddict = NULL;
+    uint8_t *d = NULL, *out = NULL, *back = NULL, *train = NULL;
+    size_t  *zs = NULL, *ts = NULL, *at = NULL;
+    size_t  bound = 0, total = 0, pos, len, tn = 0;
+    double  t;
+    int     ret = STORE_ERROR;
+
+    memset(r, 0x0, sizeof(struct zip_bench_result));
+
+    for (int i = 0; i < n; i++) {
+        total += sizes[i];
+        bound += ZSTD_compressBound(sizes[i]);
+    }
+
+    out = (uint8_t *) malloc(bound);
+    back = (uint8_t *) malloc(total);
+    zs = (size_t *) malloc(n * sizeof(size_t));
+    at = (size_t *) malloc(n * sizeof(size_t));
+
+    if (cctx == NULL || dctx == NULL || out == NULL || back == NULL || zs == NULL || at == NULL) goto done;
+
+    // start of each buffer
+    for (int i = 0; i < n; i++) at[i] = i ? at[i - 1] + sizes[i - 1] : 0;
+
+    // train on every other buffer
+    if (dict) {
+        if ((train = (uint8_t *) malloc(total)) == NULL || (ts = (size_t *) malloc(n * sizeof(size_t))) == NULL
+            || (d = (uint8_t *) malloc(ZIP_DICT_SIZE)) == NULL) goto done;
+
+        pos = 0;
+
+        for (int i = 0; i < n; i += 2) {
+            memcpy(train + pos, data + at[i], sizes[i]);
+            pos += sizes[i];
+            ts[tn++] = sizes[i];
+        }
+
+        t = cpu_sec();
+        len = ZDICT_trainFromBuffer(d, ZIP_DICT_SIZE, train, ts, tn);
+        r->train_cpu = cpu_sec() - t;
+
+        if (ZDICT_isError(len)) {
+            printf("Zip: can not train dictionary: %s\n", ZDICT_getErrorName(len));
+            goto done;
+        }
+
+        if ((cdict = ZSTD_createCDict(d, len, level)) == NULL ||
+            (ddict = ZSTD_createDDict(d, len)) == NULL) goto done;
+    }
+
+    t = cpu_sec();
+    pos = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (cdict) len = ZSTD_compress_usingCDict(cctx, out + pos, bound - pos, data + at[i], sizes[i], cdict);
+        else len = ZSTD_compressCCtx(cctx, out + pos, bound - pos, data + at[i], sizes[i], level);
+
+        if (ZSTD_isError(len)) goto done;
+
+        zs[i] = len;
+        pos += len;
+    }
+
+    r->comp_cpu = cpu_sec() - t;
+    r->raw_bytes = total;
+    r->zip_bytes = pos;
+
+    t = cpu_sec();
+    pos = 0;
+
+    for (int i = 0; i < n; pos += zs[i], i++) {
+        if (ddict) len = ZSTD_decompress_usingDDict(dctx, back + at[i], sizes[i], out + pos, zs[i], ddict);
+        else len = ZSTD_decompressDCtx(dctx, back + at[i], sizes[i], out + pos, zs[i]);
+
+        if (ZSTD_isError(len) || len != sizes[i]) goto done;
+    }
+
+    r->decomp_cpu = cpu_sec() - t;
+
+    if (memcmp(back, data, total) != 0) {
+        printf("Zip: decompressed data differs\n");
+        goto done;
+    }
+
+    ret = STORE_OK;
+
+done:
+    if (cdict) ZSTD_freeCDict(cdict);
+    if (ddict) ZSTD_freeDDict(ddict);
+    if (cctx) ZSTD_freeCCtx(cctx);
+    if (dctx) ZSTD_freeDCtx(dctx);
+    free(d);
+    free(train);
+    free(ts);
+    free(at);
+    free(out);
+    free(back);
+    free(zs);
+    return(ret);
+}
+
+#else /* SPS_ZSTD */
+
+int zip_segments(const char *, uint16_t, int, int, struct zip_stats *)
+{
+    printf("Zip: compression is not supported in this build (make ZSTD=yes)\n");
+    return(STORE_ERROR);
+}
+
+int zip_bench(const uint8_t *, const size_t *, int, int, bool, struct zip_bench_result *)
+{
+    printf("Zip: compression is not supported in this build (make ZSTD=yes)\n");
+    return(STORE_ERROR);
+}
+
+#endif /* SPS_ZSTD */
+
+/*********************************************************************
+ *  reading
+ *********************************************************************/
+
+struct zip_reader
+{
+    int      fd;
+    struct zip_header hdr;
+    uint8_t  *block;            // decompressed block
+    uint32_t cached;            // offset of it in the segment, 0 = none
+    uint8_t  *frame;            // compressed block
+    size_t   frame_size;
+#ifdef SPS_ZSTD
+    ZSTD_DCtx  *dctx;
+    ZSTD_DDict *ddict;
+#endif
+};
+
+/**
+ * @brief open a compressed segment
+ */
+struct zip_reader *zip_open(const char *dir, uint16_t sensor, uint32_t seg)
+{
+    char    name[PATH_MAX];
+    int     fd;
+
+    store_zip_name(name, sizeof(name), dir, sensor, seg);
+
+    if ((fd = open(name, O_RDONLY)) < 0) return(NULL);
+
+#ifndef SPS_ZSTD
+    static int told = 0;
+
+    // once, a query can open many segments (from more threads)
+    if (__atomic_exchange_n(&told, 1, __ATOMIC_RELAXED) == 0)
+        printf("Zip: %s is compressed, this build can not read it (make ZSTD=yes)\n", name);
+
+    close(fd);
+    return(NULL);
+#else
+    struct  zip_reader *z;
+    uint8_t *dict;
+    size_t  dlen;
+
+    if ((z = (struct zip_reader *) calloc(1, sizeof(struct zip_reader))) == NULL) {
+        close(fd);
+        return(NULL);
+    }
+
+    z->fd = fd;
+
+    if (pread(fd, &z->hdr, sizeof(z->hdr), 0) != sizeof(z->hdr) || z->hdr.magic != ZIP_MAGIC
+        || z->hdr.version != ZIP_VERSION || z->hdr.crc != crc32c(0, &z->hdr, offsetof(struct zip_header, crc))) {
+        printf("Zip: header of %s is corrupt\n", name);
+        zip_close(z);
+        return(NULL);
+    }
+
+    if (z->hdr.dict) {
+        zip_dict_name(name, sizeof(name), dir, z->hdr.dict);
+
+        if ((dict = read_file(name, &dlen)) == NULL) {
+            printf("Zip: can not read dictionary %s\n", name);
+            zip_close(z);
+            return(NULL);
+        }
+
+        z->ddict = ZSTD_createDDict(dict, dlen);
+        free(dict);
+    }
+
+    z->dctx = ZSTD_createDCtx();
+    z->block = (uint8_t *) malloc(STORE_BLOCK_SIZE);
+
+    if (z->dctx == NULL || z->block == NULL || (z->hdr.dict && z->ddict == NULL)) {
+        zip_close(z);
+        return(NULL);
+    }
+
+    return(z);
+#endif
+}
+
+const struct zip_header *zip_get_header(struct zip_reader *z)
+{
+    return(&z->hdr);
+}
+
+/**
+ * @brief get a block of a compressed segment
+ */
+const struct store_blk_header *zip_block(struct zip_reader *z, uint32_t offset)
+{
+#ifdef SPS_ZSTD
+    const struct zip_block *b;
+    uint32_t i = (offset - STORE_HDR_SIZE) / STORE_BLOCK_SIZE;
+    size_t  r;
+
+    if (offset == z->cached) return((const struct store_blk_header *) z->block);
+
+    if (offset < STORE_HDR_SIZE || i >= STORE_SEG_BLOCKS) return(NULL);
+
+    b = &z->hdr.block[i];
+    if (b->offset == 0 || b->raw > STORE_BLOCK_SIZE) return(NULL);
+
+    if (b->length > z->frame_size) {
+        free(z->frame);
+        z->frame_size = b->length;
+        if ((z->frame = (uint8_t *) malloc(z->frame_size)) == NULL) {
+            z->frame_size = 0;
+            return(NULL);
+        }
+    }
+
+    z->cached = 0;
+
+    if (pread(z->fd, z->frame, b->length, b->offset) != (ssize_t) b->length) return(NULL);
+
+    if (z->ddict) r = ZSTD_decompress_usingDDict(z->dctx, z->block, STORE_BLOCK_SIZE, z->frame, b->length, z->ddict);
+    else r = ZSTD_decompressDCtx(z->dctx, z->block, STORE_BLOCK_SIZE, z->frame, b->length);
+
+    // the frame checksum is checked as well
+    if (ZSTD_isError(r) || r != b->raw) return(NULL);
+
+    z->cached = offset;
+    return((const struct store_blk_header *) z->block);
+#else
+    (void) z;
+    (void) offset;
+    return(NULL);
+#endif
+}
+
+/**
+ * @brief close a compressed segment
+ */
+void zip_close(struct zip_reader *z)
+{
+    if (z == NULL) return;
+
+#ifdef SPS_ZSTD
+    if (z->ddict) ZSTD_freeDDict(z->ddict);
+    if (z->dctx) ZSTD_freeDCtx(z->dctx);
+#endif
+
+    if (z->fd > -1) close(z->fd);
+    free(z->block);
+    free(z->frame);
+    free(z);
+}
+
+/*********************************************************************
+ *  background compressor
+ *********************************************************************/
+
+SPSzip::SPSzip(void)
+{
+    _dir[0] = 0x0;
+    _sensor = 0;
+    _level = ZIP_LEVEL;
+    _verbose = 0;
+    _running = _stop = false;
+    memset(&_st, 0x0, sizeof(_st));
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+}
+
+/**
+ * @brief start the background compressor
+ */
+int SPSzip::start(const char *dir, uint16_t sensor, int level, int verbose)
+{
+#ifndef SPS_ZSTD
+    printf("Zip: compression is not supported in this build (make ZSTD=yes)\n");
+    return(STORE_ERROR);
+#endif
+
+    strncpy(_dir, dir, sizeof(_dir) - 1);
+    _sensor = sensor;
+    _level = level;
+    _verbose = verbose;
+    _stop = false;
+
+    if (pthread_create(&_thread, NULL, thread, this) != 0) {
+        printf("Zip: can not start compressor\n");
+        return(STORE_ERROR);
+    }
+
+    _running = true;
+    return(STORE_OK);
+}
+
+/**
+ * @brief stop the background compressor
+ */
+void SPSzip::stop()
+{
+    if (! _running) return;
+
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_lock);
+
+    pthread_join(_thread, NULL);
+    _running = false;
+}
+
+/**
+ * @brief the background thread
+ */
+void *SPSzip::thread(void *arg)
+{
+    SPSzip *me = (SPSzip *) arg;
+    struct zip_stats st;
+    struct sched_param sp;
+    struct timespec ts;
+    sigset_t set;
+
+    // signals are handled by the main thread
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    // only run when nothing else wants the CPU
+    memset(&sp, 0x0, sizeof(sp));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+
+    pthread_mutex_lock(&me->_lock);
+
+    while (! me->_stop) {
+        pthread_mutex_unlock(&me->_lock);
+
+        memset(&st, 0x0, sizeof(st));
+        zip_segments(me->_dir, me->_sensor, me->_level, me->_verbose, &st);
+
+        pthread_mutex_lock(&me->_lock);
+
+        me->_st.segments += st.segments;
+        me->_st.raw_bytes += st.raw_bytes;
+        me->_st.zip_bytes += st.zip_bytes;
+        me->_st.disk_bytes += st.disk_bytes;
+        me->_st.cpu += st.cpu;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += ZIP_INTERVAL;
+
+        while (! me->_stop) {
+            if (pthread_cond_timedwait(&me->_cond, &me->_lock, &ts) != 0) break;
+        }
+    }
+
+    pthread_mutex_unlock(&me->_lock);
+    return(NULL);
+}
+
+/**
+ * @brief get the statistics
+ */
+void SPSzip::stats(struct zip_stats *st)
+{
+    pthread_mutex_lock(&_lock);
+    *st = _st;
+    pthread_mutex_unlock(&_lock);
+}
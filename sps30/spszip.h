@@ -0,0 +1,187 @@
+/**
+ * SPS30 segment compression header file for Raspberry Pi
+ *
+ * Copyright (c) October 2026, Paul van Haastrecht
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Compression of sealed segments with zstd (build with make ZSTD=yes).
+ *
+ * A segment is sealed when the store has moved on to a next segment.
+ * A background thread with idle priority compresses each sealed
+ * segment into
+ *
+ *  sNNN_TTTTTTTTTT.zsg
+ *
+ * and then removes the .seg file. Each block is compressed on its own
+ * (one zstd frame with checksum), and a table in the header gives the
+ * position of each frame, so a reader decompresses only the blocks it
+ * needs. SPSread, the query engine and store_verify() read a .zsg file
+ * when the .seg file is not there, so this is transparent to them.
+ *
+ * Blocks of samples are small and alike, so a dictionary trained on
+ * blocks of the store itself improves the ratio a lot. It is stored as
+ *
+ *  zDDDDDDDDDD.dict
+ *
+ * by dictionary id, which is kept in the header of each .zsg file. A
+ * dictionary is trained on the first pass that finds ZIP_TRAIN_MIN
+ * blocks, and is shared by the sensors in the directory.
+ *********************************************************************
+*/
+#ifndef SPSZIP_H
+#define SPSZIP_H
+
+# include "spsstore.h"
+
+#define ZIP_MAGIC           0x5350535a      // "SPSZ"
+#define ZIP_VERSION         1
+#define ZIP_HDR_SIZE        4096
+
+#define ZIP_LEVEL           3               // default zstd level
+#define ZIP_DICT_SIZE       16384           // size of a trained dictionary
+#define ZIP_TRAIN_MIN       16              // blocks needed to train
+#define ZIP_TRAIN_MAX       512             // blocks used to train
+#define ZIP_INTERVAL        600             // seconds between passes
+
+/* position of a compressed block */
+struct zip_block
+{
+    uint32_t offset;        // in .zsg file, 0 = no block
+    uint32_t length;        // compressed length
+    uint32_t raw;           // length of block header and records
+};
+
+/* header of a .zsg file */
+struct zip_header
+{
+    uint32_t magic;         // ZIP_MAGIC
+    uint16_t version;       // ZIP_VERSION
+    uint16_t sensor;
+    uint32_t seg;           // segment id
+    uint32_t dict;          // dictionary id, 0 = none
+    int32_t  level;         // zstd level
+    uint32_t blocks;        // blocks present
+    uint64_t raw_bytes;     // bytes of the blocks before compression
+    uint64_t zip_bytes;     // bytes of the frames
+    struct store_seg_header hdr;            // of the segment
+    struct zip_block block[STORE_SEG_BLOCKS];
+    uint32_t crc;           // CRC32C of the fields above
+};
+
+/* statistics of the compressor */
+struct zip_stats
+{
+    uint32_t segments;      // segments compressed
+    uint64_t raw_bytes;     // block bytes before compression
+    uint64_t zip_bytes;     // bytes after compression
+    uint64_t disk_bytes;    // bytes the .seg files took on disk
+    double   cpu;           // CPU seconds used
+};
+
+/* result of zip_bench() */
+struct zip_bench_result
+{
+    uint64_t raw_bytes;
+    uint64_t zip_bytes;
+    double   comp_cpu;      // CPU seconds to compress
+    double   decomp_cpu;    // CPU seconds to decompress
+    double   train_cpu;     // CPU seconds to train the dictionary
+};
+
+/**
+ * @brief name of a dictionary file
+ */
+void zip_dict_name(char *buf, int len, const char *dir, uint32_t id);
+
+/**
+ * @brief compress the sealed segments of a sensor that are not yet
+ * compressed, training a dictionary first if there is none
+ * @param level   : zstd level
+ * @param st      : statistics, added to (or NULL)
+ *
+ * @return number of segments compressed or STORE_ERROR
+ */
+int zip_segments(const char *dir, uint16_t sensor, int level, int verbose, struct zip_stats *st);
+
+/**
+ * @brief compress buffers one by one and decompress them again
+ * @param data  : buffers after each other
+ * @param sizes : size of each buffer
+ * @param n     : number of buffers
+ * @param dict  : if true train a dictionary on every other buffer first
+ *
+ * @return
+ *  STORE_OK success
+ *  STORE_ERROR error (or no zstd in this build)
+ */
+int zip_bench(const uint8_t *data, const size_t *sizes, int n, int level, bool dict,
+              struct zip_bench_result *r);
+
+/**
+ * @brief read a compressed segment
+ *
+ * zip_open() returns NULL if there is no .zsg file (or it can not be
+ * read). zip_block() returns the block at an offset of the original
+ * segment. It stays valid until the next call.
+ */
+struct zip_reader;
+struct zip_reader *zip_open(const char *dir, uint16_t sensor, uint32_t seg);
+const struct zip_header *zip_get_header(struct zip_reader *z);
+const struct store_blk_header *zip_block(struct zip_reader *z, uint32_t offset);
+void zip_close(struct zip_reader *z);
+
+class SPSzip
+{
+  public:
+
+    SPSzip(void);
+
+    /**
+     * @brief start the background compressor
+     * @param dir     : store directory
+     * @param sensor  : sensor id
+     * @param level   : zstd level
+     * @param verbose : if > 0 progress messages are displayed
+     *
+     * @return
+     *  STORE_OK success
+     *  STORE_ERROR error
+     */
+    int start(const char *dir, uint16_t sensor, int level, int verbose);
+
+    /**
+     * @brief stop the background compressor (waits for the current pass)
+     */
+    void stop();
+
+    /**
+     * @brief get the statistics
+     */
+    void stats(struct zip_stats *st);
+
+  private:
+    char     _dir[PATH_MAX - 32];
+    uint16_t _sensor;
+    int      _level;
+    int      _verbose;
+    struct zip_stats _st;
+    bool     _running;
+    bool     _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t  _cond;
+
+    static void *thread(void *arg);
+};
+
+#endif /* SPSZIP_H */